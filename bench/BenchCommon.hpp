@@ -0,0 +1,62 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file BenchCommon.hpp
+ * @brief Shared timing helpers for the native benchmarks in this folder.
+ *
+ * The benchmarks are plain host programs, built next to the native unit tests:
+ *   g++ -std=c++17 -O2 -Iinclude bench/bench_<name>.cpp -o bench_<name>
+ */
+
+#ifndef BENCH_COMMON_HPP
+#define BENCH_COMMON_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace BENCH
+{
+    /**
+     * @brief Prevents the compiler from optimizing away a computed value.
+     */
+    template <typename T>
+    inline void doNotOptimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /**
+     * @brief Runs a callable a number of times and returns the mean time per call.
+     *
+     * @param iterations Number of calls.
+     * @param fn Callable taking the iteration index.
+     * @return double Nanoseconds per call.
+     */
+    template <typename Fn>
+    inline double nsPerCall(const uint64_t iterations, Fn &&fn)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; i++)
+        {
+            fn(i);
+        }
+        const auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+    }
+
+    /**
+     * @brief Prints one result line in a fixed format.
+     */
+    inline void report(const char *name, const double nsPerOp)
+    {
+        std::printf("%-40s %10.1f ns/op %12.0f ops/s\n", name, nsPerOp, 1e9 / nsPerOp);
+    }
+} // End of Namespace BENCH.
+#endif // BENCH_COMMON_HPP
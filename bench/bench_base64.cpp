@@ -0,0 +1,223 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file bench_base64.cpp
+ * @brief Compares the base64 kernels of ingest/Base64.hpp, alone and inside the ingest decode path.
+ *
+ * The workload is PUSH_DATA traffic of the fleet generator, as the replay client sends it. The
+ * end-to-end path is the per-datagram work of ingest/ingest_daemon.cpp without the socket:
+ * rxpk JSON, base64 into the arena, PHYPayload and CayenneLPP decoding. A second workload uses
+ * 222-byte FRMPayloads, the largest at DR5, where the vector kernels have the most to do.
+ * Before timing, every kernel is checked against the scalar one on valid and corrupted texts.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "BenchCommon.hpp"
+#include "../ingest/Base64.hpp"
+#include "../ingest/DecodeArena.hpp"
+#include "../ingest/LoRaWanFrame.hpp"
+#include "../ingest/SemtechUdp.hpp"
+#include "../ingest/UplinkDecoder.hpp"
+#include "../tools/FleetGenerator.hpp"
+
+using namespace INGEST;
+
+struct Text
+{
+    std::vector<char> characters;
+};
+
+static const BASE64_KERNEL KERNELS[] = {BASE64_KERNEL::SCALAR, BASE64_KERNEL::SSE41, BASE64_KERNEL::AVX2};
+static const char *const KERNEL_NAMES[] = {"scalar", "sse4.1", "avx2"};
+
+// PUSH_DATA datagrams of four rxpk each, from the fleet generator or with fixed-size payloads.
+static std::vector<std::vector<uint8_t>> buildDatagrams(const size_t count, const size_t payloadSize)
+{
+    FLEET::FleetConfig config;
+    config.nodes = 10000;
+    FLEET::FleetGenerator generator(config);
+    std::vector<std::vector<uint8_t>> datagrams(count);
+    uint8_t payload[255];
+    srand(7);
+    for (size_t d = 0; d < count; d++)
+    {
+        std::vector<uint8_t> &datagram = datagrams[d];
+        datagram.resize(PUSH_DATA_HEADER_SIZE);
+        writePushDataHeader(static_cast<uint16_t>(d), 0xAA555A0000000000ULL, datagram.data());
+        const char *open = "{\"rxpk\":[";
+        datagram.insert(datagram.end(), open, open + std::strlen(open));
+        for (int r = 0; r < 4; r++)
+        {
+            FLEET::FleetFrame frame;
+            generator.next(frame);
+            const uint8_t *frm = frame.payload;
+            size_t frmSize = frame.size;
+            if (payloadSize)
+            {
+                // A CayenneLPP run of analog inputs of the requested size.
+                for (size_t i = 0; i + 4 <= payloadSize; i += 4)
+                {
+                    payload[i] = static_cast<uint8_t>(i / 4);
+                    payload[i + 1] = static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::ANL_IN);
+                    payload[i + 2] = static_cast<uint8_t>(rand());
+                    payload[i + 3] = static_cast<uint8_t>(rand());
+                }
+                frm = payload;
+                frmSize = payloadSize / 4 * 4;
+                frame.fPort = KISS::FPORT_CAYENNE;
+            }
+            uint8_t phy[255 + 13];
+            const size_t phySize = writeDataUplink(frame.devAddr, frame.fCnt, frame.fPort, frm, frmSize, phy);
+            char json[600];
+            const size_t length = writeRxpk(static_cast<uint32_t>(frame.timeUs), frame.spreadingFactor, frame.snrQuarterDb / 4.0f,
+                                            frame.rssi, phy, phySize, json, sizeof(json));
+            if (r)
+            {
+                datagram.push_back(',');
+            }
+            datagram.insert(datagram.end(), json, json + length);
+        }
+        datagram.push_back(']');
+        datagram.push_back('}');
+    }
+    return datagrams;
+}
+
+static std::vector<Text> extractTexts(const std::vector<std::vector<uint8_t>> &datagrams)
+{
+    std::vector<Text> texts;
+    for (const std::vector<uint8_t> &datagram : datagrams)
+    {
+        PushDataHeader header;
+        if (!parsePushData(datagram.data(), datagram.size(), header))
+        {
+            continue;
+        }
+        RxpkReader reader(header.json, header.jsonLength);
+        Rxpk rxpk;
+        while (reader.next(rxpk))
+        {
+            texts.push_back({std::vector<char>(rxpk.data, rxpk.data + rxpk.dataLength)});
+        }
+    }
+    return texts;
+}
+
+// Every kernel must agree with the scalar decoder, on the corpus and on corrupted copies of it.
+static bool verifyKernels(const std::vector<Text> &texts)
+{
+    std::vector<uint8_t> expected(512);
+    std::vector<uint8_t> actual(512);
+    for (const BASE64_KERNEL kernel : KERNELS)
+    {
+        if (!isBase64KernelSupported(kernel))
+        {
+            continue;
+        }
+        srand(11);
+        for (size_t t = 0; t < texts.size(); t++)
+        {
+            std::vector<char> text = texts[t].characters;
+            for (int variant = 0; variant < 3; variant++)
+            {
+                if (variant == 1)
+                {
+                    text[rand() % text.size()] = static_cast<char>(rand() % 256);
+                }
+                else if (variant == 2)
+                {
+                    text[rand() % (text.size() - 4)] = '=';
+                }
+                const size_t expectedSize = decodeBase64Scalar(text.data(), text.size(), expected.data());
+                const size_t actualSize = decodeBase64(text.data(), text.size(), actual.data(), kernel);
+                if (expectedSize != actualSize || std::memcmp(expected.data(), actual.data(), expectedSize))
+                {
+                    std::printf("%s disagrees with scalar on text %zu, variant %d\n", KERNEL_NAMES[static_cast<size_t>(kernel)], t, variant);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static void run(const char *workload, const size_t payloadSize, const uint64_t iterations)
+{
+    const std::vector<std::vector<uint8_t>> datagrams = buildDatagrams(1024, payloadSize);
+    const std::vector<Text> texts = extractTexts(datagrams);
+    if (!verifyKernels(texts))
+    {
+        std::exit(1);
+    }
+    size_t characters = 0;
+    for (const Text &text : texts)
+    {
+        characters += text.characters.size();
+    }
+    std::printf("%s: %zu characters of base64 per rxpk on average\n", workload, characters / texts.size());
+
+    DecodeArena arena(64 * 1024);
+    UplinkDecoder decoder;
+    DecodedField fields[UplinkDecoder::MAX_FIELDS];
+    for (const BASE64_KERNEL kernel : KERNELS)
+    {
+        if (!isBase64KernelSupported(kernel))
+        {
+            std::printf("  %-8s not supported by this CPU\n", KERNEL_NAMES[static_cast<size_t>(kernel)]);
+            continue;
+        }
+        const double base64Ns = BENCH::nsPerCall(iterations, [&](uint64_t i) {
+            const Text &text = texts[i & (texts.size() - 1)];
+            if ((i & 63) == 0)
+            {
+                arena.reset();
+            }
+            uint8_t *phy = arena.allocate(getBase64DecodedSize(text.characters.size()));
+            BENCH::doNotOptimize(decodeBase64(text.characters.data(), text.characters.size(), phy, kernel));
+        });
+        // One datagram of four rxpk per call.
+        const double datagramNs = BENCH::nsPerCall(iterations / 4, [&](uint64_t i) {
+            const std::vector<uint8_t> &datagram = datagrams[i & (datagrams.size() - 1)];
+            arena.reset();
+            PushDataHeader header;
+            if (!parsePushData(datagram.data(), datagram.size(), header))
+            {
+                return;
+            }
+            RxpkReader reader(header.json, header.jsonLength);
+            Rxpk rxpk;
+            while (reader.next(rxpk))
+            {
+                const size_t reserved = getBase64DecodedSize(rxpk.dataLength);
+                uint8_t *phy = arena.allocate(reserved);
+                const size_t phySize = decodeBase64(rxpk.data, rxpk.dataLength, phy, kernel);
+                arena.shrink(phy, reserved, phySize);
+                DataUplink uplink;
+                if (phySize && parseDataUplink(phy, phySize, uplink))
+                {
+                    BENCH::doNotOptimize(decoder.decode(uplink.fPort, uplink.payload, uplink.size, fields));
+                    BENCH::doNotOptimize(fields[0].values[0]);
+                }
+            }
+        });
+        std::printf("  %-8s base64 %7.1f ns/rxpk (%5.2f GB/s)   end-to-end %7.1f ns/rxpk (%4.1f M rxpk/s)\n",
+                    KERNEL_NAMES[static_cast<size_t>(kernel)], base64Ns, characters / texts.size() / base64Ns,
+                    datagramNs / 4, 4e3 / datagramNs);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4000000;
+    run("fleet traffic", 0, iterations);
+    run("222-byte payloads", 222, iterations);
+    return 0;
+}
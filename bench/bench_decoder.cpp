@@ -0,0 +1,89 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file bench_decoder.cpp
+ * @brief Compares the layout-cached decoder against a full header walk.
+ *
+ * The workload is the six-field KISS frame from src/main.cpp with changing sensor values,
+ * interleaved with a second firmware layout at a configurable share of the traffic.
+ */
+
+#include <cstdlib>
+#include <vector>
+#include "BenchCommon.hpp"
+#include "../include/CayenneLPP.hpp"
+#include "../include/CayenneDecoder.hpp"
+
+using namespace PAYLOAD_ENCODER;
+
+struct Frame
+{
+    uint8_t bytes[52];
+    uint8_t size;
+};
+
+static std::vector<Frame> buildCorpus(const size_t count, const unsigned otherLayoutPercent)
+{
+    std::vector<Frame> corpus(count);
+    CayenneLPP<52> lpp(51);
+    srand(42);
+    for (size_t i = 0; i < count; i++)
+    {
+        const float noise = (rand() % 1000) / 100.0f;
+        lpp.reset();
+        if (static_cast<unsigned>(rand() % 100) < otherLayoutPercent)
+        {
+            lpp.addTemperature(0, 15.0f + noise);
+            lpp.addAnalogInput(5, 3.0f + noise / 100);
+        }
+        else
+        {
+            lpp.addDigitalInput(3, rand() % 10);
+            lpp.addTemperature(0, 15.0f + noise);
+            lpp.addHumidity(1, 40.0f + noise);
+            lpp.addIllumination(2, static_cast<uint16_t>(rand() % 1000));
+            lpp.addAccelerometer(4, noise / 100, -1.0f + noise / 1000, 0.02f);
+            lpp.addAnalogInput(5, 3.0f + noise / 100);
+        }
+        corpus[i].size = static_cast<uint8_t>(lpp.copy(corpus[i].bytes));
+    }
+    return corpus;
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+    const unsigned mixes[] = {0, 10, 50};
+
+    for (const unsigned mix : mixes)
+    {
+        const std::vector<Frame> corpus = buildCorpus(4096, mix);
+        CayenneDecoder<8> decoder;
+        DecodedField fields[8];
+
+        const double walked = BENCH::nsPerCall(iterations, [&](uint64_t i) {
+            const Frame &frame = corpus[i & 4095];
+            BENCH::doNotOptimize(CayenneDecoder<8>::decodeUncached(frame.bytes, frame.size, fields));
+            BENCH::doNotOptimize(fields[0].values[0]);
+        });
+        const double cached = BENCH::nsPerCall(iterations, [&](uint64_t i) {
+            const Frame &frame = corpus[i & 4095];
+            BENCH::doNotOptimize(decoder.decode(frame.bytes, frame.size, fields));
+            BENCH::doNotOptimize(fields[0].values[0]);
+        });
+
+        const double hits = decoder.getCacheHits();
+        const double total = hits + decoder.getCacheMisses();
+        std::printf("-- second layout share: %u%%\n", mix);
+        BENCH::report("decode, header walk", walked);
+        BENCH::report("decode, layout cache", cached);
+        std::printf("cache hit rate: %.2f%%, speedup: %.2fx\n\n", 100.0 * hits / total, walked / cached);
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file bench_dedup.cpp
+ * @brief Measures cross-gateway deduplication in front of the decoder at several duplicate ratios.
+ *
+ * Fleet traffic from five gateways, where a share of the uplinks is heard by two to five of
+ * them, is decoded once with every copy and once behind an UplinkDeduplicator with a 250 ms
+ * window, expired every 50 ms of traffic time. Before timing, the run checks that exactly one
+ * copy of every uplink reaches the decoder and that the merged metadata accounts for all copies.
+ */
+
+#include <cstdlib>
+#include <vector>
+#include "BenchCommon.hpp"
+#include "../ingest/FrameDescriptor.hpp"
+#include "../ingest/UplinkDecoder.hpp"
+#include "../ingest/UplinkDeduplicator.hpp"
+#include "../tools/FleetGenerator.hpp"
+
+using namespace INGEST;
+
+static const uint64_t WINDOW_NS = 250000000;
+static const uint64_t EXPIRE_PERIOD_NS = 50000000;
+
+using Deduplicator = UplinkDeduplicator<16, 256>;
+
+static FrameDescriptor toDescriptor(const FLEET::FleetFrame &frame)
+{
+    FrameDescriptor descriptor = {};
+    descriptor.payload = frame.payload;
+    descriptor.receivedNs = frame.timeUs * 1000;
+    descriptor.devAddr = frame.devAddr;
+    descriptor.size = frame.size;
+    descriptor.fCnt = frame.fCnt;
+    descriptor.rssi = frame.rssi;
+    descriptor.snrQuarterDb = frame.snrQuarterDb;
+    descriptor.fPort = frame.fPort;
+    descriptor.gateway = frame.gateway;
+    return descriptor;
+}
+
+struct Tally
+{
+    uint64_t passed = 0;
+    uint64_t merged = 0;
+    uint64_t copies = 0;
+    uint64_t evicted = 0;
+    uint64_t fields = 0;
+};
+
+// Runs the traffic through dedup and decode, the way a decode stage would.
+static Tally runDedup(const std::vector<FrameDescriptor> &traffic, UplinkDecoder &decoder)
+{
+    Deduplicator deduplicator(WINDOW_NS);
+    DecodedField fields[UplinkDecoder::MAX_FIELDS];
+    Tally tally;
+    auto retire = [&tally](const MergedUplink &merged) {
+        tally.merged++;
+        tally.copies += merged.copies;
+        tally.evicted += merged.evicted;
+    };
+    uint64_t nextExpiry = traffic.empty() ? 0 : traffic.front().receivedNs + EXPIRE_PERIOD_NS;
+    for (const FrameDescriptor &frame : traffic)
+    {
+        if (frame.receivedNs >= nextExpiry)
+        {
+            deduplicator.expire(frame.receivedNs, retire);
+            nextExpiry = frame.receivedNs + EXPIRE_PERIOD_NS;
+        }
+        if (deduplicator.observe(frame, retire))
+        {
+            tally.passed++;
+            tally.fields += decoder.decode(frame.fPort, frame.payload, frame.size, fields);
+        }
+    }
+    deduplicator.expire(UINT64_MAX, retire);
+    return tally;
+}
+
+static void run(const float duplicateRatio, const uint64_t frames)
+{
+    FLEET::FleetConfig config;
+    config.gateways = 5;
+    config.duplicateRatio = duplicateRatio;
+    FLEET::FleetGenerator generator(config);
+    std::vector<FLEET::FleetFrame> fleetFrames(frames);
+    for (FLEET::FleetFrame &frame : fleetFrames)
+    {
+        generator.next(frame);
+    }
+    std::vector<FrameDescriptor> traffic;
+    traffic.reserve(frames);
+    for (const FLEET::FleetFrame &frame : fleetFrames)
+    {
+        traffic.push_back(toDescriptor(frame));
+    }
+
+    // Copies of uplinks still in flight when the traffic stops have not been delivered.
+    uint64_t uplinks = 0;
+    {
+        std::vector<uint8_t> seen(config.nodes * size_t(65536) / 8);
+        for (const FrameDescriptor &frame : traffic)
+        {
+            const size_t bit = (frame.devAddr & 0xFFFFFF) * size_t(65536) + frame.fCnt;
+            uplinks += !(seen[bit / 8] >> (bit % 8) & 1);
+            seen[bit / 8] |= static_cast<uint8_t>(1 << (bit % 8));
+        }
+    }
+    UplinkDecoder decoder;
+    const Tally tally = runDedup(traffic, decoder);
+    if (tally.passed != uplinks || tally.merged != uplinks || tally.copies != traffic.size() || tally.evicted)
+    {
+        std::printf("MISMATCH at ratio %.1f: %llu uplinks, %llu decoded, %llu merged, %llu of %zu copies, %llu evicted\n", duplicateRatio,
+                    static_cast<unsigned long long>(uplinks), static_cast<unsigned long long>(tally.passed),
+                    static_cast<unsigned long long>(tally.merged), static_cast<unsigned long long>(tally.copies), traffic.size(),
+                    static_cast<unsigned long long>(tally.evicted));
+        std::exit(1);
+    }
+
+    std::printf("duplicate ratio %.1f: %.2f copies per uplink\n", duplicateRatio, static_cast<double>(traffic.size()) / uplinks);
+    DecodedField fields[UplinkDecoder::MAX_FIELDS];
+    const double decodeAll = BENCH::nsPerCall(traffic.size(), [&](uint64_t i) {
+        const FrameDescriptor &frame = traffic[i];
+        BENCH::doNotOptimize(decoder.decode(frame.fPort, frame.payload, frame.size, fields));
+    });
+    BENCH::report("  decode every copy", decodeAll);
+    const auto start = std::chrono::steady_clock::now();
+    BENCH::doNotOptimize(runDedup(traffic, decoder).fields);
+    const double dedup = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / traffic.size();
+    BENCH::report("  dedup, decode first copy", dedup);
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t frames = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+    for (const float ratio : {0.0f, 0.3f, 0.6f, 0.9f})
+    {
+        run(ratio, frames);
+    }
+    return 0;
+}
@@ -0,0 +1,249 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file bench_pipeline.cpp
+ * @brief Measures the latency of the ingest → decode → sink handoff at a fixed frame rate.
+ *
+ * An ingest thread copies fleet payloads into shared arenas at a paced rate (1M frames/s by
+ * default) and stamps each descriptor. Decode threads run UplinkDecoder on them and pass them
+ * to a sink thread, which records the time since the stamp in a LatencyHistogram and releases
+ * the arenas. The same pipeline runs over SpscQueue, MpmcQueue and a std::mutex + std::deque
+ * baseline, each with single-frame and 16-frame batches. Latency includes waiting for a full
+ * queue, so a configuration that cannot keep up with the rate shows it in the tail.
+ *   g++ -std=c++17 -O2 -Iinclude bench/bench_pipeline.cpp -o bench_pipeline -pthread
+ *   ./bench_pipeline [frames] [frames per second] [decoders]
+ * Give it at least decoders + 2 cores; with fewer, the numbers are those of the scheduler.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "BenchCommon.hpp"
+#include "../ingest/FrameDescriptor.hpp"
+#include "../ingest/LatencyHistogram.hpp"
+#include "../ingest/RingQueue.hpp"
+#include "../ingest/UplinkDecoder.hpp"
+#include "../tools/FleetGenerator.hpp"
+
+using namespace INGEST;
+
+static const size_t QUEUE_CAPACITY = 1024;
+static const size_t MAX_BATCH = 16;
+
+/**
+ * @brief The baseline: a bounded deque behind a mutex, with the same interface as the ring queues.
+ */
+template <typename T, size_t Capacity>
+class LockedQueue
+{
+public:
+    size_t pushBatch(const T *items, const size_t count)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t pushed = 0;
+        for (; pushed < count && queue.size() < Capacity; pushed++)
+        {
+            queue.push_back(items[pushed]);
+        }
+        return pushed;
+    }
+
+    size_t popBatch(T *items, const size_t maximum)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t popped = 0;
+        for (; popped < maximum && !queue.empty(); popped++)
+        {
+            items[popped] = queue.front();
+            queue.pop_front();
+        }
+        return popped;
+    }
+
+private:
+    std::mutex mutex;
+    std::deque<T> queue;
+};
+
+static uint64_t nowNs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Pushes the whole batch, waiting while the queue is full.
+template <typename Queue>
+static void pushAll(Queue &queue, const FrameDescriptor *items, const size_t count)
+{
+    for (size_t sent = 0; sent < count;)
+    {
+        const size_t pushed = queue.pushBatch(items + sent, count - sent);
+        sent += pushed;
+        if (pushed == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+struct Result
+{
+    LatencyHistogram latency;
+    uint64_t fields = 0;
+    double seconds = 0;
+};
+
+/**
+ * @brief Runs frames through ingest → decoders → sink over the queue types given.
+ */
+template <typename DecodeQueue, typename SinkQueue>
+static Result runPipeline(const std::vector<FLEET::FleetFrame> &traffic, const uint64_t frames, const double rate,
+                          const size_t batch, const unsigned decoders)
+{
+    DecodeQueue *decodeQueue = new DecodeQueue();
+    SinkQueue *sinkQueue = new SinkQueue();
+    ArenaPool<256> pool(batch * FLEET::MAX_PAYLOAD);
+    std::atomic<uint64_t> decoded(0);
+    std::atomic<uint64_t> fields(0);
+    Result result;
+
+    std::vector<std::thread> threads;
+    for (unsigned d = 0; d < decoders; d++)
+    {
+        threads.emplace_back([&] {
+            UplinkDecoder decoder;
+            DecodedField decodedFields[UplinkDecoder::MAX_FIELDS];
+            FrameDescriptor items[MAX_BATCH];
+            uint64_t count = 0;
+            while (decoded.load(std::memory_order_relaxed) < frames)
+            {
+                const size_t popped = decodeQueue->popBatch(items, batch);
+                for (size_t i = 0; i < popped; i++)
+                {
+                    count += decoder.decode(items[i].fPort, items[i].payload, items[i].size, decodedFields);
+                }
+                if (popped == 0)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                pushAll(*sinkQueue, items, popped);
+                decoded.fetch_add(popped, std::memory_order_relaxed);
+            }
+            fields += count;
+        });
+    }
+    threads.emplace_back([&] {
+        FrameDescriptor items[MAX_BATCH];
+        for (uint64_t sunk = 0; sunk < frames;)
+        {
+            const size_t popped = sinkQueue->popBatch(items, batch);
+            const uint64_t now = nowNs();
+            for (size_t i = 0; i < popped; i++)
+            {
+                result.latency.record(now - items[i].receivedNs);
+                pool.release(items[i].arena);
+            }
+            sunk += popped;
+            if (popped == 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // Ingest on this thread: one arena per batch, batches due at a fixed rate.
+    const double batchIntervalNs = 1e9 * batch / rate;
+    const uint64_t start = nowNs();
+    FrameDescriptor items[MAX_BATCH];
+    for (uint64_t produced = 0, batchIndex = 0; produced < frames; batchIndex++)
+    {
+        const uint64_t due = start + static_cast<uint64_t>(batchIndex * batchIntervalNs);
+        while (nowNs() < due)
+        {
+        }
+        SharedArena *arena;
+        while ((arena = pool.acquire()) == nullptr)
+        {
+            std::this_thread::yield();
+        }
+        const uint64_t stamp = nowNs();
+        size_t count = 0;
+        for (; count < batch && produced + count < frames; count++)
+        {
+            const FLEET::FleetFrame &frame = traffic[(produced + count) % traffic.size()];
+            uint8_t *payload = arena->allocate(frame.size);
+            std::memcpy(payload, frame.payload, frame.size);
+            FrameDescriptor &item = items[count];
+            item.arena = arena;
+            item.payload = payload;
+            item.receivedNs = stamp;
+            item.devAddr = frame.devAddr;
+            item.size = frame.size;
+            item.fCnt = frame.fCnt;
+            item.rssi = frame.rssi;
+            item.snrQuarterDb = frame.snrQuarterDb;
+            item.fPort = frame.fPort;
+            item.gateway = frame.gateway;
+        }
+        arena->retain(static_cast<uint32_t>(count));
+        pushAll(*decodeQueue, items, count);
+        pool.release(arena);
+        produced += count;
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    result.seconds = (nowNs() - start) / 1e9;
+    result.fields = fields.load();
+    delete decodeQueue;
+    delete sinkQueue;
+    return result;
+}
+
+static void print(const char *name, const size_t batch, const Result &result)
+{
+    const LatencyHistogram &latency = result.latency;
+    std::printf("%-14s batch %2zu %9.0f frames/s  p50 %7llu  p99 %8llu  p99.9 %8llu  max %9llu ns\n", name, batch,
+                latency.getCount() / result.seconds,
+                static_cast<unsigned long long>(latency.getPercentile(50)),
+                static_cast<unsigned long long>(latency.getPercentile(99)),
+                static_cast<unsigned long long>(latency.getPercentile(99.9)),
+                static_cast<unsigned long long>(latency.getMax()));
+    BENCH::doNotOptimize(result.fields);
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t frames = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+    const double rate = argc > 2 ? strtod(argv[2], nullptr) : 1e6;
+    const unsigned decoders = argc > 3 ? static_cast<unsigned>(strtoul(argv[3], nullptr, 10)) : 2;
+
+    FLEET::FleetConfig config;
+    config.nodes = 10000;
+    FLEET::FleetGenerator generator(config);
+    std::vector<FLEET::FleetFrame> traffic(65536);
+    for (FLEET::FleetFrame &frame : traffic)
+    {
+        generator.next(frame);
+    }
+
+    std::printf("%llu frames at %.0f frames/s, %u decoders for MPMC and mutex\n", static_cast<unsigned long long>(frames), rate, decoders);
+    for (const size_t batch : {size_t(1), MAX_BATCH})
+    {
+        print("spsc", batch, runPipeline<SpscQueue<FrameDescriptor, QUEUE_CAPACITY>, SpscQueue<FrameDescriptor, QUEUE_CAPACITY>>(traffic, frames, rate, batch, 1));
+        print("mpmc", batch, runPipeline<MpmcQueue<FrameDescriptor, QUEUE_CAPACITY>, MpmcQueue<FrameDescriptor, QUEUE_CAPACITY>>(traffic, frames, rate, batch, decoders));
+        print("mutex + deque", batch, runPipeline<LockedQueue<FrameDescriptor, QUEUE_CAPACITY>, LockedQueue<FrameDescriptor, QUEUE_CAPACITY>>(traffic, frames, rate, batch, decoders));
+    }
+    return 0;
+}
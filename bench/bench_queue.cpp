@@ -0,0 +1,119 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file bench_queue.cpp
+ * @brief Measures queueing of CayenneLPP frames with the defaulted copy and move operations.
+ *
+ * LegacyLPP reproduces the previous user-defined copy operations, which looped byte by byte
+ * and made the class non-trivially copyable, so both can be compared on the same workload.
+ *
+ * Build with -march=native: for generic x86-64 tuning GCC lowers the 72-byte struct copy of
+ * CayenneLPP<52> to rep movs, whose startup cost hides the gain in the ring buffer case.
+ */
+
+#include <cstdlib>
+#include <deque>
+#include <vector>
+#include "BenchCommon.hpp"
+#include "../include/CayenneLPP.hpp"
+
+using namespace PAYLOAD_ENCODER;
+
+template <size_t MaxSize>
+struct LegacyLPP
+{
+    uint8_t buffer[MaxSize];
+    size_t operationalSize;
+    size_t currentIndex;
+
+    explicit LegacyLPP(const CayenneLPP<MaxSize> &lpp) : operationalSize(MaxSize), currentIndex(lpp.getSize())
+    {
+        lpp.copy(buffer);
+    }
+    LegacyLPP(const LegacyLPP &other) : operationalSize(other.operationalSize), currentIndex(other.currentIndex)
+    {
+        for (size_t i = 0; i < currentIndex; ++i)
+            buffer[i] = other.buffer[i];
+    }
+    LegacyLPP &operator=(const LegacyLPP &other)
+    {
+        if (this != &other)
+        {
+            currentIndex = other.currentIndex;
+            for (size_t i = 0; i < currentIndex; ++i)
+                buffer[i] = other.buffer[i];
+        }
+        return *this;
+    }
+    ~LegacyLPP() {}
+    size_t getSize() const { return currentIndex; }
+};
+
+template <typename Frame>
+static double dequeRoundTrip(const Frame &frame, const uint64_t iterations)
+{
+    std::deque<Frame> queue;
+    return BENCH::nsPerCall(iterations, [&](uint64_t i) {
+        queue.push_back(frame);
+        if ((i & 15) == 15)
+        {
+            while (!queue.empty())
+            {
+                Frame out = queue.front();
+                BENCH::doNotOptimize(out.getSize());
+                queue.pop_front();
+            }
+        }
+    });
+}
+
+template <typename Frame>
+static double vectorGrowth(const Frame &frame, const uint64_t iterations)
+{
+    return BENCH::nsPerCall(iterations / 256, [&](uint64_t) {
+        std::vector<Frame> frames;
+        for (int i = 0; i < 256; i++)
+            frames.push_back(frame);
+        BENCH::doNotOptimize(frames.back().getSize());
+    }) / 256;
+}
+
+template <typename Frame>
+static double ringBuffer(const Frame &frame, const uint64_t iterations)
+{
+    std::vector<Frame> ring(64, frame);
+    size_t head = 0;
+    return BENCH::nsPerCall(iterations, [&](uint64_t i) {
+        ring[head] = frame;
+        head = (head + 1) & 63;
+        Frame out = ring[(i * 7) & 63];
+        BENCH::doNotOptimize(out.getSize());
+    });
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    CayenneLPP<52> lpp(51);
+    lpp.addDigitalInput(3, 4);
+    lpp.addTemperature(0, 21.4f);
+    lpp.addHumidity(1, 45.5f);
+    lpp.addIllumination(2, 320);
+    lpp.addAccelerometer(4, 0.012f, -0.98f, 0.051f);
+    lpp.addAnalogInput(5, 3.31f);
+    const LegacyLPP<52> legacy(lpp);
+
+    BENCH::report("deque push/pop, legacy copy", dequeRoundTrip(legacy, iterations));
+    BENCH::report("deque push/pop, trivial copy", dequeRoundTrip(lpp, iterations));
+    BENCH::report("vector growth, legacy copy", vectorGrowth(legacy, iterations));
+    BENCH::report("vector growth, trivial copy", vectorGrowth(lpp, iterations));
+    BENCH::report("ring buffer, legacy copy", ringBuffer(legacy, iterations));
+    BENCH::report("ring buffer, trivial copy", ringBuffer(lpp, iterations));
+    return 0;
+}
@@ -0,0 +1,122 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file bench_validator.cpp
+ * @brief Measures the single-pass validator on clean and corrupted corpora.
+ *
+ * Each corpus starts from KISS frames as sent by src/main.cpp and is then corrupted in one
+ * way: random bytes, single bit flips or truncation. The validator is compared against a full
+ * decode of the same frames, and the error classes it reports are counted.
+ */
+
+#include <cstdlib>
+#include <vector>
+#include "BenchCommon.hpp"
+#include "../include/CayenneLPP.hpp"
+#include "../include/CayenneDecoder.hpp"
+#include "../include/CayenneValidator.hpp"
+
+using namespace PAYLOAD_ENCODER;
+
+struct Frame
+{
+    uint8_t bytes[52];
+    uint8_t size;
+};
+
+enum class Corruption
+{
+    NONE,
+    RANDOM_BYTES,
+    BIT_FLIP,
+    TRUNCATE
+};
+
+static std::vector<Frame> buildCorpus(const size_t count, const Corruption corruption)
+{
+    std::vector<Frame> corpus(count);
+    CayenneLPP<52> lpp(51);
+    srand(7);
+    for (size_t i = 0; i < count; i++)
+    {
+        Frame &frame = corpus[i];
+        const float noise = (rand() % 1000) / 100.0f;
+        lpp.reset();
+        lpp.addDigitalInput(3, rand() % 10);
+        lpp.addTemperature(0, 15.0f + noise);
+        lpp.addHumidity(1, 40.0f + noise);
+        lpp.addIllumination(2, static_cast<uint16_t>(rand() % 1000));
+        lpp.addAccelerometer(4, noise / 100, -1.0f, 0.02f);
+        lpp.addAnalogInput(5, 3.0f + noise / 100);
+        frame.size = lpp.copy(frame.bytes);
+
+        switch (corruption)
+        {
+        case Corruption::NONE:
+            break;
+        case Corruption::RANDOM_BYTES:
+            for (uint8_t b = 0; b < frame.size; b++)
+                frame.bytes[b] = static_cast<uint8_t>(rand());
+            break;
+        case Corruption::BIT_FLIP:
+            frame.bytes[rand() % frame.size] ^= static_cast<uint8_t>(1 << (rand() % 8));
+            break;
+        case Corruption::TRUNCATE:
+            frame.size = static_cast<uint8_t>(rand() % frame.size);
+            break;
+        }
+    }
+    return corpus;
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+    const struct
+    {
+        const char *name;
+        Corruption corruption;
+    } corpora[] = {
+        {"clean", Corruption::NONE},
+        {"random bytes", Corruption::RANDOM_BYTES},
+        {"single bit flip", Corruption::BIT_FLIP},
+        {"truncated", Corruption::TRUNCATE},
+    };
+
+    for (const auto &corpus : corpora)
+    {
+        const std::vector<Frame> frames = buildCorpus(4096, corpus.corruption);
+        DecodedField fields[16];
+        uint64_t classes[5] = {0};
+        for (const Frame &frame : frames)
+        {
+            classes[static_cast<uint8_t>(validatePayload(frame.bytes, frame.size, 51).error)]++;
+        }
+
+        const double validate = BENCH::nsPerCall(iterations, [&](uint64_t i) {
+            const Frame &frame = frames[i & 4095];
+            BENCH::doNotOptimize(validatePayload(frame.bytes, frame.size, 51));
+        });
+        const double decode = BENCH::nsPerCall(iterations, [&](uint64_t i) {
+            const Frame &frame = frames[i & 4095];
+            BENCH::doNotOptimize(CayenneDecoder<16>::decodeUncached(frame.bytes, frame.size, fields));
+        });
+
+        std::printf("-- corpus: %s\n", corpus.name);
+        BENCH::report("validatePayload", validate);
+        BENCH::report("full decode", decode);
+        std::printf("ok %llu, overflow %llu, unknown type %llu, truncated %llu, out of range %llu\n\n",
+                    static_cast<unsigned long long>(classes[static_cast<uint8_t>(ERROR_TYPES::LPP_ERROR_OK)]),
+                    static_cast<unsigned long long>(classes[static_cast<uint8_t>(ERROR_TYPES::LPP_ERROR_OVERFLOW)]),
+                    static_cast<unsigned long long>(classes[static_cast<uint8_t>(ERROR_TYPES::LPP_ERROR_UNKOWN_TYPE)]),
+                    static_cast<unsigned long long>(classes[static_cast<uint8_t>(ERROR_TYPES::LPP_ERROR_TRUNCATED)]),
+                    static_cast<unsigned long long>(classes[static_cast<uint8_t>(ERROR_TYPES::LPP_ERROR_OUT_OF_RANGE)]));
+    }
+    return 0;
+}
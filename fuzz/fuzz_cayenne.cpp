@@ -0,0 +1,295 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file fuzz_cayenne.cpp
+ * @brief libFuzzer harness for the CayenneLPP encoder, decoder and validator.
+ *
+ * The first input byte selects the mode:
+ * - even: the rest of the input is an encoder script. One byte selects MaxSize, one byte sets
+ *   the operational size, then every operation is [op][channel][raw value bytes...]. Each
+ *   add* result is decoded again and compared against the raw values (round trip).
+ * - odd: the rest of the input is an arbitrary payload given to the decoder and validator,
+ *   which must agree with each other and never read outside the payload.
+ *
+ * Build with libFuzzer and sanitizers:
+ *   clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -Iinclude \
+ *       fuzz/fuzz_cayenne.cpp -o fuzz_cayenne
+ *   ./fuzz_cayenne fuzz/corpus
+ * Or replay the corpus files given as arguments, without libFuzzer:
+ *   g++ -std=c++17 -g -fsanitize=address,undefined -DFUZZ_STANDALONE -Iinclude \
+ *       fuzz/fuzz_cayenne.cpp -o fuzz_cayenne
+ *
+ * The seed corpus in fuzz/corpus is written by fuzz/make_seed_corpus.cpp.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/CayenneLPP.hpp"
+#include "../include/CayenneDecoder.hpp"
+#include "../include/CayenneValidator.hpp"
+
+using namespace PAYLOAD_ENCODER;
+
+#define FUZZ_CHECK(condition)                                                           \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(condition))                                                               \
+        {                                                                               \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::abort();                                                               \
+        }                                                                               \
+    } while (0)
+
+namespace
+{
+    constexpr size_t MAX_FIELDS = 86; // 255 bytes of 3-byte fields, plus one.
+
+    /**
+     * @brief Sequential reader over the fuzzer input; yields zeros once exhausted.
+     */
+    struct InputReader
+    {
+        const uint8_t *data;
+        size_t size;
+        size_t index;
+
+        bool empty() const { return index >= size; }
+        uint8_t u8() { return index < size ? data[index++] : 0; }
+        uint16_t u16() { return static_cast<uint16_t>(u8() | (u8() << 8)); }
+        int16_t s16() { return static_cast<int16_t>(u16()); }
+        int32_t s32(const int32_t limit)
+        {
+            const uint32_t raw = static_cast<uint32_t>(u16()) | (static_cast<uint32_t>(u16()) << 16);
+            return static_cast<int32_t>(raw % (2u * limit + 1)) - limit;
+        }
+    };
+
+    /**
+     * @brief The values one add* call is expected to decode to.
+     */
+    struct Expected
+    {
+        DATA_TYPES type;
+        uint8_t channel;
+        uint8_t count;
+        float values[3];
+        float tolerance[3];
+    };
+
+    void checkDecoderOnBytes(const uint8_t *payload, const size_t size)
+    {
+        static DecodedField walked[MAX_FIELDS];
+        static DecodedField cached[MAX_FIELDS];
+        static CayenneDecoder<MAX_FIELDS> decoder;
+
+        // Copy into an exactly sized heap block so ASan catches any read past the end.
+        uint8_t *exact = static_cast<uint8_t *>(std::malloc(size ? size : 1));
+        if (size)
+            std::memcpy(exact, payload, size);
+
+        const ValidationResult validation = validatePayload(exact, size);
+        const size_t walkedCount = CayenneDecoder<MAX_FIELDS>::decodeUncached(exact, size, walked);
+        const size_t cachedCount = decoder.decode(exact, size, cached);
+        FUZZ_CHECK(walkedCount == cachedCount);
+        FUZZ_CHECK(validation.offset <= size);
+
+        if (size <= 255)
+        {
+            // The validator stops at the first error, so an out-of-range value says nothing
+            // about the structure behind it.
+            if (validation.error == ERROR_TYPES::LPP_ERROR_OK)
+                FUZZ_CHECK(validation.fieldCount == walkedCount);
+            if (validation.error == ERROR_TYPES::LPP_ERROR_UNKOWN_TYPE ||
+                validation.error == ERROR_TYPES::LPP_ERROR_TRUNCATED)
+                FUZZ_CHECK(walkedCount == 0);
+        }
+        for (size_t i = 0; i < walkedCount; i++)
+        {
+            FUZZ_CHECK(walked[i].type == cached[i].type);
+            FUZZ_CHECK(walked[i].channel == cached[i].channel);
+            FUZZ_CHECK(walked[i].valueCount == cached[i].valueCount);
+            for (uint8_t v = 0; v < walked[i].valueCount; v++)
+                FUZZ_CHECK(std::memcmp(&walked[i].values[v], &cached[i].values[v], sizeof(float)) == 0);
+        }
+        std::free(exact);
+    }
+
+    template <size_t MaxSize>
+    void runEncoderScript(InputReader &input)
+    {
+        const uint8_t requested = input.u8();
+        const size_t operationalSize = requested > MaxSize ? MaxSize : requested;
+        CayenneLPP<MaxSize> lpp(requested);
+        static Expected expected[MAX_FIELDS];
+        size_t fieldCount = 0;
+
+        while (!input.empty() && fieldCount < MAX_FIELDS)
+        {
+            Expected &field = expected[fieldCount];
+            const uint8_t op = input.u8() % 12;
+            const uint8_t channel = input.u8();
+            const size_t before = lpp.getSize();
+            uint8_t result = 0;
+            field.channel = channel;
+            field.count = 1;
+            field.tolerance[0] = field.tolerance[1] = field.tolerance[2] = 0.0f;
+
+            switch (op)
+            {
+            case 0:
+            case 1:
+            case 2:
+            {
+                const uint8_t value = input.u8();
+                field.type = op == 0 ? DATA_TYPES::DIG_IN : (op == 1 ? DATA_TYPES::DIG_OUT : DATA_TYPES::PRSNC_SENS);
+                field.values[0] = value;
+                result = op == 0 ? lpp.addDigitalInput(channel, value)
+                                 : (op == 1 ? lpp.addDigitalOutput(channel, value) : lpp.addPresence(channel, value));
+                break;
+            }
+            case 3:
+            {
+                const uint16_t value = input.u16();
+                field.type = DATA_TYPES::ILLUM_SENS;
+                field.values[0] = value;
+                result = lpp.addIllumination(channel, value);
+                break;
+            }
+            case 4:
+            case 5:
+            case 6:
+            case 7:
+            case 8:
+            {
+                static const DATA_TYPES types[] = {DATA_TYPES::ANL_IN, DATA_TYPES::ANL_OUT, DATA_TYPES::TEMP_SENS,
+                                                   DATA_TYPES::HUM_SENS, DATA_TYPES::BARO_SENS};
+                field.type = types[op - 4];
+                const float resolution = FLOATING_DATA_RESOLUTION(field.type);
+                // Humidity and barometer are unsigned; the others signed.
+                const float value = (op >= 7 ? static_cast<float>(input.u16()) : static_cast<float>(input.s16())) / resolution;
+                field.values[0] = value;
+                field.tolerance[0] = 0.5f / resolution;
+                switch (op)
+                {
+                case 4: result = lpp.addAnalogInput(channel, value); break;
+                case 5: result = lpp.addAnalogOutput(channel, value); break;
+                case 6: result = lpp.addTemperature(channel, value); break;
+                case 7: result = lpp.addHumidity(channel, value); break;
+                default: result = lpp.addBarometer(channel, value); break;
+                }
+                break;
+            }
+            case 9:
+            case 10:
+            {
+                field.type = op == 9 ? DATA_TYPES::ACCRM_SENS : DATA_TYPES::GYRO_SENS;
+                const float resolution = FLOATING_DATA_RESOLUTION(field.type);
+                field.count = 3;
+                for (uint8_t v = 0; v < 3; v++)
+                {
+                    field.values[v] = input.s16() / resolution;
+                    field.tolerance[v] = 0.5f / resolution;
+                }
+                result = op == 9 ? lpp.addAccelerometer(channel, field.values[0], field.values[1], field.values[2])
+                                 : lpp.addGyroscope(channel, field.values[0], field.values[1], field.values[2]);
+                break;
+            }
+            default:
+            {
+                field.type = DATA_TYPES::GPS_LOC;
+                field.count = 3;
+                field.values[0] = input.s32(900000) / 10000.0f;
+                field.values[1] = input.s32(1800000) / 10000.0f;
+                field.values[2] = input.s32(1 << 20) / 100.0f;
+                field.tolerance[0] = field.tolerance[1] = 0.00015f;
+                field.tolerance[2] = 0.015f;
+                result = lpp.addGPSLocation(channel, field.values[0], field.values[1], field.values[2]);
+                break;
+            }
+            }
+
+            const size_t fieldSize = getDataTypeSize(field.type) + 2;
+            FUZZ_CHECK(lpp.getSize() <= operationalSize);
+            if (result == 0)
+            {
+                FUZZ_CHECK(lpp.getSize() == before);
+                FUZZ_CHECK(before + fieldSize > operationalSize);
+            }
+            else
+            {
+                FUZZ_CHECK(lpp.getSize() == before + fieldSize);
+                FUZZ_CHECK(result == static_cast<uint8_t>(lpp.getSize()));
+                fieldCount++;
+            }
+        }
+
+        DecodedField decoded[MAX_FIELDS];
+        const size_t count = CayenneDecoder<MAX_FIELDS>::decodeUncached(lpp.getBuffer(), lpp.getSize(), decoded);
+        FUZZ_CHECK(count == fieldCount);
+        for (size_t i = 0; i < count; i++)
+        {
+            FUZZ_CHECK(decoded[i].type == expected[i].type);
+            FUZZ_CHECK(decoded[i].channel == expected[i].channel);
+            FUZZ_CHECK(decoded[i].valueCount == expected[i].count);
+            for (uint8_t v = 0; v < expected[i].count; v++)
+            {
+                const float slack = expected[i].tolerance[v] + std::fabs(expected[i].values[v]) * 1e-6f;
+                FUZZ_CHECK(std::fabs(decoded[i].values[v] - expected[i].values[v]) <= slack);
+            }
+        }
+        checkDecoderOnBytes(lpp.getBuffer(), lpp.getSize());
+    }
+} // End of anonymous namespace.
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size == 0)
+        return 0;
+    if (data[0] & 1)
+    {
+        checkDecoderOnBytes(data + 1, size - 1);
+        return 0;
+    }
+
+    InputReader input = {data + 1, size - 1, 0};
+    switch (input.u8() % 6)
+    {
+    case 0: runEncoderScript<3>(input); break;
+    case 1: runEncoderScript<8>(input); break;
+    case 2: runEncoderScript<16>(input); break;
+    case 3: runEncoderScript<52>(input); break;
+    case 4: runEncoderScript<128>(input); break;
+    default: runEncoderScript<255>(input); break;
+    }
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        FILE *file = std::fopen(argv[i], "rb");
+        if (!file)
+        {
+            std::fprintf(stderr, "cannot open %s\n", argv[i]);
+            return 1;
+        }
+        static uint8_t buffer[1 << 16];
+        const size_t size = std::fread(buffer, 1, sizeof(buffer), file);
+        std::fclose(file);
+        LLVMFuzzerTestOneInput(buffer, size);
+    }
+    std::printf("%d inputs ok\n", argc - 1);
+    return 0;
+}
+#endif
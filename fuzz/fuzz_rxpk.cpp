@@ -0,0 +1,86 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file fuzz_rxpk.cpp
+ * @brief libFuzzer harness for the rxpk JSON reader of the ingest daemon.
+ *
+ * The input is the JSON object of a PUSH_DATA datagram, given to INGEST::RxpkReader without a
+ * terminator. Every rxpk it returns must have its members within the ranges the ingest path
+ * casts them to, and its `data` must lie inside the input. The input is copied to a buffer of
+ * its exact size, so AddressSanitizer catches any read past the end.
+ *
+ * Build with libFuzzer and sanitizers:
+ *   clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined,float-cast-overflow \
+ *       fuzz/fuzz_rxpk.cpp -o fuzz_rxpk
+ *   ./fuzz_rxpk fuzz/corpus_rxpk
+ * Or replay the corpus files given as arguments, without libFuzzer:
+ *   g++ -std=c++17 -g -fsanitize=address,undefined,float-cast-overflow -DFUZZ_STANDALONE \
+ *       fuzz/fuzz_rxpk.cpp -o fuzz_rxpk
+ *
+ * The seed corpus in fuzz/corpus_rxpk is written by fuzz/make_seed_corpus.cpp.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../ingest/SemtechUdp.hpp"
+
+using namespace INGEST;
+
+#define FUZZ_CHECK(condition)                                                           \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(condition))                                                               \
+        {                                                                               \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::abort();                                                               \
+        }                                                                               \
+    } while (0)
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    const std::vector<char> json(data, data + size);
+    const char *begin = json.data();
+    RxpkReader reader(begin, json.size());
+    Rxpk rxpk;
+    while (reader.next(rxpk))
+    {
+        FUZZ_CHECK(rxpk.size <= RXPK_MAX_SIZE);
+        FUZZ_CHECK(rxpk.rssi >= RXPK_MIN_RSSI && rxpk.rssi <= RXPK_MAX_RSSI);
+        FUZZ_CHECK(rxpk.lsnr >= RXPK_MIN_LSNR && rxpk.lsnr <= RXPK_MAX_LSNR);
+        if (rxpk.data)
+        {
+            FUZZ_CHECK(rxpk.data >= begin && rxpk.data + rxpk.dataLength <= begin + json.size());
+        }
+    }
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        FILE *file = std::fopen(argv[i], "rb");
+        if (!file)
+        {
+            std::fprintf(stderr, "cannot open %s\n", argv[i]);
+            return 1;
+        }
+        static uint8_t buffer[1 << 16];
+        const size_t size = std::fread(buffer, 1, sizeof(buffer), file);
+        std::fclose(file);
+        LLVMFuzzerTestOneInput(buffer, size);
+    }
+    std::printf("%d inputs ok\n", argc - 1);
+    return 0;
+}
+#endif
@@ -0,0 +1,232 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file make_seed_corpus.cpp
+ * @brief Writes the fuzzer seed corpora from the cases in test/main_test.cpp and the ingest path.
+ *
+ * Every unit test case becomes an encoder script seed and a raw payload seed, see
+ * fuzz_cayenne.cpp for the input format. fuzz/corpus_rxpk gets PUSH_DATA JSON for
+ * fuzz_rxpk.cpp: a well-formed rxpk and members out of range. Run from the repository root:
+ *   g++ -std=c++17 -Iinclude fuzz/make_seed_corpus.cpp -o make_seed_corpus && ./make_seed_corpus
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "../include/CayenneLPP.hpp"
+#include "../ingest/SemtechUdp.hpp"
+
+using namespace PAYLOAD_ENCODER;
+
+namespace
+{
+    enum Op : uint8_t
+    {
+        OP_DIG_IN = 0, OP_DIG_OUT, OP_PRESENCE, OP_ILLUMINATION, OP_ANL_IN, OP_ANL_OUT,
+        OP_TEMPERATURE, OP_HUMIDITY, OP_BAROMETER, OP_ACCELEROMETER, OP_GYROSCOPE, OP_GPS
+    };
+
+    struct Script
+    {
+        std::vector<uint8_t> bytes;
+        CayenneLPP<255> lpp;
+
+        Script(const uint8_t maxSizeSelector, const uint8_t operationalSize) : lpp(255)
+        {
+            bytes = {0, maxSizeSelector, operationalSize};
+        }
+
+        void u8(const uint8_t value) { bytes.push_back(value); }
+        void s16(const int16_t value)
+        {
+            bytes.push_back(static_cast<uint8_t>(value));
+            bytes.push_back(static_cast<uint8_t>(static_cast<uint16_t>(value) >> 8));
+        }
+        void s32(const int32_t value, const int32_t limit)
+        {
+            const uint32_t raw = static_cast<uint32_t>(value + limit);
+            s16(static_cast<int16_t>(raw));
+            s16(static_cast<int16_t>(raw >> 16));
+        }
+
+        void scalar(const Op op, const uint8_t channel, const float value, const DATA_TYPES type)
+        {
+            u8(op);
+            u8(channel);
+            const float scaled = value * FLOATING_DATA_RESOLUTION(type);
+            s16(static_cast<int16_t>(scaled > 0 ? scaled + 0.5f : scaled - 0.5f));
+        }
+
+        void triple(const Op op, const uint8_t channel, const float x, const float y, const float z, const DATA_TYPES type)
+        {
+            u8(op);
+            u8(channel);
+            for (const float value : {x, y, z})
+            {
+                const float scaled = value * FLOATING_DATA_RESOLUTION(type);
+                s16(static_cast<int16_t>(scaled > 0 ? scaled + 0.5f : scaled - 0.5f));
+            }
+        }
+    };
+
+    void write(const char *name, const std::vector<uint8_t> &bytes, const char *corpus = "fuzz/corpus")
+    {
+        char path[128];
+        std::snprintf(path, sizeof(path), "%s/%s", corpus, name);
+        FILE *file = std::fopen(path, "wb");
+        if (!file)
+        {
+            std::fprintf(stderr, "cannot write %s\n", path);
+            return;
+        }
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+    }
+
+    void writeJson(const char *name, const char *json)
+    {
+        write(name, std::vector<uint8_t>(json, json + std::strlen(json)), "fuzz/corpus_rxpk");
+    }
+
+    void writeRaw(const char *name, const uint8_t *payload, const size_t size)
+    {
+        std::vector<uint8_t> bytes = {1};
+        bytes.insert(bytes.end(), payload, payload + size);
+        write(name, bytes);
+    }
+
+    template <size_t MaxSize>
+    void writeBoth(const char *name, const Script &script, const CayenneLPP<MaxSize> &lpp)
+    {
+        char scriptName[96];
+        char rawName[96];
+        std::snprintf(scriptName, sizeof(scriptName), "script_%s", name);
+        std::snprintf(rawName, sizeof(rawName), "raw_%s", name);
+        write(scriptName, script.bytes);
+        writeRaw(rawName, lpp.getBuffer(), lpp.getSize());
+    }
+} // End of anonymous namespace.
+
+int main(void)
+{
+    // Single-field cases from test/main_test.cpp; MaxSize selector 3 is CayenneLPP<52>.
+    {
+        Script s(3, 64); s.u8(OP_DIG_IN); s.u8(17); s.u8(8);
+        CayenneLPP<64> lpp(64); lpp.addDigitalInput(17, 8);
+        writeBoth("digital_input", s, lpp);
+    }
+    {
+        Script s(3, 64); s.u8(OP_DIG_OUT); s.u8(2); s.u8(50);
+        CayenneLPP<64> lpp(64); lpp.addDigitalOutput(2, 50);
+        writeBoth("digital_output", s, lpp);
+    }
+    {
+        Script s(3, 64); s.scalar(OP_ANL_IN, 3, 3.3f, DATA_TYPES::ANL_IN);
+        CayenneLPP<64> lpp(64); lpp.addAnalogInput(3, 3.3f);
+        writeBoth("analog_input", s, lpp);
+    }
+    {
+        Script s(3, 64); s.scalar(OP_ANL_OUT, 4, 2.2f, DATA_TYPES::ANL_OUT);
+        CayenneLPP<64> lpp(64); lpp.addAnalogOutput(4, 2.2f);
+        writeBoth("analog_output", s, lpp);
+    }
+    {
+        Script s(3, 64); s.u8(OP_ILLUMINATION); s.u8(5); s.s16(550);
+        CayenneLPP<64> lpp(64); lpp.addIllumination(5, 550);
+        writeBoth("illumination", s, lpp);
+    }
+    {
+        Script s(3, 64); s.u8(OP_PRESENCE); s.u8(66); s.u8(1);
+        CayenneLPP<64> lpp(64); lpp.addPresence(66, 1);
+        writeBoth("presence", s, lpp);
+    }
+    {
+        Script s(3, 64); s.scalar(OP_TEMPERATURE, 102, 25.5321f, DATA_TYPES::TEMP_SENS);
+        CayenneLPP<64> lpp(64); lpp.addTemperature(102, 25.5321f);
+        writeBoth("temperature", s, lpp);
+    }
+    {
+        Script s(3, 64); s.scalar(OP_HUMIDITY, 2, 75.55f, DATA_TYPES::HUM_SENS);
+        CayenneLPP<64> lpp(64); lpp.addHumidity(2, 75.55f);
+        writeBoth("humidity", s, lpp);
+    }
+    {
+        Script s(3, 64); s.triple(OP_ACCELEROMETER, 3, 1.23f, -2.34f, 3.45f, DATA_TYPES::ACCRM_SENS);
+        CayenneLPP<64> lpp(64); lpp.addAccelerometer(3, 1.23f, -2.34f, 3.45f);
+        writeBoth("accelerometer", s, lpp);
+    }
+    {
+        Script s(3, 64); s.scalar(OP_BAROMETER, 4, 1013.25f, DATA_TYPES::BARO_SENS);
+        CayenneLPP<64> lpp(64); lpp.addBarometer(4, 1013.25f);
+        writeBoth("barometer", s, lpp);
+    }
+    {
+        Script s(3, 64); s.triple(OP_GYROSCOPE, 5, 0.123f, -0.234f, 0.345f, DATA_TYPES::GYRO_SENS);
+        CayenneLPP<64> lpp(64); lpp.addGyroscope(5, 0.123f, -0.234f, 0.345f);
+        writeBoth("gyroscope", s, lpp);
+    }
+    {
+        Script s(4, 128); s.u8(OP_GPS); s.u8(6);
+        s.s32(515074, 900000); s.s32(-1278, 1800000); s.s32(3000, 1 << 20);
+        CayenneLPP<128> lpp(128); lpp.addGPSLocation(6, 51.5074f, -0.1278f, 30.0f);
+        writeBoth("gps", s, lpp);
+    }
+    // The KISS frame from src/main.cpp, in a buffer sized like the firmware.
+    {
+        Script s(3, 51);
+        s.u8(OP_DIG_IN); s.u8(3); s.u8(4);
+        s.scalar(OP_TEMPERATURE, 0, 21.4f, DATA_TYPES::TEMP_SENS);
+        s.scalar(OP_HUMIDITY, 1, 45.5f, DATA_TYPES::HUM_SENS);
+        s.u8(OP_ILLUMINATION); s.u8(2); s.s16(320);
+        s.triple(OP_ACCELEROMETER, 4, 0.012f, -0.98f, 0.051f, DATA_TYPES::ACCRM_SENS);
+        s.scalar(OP_ANL_IN, 5, 3.31f, DATA_TYPES::ANL_IN);
+        CayenneLPP<52> lpp(51);
+        lpp.addDigitalInput(3, 4);
+        lpp.addTemperature(0, 21.4f);
+        lpp.addHumidity(1, 45.5f);
+        lpp.addIllumination(2, 320);
+        lpp.addAccelerometer(4, 0.012f, -0.98f, 0.051f);
+        lpp.addAnalogInput(5, 3.31f);
+        writeBoth("kiss_frame", s, lpp);
+    }
+    // Overflow: a GPS field does not fit into an operational size of 8.
+    {
+        Script s(1, 8); s.u8(OP_TEMPERATURE); s.u8(1); s.s16(255);
+        s.u8(OP_GPS); s.u8(6); s.s32(0, 900000); s.s32(0, 1800000); s.s32(0, 1 << 20);
+        write("script_overflow", s.bytes);
+    }
+    // Malformed payloads from the decoder and validator tests.
+    {
+        const uint8_t unknownType[] = {103, 0x01, 0xFF, 0x00, 0x55, 0x02, 0x00};
+        const uint8_t truncated[] = {103, 0x01, 0xFF};
+        const uint8_t headerOnly[] = {103};
+        writeRaw("raw_unknown_type", unknownType, sizeof(unknownType));
+        writeRaw("raw_truncated", truncated, sizeof(truncated));
+        writeRaw("raw_header_only", headerOnly, sizeof(headerOnly));
+    }
+    // rxpk JSON: the KISS frame as a packet forwarder reports it, then members the reader must
+    // reject instead of casting, and a string cut off after a backslash.
+    {
+        const uint8_t phy[] = {0x40, 0x04, 0x03, 0x02, 0x01, 0x00, 0x01, 0x00, 0x01, 0x03, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00};
+        char rxpk[512];
+        const size_t length = INGEST::writeRxpk(1234567, 7, 9.5f, -57, phy, sizeof(phy), rxpk, sizeof(rxpk));
+        char json[600];
+        std::snprintf(json, sizeof(json), "{\"rxpk\":[%.*s]}", static_cast<int>(length), rxpk);
+        writeJson("valid", json);
+        writeJson("tmst_negative", "{\"rxpk\":[{\"tmst\":-5,\"size\":4,\"data\":\"AAAAAA==\"},{\"tmst\":5,\"data\":\"AA==\"}]}");
+        writeJson("tmst_huge", "{\"rxpk\":[{\"tmst\":4294967296,\"data\":\"AA==\"}]}");
+        writeJson("size_huge", "{\"rxpk\":[{\"size\":1e12,\"data\":\"AA==\"}]}");
+        writeJson("size_256", "{\"rxpk\":[{\"size\":256,\"data\":\"AA==\"}]}");
+        writeJson("rssi_huge", "{\"rxpk\":[{\"rssi\":-1e39,\"lsnr\":7,\"data\":\"AA==\"}]}");
+        writeJson("lsnr_huge", "{\"rxpk\":[{\"rssi\":-90,\"lsnr\":1e400,\"data\":\"AA==\"}]}");
+        writeJson("trailing_backslash", "{\"rxpk\":[{\"data\":\"AA\\");
+    }
+    return 0;
+}
@@ -0,0 +1,276 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef CAYENNE_BUDGET_FRAME_HPP
+#define CAYENNE_BUDGET_FRAME_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "CayenneLPP.hpp"
+#include "LoRaWANParameters.hpp"
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief What happens to a staged field group that does not fit the payload budget.
+     */
+    enum class OVERFLOW_POLICY : uint8_t
+    {
+        DROP    = 0,    /* Discard the group. */
+        DEFER   = 1     /* Keep the group and offer it again with the next build. */
+    };
+
+    /**
+     * @brief Payload builder that fits prioritized fields into the budget of the current data rate.
+     *
+     * Fields are first staged in groups, each with a priority and an overflow policy:
+     * @code
+     * frame.stage(3).addTemperature(0, temperature);
+     * frame.stage(1, OVERFLOW_POLICY::DEFER).addAnalogInput(5, vdd);
+     * const auto& lpp = frame.build(dataRate);
+     * @endcode
+     * build() takes the maximum payload size of the data rate as budget and selects groups
+     * from the highest priority down; equal priorities keep their staging order. A group that
+     * does not fit is skipped, so smaller groups of lower priority may still be selected. The
+     * selected groups are written in staging order, which keeps the frame layout stable.
+     * Skipped groups are dropped or, with OVERFLOW_POLICY::DEFER, staged again in front of the
+     * next round. A deferred group larger than getLargestBudget() could never be selected and is
+     * dropped instead.
+     *
+     * The budget is limited to MaxSize, so a frame never exceeds it, also at data rates that
+     * allow more. The frame costs 2 * MaxSize bytes of RAM, plus MaxSize of stack in build().
+     *
+     * @tparam MaxSize Maximum size of the staging area and of the built frame, at most 255.
+     * @tparam MaxGroups Maximum number of groups staged per round, at most 255.
+     * @tparam Encoding Wire format of the staged fields and the frame, see CayenneLPP.
+     */
+    template <size_t MaxSize, size_t MaxGroups = 16, PAYLOAD_ENCODING Encoding = PAYLOAD_ENCODING::NATIVE>
+    class CayenneBudgetFrame
+    {
+        static_assert(MaxSize <= 255 && MaxGroups <= 255, "Group offsets, sizes and counts are 8-bit");
+
+    public:
+        /**
+         * @brief Constructor for CayenneBudgetFrame.
+         */
+        CayenneBudgetFrame() : staging(MaxSize), frame(MaxSize), groupCount(0), droppedCount(0), deferredCount(0) {}
+
+        /**
+         * @brief Opens a new field group; the add* calls on the returned encoder belong to it.
+         *
+         * Once MaxGroups groups are staged, further calls extend the last group.
+         *
+         * @param priority Priority of the group, higher values are selected first.
+         * @param policy What to do with the group when it does not fit.
+         * @return CayenneLPP<MaxSize, Encoding>& The staging encoder.
+         */
+        CayenneLPP<MaxSize, Encoding> &stage(const uint8_t priority, const OVERFLOW_POLICY policy = OVERFLOW_POLICY::DROP)
+        {
+            closeGroup();
+            if (groupCount < MaxGroups)
+            {
+                Group &group = groups[groupCount++];
+                group.offset = static_cast<uint8_t>(staging.getSize());
+                group.size = 0;
+                group.priority = priority;
+                group.policy = policy;
+            }
+            return staging;
+        }
+
+        /**
+         * @brief Builds the frame for a data rate out of the staged groups.
+         *
+         * @param dataRate The EU868 data rate, DR0 up to and including DR5.
+         * @return const CayenneLPP<MaxSize, Encoding>& The frame to transmit.
+         */
+        const CayenneLPP<MaxSize, Encoding> &build(const uint8_t dataRate)
+        {
+            return buildWithBudget(getMaxPayloadSizeEU868(dataRate));
+        }
+
+        /**
+         * @brief Builds the frame out of the staged groups within an explicit byte budget.
+         *
+         * @param budget Maximum payload size in bytes, limited to MaxSize.
+         * @return const CayenneLPP<MaxSize, Encoding>& The frame to transmit.
+         */
+        const CayenneLPP<MaxSize, Encoding> &buildWithBudget(const uint8_t budget)
+        {
+            closeGroup();
+            frame.reset();
+            frame.setOperationalSize(budget);
+
+            bool considered[MaxGroups] = {false};
+            bool selected[MaxGroups] = {false};
+            size_t remaining = frame.getOperationalSize();
+            for (uint8_t round = 0; round < groupCount; round++)
+            {
+                // Highest priority not yet considered; the first staged one wins a tie.
+                uint8_t next = 0;
+                bool found = false;
+                for (uint8_t i = 0; i < groupCount; i++)
+                {
+                    if (!considered[i] && (!found || groups[i].priority > groups[next].priority))
+                    {
+                        next = i;
+                        found = true;
+                    }
+                }
+                considered[next] = true;
+                if (groups[next].size <= remaining)
+                {
+                    selected[next] = true;
+                    remaining -= groups[next].size;
+                }
+            }
+
+            droppedCount = 0;
+            deferredCount = 0;
+            CayenneLPP<MaxSize, Encoding> carried(MaxSize);
+            Group carriedGroups[MaxGroups];
+            uint8_t carriedCount = 0;
+            for (uint8_t i = 0; i < groupCount; i++)
+            {
+                const Group &group = groups[i];
+                if (selected[i])
+                {
+                    copyGroup(frame, group);
+                }
+                else if (group.policy == OVERFLOW_POLICY::DEFER && group.size <= getLargestBudget())
+                {
+                    carriedGroups[carriedCount] = group;
+                    carriedGroups[carriedCount].offset = static_cast<uint8_t>(carried.getSize());
+                    carriedCount++;
+                    copyGroup(carried, group);
+                    deferredCount++;
+                }
+                else
+                {
+                    droppedCount++;
+                }
+            }
+
+            staging = carried;
+            for (uint8_t i = 0; i < carriedCount; i++)
+            {
+                groups[i] = carriedGroups[i];
+            }
+            groupCount = carriedCount;
+            return frame;
+        }
+
+        /**
+         * @brief Discards every staged group, including deferred ones.
+         */
+        void reset()
+        {
+            staging.reset();
+            groupCount = 0;
+        }
+
+        /**
+         * @brief Gets the number of groups dropped by the last build.
+         *
+         * @return uint8_t Dropped group count.
+         */
+        uint8_t getDroppedCount(void) const
+        {
+            return droppedCount;
+        }
+
+        /**
+         * @brief Checks whether the last built frame carries a field on a channel.
+         *
+         * Lets the caller tell the fields that were sent from those dropped or deferred.
+         *
+         * @param channel The sensor channel.
+         * @return bool True if a field on the channel was selected by the last build.
+         */
+        bool contains(const uint8_t channel) const
+        {
+            const uint8_t *buffer = frame.getBuffer();
+            const size_t size = frame.getSize();
+            size_t offset = 0;
+            while (offset + 2 <= size)
+            {
+                const DATA_TYPES type = static_cast<DATA_TYPES>(buffer[offset + getTypeHeaderOffset(Encoding)]);
+                if (buffer[offset + 1 - getTypeHeaderOffset(Encoding)] == channel)
+                {
+                    return true;
+                }
+                offset += getDataTypeSize(type, Encoding) + 2;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Gets the number of groups deferred to the next round by the last build.
+         *
+         * @return uint8_t Deferred group count.
+         */
+        uint8_t getDeferredCount(void) const
+        {
+            return deferredCount;
+        }
+
+        /**
+         * @brief Gets the largest budget build() grants: the payload size of DR5, limited to MaxSize.
+         *
+         * @return size_t Largest budget in bytes.
+         */
+        static size_t getLargestBudget(void)
+        {
+            const size_t largestPayload = static_cast<size_t>(EU868_MAX_PAYLOAD::DR5);
+            return MaxSize < largestPayload ? MaxSize : largestPayload;
+        }
+
+    private:
+        /**
+         * @brief A run of staged bytes with one priority and overflow policy.
+         */
+        struct Group
+        {
+            uint8_t offset;
+            uint8_t size;
+            uint8_t priority;
+            OVERFLOW_POLICY policy;
+        };
+
+        CayenneLPP<MaxSize, Encoding> staging;
+        CayenneLPP<MaxSize, Encoding> frame;
+        Group groups[MaxGroups];
+        uint8_t groupCount;
+        uint8_t droppedCount;
+        uint8_t deferredCount;
+
+        /**
+         * @brief Fixes the size of the last opened group to the bytes staged since.
+         */
+        void closeGroup()
+        {
+            if (groupCount > 0)
+            {
+                Group &group = groups[groupCount - 1];
+                group.size = static_cast<uint8_t>(staging.getSize() - group.offset);
+            }
+        }
+
+        /**
+         * @brief Appends the staged bytes of one group to a destination encoder.
+         *
+         * @param destination The encoder to append to.
+         * @param group The group to copy.
+         */
+        void copyGroup(CayenneLPP<MaxSize, Encoding> &destination, const Group &group)
+        {
+            destination.append(staging.getBuffer() + group.offset, group.size);
+        }
+    }; // End of class CayenneBudgetFrame.
+} // End of Namespace PAYLOAD_ENCODER.
+#endif // CAYENNE_BUDGET_FRAME_HPP
@@ -0,0 +1,390 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef CAYENNE_DECODER_HPP
+#define CAYENNE_DECODER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "CayenneReferences.hpp"
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief A single decoded CayenneLPP field.
+     *
+     * Scalar types fill values[0] only; accelerometer, gyroscope and GPS fill all three
+     * values (x, y, z or latitude, longitude, altitude).
+     */
+    struct DecodedField
+    {
+        DATA_TYPES type;        ///< Data type of the field.
+        uint8_t channel;        ///< Sensor channel of the field.
+        uint8_t valueCount;     ///< Number of valid entries in values (1 or 3).
+        float values[3];        ///< Decoded values in engineering units.
+    };
+
+    /**
+     * @brief Decoder for payloads produced by the CayenneLPP encoder, with a layout cache.
+     *
+     * Devices running the same firmware send the same sequence of [type][channel] headers
+     * every uplink. The first frame of a given shape is walked header by header; its field
+     * offsets are then stored in a small direct-mapped cache keyed on a fingerprint of the
+     * frame size and first header. Following frames with the same header sequence are decoded
+     * by direct offset loads, without looking up data type sizes or resolutions.
+     *
+     * @tparam MaxFields Maximum number of fields in one frame.
+     * @tparam CacheSlots Number of layouts kept in the cache.
+     * @tparam Encoding Wire format of the payloads, as produced by CayenneLPP with the same encoding.
+     */
+    template <size_t MaxFields, size_t CacheSlots = 4, PAYLOAD_ENCODING Encoding = PAYLOAD_ENCODING::NATIVE>
+    class CayenneDecoder
+    {
+    public:
+        /**
+         * @brief Constructor for CayenneDecoder, starts with an empty layout cache.
+         */
+        CayenneDecoder() : cacheHits(0), cacheMisses(0)
+        {
+            resetCache();
+        }
+
+        /**
+         * @brief Decodes a payload, using the layout cache when the header sequence is known.
+         *
+         * @param payload Pointer to the encoded payload.
+         * @param size Size of the payload in bytes.
+         * @param fields Destination array with room for MaxFields entries.
+         * @return size_t Number of decoded fields. Returns 0 if the payload is empty or malformed.
+         */
+        size_t decode(const uint8_t *payload, const size_t size, DecodedField *fields)
+        {
+            if (!payload || !fields || size < 2)
+            {
+                return 0;
+            }
+
+            LayoutEntry &entry = cache[slotOf(payload, size)];
+            if (matches(entry, payload, size))
+            {
+                cacheHits++;
+                for (uint8_t i = 0; i < entry.fieldCount; i++)
+                {
+                    loadField(entry.fields[i], payload, fields[i]);
+                }
+                return entry.fieldCount;
+            }
+
+            cacheMisses++;
+            LayoutEntry candidate;
+            const size_t count = parseLayout(payload, size, candidate);
+            if (count == 0)
+            {
+                return 0;
+            }
+            for (uint8_t i = 0; i < candidate.fieldCount; i++)
+            {
+                loadField(candidate.fields[i], payload, fields[i]);
+            }
+            entry = candidate;
+            return count;
+        }
+
+        /**
+         * @brief Decodes a payload by walking every header, without touching the cache.
+         *
+         * @param payload Pointer to the encoded payload.
+         * @param size Size of the payload in bytes.
+         * @param fields Destination array with room for MaxFields entries.
+         * @return size_t Number of decoded fields. Returns 0 if the payload is empty or malformed.
+         */
+        static size_t decodeUncached(const uint8_t *payload, const size_t size, DecodedField *fields)
+        {
+            if (!payload || !fields)
+            {
+                return 0;
+            }
+            LayoutEntry layout;
+            const size_t count = parseLayout(payload, size, layout);
+            for (uint8_t i = 0; i < count; i++)
+            {
+                loadField(layout.fields[i], payload, fields[i]);
+            }
+            return count;
+        }
+
+        /**
+         * @brief Invalidates every cached layout and clears the hit/miss counters.
+         */
+        void resetCache()
+        {
+            for (size_t i = 0; i < CacheSlots; i++)
+            {
+                cache[i].size = 0;
+                cache[i].fieldCount = 0;
+            }
+            cacheHits = 0;
+            cacheMisses = 0;
+        }
+
+        /**
+         * @brief Gets the number of frames decoded through a cached layout.
+         *
+         * @return uint32_t Cache hit count.
+         */
+        uint32_t getCacheHits(void) const
+        {
+            return cacheHits;
+        }
+
+        /**
+         * @brief Gets the number of frames that needed a full header walk.
+         *
+         * @return uint32_t Cache miss count.
+         */
+        uint32_t getCacheMisses(void) const
+        {
+            return cacheMisses;
+        }
+
+    private:
+        /**
+         * @brief Storage class of a field, resolved once when a layout is parsed.
+         */
+        enum class FieldKind : uint8_t
+        {
+            U8,         ///< One unsigned byte, scaled.
+            U16,        ///< Unsigned 16-bit integer, scaled.
+            S16,        ///< Signed 16-bit integer, scaled.
+            S16X3,      ///< Three signed 16-bit integers, scaled.
+            GPS         ///< Three signed 32-bit (NATIVE) or 24-bit (STANDARD) integers, altitude with its own scale.
+        };
+
+        /**
+         * @brief Precomputed location and conversion of one field in a frame.
+         */
+        struct FieldLayout
+        {
+            DATA_TYPES type;
+            uint8_t channel;
+            uint8_t dataOffset;
+            FieldKind kind;
+            float scale;
+        };
+
+        /**
+         * @brief Cached layout of one frame shape.
+         */
+        struct LayoutEntry
+        {
+            size_t size;
+            uint8_t fieldCount;
+            FieldLayout fields[MaxFields];
+        };
+
+        LayoutEntry cache[CacheSlots];
+        uint32_t cacheHits;
+        uint32_t cacheMisses;
+
+        /**
+         * @brief Selects the cache slot from the frame size and the first header.
+         *
+         * @param payload Pointer to the encoded payload, at least two bytes long.
+         * @param size Size of the payload in bytes.
+         * @return size_t Index into the cache.
+         */
+        static inline size_t slotOf(const uint8_t *payload, const size_t size)
+        {
+            uint32_t hash = 2166136261u; // FNV-1a offset basis.
+            hash = (hash ^ static_cast<uint8_t>(size)) * 16777619u;
+            hash = (hash ^ payload[0]) * 16777619u;
+            hash = (hash ^ payload[1]) * 16777619u;
+            return hash % CacheSlots;
+        }
+
+        /**
+         * @brief Checks whether a frame has exactly the header sequence of a cached layout.
+         *
+         * @param entry The cached layout.
+         * @param payload Pointer to the encoded payload.
+         * @param size Size of the payload in bytes.
+         * @return bool True if every header byte matches the cached layout.
+         */
+        static inline bool matches(const LayoutEntry &entry, const uint8_t *payload, const size_t size)
+        {
+            if (entry.fieldCount == 0 || entry.size != size)
+            {
+                return false;
+            }
+            for (uint8_t i = 0; i < entry.fieldCount; i++)
+            {
+                const uint8_t typeByte = entry.fields[i].dataOffset - 2 + getTypeHeaderOffset(Encoding);
+                const uint8_t channelByte = entry.fields[i].dataOffset - 1 - getTypeHeaderOffset(Encoding);
+                if (payload[typeByte] != static_cast<uint8_t>(entry.fields[i].type) ||
+                    payload[channelByte] != entry.fields[i].channel)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Walks the headers of a frame and fills in the layout of every field.
+         *
+         * @param payload Pointer to the encoded payload.
+         * @param size Size of the payload in bytes.
+         * @param layout Destination layout.
+         * @return size_t Number of fields found. Returns 0 on an unknown type, a truncated
+         *                field or more than MaxFields fields.
+         */
+        static size_t parseLayout(const uint8_t *payload, const size_t size, LayoutEntry &layout)
+        {
+            layout.size = size;
+            layout.fieldCount = 0;
+            size_t index = 0;
+            while (index < size)
+            {
+                if (layout.fieldCount >= MaxFields || index + 2 > size || index + 2 > 0xFF)
+                {
+                    return 0;
+                }
+                const DATA_TYPES type = static_cast<DATA_TYPES>(payload[index + getTypeHeaderOffset(Encoding)]);
+                const size_t dataSize = getDataTypeSize(type, Encoding);
+                if (dataSize == 0 || index + 2 + dataSize > size)
+                {
+                    return 0;
+                }
+
+                FieldLayout &field = layout.fields[layout.fieldCount++];
+                field.type = type;
+                field.channel = payload[index + 1 - getTypeHeaderOffset(Encoding)];
+                field.dataOffset = static_cast<uint8_t>(index + 2);
+                field.kind = dataSize == 1 ? FieldKind::U8 : kindOf(type);
+                const int16_t resolution = FLOATING_DATA_RESOLUTION(type, Encoding);
+                field.scale = resolution ? 1.0f / resolution : 1.0f;
+                index += 2 + dataSize;
+            }
+            return layout.fieldCount;
+        }
+
+        /**
+         * @brief Maps a data type onto its storage class.
+         *
+         * @param type The data type.
+         * @return FieldKind The storage class of the data type.
+         */
+        static inline FieldKind kindOf(const DATA_TYPES type)
+        {
+            switch (type)
+            {
+            case DATA_TYPES::DIG_IN:
+            case DATA_TYPES::DIG_OUT:
+            case DATA_TYPES::PRSNC_SENS:
+                return FieldKind::U8;
+            case DATA_TYPES::ILLUM_SENS:
+            case DATA_TYPES::HUM_SENS:
+            case DATA_TYPES::BARO_SENS:
+                return FieldKind::U16;
+            case DATA_TYPES::ACCRM_SENS:
+            case DATA_TYPES::GYRO_SENS:
+                return FieldKind::S16X3;
+            case DATA_TYPES::GPS_LOC:
+                return FieldKind::GPS;
+            default:
+                return FieldKind::S16;
+            }
+        }
+
+        /**
+         * @brief Converts one field at its precomputed offset into engineering units.
+         *
+         * @param layout Layout of the field.
+         * @param payload Pointer to the encoded payload.
+         * @param out Destination field.
+         */
+        static inline void loadField(const FieldLayout &layout, const uint8_t *payload, DecodedField &out)
+        {
+            const uint8_t *data = payload + layout.dataOffset;
+            out.type = layout.type;
+            out.channel = layout.channel;
+            switch (layout.kind)
+            {
+            case FieldKind::U8:
+                out.valueCount = 1;
+                out.values[0] = data[0] * layout.scale;
+                break;
+            case FieldKind::U16:
+                out.valueCount = 1;
+                out.values[0] = static_cast<uint16_t>(readInt16(data)) * layout.scale;
+                break;
+            case FieldKind::S16:
+                out.valueCount = 1;
+                out.values[0] = readInt16(data) * layout.scale;
+                break;
+            case FieldKind::S16X3:
+                out.valueCount = 3;
+                out.values[0] = readInt16(data) * layout.scale;
+                out.values[1] = readInt16(data + 2) * layout.scale;
+                out.values[2] = readInt16(data + 4) * layout.scale;
+                break;
+            case FieldKind::GPS:
+                out.valueCount = 3;
+                if (Encoding == PAYLOAD_ENCODING::STANDARD)
+                {
+                    out.values[0] = readInt24(data) * layout.scale;
+                    out.values[1] = readInt24(data + 3) * layout.scale;
+                    out.values[2] = readInt24(data + 6) * (layout.scale * 100);
+                }
+                else
+                {
+                    out.values[0] = readInt32(data) * layout.scale;
+                    out.values[1] = readInt32(data + 4) * layout.scale;
+                    out.values[2] = readInt32(data + 8) * (layout.scale * 100);
+                }
+                break;
+            }
+        }
+
+        /**
+         * @brief Reads a signed 16-bit integer in the byte order of the encoding.
+         */
+        static inline int16_t readInt16(const uint8_t *data)
+        {
+            if (Encoding == PAYLOAD_ENCODING::STANDARD)
+            {
+                return static_cast<int16_t>(static_cast<uint16_t>((data[0] << 8) | data[1]));
+            }
+            return static_cast<int16_t>(static_cast<uint16_t>(data[0] | (data[1] << 8)));
+        }
+
+        /**
+         * @brief Reads a big-endian signed 24-bit integer, as written in the STANDARD encoding.
+         */
+        static inline int32_t readInt24(const uint8_t *data)
+        {
+            const uint32_t value = (static_cast<uint32_t>(data[0]) << 16) |
+                                   (static_cast<uint32_t>(data[1]) << 8) |
+                                   static_cast<uint32_t>(data[2]);
+            // Sign-extend bit 23.
+            return static_cast<int32_t>(value ^ 0x800000UL) - 0x800000L;
+        }
+
+        /**
+         * @brief Reads a little-endian signed 32-bit integer, as written in the NATIVE encoding.
+         */
+        static inline int32_t readInt32(const uint8_t *data)
+        {
+            return static_cast<int32_t>(static_cast<uint32_t>(data[0]) |
+                                        (static_cast<uint32_t>(data[1]) << 8) |
+                                        (static_cast<uint32_t>(data[2]) << 16) |
+                                        (static_cast<uint32_t>(data[3]) << 24));
+        }
+    }; // End of class CayenneDecoder.
+} // End of Namespace PAYLOAD_ENCODER.
+#endif // CAYENNE_DECODER_HPP
@@ -11,6 +11,7 @@
 
 #include <stdint.h>
 #include "CayenneReferences.hpp"
+#include "FixedPointConversion.hpp"
 
 namespace PAYLOAD_ENCODER
 {
@@ -18,8 +19,13 @@ namespace PAYLOAD_ENCODER
      * @brief Template class for CayenneLPP payload encoder.
      *
      * @tparam MaxSize Maximum size of the buffer.
+     * @tparam Encoding Wire format. NATIVE keeps the original layout of this library; STANDARD
+     *                  follows the CayenneLPP specification so stock decoders (e.g. TTN) read it.
+     * @tparam Policy What happens to values outside the range of their data type. Clipped values
+     *                are counted under every policy, see getClippedCount().
      */
-    template <size_t MaxSize>
+    template <size_t MaxSize, PAYLOAD_ENCODING Encoding = PAYLOAD_ENCODING::NATIVE,
+              CONVERSION_POLICY Policy = CONVERSION_POLICY::SATURATE>
     class CayenneLPP
     {
     public:
@@ -28,7 +34,7 @@ namespace PAYLOAD_ENCODER
          *
          * @param size Size of the buffer.
          */
-        explicit CayenneLPP(const uint8_t size) : operationalSize(size > MaxSize ? MaxSize : size), currentIndex(0) 
+        explicit CayenneLPP(const uint8_t size) : operationalSize(size > MaxSize ? MaxSize : size), currentIndex(0), clippedCount(0)
         {
             for(size_t i = 0; i < MaxSize; i++) {
                 buffer[i] = 0;
@@ -36,44 +42,18 @@ namespace PAYLOAD_ENCODER
         }
 
         /**
-         * @brief Copy constructor for the CayenneLPP class.
+         * @brief Copy and move operations for the CayenneLPP class.
          *
-         * Initializes a new instance of the CayenneLPP class by deep copying the contents
-         * from another instance. This includes copying the operational size, current index,
-         * and the contents of the data buffer up to the current index. The purpose of this
-         * constructor is to create a new object with the same state as the object passed as a parameter.
-         *
-         * @param other The CayenneLPP instance from which to copy.
-         */
-        CayenneLPP(const CayenneLPP& other) : operationalSize(other.operationalSize), currentIndex(other.currentIndex)
-        {
-            for(size_t i = 0; i < currentIndex; ++i)
-            {
-                buffer[i] = other.buffer[i];
-            }
-        }
-
-        /**
-         * @brief Copy assignment operator for the CayenneLPP class.
-         *
-         * Replaces the contents of this instance with a copy of the contents of another
-         * instance.
-         *
-         * @param other The CayenneLPP instance to assign from.
-         * @return CayenneLPP& A reference to this instance after copying.
-         */
-        CayenneLPP& operator=(const CayenneLPP& other) {
-            if (this != &other) {
-                currentIndex = other.currentIndex;
-                memcpyAVR(buffer, other.getBuffer(), currentIndex);
-            }
-            return *this;
-        }
-
-        /**
-         * @brief Destructor for CayenneLPP.
+         * All members are plain values, so the compiler generated operations copy the
+         * operational size, current index and buffer as one block. Keeping them defaulted
+         * leaves the class trivially copyable: containers and queues may relocate frames
+         * with memcpy, and a copy costs a single MaxSize block move instead of a loop.
          */
-        ~CayenneLPP() {}
+        CayenneLPP(const CayenneLPP& other) = default;
+        CayenneLPP(CayenneLPP&& other) = default;
+        CayenneLPP& operator=(const CayenneLPP& other) = default;
+        CayenneLPP& operator=(CayenneLPP&& other) = default;
+        ~CayenneLPP() = default;
 
         /* REQUIRED FUNCTIONS by ASSIGNMENT #1 */
         /**
@@ -122,6 +102,124 @@ namespace PAYLOAD_ENCODER
 
         /* END of REQUIRED FUNCTIONS by ASSIGNMENT #1 */
 
+        /**
+         * @brief Gets the operational size, the number of bytes add* calls may fill.
+         *
+         * @return size_t Operational size of the buffer.
+         */
+        size_t getOperationalSize(void) const
+        {
+            return operationalSize;
+        }
+
+        /**
+         * @brief Gets the number of values that were outside the range of their data type.
+         *
+         * Counts since construction or resetClippedCount(), saturating at 65535. Under
+         * CONVERSION_POLICY::REPORT the fields holding these values were not added.
+         *
+         * @return uint16_t Clipped value count.
+         */
+        uint16_t getClippedCount(void) const
+        {
+            return clippedCount;
+        }
+
+        /**
+         * @brief Clears the clipped value count.
+         */
+        void resetClippedCount(void)
+        {
+            clippedCount = 0;
+        }
+
+        /**
+         * @brief Changes the operational size, e.g. when the data rate and thereby the maximum payload changes.
+         *
+         * Fields already in the payload are kept. If they exceed the new size, further add* calls
+         * return 0 until the payload is reset.
+         *
+         * @param size New operational size, limited to MaxSize.
+         * @return size_t The operational size that was set.
+         */
+        size_t setOperationalSize(const uint8_t size)
+        {
+            operationalSize = size > MaxSize ? MaxSize : size;
+            return operationalSize;
+        }
+
+        /**
+         * @brief Appends the fields of another payload, as far as they fit.
+         *
+         * Whole fields are copied in order until the next one would exceed the operational size.
+         * The return value tells how much of the other payload was taken, so the rest can be
+         * carried over to the next uplink with discardFront().
+         *
+         * @param other The payload fragment to append.
+         * @return size_t Number of bytes of other that were appended; equals other.getSize() when everything fit.
+         */
+        template <size_t OtherSize, CONVERSION_POLICY OtherPolicy>
+        size_t append(const CayenneLPP<OtherSize, Encoding, OtherPolicy>& other)
+        {
+            return append(other.getBuffer(), other.getSize());
+        }
+
+        /**
+         * @brief Appends encoded fields from a raw buffer, as far as they fit.
+         *
+         * @param source Pointer to encoded CayenneLPP fields, in the encoding of this payload.
+         * @param sourceSize Number of bytes at source.
+         * @return size_t Number of bytes of source that were appended; equals sourceSize when everything fit.
+         */
+        size_t append(const uint8_t *source, const size_t sourceSize)
+        {
+            if (!source)
+            {
+                return 0;
+            }
+            size_t taken = 0;
+            while (taken < sourceSize)
+            {
+                if (taken + 2 > sourceSize)
+                {
+                    break;
+                }
+                const DATA_TYPES type = static_cast<DATA_TYPES>(source[taken + getTypeHeaderOffset(Encoding)]);
+                const size_t fieldSize = getDataTypeSize(type, Encoding) + 2;
+                if (fieldSize == 2 || taken + fieldSize > sourceSize || !checkCapacity(taken + fieldSize))
+                {
+                    break;
+                }
+                taken += fieldSize;
+            }
+            memcpyAVR(&buffer[currentIndex], source, taken);
+            currentIndex += taken;
+            return taken;
+        }
+
+        /**
+         * @brief Removes bytes from the front of the payload and keeps the rest.
+         *
+         * Used after append() to keep the fields that did not fit for the next uplink.
+         *
+         * @param count Number of bytes to remove, normally the result of append().
+         * @return size_t Size of the payload that remains.
+         */
+        size_t discardFront(const size_t count)
+        {
+            if (count >= currentIndex)
+            {
+                currentIndex = 0;
+                return 0;
+            }
+            for (size_t i = count; i < currentIndex; i++)
+            {
+                buffer[i - count] = buffer[i];
+            }
+            currentIndex -= count;
+            return currentIndex;
+        }
+
         /**
          * @brief Adds a digital input field to the payload.
          *
@@ -314,52 +412,55 @@ namespace PAYLOAD_ENCODER
         uint8_t buffer[MaxSize];
         size_t operationalSize;
         size_t currentIndex;
+        uint16_t clippedCount;
 
         /**
-         * @brief Rounds a floating-point value and casts it to an int32_t.
-         * 
-         * This function rounds the given floating-point value to the nearest integer,
-         * following the half-away-from-zero rule (also known as commercial rounding).
-         * It is designed to avoid precision issues commonly associated with floating-point
-         * arithmetic when converting to an integer type.
-         * 
-         * @param value The floating-point value to be rounded and cast.
-         * @return int32_t The rounded value, cast to an int32_t.
+         * @brief Gets the range of the stored integer of a scaled data type.
+         *
+         * @param dataType The data type.
+         * @param minimum Set to the smallest storable value.
+         * @param maximum Set to the largest storable value.
          */
-        const static inline int32_t round_and_cast(const float value)
+        static inline void getScaledRange(const DATA_TYPES dataType, int32_t &minimum, int32_t &maximum)
         {
-            if (value > 0)
-            {
-                return static_cast<int32_t>(value + 0.5f);
-            }
-            else
+            switch (dataType)
             {
-                return static_cast<int32_t>(value - 0.5f);
+            case DATA_TYPES::HUM_SENS:
+                minimum = 0;
+                maximum = Encoding == PAYLOAD_ENCODING::STANDARD ? 0xFF : 0xFFFF;  // Unsigned.
+                break;
+            case DATA_TYPES::BARO_SENS:
+                minimum = 0;
+                maximum = 0xFFFF;                                                   // Unsigned.
+                break;
+            case DATA_TYPES::GPS_LOC:
+                minimum = Encoding == PAYLOAD_ENCODING::STANDARD ? -0x800000L : -0x7FFFFFFFL - 1;
+                maximum = Encoding == PAYLOAD_ENCODING::STANDARD ? 0x7FFFFFL : 0x7FFFFFFFL;
+                break;
+            default:
+                minimum = -0x8000L;                                                 // Signed 16 bit.
+                maximum = 0x7FFF;
+                break;
             }
         }
 
         /**
-         * @brief Rounds a floating-point value and casts it to an int16_t.
-         * 
-         * Similar to round_and_cast, this function rounds the given floating-point value
-         * to the nearest integer, following the half-away-from-zero rule. The result is then
-         * cast to an int16_t. This function is particularly useful for values expected to be
-         * within the int16_t range and when working with data types that require lower precision
-         * and less storage.
-         * 
-         * @param value The floating-point value to be rounded and cast.
-         * @return int16_t The rounded value, cast to an int16_t.
+         * @brief Counts a clipped value and decides whether the field may still be written.
+         *
+         * @param converted The converted value.
+         * @return bool False if the policy rejects clipped values and this one was clipped.
          */
-        const static inline int16_t round_and_cast_int16(const float value)
+        bool accept(const ConversionResult &converted)
         {
-            if (value > 0)
+            if (!converted.clipped)
             {
-                return static_cast<int16_t>(value + 0.5f);
+                return true;
             }
-            else
+            if (clippedCount != 0xFFFF)
             {
-                return static_cast<int16_t>(value - 0.5f);
+                clippedCount++;
             }
+            return Policy != CONVERSION_POLICY::REPORT;
         }
 
         /**
@@ -389,8 +490,16 @@ namespace PAYLOAD_ENCODER
          */
         void appendHeader(const DATA_TYPES dataType, const uint8_t sensorChannel)
         {
-            buffer[currentIndex++] = static_cast<uint8_t>(dataType);
-            buffer[currentIndex++] = sensorChannel;
+            if (Encoding == PAYLOAD_ENCODING::STANDARD)
+            {
+                buffer[currentIndex++] = sensorChannel;
+                buffer[currentIndex++] = static_cast<uint8_t>(dataType);
+            }
+            else
+            {
+                buffer[currentIndex++] = static_cast<uint8_t>(dataType);
+                buffer[currentIndex++] = sensorChannel;
+            }
         }
 
         /**
@@ -407,8 +516,29 @@ namespace PAYLOAD_ENCODER
         template <typename T>
         void appendData(const T data)
         {
-            memcpyAVR(&buffer[currentIndex], &data, sizeof(T));
-            currentIndex += sizeof(T);
+            if (Encoding == PAYLOAD_ENCODING::STANDARD)
+            {
+                appendBigEndian(static_cast<uint32_t>(data), sizeof(T));
+            }
+            else
+            {
+                memcpyAVR(&buffer[currentIndex], &data, sizeof(T));
+                currentIndex += sizeof(T);
+            }
+        }
+
+        /**
+         * @brief Appends the lowest bytes of a value, most significant byte first.
+         *
+         * @param value The value; signed values are passed as their two's complement.
+         * @param byteCount Number of bytes to append, 1 up to and including 4.
+         */
+        void appendBigEndian(const uint32_t value, const size_t byteCount)
+        {
+            for (size_t i = byteCount; i > 0; i--)
+            {
+                buffer[currentIndex++] = static_cast<uint8_t>(value >> (8 * (i - 1)));
+            }
         }
 
         /**
@@ -461,24 +591,35 @@ namespace PAYLOAD_ENCODER
          * @brief Adds a field with a scaled float value to the payload.
          * 
          * Appends a sensor data field to the payload, including a header (data type and sensor channel)
-         * followed by a float value that is scaled and cast to a two-byte integer before appending.
+         * followed by a float value that is scaled and converted to the integer of the data type
+         * (two bytes, or one for humidity in the STANDARD encoding) under the conversion policy.
          * This is typically used for sensor data like temperature, humidity, etc., that need scaling.
          * 
          * @param dataType The data type identifier for the sensor data being appended.
          * @param sensorChannel The channel number associated with the sensor data.
-         * @param value The float sensor data value to be scaled, cast, and appended.
+         * @param value The float sensor data value to be scaled, converted, and appended.
          * @return uint8_t Returns the new current index in the buffer after appending the data.
-         *                 Returns 0 if there was insufficient capacity to append the data.
+         *                 Returns 0 if there was insufficient capacity, or if the value was out of
+         *                 range under CONVERSION_POLICY::REPORT.
          */
         const uint8_t addFieldImpl(const DATA_TYPES dataType, const uint8_t sensorChannel, const float value)
         {
-            const uint16_t resolution = FLOATING_DATA_RESOLUTION(dataType);
-            int16_t scaledValue = round_and_cast_int16(value * resolution);
-            if (!checkCapacity(4)) {
+            const size_t dataSize = getDataTypeSize(dataType, Encoding);
+            if (!checkCapacity(dataSize + 2)) {
+                return 0;
+            }
+            int32_t minimum, maximum;
+            getScaledRange(dataType, minimum, maximum);
+            const ConversionResult converted = convertScaled<Policy>(value * FLOATING_DATA_RESOLUTION(dataType, Encoding), minimum, maximum);
+            if (!accept(converted)) {
                 return 0;
             }
             appendHeader(dataType, sensorChannel);
-            appendData(scaledValue);
+            if (dataSize == 1) {
+                buffer[currentIndex++] = static_cast<uint8_t>(converted.value);
+            } else {
+                appendData(static_cast<uint16_t>(converted.value));
+            }
             return currentIndex;
         }
 
@@ -488,7 +629,8 @@ namespace PAYLOAD_ENCODER
          * This method appends data consisting of three float values to the payload, including a header
          * (data type and sensor channel). It provides special handling for GPS location data, applying
          * appropriate scaling and precision adjustments. For other data types requiring three floats,
-         * it scales and casts each float to a two-byte integer before appending.
+         * it scales and converts each float to a two-byte integer before appending. A field is only
+         * written when all three values are accepted by the conversion policy.
          * 
          * @param dataType The data type identifier for the sensor data being appended.
          * @param sensorChannel The channel number associated with the sensor data.
@@ -496,30 +638,46 @@ namespace PAYLOAD_ENCODER
          * @param second The second float value (e.g., longitude or y-axis acceleration).
          * @param third The third float value (e.g., altitude or z-axis acceleration).
          * @return uint8_t Returns the new current index in the buffer after appending the data.
-         *                 Returns 0 if there was insufficient capacity to append the data.
+         *                 Returns 0 if there was insufficient capacity, or if a value was out of
+         *                 range under CONVERSION_POLICY::REPORT.
          */
         const uint8_t addFieldImpl(const DATA_TYPES dataType, const uint8_t sensorChannel, 
             const float first, const float second, const float third)
         {
-            const size_t totalBytes = getDataTypeSize(dataType) + 2;
+            const size_t totalBytes = getDataTypeSize(dataType, Encoding) + 2;
             if (!checkCapacity(totalBytes))
                 return 0;
 
-            appendHeader(dataType, sensorChannel);
+            const bool gps = dataType == DATA_TYPES::GPS_LOC;
+            const int16_t resolution = FLOATING_DATA_RESOLUTION(dataType, Encoding);
+            int32_t minimum, maximum;
+            getScaledRange(dataType, minimum, maximum);
+            const ConversionResult converted[3] = {
+                convertScaled<Policy>(first * resolution, minimum, maximum),
+                convertScaled<Policy>(second * resolution, minimum, maximum),
+                // GPS altitude has a resolution of 0.01 meter.
+                convertScaled<Policy>(third * (gps ? resolution / 100 : resolution), minimum, maximum)};
+            bool accepted = accept(converted[0]);
+            accepted &= accept(converted[1]);
+            accepted &= accept(converted[2]);
+            if (!accepted)
+                return 0;
 
-            if (dataType == DATA_TYPES::GPS_LOC)
-            {
-                // Special handling for GPS data
-                appendData(round_and_cast(first * FLOATING_DATA_RESOLUTION(dataType)));
-                appendData(round_and_cast(second * FLOATING_DATA_RESOLUTION(dataType)));
-                appendData(round_and_cast(third * (FLOATING_DATA_RESOLUTION(dataType) / 100)));
-            }
-            else
+            appendHeader(dataType, sensorChannel);
+            for (uint8_t i = 0; i < 3; i++)
             {
-                // Generic handling for other types requiring three floats
-                appendData(round_and_cast_int16(first * FLOATING_DATA_RESOLUTION(dataType)));
-                appendData(round_and_cast_int16(second * FLOATING_DATA_RESOLUTION(dataType)));
-                appendData(round_and_cast_int16(third * FLOATING_DATA_RESOLUTION(dataType)));
+                if (gps && Encoding == PAYLOAD_ENCODING::STANDARD)
+                {
+                    appendBigEndian(static_cast<uint32_t>(converted[i].value), 3); // Packed int24.
+                }
+                else if (gps)
+                {
+                    appendData(converted[i].value);
+                }
+                else
+                {
+                    appendData(static_cast<int16_t>(converted[i].value));
+                }
             }
             return currentIndex;
         }
@@ -131,14 +131,81 @@ namespace PAYLOAD_ENCODER
         return 0;
     }
 
+    /**
+     * @brief Enum class defining the wire format of a payload.
+     */
+    enum class PAYLOAD_ENCODING : uint8_t
+    {
+        NATIVE      = 0,    /* [type][channel] headers, host byte order, GPS as 3 x int32 (12 bytes), humidity 0.1 % in 2 bytes */
+        STANDARD    = 1     /* [channel][type] headers, big-endian, GPS as 3 x int24 (9 bytes), humidity 0.5 % in 1 byte,
+                             * as in the CayenneLPP specification */
+    };
+
+    /**
+     * @brief Size of a GPS location in the STANDARD encoding: latitude, longitude and altitude as int24.
+     */
+    const static size_t GPS_LOC_STANDARD_SIZE = 9;
+
+    /**
+     * @brief Size and resolution (0.5 % unsigned) of a humidity value in the STANDARD encoding.
+     */
+    const static size_t HUM_SENS_STANDARD_SIZE = 1;
+    const static int16_t HUM_SENS_STANDARD_RESOLUTION = 2;
+
+    /**
+     * @brief Function to get the resolution of a data type in a given encoding.
+     * @param dataType The data type.
+     * @param encoding The wire format.
+     * @return The resolution of the data type, 0 for types without scaling.
+     */
+    const static inline int16_t FLOATING_DATA_RESOLUTION(DATA_TYPES dataType, PAYLOAD_ENCODING encoding)
+    {
+        if (encoding == PAYLOAD_ENCODING::STANDARD && dataType == DATA_TYPES::HUM_SENS)
+        {
+            return HUM_SENS_STANDARD_RESOLUTION;
+        }
+        return FLOATING_DATA_RESOLUTION(dataType);
+    }
+
+    /**
+     * @brief Function to get the size of a data type in a given encoding.
+     * @param dataType The data type.
+     * @param encoding The wire format.
+     * @return The size of the data type in bytes, 0 for an unknown data type.
+     */
+    const static inline size_t getDataTypeSize(DATA_TYPES dataType, PAYLOAD_ENCODING encoding)
+    {
+        if (encoding == PAYLOAD_ENCODING::STANDARD && dataType == DATA_TYPES::GPS_LOC)
+        {
+            return GPS_LOC_STANDARD_SIZE;
+        }
+        if (encoding == PAYLOAD_ENCODING::STANDARD && dataType == DATA_TYPES::HUM_SENS)
+        {
+            return HUM_SENS_STANDARD_SIZE;
+        }
+        return getDataTypeSize(dataType);
+    }
+
+    /**
+     * @brief Function to get the position of the data type byte within a field header.
+     * @param encoding The wire format.
+     * @return 0 when the type comes first (NATIVE), 1 when the channel comes first (STANDARD).
+     */
+    const static inline uint8_t getTypeHeaderOffset(PAYLOAD_ENCODING encoding)
+    {
+        return encoding == PAYLOAD_ENCODING::STANDARD ? 1 : 0;
+    }
+
     /**
      * @brief Enum class defining error types for Cayenne LPP.
      */
     enum class ERROR_TYPES : uint8_t
     {
-        LPP_ERROR_OVERFLOW      = 0,    /**< No error */
-        LPP_ERROR_UNKOWN_TYPE   = 1,    /**< Buffer overflow */
-        LPP_ERROR_OK            = 2     /**< Unknown data type */
+        LPP_ERROR_OVERFLOW      = 0,    /**< Buffer overflow */
+        LPP_ERROR_UNKOWN_TYPE   = 1,    /**< Unknown data type */
+        LPP_ERROR_OK            = 2,    /**< No error */
+        LPP_ERROR_TRUNCATED     = 3,    /**< Field header or data cut off by the end of the payload */
+        LPP_ERROR_OUT_OF_RANGE  = 4     /**< Value outside the range of the data type */
     };
 
 } // End of PAYLOAD_ENCODER Namespace.
@@ -0,0 +1,182 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef CAYENNE_VALIDATOR_HPP
+#define CAYENNE_VALIDATOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "CayenneReferences.hpp"
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief Outcome of validating a payload.
+     */
+    struct ValidationResult
+    {
+        ERROR_TYPES error;      ///< LPP_ERROR_OK, or the class of the first error found.
+        size_t offset;          ///< Byte offset of the first error; equals the payload size when valid.
+        size_t fieldCount;      ///< Number of fields that passed validation before the error.
+    };
+
+    /**
+     * @brief Reads a signed 16-bit integer in the byte order of the encoding.
+     */
+    static inline int16_t validatorReadInt16(const uint8_t *data, const PAYLOAD_ENCODING encoding = PAYLOAD_ENCODING::NATIVE)
+    {
+        if (encoding == PAYLOAD_ENCODING::STANDARD)
+        {
+            return static_cast<int16_t>(static_cast<uint16_t>((data[0] << 8) | data[1]));
+        }
+        return static_cast<int16_t>(static_cast<uint16_t>(data[0] | (data[1] << 8)));
+    }
+
+    /**
+     * @brief Reads a big-endian signed 24-bit integer, as written in the STANDARD encoding.
+     */
+    static inline int32_t validatorReadInt24(const uint8_t *data)
+    {
+        const uint32_t value = (static_cast<uint32_t>(data[0]) << 16) |
+                               (static_cast<uint32_t>(data[1]) << 8) |
+                               static_cast<uint32_t>(data[2]);
+        return static_cast<int32_t>(value ^ 0x800000UL) - 0x800000L;
+    }
+
+    /**
+     * @brief Reads a little-endian signed 32-bit integer, as written in the NATIVE encoding.
+     */
+    static inline int32_t validatorReadInt32(const uint8_t *data)
+    {
+        return static_cast<int32_t>(static_cast<uint32_t>(data[0]) |
+                                    (static_cast<uint32_t>(data[1]) << 8) |
+                                    (static_cast<uint32_t>(data[2]) << 16) |
+                                    (static_cast<uint32_t>(data[3]) << 24));
+    }
+
+    /**
+     * @brief Checks the value of one field against the range of its data type.
+     *
+     * Only types with a physical bound are checked; digital, analog, illumination,
+     * barometer (unsigned), accelerometer and gyroscope values may use their full encoded range.
+     *
+     * @param dataType The data type of the field.
+     * @param data Pointer to the first data byte of the field.
+     * @param available Number of bytes readable from data; a field that does not fit is reported at offset 0.
+     * @param encoding Wire format of the payload.
+     * @return size_t Offset of the offending value relative to data, or the data type
+     *                size when every value is in range.
+     */
+    static inline size_t checkFieldRange(const DATA_TYPES dataType, const uint8_t *data, const size_t available,
+                                         const PAYLOAD_ENCODING encoding = PAYLOAD_ENCODING::NATIVE)
+    {
+        if (available < getDataTypeSize(dataType, encoding))
+        {
+            return 0;
+        }
+        switch (dataType)
+        {
+        case DATA_TYPES::PRSNC_SENS:
+            return data[0] <= 1 ? 1 : 0;                        // 0 or 1
+        case DATA_TYPES::TEMP_SENS:
+            return validatorReadInt16(data, encoding) >= -2732 ? 2 : 0;   // Not below absolute zero, 0.1 °C
+        case DATA_TYPES::HUM_SENS:
+        {
+            if (encoding == PAYLOAD_ENCODING::STANDARD)
+                return data[0] <= 200 ? 1 : 0;                  // 0 - 100 %, 0.5 %
+            const uint16_t value = static_cast<uint16_t>(validatorReadInt16(data, encoding));
+            return value <= 1000 ? 2 : 0;                       // 0 - 100 %, 0.1 %
+        }
+        case DATA_TYPES::GPS_LOC:
+        {
+            const bool packed = encoding == PAYLOAD_ENCODING::STANDARD;
+            const size_t stride = packed ? 3 : 4;
+            if (available < 2 * stride)                         // Spelled out for the compiler's bounds analysis
+                return 0;
+            const int32_t lat = packed ? validatorReadInt24(data) : validatorReadInt32(data);
+            const int32_t lon = packed ? validatorReadInt24(data + stride) : validatorReadInt32(data + stride);
+            if (lat < -900000 || lat > 900000)                  // +-90°, 0.0001°
+                return 0;
+            if (lon < -1800000 || lon > 1800000)                // +-180°, 0.0001°
+                return stride;
+            return getDataTypeSize(dataType, encoding);
+        }
+        default:
+            return getDataTypeSize(dataType, encoding);
+        }
+    }
+
+    /**
+     * @brief Validates a complete payload in a single pass, without decoding it.
+     *
+     * Walks the [type][channel][data] fields once and stops at the first problem. Intended to
+     * run on every uplink before the full decode so that garbage is rejected cheaply.
+     *
+     * @param payload Pointer to the encoded payload.
+     * @param size Size of the payload in bytes.
+     * @param maxSize Largest payload accepted, e.g. the maximum LoRaWAN application payload.
+     * @param encoding Wire format of the payload.
+     * @return ValidationResult LPP_ERROR_OK, or LPP_ERROR_OVERFLOW, LPP_ERROR_UNKOWN_TYPE,
+     *                          LPP_ERROR_TRUNCATED or LPP_ERROR_OUT_OF_RANGE together with the
+     *                          byte offset of the offending byte.
+     */
+    static inline ValidationResult validatePayload(const uint8_t *payload, const size_t size, const size_t maxSize = 255,
+                                                   const PAYLOAD_ENCODING encoding = PAYLOAD_ENCODING::NATIVE)
+    {
+        ValidationResult result = {ERROR_TYPES::LPP_ERROR_OK, 0, 0};
+        if (size > maxSize)
+        {
+            result.error = ERROR_TYPES::LPP_ERROR_OVERFLOW;
+            result.offset = maxSize;
+            return result;
+        }
+        if (!payload && size > 0)
+        {
+            result.error = ERROR_TYPES::LPP_ERROR_TRUNCATED;
+            return result;
+        }
+
+        size_t index = 0;
+        while (index < size)
+        {
+            if (index + 2 > size)
+            {
+                result.error = ERROR_TYPES::LPP_ERROR_TRUNCATED;
+                result.offset = index;
+                return result;
+            }
+            const DATA_TYPES dataType = static_cast<DATA_TYPES>(payload[index + getTypeHeaderOffset(encoding)]);
+            const size_t dataSize = getDataTypeSize(dataType, encoding);
+            if (dataSize == 0)
+            {
+                result.error = ERROR_TYPES::LPP_ERROR_UNKOWN_TYPE;
+                result.offset = index + getTypeHeaderOffset(encoding);
+                return result;
+            }
+            if (index + 2 + dataSize > size)
+            {
+                result.error = ERROR_TYPES::LPP_ERROR_TRUNCATED;
+                result.offset = index;
+                return result;
+            }
+            const size_t validBytes = checkFieldRange(dataType, &payload[index + 2], size - index - 2, encoding);
+            if (validBytes != dataSize)
+            {
+                result.error = ERROR_TYPES::LPP_ERROR_OUT_OF_RANGE;
+                result.offset = index + 2 + validBytes;
+                return result;
+            }
+            index += 2 + dataSize;
+            result.fieldCount++;
+        }
+        result.offset = size;
+        return result;
+    }
+} // End of PAYLOAD_ENCODER Namespace.
+
+#endif // CAYENNE_VALIDATOR_HPP
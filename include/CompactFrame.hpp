@@ -0,0 +1,236 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef COMPACT_FRAME_HPP
+#define COMPACT_FRAME_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "CayenneReferences.hpp"
+#include "CayenneDecoder.hpp"
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief Maximum number of slots in a compact frame profile, two bitmap bytes.
+     */
+    const static uint8_t COMPACT_MAX_SLOTS = 16;
+
+    /**
+     * @brief One field a profile may carry: the data type on a sensor channel.
+     */
+    struct ProfileSlot
+    {
+        uint8_t channel;    ///< Sensor channel of the field.
+        DATA_TYPES type;    ///< Data type of the field.
+    };
+
+    /**
+     * @brief Fixed set of fields shared by the device and the decoder.
+     *
+     * A compact frame names its profile and marks which slots are present, so the
+     * [type][channel] header of every field is implied instead of transmitted.
+     */
+    struct CompactProfile
+    {
+        uint8_t id;                 ///< Profile ID, the first byte of a compact frame.
+        uint8_t slotCount;          ///< Number of slots, at most COMPACT_MAX_SLOTS.
+        const ProfileSlot *slots;   ///< Slots in transmission order.
+    };
+
+    /**
+     * @brief Function to get the size of the presence bitmap of a profile.
+     * @param profile The profile.
+     * @return The bitmap size in bytes, one bit per slot.
+     */
+    const static inline size_t getCompactBitmapSize(const CompactProfile &profile)
+    {
+        return (static_cast<size_t>(profile.slotCount) + 7) / 8;
+    }
+
+    /**
+     * @brief Function to convert a CayenneLPP payload into a compact frame.
+     *
+     * The compact frame is [profile ID][presence bitmap][field data...]. Bit i of the bitmap
+     * (least significant bit of the first byte first) marks slot i present. The data of the
+     * present fields follows in slot order, encoded exactly as in CayenneLPP.
+     *
+     * @param profile The profile the payload is written with.
+     * @param payload The CayenneLPP payload, e.g. lpp.getBuffer().
+     * @param size The size of the CayenneLPP payload.
+     * @param destination The buffer for the compact frame.
+     * @param destinationSize The size of the destination buffer.
+     * @return size_t The size of the compact frame. Returns 0 if a field is not in the profile,
+     *                occurs twice, the payload is malformed or the destination is too small.
+     */
+    const static inline size_t compactFrame(const CompactProfile &profile, const uint8_t *payload, const size_t size,
+                                            uint8_t *destination, const size_t destinationSize)
+    {
+        const size_t bitmapSize = getCompactBitmapSize(profile);
+        if (!payload || !destination || profile.slotCount > COMPACT_MAX_SLOTS || destinationSize < 1 + bitmapSize)
+        {
+            return 0;
+        }
+
+        // Locate the field of every slot in the classic payload.
+        uint8_t fieldOffset[COMPACT_MAX_SLOTS];
+        bool present[COMPACT_MAX_SLOTS] = {false};
+        size_t index = 0;
+        while (index < size)
+        {
+            if (index + 2 > size)
+            {
+                return 0;
+            }
+            const DATA_TYPES type = static_cast<DATA_TYPES>(payload[index]);
+            const uint8_t channel = payload[index + 1];
+            const size_t dataSize = getDataTypeSize(type);
+            if (dataSize == 0 || index + 2 + dataSize > size)
+            {
+                return 0;
+            }
+            uint8_t slot = 0;
+            while (slot < profile.slotCount && (profile.slots[slot].type != type || profile.slots[slot].channel != channel))
+            {
+                slot++;
+            }
+            if (slot == profile.slotCount || present[slot])
+            {
+                return 0;
+            }
+            present[slot] = true;
+            fieldOffset[slot] = static_cast<uint8_t>(index + 2);
+            index += 2 + dataSize;
+        }
+
+        destination[0] = profile.id;
+        for (size_t i = 0; i < bitmapSize; i++)
+        {
+            destination[1 + i] = 0;
+        }
+        size_t length = 1 + bitmapSize;
+        for (uint8_t slot = 0; slot < profile.slotCount; slot++)
+        {
+            if (!present[slot])
+            {
+                continue;
+            }
+            const size_t dataSize = getDataTypeSize(profile.slots[slot].type);
+            if (length + dataSize > destinationSize)
+            {
+                return 0;
+            }
+            destination[1 + slot / 8] |= static_cast<uint8_t>(1 << (slot % 8));
+            for (size_t i = 0; i < dataSize; i++)
+            {
+                destination[length++] = payload[fieldOffset[slot] + i];
+            }
+        }
+        return length;
+    }
+
+    /**
+     * @brief Function to find the profile of a compact frame by its ID.
+     * @param profiles The known profiles.
+     * @param profileCount The number of known profiles.
+     * @param id The profile ID.
+     * @return Pointer to the profile, or nullptr if the ID is unknown.
+     */
+    const static inline CompactProfile *findCompactProfile(const CompactProfile *profiles, const size_t profileCount, const uint8_t id)
+    {
+        for (size_t i = 0; i < profileCount; i++)
+        {
+            if (profiles[i].id == id)
+            {
+                return &profiles[i];
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Function to convert a compact frame back into a CayenneLPP payload.
+     *
+     * @param profiles The known profiles.
+     * @param profileCount The number of known profiles.
+     * @param frame The compact frame.
+     * @param size The size of the compact frame.
+     * @param destination The buffer for the CayenneLPP payload.
+     * @param destinationSize The size of the destination buffer.
+     * @return size_t The size of the CayenneLPP payload. Returns 0 if the profile is unknown,
+     *                the bitmap marks slots the profile does not have, the frame is truncated
+     *                or longer than its bitmap implies, or the destination is too small.
+     */
+    const static inline size_t expandCompactFrame(const CompactProfile *profiles, const size_t profileCount,
+                                                  const uint8_t *frame, const size_t size,
+                                                  uint8_t *destination, const size_t destinationSize)
+    {
+        if (!frame || !destination || size < 1)
+        {
+            return 0;
+        }
+        const CompactProfile *profile = findCompactProfile(profiles, profileCount, frame[0]);
+        if (!profile || profile->slotCount > COMPACT_MAX_SLOTS)
+        {
+            return 0;
+        }
+        const size_t bitmapSize = getCompactBitmapSize(*profile);
+        if (size < 1 + bitmapSize)
+        {
+            return 0;
+        }
+
+        size_t index = 1 + bitmapSize;
+        size_t length = 0;
+        for (uint8_t slot = 0; slot < bitmapSize * 8; slot++)
+        {
+            if (!(frame[1 + slot / 8] & (1 << (slot % 8))))
+            {
+                continue;
+            }
+            if (slot >= profile->slotCount)
+            {
+                return 0;
+            }
+            const ProfileSlot &entry = profile->slots[slot];
+            const size_t dataSize = getDataTypeSize(entry.type);
+            if (index + dataSize > size || length + 2 + dataSize > destinationSize)
+            {
+                return 0;
+            }
+            destination[length++] = static_cast<uint8_t>(entry.type);
+            destination[length++] = entry.channel;
+            for (size_t i = 0; i < dataSize; i++)
+            {
+                destination[length++] = frame[index++];
+            }
+        }
+        return index == size ? length : 0;
+    }
+
+    /**
+     * @brief Function to decode a compact frame into fields.
+     *
+     * @tparam MaxFields Maximum number of fields in one frame.
+     * @param profiles The known profiles.
+     * @param profileCount The number of known profiles.
+     * @param frame The compact frame.
+     * @param size The size of the compact frame.
+     * @param fields Destination array with room for MaxFields entries.
+     * @return size_t Number of decoded fields. Returns 0 if the frame is malformed.
+     */
+    template <size_t MaxFields>
+    const static inline size_t decodeCompactFrame(const CompactProfile *profiles, const size_t profileCount,
+                                                  const uint8_t *frame, const size_t size, DecodedField *fields)
+    {
+        uint8_t payload[255];
+        const size_t payloadSize = expandCompactFrame(profiles, profileCount, frame, size, payload, sizeof(payload));
+        return CayenneDecoder<MaxFields>::decodeUncached(payload, payloadSize, fields);
+    }
+} // End of Namespace PAYLOAD_ENCODER.
+#endif // COMPACT_FRAME_HPP
@@ -0,0 +1,176 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef DOWNLINK_COMMANDS_HPP
+#define DOWNLINK_COMMANDS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "CayenneReferences.hpp"
+#include "CayenneValidator.hpp"
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief Opcodes of the binary downlink protocol. Arguments are big-endian.
+     */
+    enum class DOWNLINK_COMMAND : uint8_t
+    {
+        SET_UPLINK_PERIOD   = 0x01,     /* uint16 seconds between measurement cycles, 10 - 65535 */
+        SET_SAMPLE_PERIOD   = 0x02,     /* uint16 milliseconds between accelerometer samples, 10 - 60000 */
+        SET_DEADBAND        = 0x03,     /* uint8 channel, uint16 deadband in 0.01 engineering units */
+        SET_DATA_RATE       = 0x04,     /* uint8 EU868 data rate, 0 - 5 */
+        REQUEST_UPLINK      = 0x05      /* No arguments: start the next measurement cycle now and report every field */
+    };
+
+    /**
+     * @brief Limits of the downlink command arguments.
+     */
+    const static uint16_t DOWNLINK_MIN_UPLINK_PERIOD_S = 10;
+    const static uint16_t DOWNLINK_MIN_SAMPLE_PERIOD_MS = 10;
+    const static uint16_t DOWNLINK_MAX_SAMPLE_PERIOD_MS = 60000;
+    const static uint8_t DOWNLINK_MAX_DATA_RATE = 5;
+
+    /**
+     * @brief Run-time configuration of a node that downlinks may change.
+     *
+     * @tparam Channels Number of sensor channels with a deadband.
+     */
+    template <size_t Channels>
+    struct DeviceConfig
+    {
+        uint32_t uplinkPeriodMs;        ///< Time between measurement cycles.
+        uint16_t samplePeriodMs;        ///< Time between accelerometer samples within a cycle.
+        uint8_t dataRate;               ///< EU868 data rate of the most robust uplink.
+        bool uplinkRequested;           ///< Set by REQUEST_UPLINK; cleared by the application once the uplink is sent.
+        float deadband[Channels];       ///< Report-on-change deadband per channel.
+    };
+
+    /**
+     * @brief Function to read a big-endian unsigned 16-bit downlink argument.
+     */
+    static inline uint16_t downlinkReadUint16(const uint8_t *data)
+    {
+        return static_cast<uint16_t>((data[0] << 8) | data[1]);
+    }
+
+    /**
+     * @brief Function to get the number of argument bytes of a downlink command.
+     * @param command The opcode.
+     * @return The argument size in bytes, or -1 for an unknown opcode.
+     */
+    static inline int8_t getDownlinkArgumentSize(const uint8_t command)
+    {
+        switch (static_cast<DOWNLINK_COMMAND>(command))
+        {
+        case DOWNLINK_COMMAND::SET_UPLINK_PERIOD:
+        case DOWNLINK_COMMAND::SET_SAMPLE_PERIOD:
+            return 2;
+        case DOWNLINK_COMMAND::SET_DEADBAND:
+            return 3;
+        case DOWNLINK_COMMAND::SET_DATA_RATE:
+            return 1;
+        case DOWNLINK_COMMAND::REQUEST_UPLINK:
+            return 0;
+        default:
+            return -1;
+        }
+    }
+
+    /**
+     * @brief Function to parse a downlink and apply all of its commands, or none.
+     *
+     * The downlink is a sequence of [opcode][arguments] commands. Every command is applied to a
+     * copy of the configuration on the stack; the copy replaces the configuration only when the
+     * whole downlink parsed without error, so a node never runs on half a configuration. Nothing
+     * is allocated.
+     *
+     * @param payload The downlink payload.
+     * @param size The size of the downlink payload.
+     * @param config The configuration to update.
+     * @return ValidationResult LPP_ERROR_OK with the number of commands in fieldCount, or
+     *                          LPP_ERROR_UNKOWN_TYPE (unknown opcode), LPP_ERROR_TRUNCATED
+     *                          (missing arguments) or LPP_ERROR_OUT_OF_RANGE together with the
+     *                          offset of the rejected command. The configuration is then unchanged.
+     */
+    template <size_t Channels>
+    static inline ValidationResult applyDownlink(const uint8_t *payload, const size_t size, DeviceConfig<Channels> &config)
+    {
+        ValidationResult result = {ERROR_TYPES::LPP_ERROR_OK, 0, 0};
+        if (!payload && size > 0)
+        {
+            result.error = ERROR_TYPES::LPP_ERROR_TRUNCATED;
+            return result;
+        }
+
+        DeviceConfig<Channels> staged = config;
+        size_t index = 0;
+        while (index < size)
+        {
+            result.offset = index;
+            const int8_t argumentSize = getDownlinkArgumentSize(payload[index]);
+            if (argumentSize < 0)
+            {
+                result.error = ERROR_TYPES::LPP_ERROR_UNKOWN_TYPE;
+                return result;
+            }
+            if (index + 1 + argumentSize > size)
+            {
+                result.error = ERROR_TYPES::LPP_ERROR_TRUNCATED;
+                return result;
+            }
+
+            const uint8_t *argument = &payload[index + 1];
+            bool inRange = true;
+            switch (static_cast<DOWNLINK_COMMAND>(payload[index]))
+            {
+            case DOWNLINK_COMMAND::SET_UPLINK_PERIOD:
+            {
+                const uint16_t seconds = downlinkReadUint16(argument);
+                inRange = seconds >= DOWNLINK_MIN_UPLINK_PERIOD_S;
+                staged.uplinkPeriodMs = static_cast<uint32_t>(seconds) * 1000;
+                break;
+            }
+            case DOWNLINK_COMMAND::SET_SAMPLE_PERIOD:
+            {
+                const uint16_t milliseconds = downlinkReadUint16(argument);
+                inRange = milliseconds >= DOWNLINK_MIN_SAMPLE_PERIOD_MS && milliseconds <= DOWNLINK_MAX_SAMPLE_PERIOD_MS;
+                staged.samplePeriodMs = milliseconds;
+                break;
+            }
+            case DOWNLINK_COMMAND::SET_DEADBAND:
+                inRange = argument[0] < Channels;
+                if (inRange)
+                {
+                    staged.deadband[argument[0]] = downlinkReadUint16(argument + 1) / 100.0f;
+                }
+                break;
+            case DOWNLINK_COMMAND::SET_DATA_RATE:
+                inRange = argument[0] <= DOWNLINK_MAX_DATA_RATE;
+                staged.dataRate = argument[0];
+                break;
+            default: // REQUEST_UPLINK
+                staged.uplinkRequested = true;
+                break;
+            }
+            if (!inRange)
+            {
+                result.error = ERROR_TYPES::LPP_ERROR_OUT_OF_RANGE;
+                return result;
+            }
+            index += 1 + argumentSize;
+            result.fieldCount++;
+        }
+
+        config = staged;
+        result.offset = size;
+        return result;
+    }
+} // End of PAYLOAD_ENCODER Namespace.
+
+#endif // DOWNLINK_COMMANDS_HPP
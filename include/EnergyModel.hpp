@@ -0,0 +1,239 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef ENERGY_MODEL_HPP
+#define ENERGY_MODEL_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief What the node is doing, each with its own supply current.
+     *
+     * There is no power-down phase: KISSLoRa_sleep_delay_ms() stops timer0, so millis() would
+     * stand still for the duty-cycle limiter and the report-on-change silence, and the firmware
+     * only sleeps in KISSLoRa_sleep_idle_ms().
+     */
+    enum class ENERGY_PHASE : uint8_t
+    {
+        ACTIVE          = 0,    /* CPU running with all peripherals on: control flow, delay(), modem UART. */
+        SENSOR_READ     = 1,    /* Reading the Si7021, accelerometer, light sensor and switch. */
+        ENCODE          = 2,    /* Building the payload. */
+        TX              = 3,    /* RN2483 transmitting. */
+        RX_WINDOW       = 4,    /* RN2483 listening in RX1/RX2. */
+        IDLE_SLEEP      = 5,    /* MCU in idle sleep, timer running (KISSLoRa_sleep_idle_ms). */
+        COUNT           = 6
+    };
+
+    const static size_t ENERGY_PHASE_COUNT = static_cast<size_t>(ENERGY_PHASE::COUNT);
+
+    /**
+     * @brief Supply current of the node in every phase.
+     */
+    struct EnergyProfile
+    {
+        float currentMa[ENERGY_PHASE_COUNT];    ///< Current in mA, indexed by ENERGY_PHASE.
+    };
+
+    /**
+     * @brief Currents of the KISS node at 3.77 V.
+     *
+     * The MCU figures are the board currents measured in lib/KISS_LoRa/KISSLoRa_sleep.cpp:
+     * 13.80 mA with all peripherals enabled and 10.65 mA in idle sleep; the RN2483 is in its idle
+     * state in both. TX and RX add the RN2483 datasheet currents
+     * at 14 dBm (38.9 mA) and in receive (14.2 mA) to the active figure.
+     */
+    const static EnergyProfile KISS_ENERGY_PROFILE = {{13.80f, 13.80f, 13.80f, 52.70f, 28.00f, 10.65f}};
+
+    /**
+     * @brief Books the time of the node on phases and turns it into charge.
+     *
+     * The node is always in exactly one phase; begin() ends the current phase and starts the next,
+     * so tagging the start of every phase accounts for all time. Timestamps are micros() values;
+     * a single phase may last up to 71 minutes before the 32-bit difference wraps.
+     */
+    class EnergyAccount
+    {
+    public:
+        /**
+         * @brief Constructor for EnergyAccount, starts in ACTIVE at time 0.
+         *
+         * @param profile The currents of the node.
+         */
+        explicit EnergyAccount(const EnergyProfile &profile = KISS_ENERGY_PROFILE) : profile(profile)
+        {
+            reset(0);
+        }
+
+        /**
+         * @brief Clears all booked time and uplinks and starts in ACTIVE.
+         *
+         * @param nowUs The current time in microseconds, e.g. micros().
+         */
+        void reset(const uint32_t nowUs)
+        {
+            for (size_t i = 0; i < ENERGY_PHASE_COUNT; i++)
+            {
+                timeUs[i] = 0;
+            }
+            uplinks = 0;
+            phase = ENERGY_PHASE::ACTIVE;
+            phaseStartUs = nowUs;
+        }
+
+        /**
+         * @brief Books the time since the last call on the current phase, without switching.
+         *
+         * @param nowUs The current time in microseconds.
+         */
+        void update(const uint32_t nowUs)
+        {
+            timeUs[static_cast<size_t>(phase)] += static_cast<uint32_t>(nowUs - phaseStartUs);
+            phaseStartUs = nowUs;
+        }
+
+        /**
+         * @brief Ends the current phase and starts another.
+         *
+         * @param next The phase starting now.
+         * @param nowUs The current time in microseconds.
+         */
+        void begin(const ENERGY_PHASE next, const uint32_t nowUs)
+        {
+            update(nowUs);
+            phase = next < ENERGY_PHASE::COUNT ? next : ENERGY_PHASE::ACTIVE;
+        }
+
+        /**
+         * @brief Ends a TX phase that covered a whole sendBytes() call, and counts the uplink.
+         *
+         * The call transmits for the time on air and then listens in the receive windows, so the
+         * time beyond the time on air is moved to RX_WINDOW. The node continues in ACTIVE.
+         *
+         * @param nowUs The current time in microseconds, right after sendBytes() returned.
+         * @param timeOnAirUs Time on air of the uplink, e.g. getUplinkTimeOnAirUs().
+         */
+        void endUplink(const uint32_t nowUs, const uint32_t timeOnAirUs)
+        {
+            const uint32_t callUs = static_cast<uint32_t>(nowUs - phaseStartUs);
+            const uint32_t txUs = callUs < timeOnAirUs ? callUs : timeOnAirUs;
+            timeUs[static_cast<size_t>(ENERGY_PHASE::TX)] += txUs;
+            timeUs[static_cast<size_t>(ENERGY_PHASE::RX_WINDOW)] += callUs - txUs;
+            uplinks++;
+            phase = ENERGY_PHASE::ACTIVE;
+            phaseStartUs = nowUs;
+        }
+
+        /**
+         * @brief Gets the time booked on a phase.
+         *
+         * @param which The phase.
+         * @return uint64_t Time in microseconds.
+         */
+        uint64_t getTimeUs(const ENERGY_PHASE which) const
+        {
+            return which < ENERGY_PHASE::COUNT ? timeUs[static_cast<size_t>(which)] : 0;
+        }
+
+        /**
+         * @brief Gets the total time booked.
+         *
+         * @return uint64_t Time in microseconds.
+         */
+        uint64_t getTotalTimeUs(void) const
+        {
+            uint64_t total = 0;
+            for (size_t i = 0; i < ENERGY_PHASE_COUNT; i++)
+            {
+                total += timeUs[i];
+            }
+            return total;
+        }
+
+        /**
+         * @brief Gets the charge drawn in a phase.
+         *
+         * @param which The phase.
+         * @return float Charge in mAh.
+         */
+        float getChargeMah(const ENERGY_PHASE which) const
+        {
+            return which < ENERGY_PHASE::COUNT ? profile.currentMa[static_cast<size_t>(which)] * (getTimeUs(which) / US_PER_HOUR) : 0.0f;
+        }
+
+        /**
+         * @brief Gets the charge drawn in all phases.
+         *
+         * @return float Charge in mAh.
+         */
+        float getTotalChargeMah(void) const
+        {
+            float total = 0.0f;
+            for (size_t i = 0; i < ENERGY_PHASE_COUNT; i++)
+            {
+                total += getChargeMah(static_cast<ENERGY_PHASE>(i));
+            }
+            return total;
+        }
+
+        /**
+         * @brief Gets the number of uplinks counted by endUplink().
+         *
+         * @return uint32_t Uplink count.
+         */
+        uint32_t getUplinkCount(void) const
+        {
+            return uplinks;
+        }
+
+        /**
+         * @brief Gets the charge drawn per uplink, all phases included.
+         *
+         * @return float Charge in mAh, 0 before the first uplink.
+         */
+        float getChargePerUplinkMah(void) const
+        {
+            return uplinks ? getTotalChargeMah() / uplinks : 0.0f;
+        }
+
+        /**
+         * @brief Gets the average supply current over the booked time.
+         *
+         * @return float Current in mA, 0 before any time was booked.
+         */
+        float getAverageCurrentMa(void) const
+        {
+            const uint64_t total = getTotalTimeUs();
+            return total ? getTotalChargeMah() / (total / US_PER_HOUR) : 0.0f;
+        }
+
+        /**
+         * @brief Gets how long a battery lasts at the average current.
+         *
+         * @param capacityMah The usable battery capacity.
+         * @return float Battery life in days, 0 before any time was booked.
+         */
+        float getBatteryLifeDays(const float capacityMah) const
+        {
+            const float averageMa = getAverageCurrentMa();
+            return averageMa > 0.0f ? capacityMah / averageMa / 24.0f : 0.0f;
+        }
+
+    private:
+        static constexpr float US_PER_HOUR = 3600000000.0f;
+
+        EnergyProfile profile;
+        uint64_t timeUs[ENERGY_PHASE_COUNT];
+        uint32_t uplinks;
+        ENERGY_PHASE phase;
+        uint32_t phaseStartUs;
+    }; // End of class EnergyAccount.
+} // End of Namespace PAYLOAD_ENCODER.
+#endif // ENERGY_MODEL_HPP
@@ -0,0 +1,91 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef FIXED_POINT_CONVERSION_HPP
+#define FIXED_POINT_CONVERSION_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief What the encoder does with a scaled value outside the range of its data type.
+     */
+    enum class CONVERSION_POLICY : uint8_t
+    {
+        SATURATE    = 0,    /* Clamp to the nearest representable value. */
+        WRAP        = 1,    /* Keep the low bits, the behaviour of a plain integer cast. */
+        REPORT      = 2     /* Reject the field: the add* call returns 0 and writes nothing. */
+    };
+
+    /**
+     * @brief Outcome of converting one scaled value.
+     */
+    struct ConversionResult
+    {
+        int32_t value;      ///< The value to store; only the low bits of the field size are written.
+        bool clipped;       ///< True if the rounded value was outside [minimum, maximum].
+    };
+
+    /**
+     * @brief Function to round half away from zero without branching on the sign.
+     *
+     * Adds 0.5 carrying the sign bit of the value, then truncates. Values beyond the int32
+     * range give 0x7FFFFF80 or its negative, NaN gives the negative; any data type clips these.
+     *
+     * @param value The scaled floating-point value.
+     * @return int32_t The rounded value.
+     */
+    const static inline int32_t roundHalfAwayFromZero(const float value)
+    {
+        const float limit = 2147483520.0f; // Largest float below 2^31.
+        // NaN fails the first comparison and ends up at the lower limit.
+        const float bounded = value > -limit ? (value < limit ? value : limit) : -limit;
+
+        uint32_t bits;
+        memcpy(&bits, &bounded, sizeof(bits));
+        bits = 0x3F000000UL | (bits & 0x80000000UL); // +-0.5 with the sign of value.
+        float half;
+        memcpy(&half, &bits, sizeof(half));
+        return static_cast<int32_t>(bounded + half);
+    }
+
+    /**
+     * @brief Function to convert a scaled value into the integer range of a data type.
+     *
+     * @tparam Policy How values outside [minimum, maximum] are stored.
+     * @param scaled The value multiplied by the resolution of its data type.
+     * @param minimum The smallest value the field can hold.
+     * @param maximum The largest value the field can hold.
+     * @return ConversionResult The value to store and whether it was clipped.
+     */
+    template <CONVERSION_POLICY Policy>
+    const static inline ConversionResult convertScaled(const float scaled, const int32_t minimum, const int32_t maximum)
+    {
+        const int32_t rounded = roundHalfAwayFromZero(scaled);
+        const bool below = rounded < minimum;
+        const bool above = rounded > maximum;
+        ConversionResult result;
+        result.clipped = below | above;
+        if (Policy == CONVERSION_POLICY::SATURATE)
+        {
+            // Select without branches: exactly one of the three masks is all ones.
+            const int32_t keep = -static_cast<int32_t>(!result.clipped);
+            result.value = (rounded & keep) | (minimum & -static_cast<int32_t>(below)) | (maximum & -static_cast<int32_t>(above));
+        }
+        else
+        {
+            result.value = rounded;
+        }
+        return result;
+    }
+} // End of PAYLOAD_ENCODER Namespace.
+
+#endif // FIXED_POINT_CONVERSION_HPP
@@ -0,0 +1,100 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef KISS_NODE_HPP
+#define KISS_NODE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "CompactFrame.hpp"
+
+/**
+ * @brief Channels, FPorts, compact frame profile and frame building configuration of the KISS
+ * node firmware.
+ *
+ * Included by src/main.hpp and by the host programs that build or decode the same frames, so
+ * the firmware, its emulation and the decoders cannot drift apart.
+ */
+namespace KISS
+{
+    /**
+     * @brief CayenneLPP channel of every sensor field of the KISS node.
+     */
+    enum class NodeSensors : uint8_t
+    {
+        LPP_CH_TEMPERATURE      = 0,    /* Temperature. */
+        LPP_CH_HUMIDITY         = 1,    /* Humidity sensor. */
+        LPP_CH_LUMINOSITY       = 2,    /* Luminosity sensor. */
+        LPP_CH_ROTARYSWITCH     = 3,    /* Rotary switch. */
+        LPP_CH_ACCELEROMETER    = 4,    /* Accelerometer. */
+        LPP_CH_BOARDVCCVOLTAGE  = 5,    /* Processor voltage. */
+        LPP_CH_PRESENCE         = 6,    /* Wake events of an event uplink. */
+        LPP_CH_ACC_MIN          = 7,    /* Accelerometer minimum since the last summary. */
+        LPP_CH_ACC_MAX          = 8,    /* Accelerometer maximum since the last summary. */
+        LPP_CH_ACC_MEAN         = 9,    /* Accelerometer mean since the last summary. */
+        LPP_CH_ACC_RMS          = 10    /* Accelerometer RMS since the last summary. */
+    };
+
+    const static uint8_t FPORT_CAYENNE = 1;         ///< CayenneLPP frames.
+    const static uint8_t FPORT_COMPACT = 2;         ///< Compact frames, profile ID + channel bitmap.
+    const static uint8_t FPORT_DIAGNOSTICS = 3;     ///< Phase profile, see PhaseProfiler::report.
+    const static uint8_t FPORT_COMMAND = 10;        ///< Binary downlink commands.
+
+    /// ID of the KISS node profile, the first byte of its compact frames.
+    const static uint8_t COMPACT_PROFILE_ID = 1;
+
+    /// Fields of the KISS node in compact frame slot order.
+    const static PAYLOAD_ENCODER::ProfileSlot KISS_PROFILE_SLOTS[] = {
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_TEMPERATURE), PAYLOAD_ENCODER::DATA_TYPES::TEMP_SENS},
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_HUMIDITY), PAYLOAD_ENCODER::DATA_TYPES::HUM_SENS},
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_LUMINOSITY), PAYLOAD_ENCODER::DATA_TYPES::ILLUM_SENS},
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_ROTARYSWITCH), PAYLOAD_ENCODER::DATA_TYPES::DIG_IN},
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_ACCELEROMETER), PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS},
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_BOARDVCCVOLTAGE), PAYLOAD_ENCODER::DATA_TYPES::ANL_IN},
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_ACC_MIN), PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS},
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_ACC_MAX), PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS},
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_ACC_MEAN), PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS},
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_ACC_RMS), PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS},
+        {static_cast<uint8_t>(NodeSensors::LPP_CH_PRESENCE), PAYLOAD_ENCODER::DATA_TYPES::PRSNC_SENS},
+    };
+
+    /// Compact frame profile of the KISS node.
+    const static PAYLOAD_ENCODER::CompactProfile KISS_PROFILE = {
+        COMPACT_PROFILE_ID, sizeof(KISS_PROFILE_SLOTS) / sizeof(KISS_PROFILE_SLOTS[0]), KISS_PROFILE_SLOTS};
+
+    /**
+     * @brief Priority of a field group in the payload budget, see CayenneBudgetFrame.
+     */
+    enum class FieldPriority : uint8_t
+    {
+        PRIO_DIAGNOSTICS    = 0,    /* Board voltage, first to go when the payload budget shrinks. */
+        PRIO_MOTION         = 1,    /* Accelerometer and its window summary. */
+        PRIO_INPUT          = 2,    /* Rotary switch. */
+        PRIO_ENVIRONMENT    = 3     /* Temperature, humidity and luminosity. */
+    };
+
+    /// Number of sensor channels tracked by the deadband filter; LPP_CH_ACC_MIN stands for the whole accelerometer summary.
+    const static uint8_t REPORT_CHANNELS = 8;
+    /// Every channel is reported at least once an hour.
+    const static uint32_t REPORT_MAX_SILENCE_MS = 3600000UL;
+
+    const static float DEADBAND_TEMPERATURE = 0.2f;         ///< Degrees Celsius.
+    const static float DEADBAND_HUMIDITY = 1.0f;            ///< %RH.
+    const static float DEADBAND_LUMINOSITY = 10.0f;         ///< Lux.
+    const static float DEADBAND_ROTARYSWITCH = 0.5f;        ///< Any change of position.
+    const static float DEADBAND_ACCELEROMETER = 0.05f;      ///< g, largest change over the three axes.
+    const static float DEADBAND_BOARDVCCVOLTAGE = 0.05f;    ///< Volt.
+    const static float DEADBAND_PRESENCE = 0.0f;            ///< Event uplinks only, never filtered.
+    const static float DEADBAND_ACC_SUMMARY = 0.05f;        ///< g, largest change of the peak-to-peak swing over the three axes.
+
+    /// Default deadband of every tracked channel, in NodeSensors order.
+    const static float REPORT_DEADBANDS[REPORT_CHANNELS] = {
+        DEADBAND_TEMPERATURE, DEADBAND_HUMIDITY, DEADBAND_LUMINOSITY, DEADBAND_ROTARYSWITCH,
+        DEADBAND_ACCELEROMETER, DEADBAND_BOARDVCCVOLTAGE, DEADBAND_PRESENCE, DEADBAND_ACC_SUMMARY};
+} // End of Namespace KISS.
+#endif // KISS_NODE_HPP
@@ -0,0 +1,264 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef LORA_AIRTIME_HPP
+#define LORA_AIRTIME_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "LoRaWANParameters.hpp"
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief LoRa coding rates, as the number of redundancy bits (4/5 - 4/8).
+     */
+    enum class LORA_CODING_RATE : uint8_t
+    {
+        CR_4_5 = 1,
+        CR_4_6 = 2,
+        CR_4_7 = 3,
+        CR_4_8 = 4
+    };
+
+    /**
+     * @brief Bytes a LoRaWAN uplink adds around the application payload: MHDR (1), FHDR (7), FPort (1) and MIC (4).
+     */
+    const static uint8_t LORAWAN_FRAME_OVERHEAD = 13;
+
+    /**
+     * @brief Function to calculate the time on air of one LoRa packet.
+     *
+     * Implements the formula of Semtech AN1200.13 with an explicit header and CRC, as used for
+     * LoRaWAN uplinks. Low data rate optimization is enabled when a symbol lasts 16 ms or longer
+     * (SF11 and SF12 at 125 kHz). All arithmetic is integer and exact in microseconds.
+     *
+     * @param spreadingFactor The spreading factor, 7 up to and including 12.
+     * @param bandwidthKHz The bandwidth: 125, 250 or 500 kHz.
+     * @param codingRate The coding rate.
+     * @param phyPayloadSize The size of the PHY payload in bytes (application payload plus LORAWAN_FRAME_OVERHEAD).
+     * @param preambleSymbols The number of programmed preamble symbols, 8 for LoRaWAN.
+     * @return The time on air in microseconds. Returns 0 for an invalid spreading factor or bandwidth.
+     */
+    const static inline uint32_t getTimeOnAirUs(const uint8_t spreadingFactor, const uint16_t bandwidthKHz,
+        const LORA_CODING_RATE codingRate, const uint8_t phyPayloadSize, const uint8_t preambleSymbols = 8)
+    {
+        if (spreadingFactor < 7 || spreadingFactor > 12 ||
+            (bandwidthKHz != 125 && bandwidthKHz != 250 && bandwidthKHz != 500))
+        {
+            return 0;
+        }
+        const uint32_t symbolUs = (static_cast<uint32_t>(1) << spreadingFactor) * 1000 / bandwidthKHz;
+        const int32_t lowDataRate = symbolUs >= 16000 ? 1 : 0;
+
+        // 8 * PL - 4 * SF + 28 + 16 (CRC) - 0 (explicit header)
+        const int32_t numerator = 8 * static_cast<int32_t>(phyPayloadSize) - 4 * spreadingFactor + 28 + 16;
+        const int32_t denominator = 4 * (spreadingFactor - 2 * lowDataRate);
+        int32_t payloadSymbols = 8;
+        if (numerator > 0)
+        {
+            payloadSymbols += ((numerator + denominator - 1) / denominator) * (static_cast<int32_t>(codingRate) + 4);
+        }
+
+        // The preamble lasts preambleSymbols + 4.25 symbols; count in quarter symbols to stay integer.
+        const uint32_t quarterSymbols = 4 * static_cast<uint32_t>(preambleSymbols) + 17 + 4 * static_cast<uint32_t>(payloadSymbols);
+        return quarterSymbols * symbolUs / 4;
+    }
+
+    /**
+     * @brief Function to calculate the time on air of a LoRaWAN uplink on EU868 (125 kHz, CR 4/5).
+     * @param applicationPayloadSize The size of the application payload, e.g. lpp.getSize().
+     * @param spreadingFactor The spreading factor, 7 up to and including 12.
+     * @return The time on air in microseconds.
+     */
+    const static inline uint32_t getUplinkTimeOnAirUs(const uint8_t applicationPayloadSize, const uint8_t spreadingFactor)
+    {
+        return getTimeOnAirUs(spreadingFactor, 125, LORA_CODING_RATE::CR_4_5,
+                              static_cast<uint8_t>(applicationPayloadSize + LORAWAN_FRAME_OVERHEAD));
+    }
+
+    /**
+     * @brief EU868 sub-bands with their own duty cycle limit (ETSI EN 300 220).
+     */
+    enum class EU868_SUB_BAND : uint8_t
+    {
+        BAND_863_865    = 0,    /* 0.1 % */
+        BAND_865_868    = 1,    /* 1 %, TTN channels 867.1 - 867.9 MHz */
+        BAND_868_0_868_6 = 2,   /* 1 %, TTN channels 868.1, 868.3 and 868.5 MHz */
+        BAND_868_7_869_2 = 3,   /* 0.1 % */
+        BAND_869_4_869_65 = 4,  /* 10 %, RX2 */
+        BAND_869_7_870  = 5     /* 1 % */
+    };
+
+    const static size_t EU868_SUB_BAND_COUNT = 6;
+
+    /**
+     * @brief Function to get the duty cycle of a sub-band as the divisor of the transmit time.
+     * @param band The sub-band.
+     * @return 1000 for 0.1 %, 100 for 1 % and 10 for 10 %.
+     */
+    const static inline uint16_t getDutyCycleDivisorEU868(const EU868_SUB_BAND band)
+    {
+        switch (band)
+        {
+        case EU868_SUB_BAND::BAND_863_865:
+        case EU868_SUB_BAND::BAND_868_7_869_2:
+            return 1000;
+        case EU868_SUB_BAND::BAND_869_4_869_65:
+            return 10;
+        default:
+            return 100;
+        }
+    }
+
+    /**
+     * @brief Token bucket per EU868 sub-band that keeps transmissions within the duty cycle.
+     *
+     * Every sub-band earns transmit credit as time passes, at its duty cycle rate, and a
+     * transmission spends its time on air. Credit is capped at the duty cycle share of one
+     * hour, the observation period of the regulation. Credit is kept in microseconds of
+     * elapsed time, where a transmission costs its time on air times the duty cycle divisor,
+     * so accrual is exact without fractions.
+     */
+    class DutyCycleLimiter
+    {
+    public:
+        /**
+         * @brief Constructor for DutyCycleLimiter, starts every sub-band with full credit.
+         *
+         * @param nowMs The current time in milliseconds, e.g. millis().
+         */
+        explicit DutyCycleLimiter(const uint32_t nowMs = 0) : lastUpdateMs(nowMs)
+        {
+            for (size_t i = 0; i < EU868_SUB_BAND_COUNT; i++)
+            {
+                credit[i] = MAX_CREDIT;
+            }
+        }
+
+        /**
+         * @brief Adds the credit earned since the previous update.
+         *
+         * @param nowMs The current time in milliseconds; wraps like millis().
+         */
+        void update(const uint32_t nowMs)
+        {
+            uint32_t elapsedMs = nowMs - lastUpdateMs;
+            lastUpdateMs = nowMs;
+            if (elapsedMs > MAX_CREDIT / 1000)
+            {
+                elapsedMs = MAX_CREDIT / 1000;
+            }
+            const uint32_t earned = elapsedMs * 1000;
+            for (size_t i = 0; i < EU868_SUB_BAND_COUNT; i++)
+            {
+                credit[i] = (MAX_CREDIT - credit[i] < earned) ? MAX_CREDIT : credit[i] + earned;
+            }
+        }
+
+        /**
+         * @brief Checks whether a transmission fits in the credit of a sub-band now.
+         *
+         * @param band The sub-band.
+         * @param timeOnAirUs The time on air of the transmission.
+         * @return bool True if the transmission is allowed.
+         */
+        bool canTransmit(const EU868_SUB_BAND band, const uint32_t timeOnAirUs) const
+        {
+            return cost(band, timeOnAirUs) <= credit[static_cast<uint8_t>(band)];
+        }
+
+        /**
+         * @brief Spends the credit for a transmission.
+         *
+         * @param band The sub-band.
+         * @param timeOnAirUs The time on air of the transmission.
+         * @return bool True if the credit sufficed and was spent; false leaves the credit untouched.
+         */
+        bool consume(const EU868_SUB_BAND band, const uint32_t timeOnAirUs)
+        {
+            if (!canTransmit(band, timeOnAirUs))
+            {
+                return false;
+            }
+            credit[static_cast<uint8_t>(band)] -= cost(band, timeOnAirUs);
+            return true;
+        }
+
+        /**
+         * @brief Gets how long to wait before a transmission fits in the credit of a sub-band.
+         *
+         * @param band The sub-band.
+         * @param timeOnAirUs The time on air of the transmission.
+         * @return uint32_t Waiting time in milliseconds, 0 if the transmission is allowed now.
+         *                  Returns 0xFFFFFFFF if the transmission exceeds the credit of one hour.
+         */
+        uint32_t getWaitTimeMs(const EU868_SUB_BAND band, const uint32_t timeOnAirUs) const
+        {
+            const uint32_t needed = cost(band, timeOnAirUs);
+            const uint32_t available = credit[static_cast<uint8_t>(band)];
+            if (needed <= available)
+            {
+                return 0;
+            }
+            if (needed > MAX_CREDIT)
+            {
+                return 0xFFFFFFFFUL;
+            }
+            return (needed - available + 999) / 1000;
+        }
+
+        /**
+         * @brief Selects the spreading factor for an uplink.
+         *
+         * Walks from the most robust spreading factor (maxSF) towards the fastest (minSF) and
+         * returns the first one whose maximum payload holds the payload and whose time on air
+         * fits in the credit of the sub-band now.
+         *
+         * @param band The sub-band.
+         * @param applicationPayloadSize The size of the application payload.
+         * @param minSF The fastest spreading factor allowed.
+         * @param maxSF The most robust spreading factor allowed.
+         * @return uint8_t The selected spreading factor. Returns 0 if no spreading factor fits now.
+         */
+        uint8_t selectSpreadingFactor(const EU868_SUB_BAND band, const uint8_t applicationPayloadSize,
+                                      const uint8_t minSF, const uint8_t maxSF) const
+        {
+            for (uint8_t sf = maxSF; sf >= minSF && sf >= 7; sf--)
+            {
+                if (applicationPayloadSize <= getMaxPayloadSizeEU868(getDataRateEU868(sf)) &&
+                    canTransmit(band, getUplinkTimeOnAirUs(applicationPayloadSize, sf)))
+                {
+                    return sf;
+                }
+            }
+            return 0;
+        }
+
+    private:
+        static const uint32_t MAX_CREDIT = 3600000000UL; ///< One hour in microseconds.
+
+        uint32_t credit[EU868_SUB_BAND_COUNT];
+        uint32_t lastUpdateMs;
+
+        /**
+         * @brief Converts a time on air into credit units for a sub-band.
+         */
+        static uint32_t cost(const EU868_SUB_BAND band, const uint32_t timeOnAirUs)
+        {
+            const uint16_t divisor = getDutyCycleDivisorEU868(band);
+            if (timeOnAirUs > MAX_CREDIT / divisor)
+            {
+                return 0xFFFFFFFFUL; // More than one hour of credit, never affordable.
+            }
+            return timeOnAirUs * divisor;
+        }
+    }; // End of class DutyCycleLimiter.
+} // End of PAYLOAD_ENCODER Namespace.
+
+#endif // LORA_AIRTIME_HPP
@@ -0,0 +1,85 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef LORAWAN_PARAMETERS_HPP
+#define LORAWAN_PARAMETERS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief Maximum application payload size (N) per EU868 data rate, without repeater.
+     *
+     * Source: LoRaWAN Regional Parameters RP002, EU863-870 maximum payload size table.
+     */
+    enum class EU868_MAX_PAYLOAD : uint8_t
+    {
+        DR0 = 51,   /* SF12 / 125 kHz */
+        DR1 = 51,   /* SF11 / 125 kHz */
+        DR2 = 51,   /* SF10 / 125 kHz */
+        DR3 = 115,  /* SF9  / 125 kHz */
+        DR4 = 222,  /* SF8  / 125 kHz */
+        DR5 = 222   /* SF7  / 125 kHz */
+    };
+
+    /**
+     * @brief Function to map an EU868 spreading factor on 125 kHz onto its data rate.
+     * @param spreadingFactor The spreading factor, 7 up to and including 12.
+     * @return The data rate (DR0 - DR5). Returns 0 (the most robust data rate) for an invalid spreading factor.
+     */
+    const static inline uint8_t getDataRateEU868(const uint8_t spreadingFactor)
+    {
+        if (spreadingFactor < 7 || spreadingFactor > 12)
+        {
+            return 0;
+        }
+        return static_cast<uint8_t>(12 - spreadingFactor);
+    }
+
+    /**
+     * @brief Function to map an EU868 data rate onto its spreading factor on 125 kHz.
+     * @param dataRate The data rate, DR0 up to and including DR5.
+     * @return The spreading factor (7 - 12). Returns 12 (the most robust) for an unknown data rate.
+     */
+    const static inline uint8_t getSpreadingFactorEU868(const uint8_t dataRate)
+    {
+        if (dataRate > 5)
+        {
+            return 12;
+        }
+        return static_cast<uint8_t>(12 - dataRate);
+    }
+
+    /**
+     * @brief Function to get the maximum application payload size of an EU868 data rate.
+     * @param dataRate The data rate, DR0 up to and including DR5.
+     * @return The maximum application payload size in bytes. Returns the DR0 size for an unknown data rate.
+     */
+    const static inline uint8_t getMaxPayloadSizeEU868(const uint8_t dataRate)
+    {
+        switch (dataRate)
+        {
+        case 1:
+            return static_cast<uint8_t>(EU868_MAX_PAYLOAD::DR1);
+        case 2:
+            return static_cast<uint8_t>(EU868_MAX_PAYLOAD::DR2);
+        case 3:
+            return static_cast<uint8_t>(EU868_MAX_PAYLOAD::DR3);
+        case 4:
+            return static_cast<uint8_t>(EU868_MAX_PAYLOAD::DR4);
+        case 5:
+            return static_cast<uint8_t>(EU868_MAX_PAYLOAD::DR5);
+        default:
+            return static_cast<uint8_t>(EU868_MAX_PAYLOAD::DR0);
+        }
+    }
+} // End of PAYLOAD_ENCODER Namespace.
+
+#endif // LORAWAN_PARAMETERS_HPP
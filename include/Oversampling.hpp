@@ -0,0 +1,125 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef OVERSAMPLING_HPP
+#define OVERSAMPLING_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PAYLOAD_ENCODER
+{
+    /// Resolution of a single conversion of the AVR ADC.
+    const static uint8_t ADC_BITS = 10;
+    /// Most bits oversampling may add: 4^6 full-scale conversions still fit the accumulator, the result 16 bits.
+    const static uint8_t OVERSAMPLING_MAX_EXTRA_BITS = 6;
+
+    /**
+     * @brief Gets the number of conversions that gain extraBits bits of resolution, 4^extraBits.
+     */
+    inline uint16_t getOversampleCount(const uint8_t extraBits)
+    {
+        return static_cast<uint16_t>(1U << (2 * (extraBits < OVERSAMPLING_MAX_EXTRA_BITS ? extraBits : OVERSAMPLING_MAX_EXTRA_BITS)));
+    }
+
+    /**
+     * @brief Gets the decimated reading of a full-scale input, 1023 << extraBits.
+     */
+    inline uint16_t getOversampledFullScale(const uint8_t extraBits)
+    {
+        return static_cast<uint16_t>(((1U << ADC_BITS) - 1) << (extraBits < OVERSAMPLING_MAX_EXTRA_BITS ? extraBits : OVERSAMPLING_MAX_EXTRA_BITS));
+    }
+
+    /**
+     * @brief Oversampling and decimation of ADC conversions (Atmel AVR121).
+     *
+     * Summing 4^n conversions and shifting the sum right by n gives a reading of 10 + n bits, as
+     * long as the input carries about one LSB of noise, which dithers it across codes. A steady
+     * input without noise gains nothing but averaging.
+     */
+    class Decimator
+    {
+    public:
+        /**
+         * @brief Constructor for Decimator.
+         *
+         * @param extraBits Bits of resolution to gain, at most OVERSAMPLING_MAX_EXTRA_BITS.
+         */
+        explicit Decimator(const uint8_t extraBits)
+            : extraBits(extraBits < OVERSAMPLING_MAX_EXTRA_BITS ? extraBits : OVERSAMPLING_MAX_EXTRA_BITS)
+        {
+            reset();
+        }
+
+        /**
+         * @brief Starts a new reading.
+         */
+        void reset()
+        {
+            sum = 0;
+            count = 0;
+        }
+
+        /**
+         * @brief Adds a conversion; conversions beyond getOversampleCount() are ignored.
+         *
+         * @param sample A 10-bit conversion, larger values are clamped to 1023.
+         * @return bool True once the reading is complete.
+         */
+        bool add(const uint16_t sample)
+        {
+            if (!isComplete())
+            {
+                sum += sample < (1U << ADC_BITS) ? sample : (1U << ADC_BITS) - 1;
+                count++;
+            }
+            return isComplete();
+        }
+
+        bool isComplete(void) const { return count >= getOversampleCount(extraBits); }
+        uint8_t getExtraBits(void) const { return extraBits; }
+
+        /**
+         * @brief Gets the decimated reading, sum / 2^extraBits rounded half up.
+         *
+         * @return uint16_t Reading of 10 + extraBits bits, 0 before the reading is complete.
+         */
+        uint16_t getResult(void) const
+        {
+            if (!isComplete())
+            {
+                return 0;
+            }
+            return static_cast<uint16_t>(extraBits ? (sum + (1UL << (extraBits - 1))) >> extraBits : sum);
+        }
+
+    private:
+        uint32_t sum;
+        uint16_t count;
+        uint8_t extraBits;
+    }; // End of class Decimator.
+
+    /**
+     * @brief Gets the supply voltage from a reading of the internal bandgap against the supply.
+     *
+     * @param reading Decimated reading of the bandgap channel with AVcc as reference.
+     * @param extraBits The extra bits of the reading.
+     * @param bandgapMv Voltage of the bandgap, 1100 mV nominal; calibrate it per chip for better than 10 %.
+     * @return uint16_t Supply in mV, 0 for a zero reading.
+     */
+    inline uint16_t getSupplyMv(const uint16_t reading, const uint8_t extraBits, const uint16_t bandgapMv)
+    {
+        if (!reading)
+        {
+            return 0;
+        }
+        const uint32_t supplyMv = (static_cast<uint32_t>(bandgapMv) * getOversampledFullScale(extraBits) + reading / 2) / reading;
+        return static_cast<uint16_t>(supplyMv < UINT16_MAX ? supplyMv : UINT16_MAX);
+    }
+} // End of Namespace PAYLOAD_ENCODER.
+#endif // OVERSAMPLING_HPP
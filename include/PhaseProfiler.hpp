@@ -0,0 +1,196 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef PHASE_PROFILER_HPP
+#define PHASE_PROFILER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "CayenneLPP.hpp"
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief The timed phases of loop().
+     */
+    enum class PROFILE_PHASE : uint8_t
+    {
+        SI7021          = 0,    /* sensor.getRH() and sensor.getTemp(). */
+        ACCELERATION    = 1,    /* getAcceleration(). */
+        VDD             = 2,    /* ttn.getVDD(). */
+        ENCODE          = 3,    /* Building the payload, compact frame included. */
+        SEND            = 4,    /* ttn.sendBytes(), receive windows included. */
+        COUNT           = 5
+    };
+
+    const static size_t PROFILE_PHASE_COUNT = static_cast<size_t>(PROFILE_PHASE::COUNT);
+
+    /**
+     * @brief Times the phases of loop() and counts add* calls that found the payload full.
+     *
+     * Each phase keeps its count, total and maximum duration since the last reset(), which
+     * report() packs into a CayenneLPP diagnostics frame. Timestamps are micros() values.
+     */
+    class PhaseProfiler
+    {
+    public:
+        /// Channels per phase in the report: mean, then maximum.
+        const static uint8_t REPORT_CHANNELS_PER_PHASE = 2;
+        /// Channel of the add overflow count, after those of the phases.
+        const static uint8_t REPORT_OVERFLOW_CHANNEL = PROFILE_PHASE_COUNT * REPORT_CHANNELS_PER_PHASE;
+
+        PhaseProfiler()
+        {
+            reset();
+        }
+
+        /**
+         * @brief Clears all durations and counts.
+         */
+        void reset()
+        {
+            for (size_t i = 0; i < PROFILE_PHASE_COUNT; i++)
+            {
+                count[i] = 0;
+                totalUs[i] = 0;
+                maxUs[i] = 0;
+            }
+            addOverflows = 0;
+            running = false;
+        }
+
+        /**
+         * @brief Starts timing a phase.
+         *
+         * @param phase The phase.
+         * @param nowUs The current time in microseconds, e.g. micros().
+         */
+        void begin(const PROFILE_PHASE phase, const uint32_t nowUs)
+        {
+            current = phase < PROFILE_PHASE::COUNT ? phase : PROFILE_PHASE::ENCODE;
+            startUs = nowUs;
+            running = true;
+        }
+
+        /**
+         * @brief Ends the phase started last and books its duration; does nothing without one.
+         *
+         * @param nowUs The current time in microseconds.
+         */
+        void end(const uint32_t nowUs)
+        {
+            if (running)
+            {
+                record(current, static_cast<uint32_t>(nowUs - startUs));
+                running = false;
+            }
+        }
+
+        /**
+         * @brief Books a duration on a phase. Counts and totals saturate instead of wrapping.
+         *
+         * @param phase The phase.
+         * @param durationUs The duration in microseconds.
+         */
+        void record(const PROFILE_PHASE phase, const uint32_t durationUs)
+        {
+            if (phase >= PROFILE_PHASE::COUNT)
+            {
+                return;
+            }
+            const size_t i = static_cast<size_t>(phase);
+            count[i] += count[i] < UINT16_MAX;
+            totalUs[i] = totalUs[i] > UINT32_MAX - durationUs ? UINT32_MAX : totalUs[i] + durationUs;
+            maxUs[i] = durationUs > maxUs[i] ? durationUs : maxUs[i];
+        }
+
+        /**
+         * @brief Passes the result of an add* call through, counting it when the payload was full.
+         *
+         * @param result The return value of the add* call.
+         * @return uint8_t The same value.
+         */
+        uint8_t countAdd(const uint8_t result)
+        {
+            addOverflows += result == 0 && addOverflows < UINT16_MAX;
+            return result;
+        }
+
+        /**
+         * @brief Counts field groups that were staged but left out of the frame, e.g. CayenneBudgetFrame::getDroppedCount().
+         *
+         * @param dropped Number of groups dropped; the count saturates instead of wrapping.
+         */
+        void countDropped(const uint8_t dropped)
+        {
+            addOverflows = addOverflows > UINT16_MAX - dropped ? UINT16_MAX : static_cast<uint16_t>(addOverflows + dropped);
+        }
+
+        uint16_t getCount(const PROFILE_PHASE phase) const { return phase < PROFILE_PHASE::COUNT ? count[static_cast<size_t>(phase)] : 0; }
+        uint32_t getMaxUs(const PROFILE_PHASE phase) const { return phase < PROFILE_PHASE::COUNT ? maxUs[static_cast<size_t>(phase)] : 0; }
+        uint16_t getAddOverflowCount(void) const { return addOverflows; }
+
+        /**
+         * @brief Gets the mean duration of a phase.
+         *
+         * @return uint32_t Duration in microseconds, 0 if the phase did not run.
+         */
+        uint32_t getMeanUs(const PROFILE_PHASE phase) const
+        {
+            const uint16_t n = getCount(phase);
+            return n ? totalUs[static_cast<size_t>(phase)] / n : 0;
+        }
+
+        /**
+         * @brief Gets the size of the report in bytes.
+         */
+        static size_t getReportSize(void)
+        {
+            return PROFILE_PHASE_COUNT * REPORT_CHANNELS_PER_PHASE * (static_cast<size_t>(DATA_TYPES_SIZES::ANL_IN) + 2) +
+                   static_cast<size_t>(DATA_TYPES_SIZES::DIG_IN) + 2;
+        }
+
+        /**
+         * @brief Adds the mean and maximum duration of every phase and the add overflow count to a frame.
+         *
+         * Durations are analog inputs on channel 2 * phase (mean) and 2 * phase + 1 (maximum), in
+         * milliseconds, except SEND in seconds, which lasts longer than an analog input holds in
+         * milliseconds. The overflow count is a digital input on REPORT_OVERFLOW_CHANNEL, saturated at 255.
+         *
+         * @param lpp The frame, typically empty and sent on its own FPort.
+         * @return uint8_t The new size of the frame, or 0 if the report did not fit; the frame is then unchanged.
+         */
+        template <size_t MaxSize, PAYLOAD_ENCODING Encoding, CONVERSION_POLICY Policy>
+        uint8_t report(CayenneLPP<MaxSize, Encoding, Policy> &lpp) const
+        {
+            if (lpp.getSize() + getReportSize() > lpp.getOperationalSize())
+            {
+                return 0;
+            }
+            for (size_t i = 0; i < PROFILE_PHASE_COUNT; i++)
+            {
+                const PROFILE_PHASE phase = static_cast<PROFILE_PHASE>(i);
+                const float scale = phase == PROFILE_PHASE::SEND ? 1e-6f : 1e-3f;
+                const uint8_t channel = static_cast<uint8_t>(i * REPORT_CHANNELS_PER_PHASE);
+                lpp.addAnalogInput(channel, getMeanUs(phase) * scale);
+                lpp.addAnalogInput(channel + 1, getMaxUs(phase) * scale);
+            }
+            return lpp.addDigitalInput(REPORT_OVERFLOW_CHANNEL, static_cast<uint8_t>(addOverflows < UINT8_MAX ? addOverflows : UINT8_MAX));
+        }
+
+    private:
+        uint16_t count[PROFILE_PHASE_COUNT];
+        uint32_t totalUs[PROFILE_PHASE_COUNT];
+        uint32_t maxUs[PROFILE_PHASE_COUNT];
+        uint16_t addOverflows;
+        PROFILE_PHASE current;
+        uint32_t startUs;
+        bool running;
+    }; // End of class PhaseProfiler.
+} // End of Namespace PAYLOAD_ENCODER.
+#endif // PHASE_PROFILER_HPP
@@ -0,0 +1,217 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef REPORT_ON_CHANGE_HPP
+#define REPORT_ON_CHANGE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief Deadband filter per sensor channel, deciding which fields are worth an uplink.
+     *
+     * A field is reported when it differs from the last transmitted value by more than the
+     * deadband of its channel, when the maximum silence of the channel has passed, or when it
+     * was never transmitted. Values accepted by update() are pending until the uplink is sent:
+     * commit() then makes them the new reference, discard() forgets them so they are offered
+     * again next time. When the payload builder dropped some fields, commit only the channels
+     * that were sent and discard the others.
+     *
+     * @tparam MaxChannels Number of channels tracked, channel numbers 0 up to MaxChannels - 1.
+     *                     Fields on other channels are always reported.
+     */
+    template <size_t MaxChannels>
+    class ReportOnChange
+    {
+    public:
+        /**
+         * @brief Constructor for ReportOnChange; every channel reports any change and is never forced.
+         */
+        ReportOnChange()
+        {
+            for (size_t i = 0; i < MaxChannels; i++)
+            {
+                channels[i].deadband = 0.0f;
+                channels[i].maxSilenceMs = 0;
+                channels[i].lastReportMs = 0;
+                channels[i].last[0] = channels[i].last[1] = channels[i].last[2] = 0.0f;
+                channels[i].reported = false;
+                channels[i].pending = false;
+                channels[i].expired = false;
+            }
+        }
+
+        /**
+         * @brief Sets the deadband and maximum silence of a channel.
+         *
+         * @param channel The sensor channel.
+         * @param deadband Smallest change, in engineering units, that is reported.
+         * @param maxSilenceMs Time after which the channel is reported regardless; 0 disables it.
+         */
+        void configure(const uint8_t channel, const float deadband, const uint32_t maxSilenceMs)
+        {
+            if (channel < MaxChannels)
+            {
+                channels[channel].deadband = deadband;
+                channels[channel].maxSilenceMs = maxSilenceMs;
+            }
+        }
+
+        /**
+         * @brief Checks whether a single value should be reported, and if so marks it pending.
+         *
+         * @param channel The sensor channel.
+         * @param value The current value.
+         * @param nowMs The current time in milliseconds, e.g. millis().
+         * @return bool True if the field should be added to the payload.
+         */
+        bool update(const uint8_t channel, const float value, const uint32_t nowMs)
+        {
+            return update(channel, value, value, value, nowMs);
+        }
+
+        /**
+         * @brief Checks whether a three-axis value should be reported, and if so marks it pending.
+         *
+         * The largest change over the three axes is compared against the deadband.
+         *
+         * @param channel The sensor channel.
+         * @param x The first axis.
+         * @param y The second axis.
+         * @param z The third axis.
+         * @param nowMs The current time in milliseconds, e.g. millis().
+         * @return bool True if the field should be added to the payload.
+         */
+        bool update(const uint8_t channel, const float x, const float y, const float z, const uint32_t nowMs)
+        {
+            if (channel >= MaxChannels)
+            {
+                return true;
+            }
+            Channel &state = channels[channel];
+            const float change = max3(absolute(x - state.last[0]), absolute(y - state.last[1]), absolute(z - state.last[2]));
+            const bool silenceExpired = state.maxSilenceMs != 0 && (nowMs - state.lastReportMs) >= state.maxSilenceMs;
+            if (state.reported && change <= state.deadband && !silenceExpired && !state.expired)
+            {
+                return false;
+            }
+            state.candidate[0] = x;
+            state.candidate[1] = y;
+            state.candidate[2] = z;
+            state.pending = true;
+            return true;
+        }
+
+        /**
+         * @brief Makes all pending values the last transmitted ones, after a successful uplink.
+         *
+         * @param nowMs The time of the uplink in milliseconds.
+         */
+        void commit(const uint32_t nowMs)
+        {
+            for (size_t i = 0; i < MaxChannels; i++)
+            {
+                commit(static_cast<uint8_t>(i), nowMs);
+            }
+        }
+
+        /**
+         * @brief Makes the pending value of one channel the last transmitted one.
+         *
+         * Used when not every pending field made it into the uplink: commit the channels that
+         * were sent, then discard() the rest so they are offered again.
+         *
+         * @param channel The sensor channel that was sent.
+         * @param nowMs The time of the uplink in milliseconds.
+         */
+        void commit(const uint8_t channel, const uint32_t nowMs)
+        {
+            if (channel >= MaxChannels || !channels[channel].pending)
+            {
+                return;
+            }
+            Channel &state = channels[channel];
+            state.last[0] = state.candidate[0];
+            state.last[1] = state.candidate[1];
+            state.last[2] = state.candidate[2];
+            state.lastReportMs = nowMs;
+            state.reported = true;
+            state.pending = false;
+            state.expired = false;
+        }
+
+        /**
+         * @brief Makes every channel report its next value regardless of the deadband, e.g. for an
+         * uplink requested by the network.
+         */
+        void expire()
+        {
+            for (size_t i = 0; i < MaxChannels; i++)
+            {
+                expire(static_cast<uint8_t>(i));
+            }
+        }
+
+        /**
+         * @brief Makes a channel report its next value regardless of the deadband, as if its
+         * maximum silence had passed, until that value is committed.
+         *
+         * @param channel The sensor channel.
+         */
+        void expire(const uint8_t channel)
+        {
+            if (channel < MaxChannels)
+            {
+                channels[channel].expired = true;
+            }
+        }
+
+        /**
+         * @brief Forgets all pending values, e.g. when the uplink was not sent.
+         */
+        void discard()
+        {
+            for (size_t i = 0; i < MaxChannels; i++)
+            {
+                channels[i].pending = false;
+            }
+        }
+
+    private:
+        /**
+         * @brief Deadband configuration and reporting state of one channel.
+         */
+        struct Channel
+        {
+            float deadband;
+            uint32_t maxSilenceMs;
+            uint32_t lastReportMs;
+            float last[3];
+            float candidate[3];
+            bool reported;
+            bool pending;
+            bool expired;
+        };
+
+        Channel channels[MaxChannels];
+
+        static inline float absolute(const float value)
+        {
+            return value < 0 ? -value : value;
+        }
+
+        static inline float max3(const float a, const float b, const float c)
+        {
+            const float ab = a > b ? a : b;
+            return ab > c ? ab : c;
+        }
+    }; // End of class ReportOnChange.
+} // End of Namespace PAYLOAD_ENCODER.
+#endif // REPORT_ON_CHANGE_HPP
@@ -0,0 +1,204 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef STREAMING_AGGREGATOR_HPP
+#define STREAMING_AGGREGATOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "CayenneLPP.hpp"
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief Running min/max/mean/RMS of one channel of raw fixed-point samples.
+     *
+     * Samples are the raw integer readings of a sensor, e.g. accelerometer counts, so the
+     * accumulation is exact and needs no floating point. Memory is constant: a sample count,
+     * the extremes, the sum and the sum of squares. At most MAX_SAMPLES samples are accumulated
+     * per window, which keeps the sum within an int32_t; later samples are ignored until reset().
+     */
+    class StreamingAggregator
+    {
+    public:
+        static const uint16_t MAX_SAMPLES = 0xFFFF; ///< Largest window, in samples.
+
+        /**
+         * @brief Constructor for StreamingAggregator, starts an empty window.
+         */
+        StreamingAggregator()
+        {
+            reset();
+        }
+
+        /**
+         * @brief Starts a new, empty window.
+         */
+        void reset()
+        {
+            count = 0;
+            minimum = 0;
+            maximum = 0;
+            sum = 0;
+            sumSquares = 0;
+        }
+
+        /**
+         * @brief Adds a sample to the window.
+         *
+         * @param sample The raw sample.
+         * @return bool False if the window is full and the sample was ignored.
+         */
+        bool add(const int16_t sample)
+        {
+            if (count == MAX_SAMPLES)
+            {
+                return false;
+            }
+            if (count == 0 || sample < minimum)
+            {
+                minimum = sample;
+            }
+            if (count == 0 || sample > maximum)
+            {
+                maximum = sample;
+            }
+            count++;
+            sum += sample;
+            sumSquares += static_cast<uint32_t>(static_cast<int32_t>(sample) * sample);
+            return true;
+        }
+
+        /**
+         * @brief Gets the number of samples in the window.
+         *
+         * @return uint16_t Sample count.
+         */
+        uint16_t getCount(void) const
+        {
+            return count;
+        }
+
+        /**
+         * @brief Gets the smallest sample of the window; 0 for an empty window.
+         *
+         * @return int16_t Minimum.
+         */
+        int16_t getMin(void) const
+        {
+            return minimum;
+        }
+
+        /**
+         * @brief Gets the largest sample of the window; 0 for an empty window.
+         *
+         * @return int16_t Maximum.
+         */
+        int16_t getMax(void) const
+        {
+            return maximum;
+        }
+
+        /**
+         * @brief Gets the mean of the window, rounded half away from zero; 0 for an empty window.
+         *
+         * @return int16_t Mean.
+         */
+        int16_t getMean(void) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+            const int32_t half = count / 2;
+            return static_cast<int16_t>(sum >= 0 ? (sum + half) / count : (sum - half) / count);
+        }
+
+        /**
+         * @brief Gets the root mean square of the window, rounded to nearest; 0 for an empty window.
+         *
+         * @return uint16_t RMS, up to 32768.
+         */
+        uint16_t getRms(void) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+            const uint32_t meanSquare = static_cast<uint32_t>((sumSquares + count / 2) / count);
+            const uint32_t root = squareRoot(meanSquare);
+            // Round to nearest: (root + 0.5)^2 = root^2 + root + 0.25.
+            return static_cast<uint16_t>(meanSquare - root * root > root ? root + 1 : root);
+        }
+
+    private:
+        uint16_t count;
+        int16_t minimum;
+        int16_t maximum;
+        int32_t sum;
+        uint64_t sumSquares;
+
+        /**
+         * @brief Integer square root, rounded down, by the bitwise digit method.
+         *
+         * @param value The radicand.
+         * @return uint32_t floor(sqrt(value)).
+         */
+        static uint32_t squareRoot(uint32_t value)
+        {
+            uint32_t root = 0;
+            uint32_t bit = 1UL << 30;
+            while (bit > value)
+            {
+                bit >>= 2;
+            }
+            while (bit != 0)
+            {
+                if (value >= root + bit)
+                {
+                    value -= root + bit;
+                    root = (root >> 1) + bit;
+                }
+                else
+                {
+                    root >>= 1;
+                }
+                bit >>= 2;
+            }
+            return root;
+        }
+    }; // End of class StreamingAggregator.
+
+    /**
+     * @brief Function to add the statistics of a three-axis window as accelerometer fields.
+     *
+     * Writes four ACCRM_SENS fields on consecutive channels: minimum, maximum, mean and RMS,
+     * each with the x, y and z axis. Either all four fields are added or none.
+     *
+     * @param lpp The encoder to add the fields to.
+     * @param firstChannel The channel of the minimum; maximum, mean and RMS follow.
+     * @param axes The aggregators of the x, y and z axis.
+     * @param scale The size of one raw count in g.
+     * @return uint8_t Returns the new size of the payload, or 0 if the four fields do not fit.
+     */
+    template <size_t MaxSize, PAYLOAD_ENCODING Encoding, CONVERSION_POLICY Policy>
+    const static inline uint8_t addAccelerometerSummary(CayenneLPP<MaxSize, Encoding, Policy> &lpp, const uint8_t firstChannel,
+                                                        const StreamingAggregator (&axes)[3], const float scale)
+    {
+        const size_t fieldSize = static_cast<size_t>(DATA_TYPES_SIZES::ACCRM_SENS) + 2;
+        if (lpp.getSize() + 4 * fieldSize > lpp.getOperationalSize())
+        {
+            return 0;
+        }
+        lpp.addAccelerometer(firstChannel, axes[0].getMin() * scale, axes[1].getMin() * scale, axes[2].getMin() * scale);
+        lpp.addAccelerometer(firstChannel + 1, axes[0].getMax() * scale, axes[1].getMax() * scale, axes[2].getMax() * scale);
+        lpp.addAccelerometer(firstChannel + 2, axes[0].getMean() * scale, axes[1].getMean() * scale, axes[2].getMean() * scale);
+        return lpp.addAccelerometer(firstChannel + 3, axes[0].getRms() * scale, axes[1].getRms() * scale, axes[2].getRms() * scale);
+    }
+} // End of Namespace PAYLOAD_ENCODER.
+#endif // STREAMING_AGGREGATOR_HPP
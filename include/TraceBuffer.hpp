@@ -0,0 +1,214 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef TRACE_BUFFER_HPP
+#define TRACE_BUFFER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief Wire format of a trace frame: [sync][event][time, 4 bytes][value, 4 bytes][checksum].
+     *
+     * Time and value are little-endian, the checksum is the XOR of the event, time and value
+     * bytes. The sync byte lies outside printable ASCII, so frames can share a serial port with
+     * text output and a reader can resynchronise after a lost byte.
+     */
+    const static uint8_t TRACE_SYNC = 0xA5;
+    const static uint8_t TRACE_FRAME_SIZE = 11;
+
+    /**
+     * @brief Event ID reserved for the trace itself: value is the number of records overwritten
+     * because the buffer was full before it was flushed.
+     */
+    const static uint8_t TRACE_EVENT_LOST = 0;
+
+    /**
+     * @brief One trace record: what happened, when, and one raw value.
+     */
+    struct TraceRecord
+    {
+        uint8_t event;      ///< Application defined event ID; 0 is TRACE_EVENT_LOST.
+        uint32_t timeMs;    ///< Time of the event, e.g. millis().
+        int32_t value;      ///< Raw value, scaled as the event defines.
+    };
+
+    /**
+     * @brief Function to write a trace record as one frame.
+     * @param record The record.
+     * @param destination Buffer with room for TRACE_FRAME_SIZE bytes.
+     */
+    static inline void writeTraceFrame(const TraceRecord &record, uint8_t *destination)
+    {
+        const uint32_t value = static_cast<uint32_t>(record.value);
+        destination[0] = TRACE_SYNC;
+        destination[1] = record.event;
+        uint8_t checksum = record.event;
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            destination[2 + i] = static_cast<uint8_t>(record.timeMs >> (8 * i));
+            destination[6 + i] = static_cast<uint8_t>(value >> (8 * i));
+            checksum ^= destination[2 + i] ^ destination[6 + i];
+        }
+        destination[10] = checksum;
+    }
+
+    /**
+     * @brief Function to read a trace frame.
+     * @param data The frame, starting at the sync byte.
+     * @param size The number of bytes available at data.
+     * @param record The decoded record.
+     * @return bool False if the bytes are not a complete frame with a valid sync byte and checksum.
+     */
+    const static inline bool readTraceFrame(const uint8_t *data, const size_t size, TraceRecord &record)
+    {
+        if (!data || size < TRACE_FRAME_SIZE || data[0] != TRACE_SYNC)
+        {
+            return false;
+        }
+        uint8_t checksum = data[1];
+        uint32_t timeMs = 0;
+        uint32_t value = 0;
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            timeMs |= static_cast<uint32_t>(data[2 + i]) << (8 * i);
+            value |= static_cast<uint32_t>(data[6 + i]) << (8 * i);
+            checksum ^= data[2 + i] ^ data[6 + i];
+        }
+        if (checksum != data[10])
+        {
+            return false;
+        }
+        record.event = data[1];
+        record.timeMs = timeMs;
+        record.value = static_cast<int32_t>(value);
+        return true;
+    }
+
+    /**
+     * @brief RAM ring buffer of trace records, flushed when the application has time.
+     *
+     * Logging a record costs a few stores instead of formatting text for a slow serial port, so
+     * tracing can stay enabled in production builds. When the buffer is full the oldest record is
+     * overwritten; the next drain() starts with a TRACE_EVENT_LOST record counting them.
+     *
+     * @tparam Capacity Number of records held.
+     */
+    template <size_t Capacity>
+    class TraceBuffer
+    {
+    public:
+        /**
+         * @brief Constructor for TraceBuffer, starts empty.
+         */
+        TraceBuffer()
+        {
+            clear();
+        }
+
+        /**
+         * @brief Discards all records and the lost count.
+         */
+        void clear()
+        {
+            head = 0;
+            count = 0;
+            lost = 0;
+            lostTimeMs = 0;
+        }
+
+        /**
+         * @brief Adds a record, overwriting the oldest one when the buffer is full.
+         *
+         * @param event The event ID, not TRACE_EVENT_LOST.
+         * @param timeMs The time of the event.
+         * @param value The raw value.
+         */
+        void log(const uint8_t event, const uint32_t timeMs, const int32_t value)
+        {
+            size_t tail = head + count;
+            if (tail >= Capacity)
+            {
+                tail -= Capacity;
+            }
+            if (count == Capacity)
+            {
+                head = head + 1 == Capacity ? 0 : head + 1;
+                if (lost != 0xFFFF)
+                {
+                    lost++;
+                }
+                lostTimeMs = timeMs;
+            }
+            else
+            {
+                count++;
+            }
+            records[tail].event = event;
+            records[tail].timeMs = timeMs;
+            records[tail].value = value;
+        }
+
+        /**
+         * @brief Moves the oldest records out of the buffer as frames.
+         *
+         * @param destination The buffer for the frames.
+         * @param destinationSize The size of the destination; only whole frames are written.
+         * @return size_t The number of bytes written, 0 when the buffer is empty.
+         */
+        size_t drain(uint8_t *destination, const size_t destinationSize)
+        {
+            size_t length = 0;
+            if (lost != 0 && length + TRACE_FRAME_SIZE <= destinationSize)
+            {
+                const TraceRecord marker = {TRACE_EVENT_LOST, lostTimeMs, lost};
+                writeTraceFrame(marker, &destination[length]);
+                length += TRACE_FRAME_SIZE;
+                lost = 0;
+            }
+            while (count != 0 && length + TRACE_FRAME_SIZE <= destinationSize)
+            {
+                writeTraceFrame(records[head], &destination[length]);
+                length += TRACE_FRAME_SIZE;
+                head = head + 1 == Capacity ? 0 : head + 1;
+                count--;
+            }
+            return length;
+        }
+
+        /**
+         * @brief Gets the number of records waiting to be drained.
+         *
+         * @return size_t Record count.
+         */
+        size_t getCount(void) const
+        {
+            return count;
+        }
+
+        /**
+         * @brief Gets the number of records overwritten since the last drain.
+         *
+         * @return uint16_t Lost count, saturating at 0xFFFF.
+         */
+        uint16_t getLostCount(void) const
+        {
+            return lost;
+        }
+
+    private:
+        TraceRecord records[Capacity];
+        size_t head;
+        size_t count;
+        uint16_t lost;
+        uint32_t lostTimeMs;
+    }; // End of class TraceBuffer.
+} // End of Namespace PAYLOAD_ENCODER.
+#endif // TRACE_BUFFER_HPP
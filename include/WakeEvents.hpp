@@ -0,0 +1,153 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef WAKE_EVENTS_HPP
+#define WAKE_EVENTS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PAYLOAD_ENCODER
+{
+    /**
+     * @brief Inputs that wake the node for an event uplink; the value is the bit in a source mask.
+     */
+    enum class WAKE_SOURCE : uint8_t
+    {
+        BUTTON          = 0,    /* Push button pressed. */
+        MOTION          = 1,    /* Accelerometer motion interrupt. */
+        COUNT           = 2
+    };
+
+    const static size_t WAKE_SOURCE_COUNT = static_cast<size_t>(WAKE_SOURCE::COUNT);
+
+    /**
+     * @brief Gets the bit of a wake source in a source mask.
+     */
+    inline uint8_t getWakeMask(const WAKE_SOURCE source)
+    {
+        return static_cast<uint8_t>(1 << static_cast<uint8_t>(source));
+    }
+
+    /**
+     * @brief Decides when latched wake events are sent, so a burst of them costs one uplink.
+     *
+     * Sources latched by latch() stay pending until take() hands them to an event uplink. After an
+     * event uplink, new events wait for the hold-off to pass and are then sent together; the first
+     * event is due at once.
+     */
+    class WakeEvents
+    {
+    public:
+        /**
+         * @brief Constructor for WakeEvents.
+         *
+         * @param holdOffMs Shortest time between two event uplinks.
+         */
+        explicit WakeEvents(const uint32_t holdOffMs) : holdOffMs(holdOffMs)
+        {
+            reset();
+        }
+
+        /**
+         * @brief Forgets pending events, counts and the last event uplink.
+         */
+        void reset()
+        {
+            pending = 0;
+            sent = false;
+            lastSentMs = 0;
+            for (size_t i = 0; i < WAKE_SOURCE_COUNT; i++)
+            {
+                count[i] = 0;
+            }
+        }
+
+        /**
+         * @brief Latches the sources that fired; counts saturate instead of wrapping.
+         *
+         * @param sources Source mask, bits beyond WAKE_SOURCE_COUNT are ignored.
+         */
+        void latch(const uint8_t sources)
+        {
+            for (size_t i = 0; i < WAKE_SOURCE_COUNT; i++)
+            {
+                const uint8_t mask = getWakeMask(static_cast<WAKE_SOURCE>(i));
+                if (sources & mask)
+                {
+                    pending |= mask;
+                    count[i] += count[i] < UINT16_MAX;
+                }
+            }
+        }
+
+        /**
+         * @brief Gets the time until pending events are due.
+         *
+         * @param nowMs The current time in milliseconds, e.g. millis().
+         * @return uint32_t 0 if they are due now, UINT32_MAX if nothing is pending.
+         */
+        uint32_t getWaitMs(const uint32_t nowMs) const
+        {
+            if (!pending)
+            {
+                return UINT32_MAX;
+            }
+            const uint32_t elapsedMs = nowMs - lastSentMs;
+            return !sent || elapsedMs >= holdOffMs ? 0 : holdOffMs - elapsedMs;
+        }
+
+        /**
+         * @brief Checks whether pending events should be sent now.
+         */
+        bool isDue(const uint32_t nowMs) const
+        {
+            return getWaitMs(nowMs) == 0;
+        }
+
+        /**
+         * @brief Hands the pending events to an event uplink and starts the hold-off.
+         *
+         * @param nowMs The current time in milliseconds.
+         * @return uint8_t Source mask of the events, 0 if none were pending.
+         */
+        uint8_t take(const uint32_t nowMs)
+        {
+            const uint8_t sources = pending;
+            if (sources)
+            {
+                pending = 0;
+                sent = true;
+                lastSentMs = nowMs;
+            }
+            return sources;
+        }
+
+        /**
+         * @brief Puts back events an event uplink could not send, without counting them again.
+         * They are due when the hold-off started by take() has passed.
+         *
+         * @param sources Source mask returned by take().
+         */
+        void requeue(const uint8_t sources)
+        {
+            pending |= sources & static_cast<uint8_t>((1 << WAKE_SOURCE_COUNT) - 1);
+        }
+
+        uint8_t getPending(void) const { return pending; }
+        uint16_t getCount(const WAKE_SOURCE source) const { return source < WAKE_SOURCE::COUNT ? count[static_cast<size_t>(source)] : 0; }
+
+    private:
+        uint32_t holdOffMs;
+        uint32_t lastSentMs;
+        uint16_t count[WAKE_SOURCE_COUNT];
+        uint8_t pending;
+        bool sent;
+    }; // End of class WakeEvents.
+} // End of Namespace PAYLOAD_ENCODER.
+#endif // WAKE_EVENTS_HPP
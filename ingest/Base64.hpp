@@ -0,0 +1,357 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file Base64.hpp
+ * @brief Base64 (RFC 4648, padded) as used for `data` in rxpk and `frm_payload` in TTN webhooks.
+ *
+ * On x86 the decoder has SSE4.1 and AVX2 kernels that translate and validate 16 or 32 characters
+ * at a time with nibble lookups (pshufb) and pack them with multiply-add; the kernel is picked
+ * once at run time, so no -march flag is needed. Elsewhere, and for the last quartets of every
+ * text, the scalar decoder runs. All kernels decode exactly the same inputs.
+ */
+
+#ifndef INGEST_BASE64_HPP
+#define INGEST_BASE64_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INGEST_BASE64_X86 1
+#else
+#define INGEST_BASE64_X86 0
+#endif
+
+namespace INGEST
+{
+    const static char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    /**
+     * @brief Gets the largest size a base64 text decodes to.
+     *
+     * @param length Length of the text.
+     * @return size_t Size in bytes; the exact size is smaller by the number of padding characters.
+     */
+    inline size_t getBase64DecodedSize(const size_t length)
+    {
+        return length / 4 * 3;
+    }
+
+    /**
+     * @brief Gets the length of the base64 text of some bytes.
+     *
+     * @param size Number of bytes.
+     * @return size_t Length of the padded text.
+     */
+    inline size_t getBase64EncodedLength(const size_t size)
+    {
+        return (size + 2) / 3 * 4;
+    }
+
+    /**
+     * @brief Encodes bytes as padded base64.
+     *
+     * @param data The bytes.
+     * @param size Number of bytes.
+     * @param text Destination with room for getBase64EncodedLength(size) characters; not terminated.
+     * @return size_t Length of the text.
+     */
+    inline size_t encodeBase64(const uint8_t *data, const size_t size, char *text)
+    {
+        size_t length = 0;
+        size_t i = 0;
+        for (; i + 3 <= size; i += 3)
+        {
+            const uint32_t triple = static_cast<uint32_t>(data[i]) << 16 | static_cast<uint32_t>(data[i + 1]) << 8 | data[i + 2];
+            text[length++] = BASE64_ALPHABET[triple >> 18];
+            text[length++] = BASE64_ALPHABET[(triple >> 12) & 0x3F];
+            text[length++] = BASE64_ALPHABET[(triple >> 6) & 0x3F];
+            text[length++] = BASE64_ALPHABET[triple & 0x3F];
+        }
+        if (i < size)
+        {
+            const uint32_t triple = static_cast<uint32_t>(data[i]) << 16 | (i + 1 < size ? static_cast<uint32_t>(data[i + 1]) << 8 : 0);
+            text[length++] = BASE64_ALPHABET[triple >> 18];
+            text[length++] = BASE64_ALPHABET[(triple >> 12) & 0x3F];
+            text[length++] = i + 1 < size ? BASE64_ALPHABET[(triple >> 6) & 0x3F] : '=';
+            text[length++] = '=';
+        }
+        return length;
+    }
+
+    /**
+     * @brief Maps a base64 character onto its 6-bit value.
+     *
+     * @return uint8_t The value, 0xFF for characters outside the alphabet, padding included.
+     */
+    inline uint8_t getBase64Value(const char character)
+    {
+        struct Table
+        {
+            uint8_t values[256];
+            Table()
+            {
+                for (int i = 0; i < 256; i++)
+                {
+                    values[i] = 0xFF;
+                }
+                for (uint8_t i = 0; i < 64; i++)
+                {
+                    values[static_cast<uint8_t>(BASE64_ALPHABET[i])] = i;
+                }
+            }
+        };
+        static const Table table;
+        return table.values[static_cast<uint8_t>(character)];
+    }
+
+    /**
+     * @brief Decodes padded base64 one quartet at a time.
+     *
+     * @param text The text.
+     * @param length Length of the text, a multiple of 4.
+     * @param data Destination with room for getBase64DecodedSize(length) bytes.
+     * @return size_t Number of bytes decoded. Returns 0 if the text is empty, not a multiple of 4 long,
+     *                contains characters outside the alphabet or padding anywhere but at the end.
+     */
+    inline size_t decodeBase64Scalar(const char *text, const size_t length, uint8_t *data)
+    {
+        if (length == 0 || length % 4)
+        {
+            return 0;
+        }
+        const size_t padding = text[length - 1] == '=' ? (text[length - 2] == '=' ? 2 : 1) : 0;
+        const size_t full = length - (padding ? 4 : 0);
+        size_t size = 0;
+        for (size_t i = 0; i < full; i += 4)
+        {
+            const uint8_t a = getBase64Value(text[i]);
+            const uint8_t b = getBase64Value(text[i + 1]);
+            const uint8_t c = getBase64Value(text[i + 2]);
+            const uint8_t d = getBase64Value(text[i + 3]);
+            if ((a | b | c | d) & 0xC0)
+            {
+                return 0;
+            }
+            const uint32_t quartet = static_cast<uint32_t>(a) << 18 | static_cast<uint32_t>(b) << 12 | static_cast<uint32_t>(c) << 6 | d;
+            data[size++] = static_cast<uint8_t>(quartet >> 16);
+            data[size++] = static_cast<uint8_t>(quartet >> 8);
+            data[size++] = static_cast<uint8_t>(quartet);
+        }
+        if (padding)
+        {
+            const uint8_t a = getBase64Value(text[full]);
+            const uint8_t b = getBase64Value(text[full + 1]);
+            const uint8_t c = padding == 1 ? getBase64Value(text[full + 2]) : 0;
+            if ((a | b | c) & 0xC0)
+            {
+                return 0;
+            }
+            data[size++] = static_cast<uint8_t>(a << 2 | b >> 4);
+            if (padding == 1)
+            {
+                data[size++] = static_cast<uint8_t>(b << 4 | c >> 2);
+            }
+        }
+        return size;
+    }
+
+    /**
+     * @brief Decoder implementations.
+     */
+    enum class BASE64_KERNEL : uint8_t
+    {
+        SCALAR  = 0,    /* One quartet at a time, any CPU. */
+        SSE41   = 1,    /* 16 characters at a time. */
+        AVX2    = 2     /* 32 characters at a time. */
+    };
+
+#if INGEST_BASE64_X86
+    /**
+     * @brief Translates 16 characters into 6-bit values.
+     *
+     * @return bool False if a character is outside the alphabet, padding included.
+     */
+    __attribute__((target("sse4.1"))) inline bool translateBase64Sse41(__m128i &values)
+    {
+        // Bit sets of the characters with a given low and high nibble; a character is invalid
+        // when its two sets intersect.
+        const __m128i lowValid = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m128i highValid = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        // Offset from character to value by high nibble; '/' gets its own entry.
+        const __m128i roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i high = _mm_and_si128(_mm_srli_epi32(values, 4), nibble);
+        const __m128i low = _mm_and_si128(values, nibble);
+        if (!_mm_testz_si128(_mm_shuffle_epi8(lowValid, low), _mm_shuffle_epi8(highValid, high)))
+        {
+            return false;
+        }
+        const __m128i slash = _mm_cmpeq_epi8(values, _mm_set1_epi8('/'));
+        values = _mm_add_epi8(values, _mm_shuffle_epi8(roll, _mm_add_epi8(slash, high)));
+        return true;
+    }
+
+    /**
+     * @brief Decodes padded base64 with SSE4.1, 16 characters into 12 bytes per step.
+     *
+     * @param text The text.
+     * @param length Length of the text, a multiple of 4.
+     * @param data Destination with room for getBase64DecodedSize(length) bytes.
+     * @return size_t Number of bytes decoded, 0 if the text is empty or malformed.
+     */
+    __attribute__((target("sse4.1"))) inline size_t decodeBase64Sse41(const char *text, const size_t length, uint8_t *data)
+    {
+        if (length == 0 || length % 4)
+        {
+            return 0;
+        }
+        size_t i = 0;
+        size_t size = 0;
+        // Each step stores 16 bytes for 12; keeping 8 characters back leaves room for the extra 4
+        // and keeps padding out of the vector path.
+        while (i + 24 <= length)
+        {
+            __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+            if (!translateBase64Sse41(values))
+            {
+                return 0;
+            }
+            const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+            const __m128i triples = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+            const __m128i bytes = _mm_shuffle_epi8(triples, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(data + size), bytes);
+            i += 16;
+            size += 12;
+        }
+        const size_t tail = decodeBase64Scalar(text + i, length - i, data + size);
+        return tail ? size + tail : 0;
+    }
+
+    /**
+     * @brief Decodes padded base64 with AVX2, 32 characters into 24 bytes per step.
+     *
+     * @param text The text.
+     * @param length Length of the text, a multiple of 4.
+     * @param data Destination with room for getBase64DecodedSize(length) bytes.
+     * @return size_t Number of bytes decoded, 0 if the text is empty or malformed.
+     */
+    __attribute__((target("avx2"))) inline size_t decodeBase64Avx2(const char *text, const size_t length, uint8_t *data)
+    {
+        if (length == 0 || length % 4)
+        {
+            return 0;
+        }
+        const __m256i lowValid = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                                  0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m256i highValid = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                                   0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                              2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        size_t i = 0;
+        size_t size = 0;
+        // Each step stores 32 bytes for 24; 16 characters kept back leave room for the extra 8.
+        while (i + 48 <= length)
+        {
+            __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+            const __m256i high = _mm256_and_si256(_mm256_srli_epi32(values, 4), nibble);
+            const __m256i low = _mm256_and_si256(values, nibble);
+            if (!_mm256_testz_si256(_mm256_shuffle_epi8(lowValid, low), _mm256_shuffle_epi8(highValid, high)))
+            {
+                return 0;
+            }
+            const __m256i slash = _mm256_cmpeq_epi8(values, _mm256_set1_epi8('/'));
+            values = _mm256_add_epi8(values, _mm256_shuffle_epi8(roll, _mm256_add_epi8(slash, high)));
+            const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+            const __m256i triples = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+            // 12 bytes at the bottom of each lane; move them together.
+            const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(triples, pack), _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + size), bytes);
+            i += 32;
+            size += 24;
+        }
+        const size_t tail = decodeBase64Sse41(text + i, length - i, data + size);
+        return tail ? size + tail : 0;
+    }
+#endif
+
+    /**
+     * @brief Tells whether a kernel can run on this CPU.
+     */
+    inline bool isBase64KernelSupported(const BASE64_KERNEL kernel)
+    {
+        switch (kernel)
+        {
+        case BASE64_KERNEL::SCALAR:
+            return true;
+#if INGEST_BASE64_X86
+        case BASE64_KERNEL::SSE41:
+            return __builtin_cpu_supports("sse4.1");
+        case BASE64_KERNEL::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * @brief Gets the fastest kernel this CPU supports, determined on the first call.
+     */
+    inline BASE64_KERNEL getBase64Kernel(void)
+    {
+        static const BASE64_KERNEL kernel = isBase64KernelSupported(BASE64_KERNEL::AVX2)    ? BASE64_KERNEL::AVX2
+                                            : isBase64KernelSupported(BASE64_KERNEL::SSE41) ? BASE64_KERNEL::SSE41
+                                                                                             : BASE64_KERNEL::SCALAR;
+        return kernel;
+    }
+
+    /**
+     * @brief Decodes padded base64 with a given kernel.
+     *
+     * @param text The text.
+     * @param length Length of the text, a multiple of 4.
+     * @param data Destination with room for getBase64DecodedSize(length) bytes.
+     * @param kernel The kernel; must be supported by the CPU.
+     * @return size_t Number of bytes decoded, 0 if the text is empty or malformed.
+     */
+    inline size_t decodeBase64(const char *text, const size_t length, uint8_t *data, const BASE64_KERNEL kernel)
+    {
+        switch (kernel)
+        {
+#if INGEST_BASE64_X86
+        case BASE64_KERNEL::AVX2:
+            return decodeBase64Avx2(text, length, data);
+        case BASE64_KERNEL::SSE41:
+            return decodeBase64Sse41(text, length, data);
+#endif
+        default:
+            return decodeBase64Scalar(text, length, data);
+        }
+    }
+
+    /**
+     * @brief Decodes padded base64 with the fastest kernel of this CPU.
+     *
+     * @param text The text.
+     * @param length Length of the text, a multiple of 4.
+     * @param data Destination with room for getBase64DecodedSize(length) bytes.
+     * @return size_t Number of bytes decoded, 0 if the text is empty or malformed.
+     */
+    inline size_t decodeBase64(const char *text, const size_t length, uint8_t *data)
+    {
+        return decodeBase64(text, length, data, getBase64Kernel());
+    }
+} // namespace INGEST
+
+#endif // INGEST_BASE64_HPP
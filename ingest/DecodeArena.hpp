@@ -0,0 +1,85 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file DecodeArena.hpp
+ * @brief Bump allocator for the payloads of one receive batch.
+ *
+ * Payloads are decoded from base64 straight into the arena and referenced by pointer until
+ * the batch is done; reset() then releases all of them at once, without per-frame allocation.
+ */
+
+#ifndef INGEST_DECODE_ARENA_HPP
+#define INGEST_DECODE_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace INGEST
+{
+    class DecodeArena
+    {
+    public:
+        /**
+         * @brief Constructor for DecodeArena.
+         *
+         * @param capacity Size of the arena in bytes.
+         */
+        explicit DecodeArena(const size_t capacity) : storage(capacity), used(0) {}
+
+        /**
+         * @brief Takes bytes from the arena.
+         *
+         * @param size Number of bytes.
+         * @return uint8_t* The bytes, nullptr if the arena is exhausted.
+         */
+        uint8_t *allocate(const size_t size)
+        {
+            if (size > storage.size() - used)
+            {
+                return nullptr;
+            }
+            uint8_t *bytes = storage.data() + used;
+            used += size;
+            return bytes;
+        }
+
+        /**
+         * @brief Gives back the unused tail of the last allocation.
+         *
+         * @param bytes Pointer returned by the last allocate().
+         * @param reserved Size passed to that allocate().
+         * @param size Number of bytes actually used.
+         */
+        void shrink(const uint8_t *bytes, const size_t reserved, const size_t size)
+        {
+            if (bytes + reserved == storage.data() + used && size <= reserved)
+            {
+                used -= reserved - size;
+            }
+        }
+
+        /**
+         * @brief Releases all allocations.
+         */
+        void reset()
+        {
+            used = 0;
+        }
+
+        size_t getUsed(void) const { return used; }
+        size_t getCapacity(void) const { return storage.size(); }
+
+    private:
+        std::vector<uint8_t> storage;
+        size_t used;
+    };
+} // namespace INGEST
+
+#endif // INGEST_DECODE_ARENA_HPP
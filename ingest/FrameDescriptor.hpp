@@ -0,0 +1,156 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file FrameDescriptor.hpp
+ * @brief Frame descriptors and the shared arenas their payloads live in.
+ *
+ * The receiving thread decodes the payloads of a batch into one arena taken from an ArenaPool
+ * and passes small descriptors through the ring queues; the payload bytes are never copied.
+ * Each descriptor holds a reference on its arena. The arena goes back to the pool when the
+ * last stage releases the last of its descriptors, and the receiving thread releases its own.
+ */
+
+#ifndef INGEST_FRAME_DESCRIPTOR_HPP
+#define INGEST_FRAME_DESCRIPTOR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "DecodeArena.hpp"
+#include "RingQueue.hpp"
+
+namespace INGEST
+{
+    /**
+     * @brief An arena shared by the descriptors of one receive batch.
+     */
+    class SharedArena : public DecodeArena
+    {
+    public:
+        explicit SharedArena(const size_t capacity) : DecodeArena(capacity), references(0) {}
+
+        /**
+         * @brief Adds references, one per descriptor handed out.
+         */
+        void retain(const uint32_t count = 1)
+        {
+            references.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Drops a reference.
+         *
+         * @return bool True if it was the last one; the arena may then be reused.
+         */
+        bool release()
+        {
+            return references.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+
+    private:
+        template <size_t> friend class ArenaPool;
+        std::atomic<uint32_t> references;
+    };
+
+    /**
+     * @brief A received frame on its way through the pipeline: 40 bytes, the payload stays in its arena.
+     */
+    struct FrameDescriptor
+    {
+        SharedArena *arena;         ///< Arena holding the payload; released once per descriptor.
+        const uint8_t *payload;     ///< PHYPayload or FRMPayload, depending on the stage.
+        uint64_t receivedNs;        ///< Steady clock at reception, for latency.
+        uint32_t devAddr;
+        uint16_t size;
+        uint16_t fCnt;
+        int16_t rssi;               ///< dBm.
+        int8_t snrQuarterDb;        ///< SNR in 0.25 dB.
+        uint8_t fPort;
+        uint8_t gateway;
+    };
+
+    /**
+     * @brief Fixed set of shared arenas, recycled through a lock-free free list.
+     *
+     * @tparam Arenas Number of arenas, a power of two.
+     */
+    template <size_t Arenas>
+    class ArenaPool
+    {
+    public:
+        /**
+         * @brief Constructor for ArenaPool.
+         *
+         * @param arenaCapacity Size of every arena in bytes.
+         */
+        explicit ArenaPool(const size_t arenaCapacity)
+        {
+            arenas.reserve(Arenas);
+            for (size_t i = 0; i < Arenas; i++)
+            {
+                arenas.push_back(new SharedArena(arenaCapacity));
+                free.tryPush(arenas.back());
+            }
+        }
+
+        ~ArenaPool()
+        {
+            for (SharedArena *arena : arenas)
+            {
+                delete arena;
+            }
+        }
+
+        ArenaPool(const ArenaPool &) = delete;
+        ArenaPool &operator=(const ArenaPool &) = delete;
+
+        /**
+         * @brief Takes an empty arena, holding one reference for the caller.
+         *
+         * @return SharedArena* The arena, nullptr if all are in use.
+         */
+        SharedArena *acquire()
+        {
+            SharedArena *arena;
+            if (!free.tryPop(arena))
+            {
+                return nullptr;
+            }
+            arena->reset();
+            arena->references.store(1, std::memory_order_relaxed);
+            return arena;
+        }
+
+        /**
+         * @brief Drops a reference on an arena, recycling it after the last one.
+         */
+        void release(SharedArena *arena)
+        {
+            if (arena->release())
+            {
+                free.tryPush(arena);
+            }
+        }
+
+        /**
+         * @brief Gets the number of arenas not in use; approximate while others run.
+         */
+        size_t getFreeCount(void) const
+        {
+            return free.getSize();
+        }
+
+    private:
+        std::vector<SharedArena *> arenas;
+        MpmcQueue<SharedArena *, Arenas> free;
+    };
+} // namespace INGEST
+
+#endif // INGEST_FRAME_DESCRIPTOR_HPP
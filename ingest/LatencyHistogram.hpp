@@ -0,0 +1,153 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file LatencyHistogram.hpp
+ * @brief Log-linear latency histogram in the manner of HdrHistogram.
+ *
+ * Values below 32 get a bucket each; above that, every power of two is split into 32 buckets,
+ * so any value is known within 3.2 % over the full 64-bit range, in 1920 fixed buckets.
+ * Recording is an index computation and an increment, cheap enough for every frame.
+ */
+
+#ifndef INGEST_LATENCY_HISTOGRAM_HPP
+#define INGEST_LATENCY_HISTOGRAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace INGEST
+{
+    class LatencyHistogram
+    {
+    public:
+        static const unsigned SUB_BUCKET_BITS = 5;
+        static const size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+        static const size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        LatencyHistogram()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            std::memset(counts, 0, sizeof(counts));
+            count = 0;
+            sum = 0;
+            minimum = UINT64_MAX;
+            maximum = 0;
+        }
+
+        /**
+         * @brief Records a value, e.g. a latency in nanoseconds.
+         */
+        void record(const uint64_t value)
+        {
+            counts[getBucket(value)]++;
+            count++;
+            sum += value;
+            minimum = value < minimum ? value : minimum;
+            maximum = value > maximum ? value : maximum;
+        }
+
+        /**
+         * @brief Adds the values recorded in another histogram.
+         */
+        void merge(const LatencyHistogram &other)
+        {
+            for (size_t i = 0; i < BUCKETS; i++)
+            {
+                counts[i] += other.counts[i];
+            }
+            count += other.count;
+            sum += other.sum;
+            minimum = other.minimum < minimum ? other.minimum : minimum;
+            maximum = other.maximum > maximum ? other.maximum : maximum;
+        }
+
+        /**
+         * @brief Gets the value below which a share of the recorded values lies.
+         *
+         * @param percentile The share in percent, 0 to 100.
+         * @return uint64_t Upper bound of the bucket holding the percentile, at most the maximum; 0 when empty.
+         */
+        uint64_t getPercentile(const double percentile) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+            uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+            rank = rank < 1 ? 1 : (rank > count ? count : rank);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; i++)
+            {
+                seen += counts[i];
+                if (seen >= rank)
+                {
+                    const uint64_t upper = getBucketUpperBound(i);
+                    return upper < maximum ? upper : maximum;
+                }
+            }
+            return maximum;
+        }
+
+        uint64_t getCount(void) const { return count; }
+        uint64_t getSum(void) const { return sum; }
+        uint64_t getMin(void) const { return count ? minimum : 0; }
+        uint64_t getMax(void) const { return maximum; }
+        double getMean(void) const { return count ? static_cast<double>(sum) / count : 0.0; }
+
+        /**
+         * @brief Gets the number of values in a bucket.
+         */
+        uint64_t getBucketCount(const size_t bucket) const
+        {
+            return bucket < BUCKETS ? counts[bucket] : 0;
+        }
+
+        /**
+         * @brief Gets the bucket of a value.
+         */
+        static size_t getBucket(const uint64_t value)
+        {
+            if (value < SUB_BUCKETS)
+            {
+                return static_cast<size_t>(value);
+            }
+            const unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+            const unsigned shift = msb - SUB_BUCKET_BITS;
+            return (shift + 1) * SUB_BUCKETS + static_cast<size_t>((value >> shift) - SUB_BUCKETS);
+        }
+
+        /**
+         * @brief Gets the largest value that falls into a bucket.
+         */
+        static uint64_t getBucketUpperBound(const size_t bucket)
+        {
+            if (bucket < 2 * SUB_BUCKETS)
+            {
+                return bucket;
+            }
+            const unsigned shift = static_cast<unsigned>(bucket / SUB_BUCKETS - 1);
+            const uint64_t top = SUB_BUCKETS + bucket % SUB_BUCKETS;
+            return ((top + 1) << shift) - 1;
+        }
+
+    private:
+        uint64_t counts[BUCKETS];
+        uint64_t count;
+        uint64_t sum;
+        uint64_t minimum;
+        uint64_t maximum;
+    };
+} // namespace INGEST
+
+#endif // INGEST_LATENCY_HISTOGRAM_HPP
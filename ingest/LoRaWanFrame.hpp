@@ -0,0 +1,110 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file LoRaWanFrame.hpp
+ * @brief LoRaWAN 1.0 data uplinks: the PHYPayload a gateway forwards in rxpk `data`.
+ *
+ * PHYPayload = MHDR | DevAddr | FCtrl | FCnt | FOpts | FPort | FRMPayload | MIC, little-endian.
+ * The MIC is not checked and FRMPayload is taken as is: decrypting it needs the AppSKey of
+ * every device, which a network server holds and this stand-in does not.
+ */
+
+#ifndef INGEST_LORAWAN_FRAME_HPP
+#define INGEST_LORAWAN_FRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace INGEST
+{
+    const static uint8_t MHDR_UNCONFIRMED_UP = 0x40;
+    const static uint8_t MHDR_CONFIRMED_UP = 0x80;
+    const static size_t LORAWAN_MIC_SIZE = 4;
+
+    /**
+     * @brief A data uplink, pointing into the PHYPayload it was parsed from.
+     */
+    struct DataUplink
+    {
+        uint32_t devAddr;
+        uint16_t fCnt;              ///< 16 LSBs of the frame counter, as transmitted.
+        uint8_t fCtrl;
+        bool hasPort;               ///< False for frames without FPort and FRMPayload.
+        uint8_t fPort;
+        const uint8_t *payload;     ///< FRMPayload.
+        size_t size;
+    };
+
+    /**
+     * @brief Parses a data uplink.
+     *
+     * @param phy The PHYPayload.
+     * @param size Size of the PHYPayload.
+     * @param uplink The parsed uplink.
+     * @return bool False if the frame is no data uplink or is truncated.
+     */
+    inline bool parseDataUplink(const uint8_t *phy, const size_t size, DataUplink &uplink)
+    {
+        if (size < 1 + 7 + LORAWAN_MIC_SIZE)
+        {
+            return false;
+        }
+        const uint8_t messageType = phy[0] & 0xE0;
+        if (messageType != MHDR_UNCONFIRMED_UP && messageType != MHDR_CONFIRMED_UP)
+        {
+            return false;
+        }
+        uplink.devAddr = static_cast<uint32_t>(phy[1]) | static_cast<uint32_t>(phy[2]) << 8 |
+                         static_cast<uint32_t>(phy[3]) << 16 | static_cast<uint32_t>(phy[4]) << 24;
+        uplink.fCtrl = phy[5];
+        uplink.fCnt = static_cast<uint16_t>(phy[6] | phy[7] << 8);
+        const size_t portIndex = 8 + (uplink.fCtrl & 0x0F);
+        const size_t end = size - LORAWAN_MIC_SIZE;
+        if (portIndex > end)
+        {
+            return false;
+        }
+        uplink.hasPort = portIndex < end;
+        uplink.fPort = uplink.hasPort ? phy[portIndex] : 0;
+        uplink.payload = uplink.hasPort ? &phy[portIndex + 1] : nullptr;
+        uplink.size = uplink.hasPort ? end - portIndex - 1 : 0;
+        return true;
+    }
+
+    /**
+     * @brief Writes an unconfirmed data uplink without FOpts, with FRMPayload in plain text and a zero MIC.
+     *
+     * @param devAddr Device address.
+     * @param fCnt Frame counter.
+     * @param fPort FPort.
+     * @param payload FRMPayload.
+     * @param size Size of FRMPayload.
+     * @param phy Destination with room for size + 13 bytes.
+     * @return size_t Size of the PHYPayload.
+     */
+    inline size_t writeDataUplink(const uint32_t devAddr, const uint16_t fCnt, const uint8_t fPort,
+                                  const uint8_t *payload, const size_t size, uint8_t *phy)
+    {
+        phy[0] = MHDR_UNCONFIRMED_UP;
+        for (int i = 0; i < 4; i++)
+        {
+            phy[1 + i] = static_cast<uint8_t>(devAddr >> (8 * i));
+        }
+        phy[5] = 0;
+        phy[6] = static_cast<uint8_t>(fCnt);
+        phy[7] = static_cast<uint8_t>(fCnt >> 8);
+        phy[8] = fPort;
+        std::memcpy(&phy[9], payload, size);
+        std::memset(&phy[9 + size], 0, LORAWAN_MIC_SIZE);
+        return 9 + size + LORAWAN_MIC_SIZE;
+    }
+} // namespace INGEST
+
+#endif // INGEST_LORAWAN_FRAME_HPP
@@ -0,0 +1,331 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file Metrics.hpp
+ * @brief Hot-path instrumentation of the ingest pipeline, exported in the Prometheus text format.
+ *
+ * Every thread counts into its own Metrics without atomics or locks: rxpk by outcome, decoded
+ * fields by DATA_TYPES, and the time spent in each pipeline stage in a LatencyHistogram. Now and
+ * then, e.g. once per second, a thread publishes its counts into the process total, which the
+ * exporter reads. Reading the clock costs more than most stages, so only one rxpk in
+ * METRICS_SAMPLE_PERIOD is timed; counters see every rxpk.
+ *
+ * The METRICS_* macros are the instrumentation points. Build with -DINGEST_METRICS=0 and they
+ * compile to nothing.
+ */
+
+#ifndef INGEST_METRICS_HPP
+#define INGEST_METRICS_HPP
+
+#ifndef INGEST_METRICS
+#define INGEST_METRICS 1
+#endif
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include "../include/CayenneReferences.hpp"
+#include "LatencyHistogram.hpp"
+
+namespace INGEST
+{
+    using PAYLOAD_ENCODER::DATA_TYPES;
+
+    /**
+     * @brief Stages of an rxpk through the daemon; each is timed from the end of the previous one.
+     */
+    enum class PIPELINE_STAGE : uint8_t
+    {
+        RXPK        = 0,    /* RXPK JSON OBJECT READ */
+        BASE64      = 1,    /* PHYPAYLOAD BASE64 DECODED */
+        FRAME       = 2,    /* PHYPAYLOAD PARSED */
+        DEDUP       = 3,    /* CROSS-GATEWAY DEDUPLICATION */
+        DECODE      = 4     /* FRMPAYLOAD DECODED */
+    };
+    const static size_t PIPELINE_STAGES = 5;
+
+    /**
+     * @brief What became of an rxpk.
+     */
+    enum class FRAME_OUTCOME : uint8_t
+    {
+        DECODED         = 0,    /* FIELDS DECODED */
+        BAD_BASE64      = 1,    /* DATA MISSING OR NOT BASE64 */
+        NOT_DATA_UPLINK = 2,    /* PHYPAYLOAD IS NO DATA UPLINK */
+        UNDECODED       = 3,    /* OTHER FPORT OR MALFORMED PAYLOAD */
+        DUPLICATE       = 4     /* COPY OF AN UPLINK ALREADY DECODED */
+    };
+    const static size_t FRAME_OUTCOMES = 5;
+
+    /// One rxpk in this many is timed per stage; a power of two.
+    const static uint32_t METRICS_SAMPLE_PERIOD = 16;
+
+    /**
+     * @brief Gets the Prometheus label of a stage.
+     */
+    inline const char *getStageName(const PIPELINE_STAGE stage)
+    {
+        static const char *const NAMES[PIPELINE_STAGES] = {"rxpk", "base64", "frame", "dedup", "decode"};
+        return NAMES[static_cast<uint8_t>(stage)];
+    }
+
+    /**
+     * @brief Gets the Prometheus label of an outcome.
+     */
+    inline const char *getOutcomeName(const FRAME_OUTCOME outcome)
+    {
+        static const char *const NAMES[FRAME_OUTCOMES] = {"decoded", "bad_base64", "not_data_uplink", "undecoded", "duplicate"};
+        return NAMES[static_cast<uint8_t>(outcome)];
+    }
+
+    /**
+     * @brief Gets the Prometheus label of a data type, nullptr for values outside DATA_TYPES.
+     */
+    inline const char *getDataTypeName(const DATA_TYPES type)
+    {
+        switch (type)
+        {
+        case DATA_TYPES::DIG_IN:      return "digital_input";
+        case DATA_TYPES::DIG_OUT:     return "digital_output";
+        case DATA_TYPES::ANL_IN:      return "analog_input";
+        case DATA_TYPES::ANL_OUT:     return "analog_output";
+        case DATA_TYPES::ILLUM_SENS:  return "illuminance";
+        case DATA_TYPES::PRSNC_SENS:  return "presence";
+        case DATA_TYPES::TEMP_SENS:   return "temperature";
+        case DATA_TYPES::HUM_SENS:    return "humidity";
+        case DATA_TYPES::ACCRM_SENS:  return "accelerometer";
+        case DATA_TYPES::BARO_SENS:   return "barometer";
+        case DATA_TYPES::GYRO_SENS:   return "gyrometer";
+        case DATA_TYPES::GPS_LOC:     return "gps";
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Counters and stage histograms of one thread, or the total of all threads.
+     */
+    class Metrics
+    {
+    public:
+        Metrics()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            std::memset(fields, 0, sizeof(fields));
+            std::memset(outcomes, 0, sizeof(outcomes));
+            for (LatencyHistogram &histogram : stages)
+            {
+                histogram.reset();
+            }
+        }
+
+        void countField(const DATA_TYPES type) { fields[static_cast<uint8_t>(type)]++; }
+        void countOutcome(const FRAME_OUTCOME outcome) { outcomes[static_cast<uint8_t>(outcome)]++; }
+
+        /**
+         * @brief Starts an rxpk; decides whether its stages are timed.
+         */
+        void begin()
+        {
+            sampled = (++sampleCounter & (METRICS_SAMPLE_PERIOD - 1)) == 0;
+            if (sampled)
+            {
+                lastNs = now();
+            }
+        }
+
+        /**
+         * @brief Ends a stage of the current rxpk, which started where the previous one ended.
+         */
+        void endStage(const PIPELINE_STAGE stage)
+        {
+            if (sampled)
+            {
+                const uint64_t stageEnd = now();
+                stages[static_cast<uint8_t>(stage)].record(stageEnd - lastNs);
+                lastNs = stageEnd;
+            }
+        }
+
+        /**
+         * @brief Adds the counts of another Metrics.
+         */
+        void merge(const Metrics &other)
+        {
+            for (size_t i = 0; i < 256; i++)
+            {
+                fields[i] += other.fields[i];
+            }
+            for (size_t i = 0; i < FRAME_OUTCOMES; i++)
+            {
+                outcomes[i] += other.outcomes[i];
+            }
+            for (size_t i = 0; i < PIPELINE_STAGES; i++)
+            {
+                stages[i].merge(other.stages[i]);
+            }
+        }
+
+        uint64_t getFieldCount(const DATA_TYPES type) const { return fields[static_cast<uint8_t>(type)]; }
+        uint64_t getOutcomeCount(const FRAME_OUTCOME outcome) const { return outcomes[static_cast<uint8_t>(outcome)]; }
+        const LatencyHistogram &getStage(const PIPELINE_STAGE stage) const { return stages[static_cast<uint8_t>(stage)]; }
+
+        /**
+         * @brief Appends the metrics in the Prometheus text exposition format.
+         *
+         * @param out Destination text.
+         */
+        void writePrometheus(std::string &out) const
+        {
+            char line[160];
+            out += "# HELP ingest_fields_total CayenneLPP fields decoded, by data type.\n";
+            out += "# TYPE ingest_fields_total counter\n";
+            for (size_t i = 0; i < 256; i++)
+            {
+                const char *name = getDataTypeName(static_cast<DATA_TYPES>(i));
+                if (name)
+                {
+                    std::snprintf(line, sizeof(line), "ingest_fields_total{type=\"%s\"} %llu\n", name, static_cast<unsigned long long>(fields[i]));
+                    out += line;
+                }
+            }
+            out += "# HELP ingest_rxpk_total Received rxpk, by outcome.\n";
+            out += "# TYPE ingest_rxpk_total counter\n";
+            for (size_t i = 0; i < FRAME_OUTCOMES; i++)
+            {
+                std::snprintf(line, sizeof(line), "ingest_rxpk_total{outcome=\"%s\"} %llu\n", getOutcomeName(static_cast<FRAME_OUTCOME>(i)),
+                              static_cast<unsigned long long>(outcomes[i]));
+                out += line;
+            }
+            out += "# HELP ingest_stage_seconds Time per rxpk spent in each pipeline stage, sampled.\n";
+            out += "# TYPE ingest_stage_seconds summary\n";
+            static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+            for (size_t i = 0; i < PIPELINE_STAGES; i++)
+            {
+                const char *stage = getStageName(static_cast<PIPELINE_STAGE>(i));
+                for (const double quantile : QUANTILES)
+                {
+                    std::snprintf(line, sizeof(line), "ingest_stage_seconds{stage=\"%s\",quantile=\"%g\"} %.9f\n", stage, quantile,
+                                  stages[i].getPercentile(quantile * 100.0) / 1e9);
+                    out += line;
+                }
+                std::snprintf(line, sizeof(line), "ingest_stage_seconds_sum{stage=\"%s\"} %.9f\n", stage, stages[i].getSum() / 1e9);
+                out += line;
+                std::snprintf(line, sizeof(line), "ingest_stage_seconds_count{stage=\"%s\"} %llu\n", stage, static_cast<unsigned long long>(stages[i].getCount()));
+                out += line;
+            }
+        }
+
+    private:
+        static uint64_t now()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        uint64_t fields[256];
+        uint64_t outcomes[FRAME_OUTCOMES];
+        LatencyHistogram stages[PIPELINE_STAGES];
+        uint32_t sampleCounter = 0;
+        bool sampled = false;
+        uint64_t lastNs = 0;
+    };
+
+    /**
+     * @brief Gets the Metrics of the calling thread.
+     */
+    inline Metrics &getThreadMetrics()
+    {
+        static thread_local Metrics metrics;
+        return metrics;
+    }
+
+    /**
+     * @brief The process total that threads publish into and exporters read.
+     */
+    class MetricsRegistry
+    {
+    public:
+        static MetricsRegistry &get()
+        {
+            static MetricsRegistry registry;
+            return registry;
+        }
+
+        /**
+         * @brief Moves the counts of a thread into the total.
+         */
+        void publish(Metrics &local)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            total.merge(local);
+            local.reset();
+        }
+
+        /**
+         * @brief Renders the total in the Prometheus text format.
+         */
+        std::string renderPrometheus()
+        {
+            std::string text;
+            std::lock_guard<std::mutex> lock(mutex);
+            total.writePrometheus(text);
+            return text;
+        }
+
+        /**
+         * @brief Writes the total in the Prometheus text format, e.g. for the node exporter textfile collector.
+         *
+         * The text goes to a temporary file first, which is renamed over the target, so readers never see half a file.
+         *
+         * @param path Target file.
+         * @return bool True on success.
+         */
+        bool writePrometheusFile(const std::string &path)
+        {
+            const std::string text = renderPrometheus();
+            const std::string temporary = path + ".tmp";
+            FILE *file = std::fopen(temporary.c_str(), "w");
+            if (!file)
+            {
+                return false;
+            }
+            const bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+            return (std::fclose(file) == 0) && written && std::rename(temporary.c_str(), path.c_str()) == 0;
+        }
+
+    private:
+        MetricsRegistry() = default;
+
+        std::mutex mutex;
+        Metrics total;
+    };
+} // namespace INGEST
+
+#if INGEST_METRICS
+#define METRICS_BEGIN() INGEST::getThreadMetrics().begin()
+#define METRICS_STAGE(stage) INGEST::getThreadMetrics().endStage(INGEST::PIPELINE_STAGE::stage)
+#define METRICS_OUTCOME(outcome) INGEST::getThreadMetrics().countOutcome(INGEST::FRAME_OUTCOME::outcome)
+#define METRICS_FIELD(type) INGEST::getThreadMetrics().countField(type)
+#define METRICS_PUBLISH() INGEST::MetricsRegistry::get().publish(INGEST::getThreadMetrics())
+#else
+#define METRICS_BEGIN()
+#define METRICS_STAGE(stage)
+#define METRICS_OUTCOME(outcome)
+#define METRICS_FIELD(type)
+#define METRICS_PUBLISH()
+#endif
+
+#endif // INGEST_METRICS_HPP
@@ -0,0 +1,144 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file MetricsEndpoint.hpp
+ * @brief Serves the MetricsRegistry to a Prometheus scraper on a localhost port.
+ *
+ * A minimal HTTP/1.0 server on its own thread: every request, whatever its path, is answered
+ * with the current total in the text format and the connection is closed. It binds to the
+ * loopback address only; put a reverse proxy in front to expose it further. Linux only.
+ */
+
+#ifndef INGEST_METRICS_ENDPOINT_HPP
+#define INGEST_METRICS_ENDPOINT_HPP
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "Metrics.hpp"
+
+namespace INGEST
+{
+    class MetricsEndpoint
+    {
+    public:
+        MetricsEndpoint() : fd(-1), stopRequested(false) {}
+
+        ~MetricsEndpoint()
+        {
+            stop();
+        }
+
+        MetricsEndpoint(const MetricsEndpoint &) = delete;
+        MetricsEndpoint &operator=(const MetricsEndpoint &) = delete;
+
+        /**
+         * @brief Starts serving on 127.0.0.1.
+         *
+         * @param port TCP port, e.g. 9108.
+         * @return bool False if the port could not be bound.
+         */
+        bool start(const uint16_t port)
+        {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            const int reuse = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (fd < 0 || bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0 || listen(fd, 8) < 0)
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                    fd = -1;
+                }
+                return false;
+            }
+            thread = std::thread([this] { serve(); });
+            return true;
+        }
+
+        void stop()
+        {
+            if (thread.joinable())
+            {
+                stopRequested = true;
+                thread.join();
+            }
+            if (fd >= 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+
+    private:
+        void serve()
+        {
+            while (!stopRequested)
+            {
+                // Wake up now and then to notice stop().
+                pollfd waiting = {fd, POLLIN, 0};
+                if (poll(&waiting, 1, 200) <= 0)
+                {
+                    continue;
+                }
+                const int client = accept(fd, nullptr, nullptr);
+                if (client < 0)
+                {
+                    continue;
+                }
+                // The request itself does not matter; read what has arrived so closing does not reset it.
+                char request[1024];
+                pollfd reading = {client, POLLIN, 0};
+                if (poll(&reading, 1, 1000) > 0)
+                {
+                    const ssize_t ignored = recv(client, request, sizeof(request), 0);
+                    (void)ignored;
+                }
+                const std::string body = MetricsRegistry::get().renderPrometheus();
+                char header[128];
+                const int headerSize = std::snprintf(header, sizeof(header),
+                                                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", body.size());
+                sendAll(client, header, static_cast<size_t>(headerSize));
+                sendAll(client, body.data(), body.size());
+                close(client);
+            }
+        }
+
+        static void sendAll(const int client, const char *data, size_t size)
+        {
+            while (size)
+            {
+                const ssize_t sent = send(client, data, size, MSG_NOSIGNAL);
+                if (sent <= 0)
+                {
+                    return;
+                }
+                data += sent;
+                size -= static_cast<size_t>(sent);
+            }
+        }
+
+        int fd;
+        std::atomic<bool> stopRequested;
+        std::thread thread;
+    };
+} // namespace INGEST
+
+#endif // INGEST_METRICS_ENDPOINT_HPP
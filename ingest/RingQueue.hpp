@@ -0,0 +1,251 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file RingQueue.hpp
+ * @brief Bounded lock-free ring queues for handing frames between pipeline threads.
+ *
+ * SpscQueue connects one producer to one consumer with two indices and no read-modify-write
+ * operations. MpmcQueue lets any number of threads push and pop; every cell carries a sequence
+ * number telling whose turn it is (D. Vyukov's bounded queue). Both move items in batches:
+ * a batch costs the synchronisation of a single item, which is what makes millions of frames
+ * per second cheap. Items are copied, so they should be small descriptors, not payloads.
+ */
+
+#ifndef INGEST_RING_QUEUE_HPP
+#define INGEST_RING_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace INGEST
+{
+    const static size_t CACHE_LINE_SIZE = 64;
+
+    /**
+     * @brief Bounded single-producer single-consumer queue.
+     *
+     * @tparam T Item type, trivially copyable.
+     * @tparam Capacity Number of items, a power of two.
+     */
+    template <typename T, size_t Capacity>
+    class SpscQueue
+    {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        SpscQueue() : head(0), tailCache(0), tail(0), headCache(0) {}
+
+        /**
+         * @brief Pushes up to count items; producer thread only.
+         *
+         * @param items The items.
+         * @param count Number of items.
+         * @return size_t Number of items pushed, fewer than count when the queue is full.
+         */
+        size_t pushBatch(const T *items, const size_t count)
+        {
+            const size_t position = tail.load(std::memory_order_relaxed);
+            size_t free = Capacity - (position - headCache);
+            if (free < count)
+            {
+                headCache = head.load(std::memory_order_acquire);
+                free = Capacity - (position - headCache);
+            }
+            const size_t pushed = count < free ? count : free;
+            for (size_t i = 0; i < pushed; i++)
+            {
+                slots[(position + i) & (Capacity - 1)] = items[i];
+            }
+            tail.store(position + pushed, std::memory_order_release);
+            return pushed;
+        }
+
+        /**
+         * @brief Pops up to maximum items; consumer thread only.
+         *
+         * @param items Destination for the items.
+         * @param maximum Room in the destination.
+         * @return size_t Number of items popped, 0 when the queue is empty.
+         */
+        size_t popBatch(T *items, const size_t maximum)
+        {
+            const size_t position = head.load(std::memory_order_relaxed);
+            size_t available = tailCache - position;
+            if (available < maximum)
+            {
+                tailCache = tail.load(std::memory_order_acquire);
+                available = tailCache - position;
+            }
+            const size_t popped = maximum < available ? maximum : available;
+            for (size_t i = 0; i < popped; i++)
+            {
+                items[i] = slots[(position + i) & (Capacity - 1)];
+            }
+            head.store(position + popped, std::memory_order_release);
+            return popped;
+        }
+
+        bool tryPush(const T &item) { return pushBatch(&item, 1) == 1; }
+        bool tryPop(T &item) { return popBatch(&item, 1) == 1; }
+
+        /**
+         * @brief Gets the number of queued items; exact only while neither side is active.
+         */
+        size_t getSize(void) const
+        {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+    private:
+        // Consumer side and producer side on their own cache lines.
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> head;
+        size_t tailCache;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail;
+        size_t headCache;
+        alignas(CACHE_LINE_SIZE) T slots[Capacity];
+    };
+
+    /**
+     * @brief Bounded multi-producer multi-consumer queue.
+     *
+     * A cell at position p is free for the producer of p when its sequence is p, and holds an
+     * item for the consumer of p when its sequence is p + 1. A batch claims a run of cells found
+     * free (or full) with a single compare-and-swap on the position; cells in that state only
+     * change hands through that position, so the run stays valid once the swap succeeds.
+     *
+     * @tparam T Item type, trivially copyable.
+     * @tparam Capacity Number of items, a power of two.
+     */
+    template <typename T, size_t Capacity>
+    class MpmcQueue
+    {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        MpmcQueue() : enqueuePosition(0), dequeuePosition(0)
+        {
+            for (size_t i = 0; i < Capacity; i++)
+            {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief Pushes up to count items.
+         *
+         * @param items The items.
+         * @param count Number of items.
+         * @return size_t Number of items pushed, fewer than count when the queue is (nearly) full.
+         */
+        size_t pushBatch(const T *items, const size_t count)
+        {
+            size_t position = enqueuePosition.load(std::memory_order_relaxed);
+            while (count)
+            {
+                const size_t run = countRun(position, count, 0);
+                if (run == 0)
+                {
+                    const intptr_t lag = static_cast<intptr_t>(cells[position & (Capacity - 1)].sequence.load(std::memory_order_acquire) - position);
+                    if (lag < 0)
+                    {
+                        return 0;   // Full: the cell still holds the item of the previous lap.
+                    }
+                    position = enqueuePosition.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (enqueuePosition.compare_exchange_weak(position, position + run, std::memory_order_relaxed))
+                {
+                    for (size_t i = 0; i < run; i++)
+                    {
+                        Cell &cell = cells[(position + i) & (Capacity - 1)];
+                        cell.item = items[i];
+                        cell.sequence.store(position + i + 1, std::memory_order_release);
+                    }
+                    return run;
+                }
+            }
+            return 0;
+        }
+
+        /**
+         * @brief Pops up to maximum items.
+         *
+         * @param items Destination for the items.
+         * @param maximum Room in the destination.
+         * @return size_t Number of items popped, 0 when the queue is empty.
+         */
+        size_t popBatch(T *items, const size_t maximum)
+        {
+            size_t position = dequeuePosition.load(std::memory_order_relaxed);
+            while (maximum)
+            {
+                const size_t run = countRun(position, maximum, 1);
+                if (run == 0)
+                {
+                    const intptr_t lag = static_cast<intptr_t>(cells[position & (Capacity - 1)].sequence.load(std::memory_order_acquire) - (position + 1));
+                    if (lag < 0)
+                    {
+                        return 0;   // Empty: the cell waits for its producer.
+                    }
+                    position = dequeuePosition.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (dequeuePosition.compare_exchange_weak(position, position + run, std::memory_order_relaxed))
+                {
+                    for (size_t i = 0; i < run; i++)
+                    {
+                        Cell &cell = cells[(position + i) & (Capacity - 1)];
+                        items[i] = cell.item;
+                        cell.sequence.store(position + i + Capacity, std::memory_order_release);
+                    }
+                    return run;
+                }
+            }
+            return 0;
+        }
+
+        bool tryPush(const T &item) { return pushBatch(&item, 1) == 1; }
+        bool tryPop(T &item) { return popBatch(&item, 1) == 1; }
+
+        /**
+         * @brief Gets the number of claimed but not yet popped positions; approximate under load.
+         */
+        size_t getSize(void) const
+        {
+            const size_t pushed = enqueuePosition.load(std::memory_order_acquire);
+            const size_t popped = dequeuePosition.load(std::memory_order_acquire);
+            return pushed > popped ? pushed - popped : 0;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T item;
+        };
+
+        // Number of consecutive cells from position in the expected state, at most limit.
+        size_t countRun(const size_t position, const size_t limit, const size_t offset) const
+        {
+            size_t run = 0;
+            while (run < limit && cells[(position + run) & (Capacity - 1)].sequence.load(std::memory_order_acquire) == position + run + offset)
+            {
+                run++;
+            }
+            return run;
+        }
+
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueuePosition;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeuePosition;
+        alignas(CACHE_LINE_SIZE) Cell cells[Capacity];
+    };
+} // namespace INGEST
+
+#endif // INGEST_RING_QUEUE_HPP
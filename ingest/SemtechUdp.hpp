@@ -0,0 +1,546 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file SemtechUdp.hpp
+ * @brief Semtech UDP packet-forwarder protocol: PUSH_DATA datagrams and their rxpk JSON.
+ *
+ * A PUSH_DATA datagram is [version][token, 2 bytes][0x00][gateway EUI, 8 bytes] followed by a
+ * JSON object whose "rxpk" array holds one object per received packet. RxpkReader walks that
+ * JSON where it lies in the receive buffer: it copies nothing and returns the base64 `data`
+ * as a pointer into the datagram. Only the members the ingest path needs are extracted;
+ * everything else, nested objects and arrays included, is skipped. An rxpk whose tmst, size,
+ * rssi or lsnr is outside the range of its member is rejected, not truncated.
+ */
+
+#ifndef INGEST_SEMTECH_UDP_HPP
+#define INGEST_SEMTECH_UDP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "Base64.hpp"
+
+namespace INGEST
+{
+    /**
+     * @brief Identifiers of the Semtech UDP protocol.
+     */
+    enum class SEMTECH_IDENTIFIER : uint8_t
+    {
+        PUSH_DATA   = 0x00,     /* Gateway -> server: rxpk and stat. */
+        PUSH_ACK    = 0x01,     /* Server -> gateway: acknowledges PUSH_DATA. */
+        PULL_DATA   = 0x02,     /* Gateway -> server: keep-alive for downlinks. */
+        PULL_RESP   = 0x03,     /* Server -> gateway: txpk. */
+        PULL_ACK    = 0x04,     /* Server -> gateway: acknowledges PULL_DATA. */
+        TX_ACK      = 0x05      /* Gateway -> server: result of a PULL_RESP. */
+    };
+
+    const static size_t PUSH_DATA_HEADER_SIZE = 12;
+    const static size_t PUSH_ACK_SIZE = 4;
+
+    /**
+     * @brief The binary header of a PUSH_DATA datagram.
+     */
+    struct PushDataHeader
+    {
+        uint8_t version;
+        uint16_t token;
+        uint64_t gatewayEui;
+        const char *json;       ///< The JSON object, not terminated.
+        size_t jsonLength;
+    };
+
+    /**
+     * @brief Parses the header of a PUSH_DATA datagram.
+     *
+     * @param datagram The datagram.
+     * @param size Size of the datagram.
+     * @param header The parsed header.
+     * @return bool False if the datagram is too short, of an unknown version or no PUSH_DATA.
+     */
+    inline bool parsePushData(const uint8_t *datagram, const size_t size, PushDataHeader &header)
+    {
+        if (size < PUSH_DATA_HEADER_SIZE || (datagram[0] != 1 && datagram[0] != 2) ||
+            datagram[3] != static_cast<uint8_t>(SEMTECH_IDENTIFIER::PUSH_DATA))
+        {
+            return false;
+        }
+        header.version = datagram[0];
+        header.token = static_cast<uint16_t>(datagram[1] << 8 | datagram[2]);
+        header.gatewayEui = 0;
+        for (size_t i = 0; i < 8; i++)
+        {
+            header.gatewayEui = header.gatewayEui << 8 | datagram[4 + i];
+        }
+        header.json = reinterpret_cast<const char *>(&datagram[PUSH_DATA_HEADER_SIZE]);
+        header.jsonLength = size - PUSH_DATA_HEADER_SIZE;
+        return true;
+    }
+
+    /**
+     * @brief Writes the PUSH_ACK for a PUSH_DATA.
+     *
+     * @param header The header of the acknowledged datagram.
+     * @param ack Destination with room for PUSH_ACK_SIZE bytes.
+     * @return size_t PUSH_ACK_SIZE.
+     */
+    inline size_t writePushAck(const PushDataHeader &header, uint8_t *ack)
+    {
+        ack[0] = header.version;
+        ack[1] = static_cast<uint8_t>(header.token >> 8);
+        ack[2] = static_cast<uint8_t>(header.token);
+        ack[3] = static_cast<uint8_t>(SEMTECH_IDENTIFIER::PUSH_ACK);
+        return PUSH_ACK_SIZE;
+    }
+
+    /**
+     * @brief Writes the header of a PUSH_DATA datagram; the JSON follows at PUSH_DATA_HEADER_SIZE.
+     *
+     * @param token Random token, echoed in the PUSH_ACK.
+     * @param gatewayEui EUI of the gateway.
+     * @param datagram Destination with room for PUSH_DATA_HEADER_SIZE bytes.
+     * @return size_t PUSH_DATA_HEADER_SIZE.
+     */
+    inline size_t writePushDataHeader(const uint16_t token, const uint64_t gatewayEui, uint8_t *datagram)
+    {
+        datagram[0] = 2;
+        datagram[1] = static_cast<uint8_t>(token >> 8);
+        datagram[2] = static_cast<uint8_t>(token);
+        datagram[3] = static_cast<uint8_t>(SEMTECH_IDENTIFIER::PUSH_DATA);
+        for (size_t i = 0; i < 8; i++)
+        {
+            datagram[4 + i] = static_cast<uint8_t>(gatewayEui >> (56 - 8 * i));
+        }
+        return PUSH_DATA_HEADER_SIZE;
+    }
+
+    /**
+     * @brief Writes an rxpk object for a LoRa uplink on 868.1 MHz, as a packet forwarder reports it.
+     *
+     * @param tmst Gateway timestamp in microseconds.
+     * @param spreadingFactor Spreading factor, at 125 kHz.
+     * @param lsnr SNR in dB.
+     * @param rssi RSSI in dBm.
+     * @param phy The PHYPayload.
+     * @param phySize Size of the PHYPayload, at most 255.
+     * @param json Destination; not terminated.
+     * @param capacity Size of the destination; 200 + 4 * phySize / 3 bytes are always enough.
+     * @return size_t Length of the object, 0 if it does not fit.
+     */
+    inline size_t writeRxpk(const uint32_t tmst, const uint8_t spreadingFactor, const float lsnr, const int rssi,
+                            const uint8_t *phy, const size_t phySize, char *json, const size_t capacity)
+    {
+        char data[344];
+        if (phySize > 255)
+        {
+            return 0;
+        }
+        const size_t dataLength = encodeBase64(phy, phySize, data);
+        const int length = std::snprintf(json, capacity,
+                                         "{\"tmst\":%lu,\"chan\":0,\"rfch\":0,\"freq\":868.100000,\"stat\":1,\"modu\":\"LORA\","
+                                         "\"datr\":\"SF%uBW125\",\"codr\":\"4/5\",\"lsnr\":%.2f,\"rssi\":%d,\"size\":%u,\"data\":\"%.*s\"}",
+                                         static_cast<unsigned long>(tmst), spreadingFactor, lsnr, rssi, static_cast<unsigned>(phySize),
+                                         static_cast<int>(dataLength), data);
+        return length > 0 && static_cast<size_t>(length) < capacity ? static_cast<size_t>(length) : 0;
+    }
+
+    /**
+     * @brief Accepted ranges of the numeric rxpk members; rssi and lsnr as the ingest path stores them.
+     */
+    const static double RXPK_MAX_TMST = 4294967295.0;
+    const static double RXPK_MAX_SIZE = 255.0;
+    const static double RXPK_MIN_RSSI = -32768.0;
+    const static double RXPK_MAX_RSSI = 32767.0;
+    const static double RXPK_MIN_LSNR = -32.0;
+    const static double RXPK_MAX_LSNR = 31.75;
+
+    /**
+     * @brief The members of one rxpk object used by the ingest path.
+     */
+    struct Rxpk
+    {
+        uint32_t tmst;              ///< Gateway timestamp in microseconds.
+        double freq;                ///< MHz.
+        float rssi;                 ///< dBm.
+        float lsnr;                 ///< dB.
+        uint8_t spreadingFactor;    ///< From "datr", 0 for FSK.
+        uint16_t size;              ///< Size of the PHYPayload according to the gateway, at most 255.
+        const char *data;           ///< Base64 PHYPayload, pointing into the datagram; nullptr if absent.
+        size_t dataLength;
+    };
+
+    /**
+     * @brief Iterates over the rxpk objects of a PUSH_DATA JSON object, in place.
+     */
+    class RxpkReader
+    {
+    public:
+        /**
+         * @brief Constructor for RxpkReader; finds the "rxpk" array.
+         *
+         * @param json The JSON object.
+         * @param length Length of the JSON.
+         */
+        RxpkReader(const char *json, const size_t length)
+            : position(json), end(json + length), inArray(false), first(true), error(false), rejectedCount(0)
+        {
+            skipWhitespace();
+            if (!consume('{'))
+            {
+                error = true;
+                return;
+            }
+            skipWhitespace();
+            if (consume('}'))
+            {
+                return;
+            }
+            do
+            {
+                const char *key;
+                size_t keyLength;
+                if (!readString(key, keyLength) || !readColon())
+                {
+                    error = true;
+                    return;
+                }
+                if (keyLength == 4 && !std::memcmp(key, "rxpk", 4))
+                {
+                    skipWhitespace();
+                    inArray = consume('[');
+                    error = !inArray;
+                    return;
+                }
+                if (!skipValue())
+                {
+                    error = true;
+                    return;
+                }
+                skipWhitespace();
+            } while (consume(','));
+        }
+
+        /**
+         * @brief Reads the next rxpk object; objects with a member out of range are skipped.
+         *
+         * @param rxpk The members of the object; members not present are 0.
+         * @return bool False at the end of the array, when there is no rxpk array, or on malformed JSON.
+         */
+        bool next(Rxpk &rxpk)
+        {
+            while (inArray)
+            {
+                bool inRange = true;
+                if (!readObject(rxpk, inRange))
+                {
+                    return false;
+                }
+                if (inRange)
+                {
+                    return true;
+                }
+                rejectedCount++;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Gets the number of rxpk objects skipped so far for a member out of range.
+         */
+        size_t getRejectedCount(void) const
+        {
+            return rejectedCount;
+        }
+
+        /**
+         * @brief Tells whether reading stopped on malformed JSON.
+         */
+        bool failed(void) const
+        {
+            return error;
+        }
+
+    private:
+        const char *position;
+        const char *end;
+        bool inArray;
+        bool first;
+        bool error;
+        size_t rejectedCount;
+
+        bool readObject(Rxpk &rxpk, bool &inRange)
+        {
+            skipWhitespace();
+            if (consume(']'))
+            {
+                inArray = false;
+                return false;
+            }
+            if (!first && !consume(','))
+            {
+                return fail();
+            }
+            first = false;
+            skipWhitespace();
+            if (!consume('{'))
+            {
+                return fail();
+            }
+            rxpk = Rxpk();
+            skipWhitespace();
+            if (consume('}'))
+            {
+                return true;
+            }
+            do
+            {
+                const char *key;
+                size_t keyLength;
+                if (!readString(key, keyLength) || !readColon() || !readMember(key, keyLength, rxpk, inRange))
+                {
+                    return fail();
+                }
+                skipWhitespace();
+            } while (consume(','));
+            return consume('}') || fail();
+        }
+
+        bool fail()
+        {
+            inArray = false;
+            error = true;
+            return false;
+        }
+
+        void skipWhitespace()
+        {
+            while (position < end && (*position == ' ' || *position == '\n' || *position == '\r' || *position == '\t'))
+            {
+                position++;
+            }
+        }
+
+        bool consume(const char character)
+        {
+            if (position < end && *position == character)
+            {
+                position++;
+                return true;
+            }
+            return false;
+        }
+
+        bool readColon()
+        {
+            skipWhitespace();
+            if (!consume(':'))
+            {
+                return false;
+            }
+            skipWhitespace();
+            return true;
+        }
+
+        // Escapes are skipped, not resolved: none of the members read contains any.
+        bool readString(const char *&text, size_t &length)
+        {
+            skipWhitespace();
+            if (!consume('"'))
+            {
+                return false;
+            }
+            text = position;
+            while (position < end && *position != '"')
+            {
+                if (*position == '\\' && end - position < 2)
+                {
+                    return false;
+                }
+                position += *position == '\\' ? 2 : 1;
+            }
+            if (position >= end)
+            {
+                return false;
+            }
+            length = static_cast<size_t>(position - text);
+            position++;
+            return true;
+        }
+
+        bool readNumber(double &value)
+        {
+            const char *start = position;
+            const bool negative = consume('-');
+            double result = 0.0;
+            while (position < end && *position >= '0' && *position <= '9')
+            {
+                result = result * 10.0 + (*position++ - '0');
+            }
+            if (consume('.'))
+            {
+                double scale = 0.1;
+                while (position < end && *position >= '0' && *position <= '9')
+                {
+                    result += (*position++ - '0') * scale;
+                    scale *= 0.1;
+                }
+            }
+            if (position < end && (*position == 'e' || *position == 'E'))
+            {
+                position++;
+                const bool negativeExponent = consume('-');
+                consume('+');
+                int exponent = 0;
+                while (position < end && *position >= '0' && *position <= '9' && exponent < 400)
+                {
+                    exponent = exponent * 10 + (*position++ - '0');
+                }
+                for (int i = 0; i < exponent; i++)
+                {
+                    result = negativeExponent ? result / 10.0 : result * 10.0;
+                }
+            }
+            value = negative ? -result : result;
+            return position > start + (negative ? 1 : 0);
+        }
+
+        // Skips any value, counting brackets outside strings.
+        bool skipValue()
+        {
+            skipWhitespace();
+            if (position >= end)
+            {
+                return false;
+            }
+            if (*position == '"')
+            {
+                const char *text;
+                size_t length;
+                return readString(text, length);
+            }
+            if (*position != '{' && *position != '[')
+            {
+                while (position < end && *position != ',' && *position != '}' && *position != ']' &&
+                       *position != ' ' && *position != '\n' && *position != '\r' && *position != '\t')
+                {
+                    position++;
+                }
+                return position < end;
+            }
+            size_t depth = 0;
+            while (position < end)
+            {
+                if (*position == '"')
+                {
+                    const char *text;
+                    size_t length;
+                    if (!readString(text, length))
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+                if (*position == '{' || *position == '[')
+                {
+                    depth++;
+                }
+                else if (*position == '}' || *position == ']')
+                {
+                    depth--;
+                }
+                position++;
+                if (depth == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool isKey(const char *key, const size_t keyLength, const char *name)
+        {
+            return std::strlen(name) == keyLength && !std::memcmp(key, name, keyLength);
+        }
+
+        static bool isWithin(const double value, const double minimum, const double maximum)
+        {
+            return value >= minimum && value <= maximum;
+        }
+
+        // Returns false on malformed JSON; clears inRange, without casting, for a number out of range.
+        bool readMember(const char *key, const size_t keyLength, Rxpk &rxpk, bool &inRange)
+        {
+            double number;
+            if (isKey(key, keyLength, "data"))
+            {
+                return readString(rxpk.data, rxpk.dataLength);
+            }
+            if (isKey(key, keyLength, "datr"))
+            {
+                // "SF7BW125" for LoRa; a number for FSK.
+                skipWhitespace();
+                if (position < end && *position != '"')
+                {
+                    return skipValue();
+                }
+                const char *text;
+                size_t length;
+                if (!readString(text, length))
+                {
+                    return false;
+                }
+                if (length > 2 && text[0] == 'S' && text[1] == 'F')
+                {
+                    rxpk.spreadingFactor = static_cast<uint8_t>(text[2] - '0');
+                    if (length > 3 && text[3] >= '0' && text[3] <= '9')
+                    {
+                        rxpk.spreadingFactor = static_cast<uint8_t>(rxpk.spreadingFactor * 10 + (text[3] - '0'));
+                    }
+                }
+                return true;
+            }
+            const bool numeric = isKey(key, keyLength, "tmst") || isKey(key, keyLength, "freq") || isKey(key, keyLength, "rssi") ||
+                                 isKey(key, keyLength, "lsnr") || isKey(key, keyLength, "size");
+            if (!numeric)
+            {
+                return skipValue();
+            }
+            if (!readNumber(number))
+            {
+                return false;
+            }
+            switch (key[0])
+            {
+            case 't':
+                inRange = inRange && isWithin(number, 0.0, RXPK_MAX_TMST);
+                rxpk.tmst = inRange ? static_cast<uint32_t>(number) : 0;
+                break;
+            case 'f':
+                rxpk.freq = number;
+                break;
+            case 'r':
+                inRange = inRange && isWithin(number, RXPK_MIN_RSSI, RXPK_MAX_RSSI);
+                rxpk.rssi = inRange ? static_cast<float>(number) : 0.0f;
+                break;
+            case 'l':
+                inRange = inRange && isWithin(number, RXPK_MIN_LSNR, RXPK_MAX_LSNR);
+                rxpk.lsnr = inRange ? static_cast<float>(number) : 0.0f;
+                break;
+            default:
+                inRange = inRange && isWithin(number, 0.0, RXPK_MAX_SIZE);
+                rxpk.size = inRange ? static_cast<uint16_t>(number) : 0;
+                break;
+            }
+            return true;
+        }
+    };
+} // namespace INGEST
+
+#endif // INGEST_SEMTECH_UDP_HPP
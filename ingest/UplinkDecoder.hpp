@@ -0,0 +1,65 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file UplinkDecoder.hpp
+ * @brief Decodes the FRMPayload of KISS node uplinks into fields, by FPort.
+ *
+ * FPort 1 carries CayenneLPP and FPort 2 compact frames, which are expanded with the KISS
+ * profile first; both then go through the layout-cached CayenneDecoder.
+ */
+
+#ifndef INGEST_UPLINK_DECODER_HPP
+#define INGEST_UPLINK_DECODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "../include/CayenneDecoder.hpp"
+#include "../include/CompactFrame.hpp"
+#include "../include/KissNode.hpp"
+
+namespace INGEST
+{
+    using PAYLOAD_ENCODER::DecodedField;
+
+    class UplinkDecoder
+    {
+    public:
+        /// Fields of the largest FRMPayload, 222 bytes of 3-byte digital inputs.
+        static const size_t MAX_FIELDS = 74;
+
+        /**
+         * @brief Decodes an FRMPayload.
+         *
+         * @param fPort FPort of the uplink.
+         * @param payload The FRMPayload.
+         * @param size Size of the FRMPayload.
+         * @param fields Destination array with room for MAX_FIELDS entries.
+         * @return size_t Number of decoded fields. Returns 0 for other FPorts and malformed payloads.
+         */
+        size_t decode(const uint8_t fPort, const uint8_t *payload, const size_t size, DecodedField *fields)
+        {
+            if (fPort == KISS::FPORT_CAYENNE)
+            {
+                return cayenne.decode(payload, size, fields);
+            }
+            if (fPort == KISS::FPORT_COMPACT)
+            {
+                uint8_t expanded[255];
+                const size_t expandedSize = PAYLOAD_ENCODER::expandCompactFrame(&KISS::KISS_PROFILE, 1, payload, size, expanded, sizeof(expanded));
+                return expandedSize ? cayenne.decode(expanded, expandedSize, fields) : 0;
+            }
+            return 0;
+        }
+
+    private:
+        PAYLOAD_ENCODER::CayenneDecoder<MAX_FIELDS> cayenne;
+    };
+} // namespace INGEST
+
+#endif // INGEST_UPLINK_DECODER_HPP
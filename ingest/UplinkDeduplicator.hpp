@@ -0,0 +1,332 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file UplinkDeduplicator.hpp
+ * @brief Drops the copies of an uplink heard by several gateways before it is decoded.
+ *
+ * An uplink is identified by DevAddr, FCnt and a hash of FPort and FRMPayload. The first copy
+ * passes and is decoded at once; copies arriving within the window only merge their RSSI and
+ * SNR into its entry. When the window has closed, the entry is retired: the caller gets the
+ * merged link metadata of all copies and the slot becomes free again.
+ *
+ * The set is bounded: a fixed table split into shards, each behind its own mutex, so decode
+ * threads rarely meet. Within a shard entries are found by linear probing over a few slots.
+ * Should all of them hold live entries, the oldest is retired early and counted as evicted;
+ * size the table for the uplink rate times the window to keep that rare. Every shard also
+ * remembers the order in which its entries started, so expiry only visits entries that are due
+ * instead of sweeping the table.
+ */
+
+#ifndef INGEST_UPLINK_DEDUPLICATOR_HPP
+#define INGEST_UPLINK_DEDUPLICATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "FrameDescriptor.hpp"
+#include "RingQueue.hpp"
+
+namespace INGEST
+{
+    /**
+     * @brief Link metadata of one uplink, merged over the gateways that heard it.
+     */
+    struct MergedUplink
+    {
+        uint32_t devAddr;
+        uint16_t fCnt;
+        uint8_t copies;             ///< Copies received, including the first.
+        uint8_t bestGateway;        ///< Gateway with the strongest RSSI, for the downlink.
+        uint64_t gatewayMask;       ///< Bit (gateway % 64) for every gateway that heard it.
+        uint64_t firstNs;           ///< receivedNs of the first copy.
+        uint64_t lastNs;            ///< receivedNs of the last copy.
+        int16_t bestRssi;           ///< dBm.
+        int8_t bestSnrQuarterDb;    ///< Highest SNR of all copies, in 0.25 dB.
+        bool evicted;               ///< Retired before its window closed; later copies pass as new.
+    };
+
+    /**
+     * @brief Gets a 64-bit hash of FPort and payload, eight bytes per step.
+     */
+    inline uint64_t getPayloadHash(const uint8_t fPort, const uint8_t *payload, const size_t size)
+    {
+        uint64_t hash = 0x9E3779B97F4A7C15ull ^ (static_cast<uint64_t>(size) << 8 | fPort);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, payload + i, 8);
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 32;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, payload + i, size - i);
+        hash = (hash ^ tail) * 0xC4CEB9FE1A85EC53ull;
+        return hash ^ (hash >> 29);
+    }
+
+    /**
+     * @brief Sharded, bounded set of recent uplinks with time-based expiry.
+     *
+     * @tparam Shards Number of shards, a power of two.
+     * @tparam SlotsPerShard Entries per shard, a power of two.
+     */
+    template <size_t Shards, size_t SlotsPerShard>
+    class UplinkDeduplicator
+    {
+        static_assert(Shards && (Shards & (Shards - 1)) == 0, "Shards must be a power of two");
+        static_assert(SlotsPerShard >= 8 && (SlotsPerShard & (SlotsPerShard - 1)) == 0, "SlotsPerShard must be a power of two");
+
+    public:
+        /// Slots searched for an uplink before the oldest one is evicted.
+        static const size_t MAX_PROBE = 8;
+
+        /**
+         * @brief Constructor for UplinkDeduplicator.
+         *
+         * @param windowNs Time after the first copy during which copies count as duplicates.
+         */
+        explicit UplinkDeduplicator(const uint64_t windowNs) : windowNs(windowNs), shards(Shards) {}
+
+        /**
+         * @brief Offers a received copy of an uplink, using its receivedNs as the current time.
+         *
+         * Expects the fields of a parsed data uplink: devAddr, fCnt, fPort, payload and size.
+         *
+         * @param frame The copy.
+         * @param retire Called with the MergedUplink of every entry that leaves the table meanwhile.
+         * @return bool True for the first copy, which should be decoded; false for a duplicate.
+         */
+        template <typename Retire>
+        bool observe(const FrameDescriptor &frame, Retire &&retire)
+        {
+            const uint64_t payloadHash = getPayloadHash(frame.fPort, frame.payload, frame.size);
+            const uint64_t key = mix(frame.devAddr, frame.fCnt, payloadHash);
+            Shard &shard = shards[(key >> 32) & (Shards - 1)];
+            const size_t home = static_cast<size_t>(key) & (SlotsPerShard - 1);
+            const uint64_t now = frame.receivedNs;
+
+            const uint16_t tag = static_cast<uint16_t>(key >> 48) | 1;
+
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size_t target = SlotsPerShard;
+            for (size_t probe = 0; probe < MAX_PROBE; probe++)
+            {
+                const size_t slot = (home + probe) & (SlotsPerShard - 1);
+                if (shard.tags[slot] == 0)
+                {
+                    target = target < SlotsPerShard ? target : slot;
+                    continue;
+                }
+                if (shard.tags[slot] != tag)
+                {
+                    continue;
+                }
+                Entry &entry = shard.entries[slot];
+                if (entry.payloadHash == payloadHash && entry.merged.devAddr == frame.devAddr && entry.merged.fCnt == frame.fCnt)
+                {
+                    if (!isClosed(entry.merged.firstNs, now))
+                    {
+                        merge(entry.merged, frame);
+                        shard.duplicates++;
+                        return false;
+                    }
+                    // A copy after the window closed starts over.
+                    retireSlot(shard, slot, retire);
+                    target = target < SlotsPerShard ? target : slot;
+                }
+            }
+            if (target == SlotsPerShard)
+            {
+                // No free slot: take one whose window has closed, or evict the oldest.
+                target = home;
+                for (size_t probe = 1; probe < MAX_PROBE; probe++)
+                {
+                    const size_t slot = (home + probe) & (SlotsPerShard - 1);
+                    target = shard.entries[slot].merged.firstNs < shard.entries[target].merged.firstNs ? slot : target;
+                }
+                const bool early = !isClosed(shard.entries[target].merged.firstNs, now);
+                shard.entries[target].merged.evicted = early;
+                shard.evictions += early;
+                retireSlot(shard, target, retire);
+            }
+            if (shard.orderCount == SlotsPerShard)
+            {
+                // As many entries started since the oldest record as the shard has slots.
+                const Started &oldest = shard.order[shard.orderHead];
+                Entry &entry = shard.entries[oldest.slot];
+                if (shard.tags[oldest.slot] && entry.merged.firstNs == oldest.firstNs)
+                {
+                    const bool early = !isClosed(oldest.firstNs, now);
+                    entry.merged.evicted = early;
+                    shard.evictions += early;
+                    retireSlot(shard, oldest.slot, retire);
+                }
+                popOrder(shard);
+            }
+            start(shard.entries[target], frame, payloadHash);
+            shard.tags[target] = tag;
+            Started &started = shard.order[(shard.orderHead + shard.orderCount++) & (SlotsPerShard - 1)];
+            started.slot = static_cast<uint32_t>(target);
+            started.firstNs = now;
+            return true;
+        }
+
+        /**
+         * @brief Retires the entries whose window has closed; cheap enough to call for every receive batch.
+         *
+         * @param nowNs Current time, on the clock of receivedNs.
+         * @param retire Called with the MergedUplink of every retired entry.
+         * @return size_t Number of retired entries.
+         */
+        template <typename Retire>
+        size_t expire(const uint64_t nowNs, Retire &&retire)
+        {
+            size_t retired = 0;
+            for (Shard &shard : shards)
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                while (shard.orderCount)
+                {
+                    const Started &oldest = shard.order[shard.orderHead];
+                    if (!isClosed(oldest.firstNs, nowNs))
+                    {
+                        break;
+                    }
+                    if (shard.tags[oldest.slot] && shard.entries[oldest.slot].merged.firstNs == oldest.firstNs)
+                    {
+                        retireSlot(shard, oldest.slot, retire);
+                        retired++;
+                    }
+                    popOrder(shard);
+                }
+            }
+            return retired;
+        }
+
+        /**
+         * @brief Gets the number of copies dropped as duplicates.
+         */
+        uint64_t getDuplicateCount(void)
+        {
+            uint64_t total = 0;
+            for (Shard &shard : shards)
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                total += shard.duplicates;
+            }
+            return total;
+        }
+
+        /**
+         * @brief Gets the number of entries retired early for lack of room.
+         */
+        uint64_t getEvictionCount(void)
+        {
+            uint64_t total = 0;
+            for (Shard &shard : shards)
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                total += shard.evictions;
+            }
+            return total;
+        }
+
+    private:
+        struct Entry
+        {
+            MergedUplink merged;
+            uint64_t payloadHash;
+        };
+
+        struct Started
+        {
+            uint32_t slot;
+            uint64_t firstNs;
+        };
+
+        struct alignas(CACHE_LINE_SIZE) Shard
+        {
+            Shard() : tags(SlotsPerShard), entries(SlotsPerShard), order(SlotsPerShard) {}
+
+            std::mutex mutex;
+            std::vector<uint16_t> tags;     ///< Hash bits per slot, so probing stays in one cache line; 0 marks a free slot.
+            std::vector<Entry> entries;
+            std::vector<Started> order;     ///< Ring of started entries, oldest first; may name reused slots.
+            size_t orderHead = 0;
+            size_t orderCount = 0;
+            uint64_t duplicates = 0;
+            uint64_t evictions = 0;
+        };
+
+        template <typename Retire>
+        static void retireSlot(Shard &shard, const size_t slot, Retire &&retire)
+        {
+            retire(shard.entries[slot].merged);
+            shard.tags[slot] = 0;
+        }
+
+        static void popOrder(Shard &shard)
+        {
+            shard.orderHead = (shard.orderHead + 1) & (SlotsPerShard - 1);
+            shard.orderCount--;
+        }
+
+        // splitmix64 finalizer over the three key parts.
+        static uint64_t mix(const uint32_t devAddr, const uint16_t fCnt, const uint64_t payloadHash)
+        {
+            uint64_t z = payloadHash ^ (static_cast<uint64_t>(devAddr) << 16 | fCnt);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // Copies from other threads may carry a slightly earlier time than the first one.
+        bool isClosed(const uint64_t firstNs, const uint64_t nowNs) const
+        {
+            return nowNs > firstNs && nowNs - firstNs >= windowNs;
+        }
+
+        static void start(Entry &entry, const FrameDescriptor &frame, const uint64_t payloadHash)
+        {
+            MergedUplink &merged = entry.merged;
+            merged.devAddr = frame.devAddr;
+            merged.fCnt = frame.fCnt;
+            merged.copies = 1;
+            merged.bestGateway = frame.gateway;
+            merged.gatewayMask = uint64_t(1) << (frame.gateway & 63);
+            merged.firstNs = frame.receivedNs;
+            merged.lastNs = frame.receivedNs;
+            merged.bestRssi = frame.rssi;
+            merged.bestSnrQuarterDb = frame.snrQuarterDb;
+            merged.evicted = false;
+            entry.payloadHash = payloadHash;
+        }
+
+        static void merge(MergedUplink &merged, const FrameDescriptor &frame)
+        {
+            merged.copies = static_cast<uint8_t>(merged.copies < UINT8_MAX ? merged.copies + 1 : UINT8_MAX);
+            merged.gatewayMask |= uint64_t(1) << (frame.gateway & 63);
+            merged.lastNs = frame.receivedNs > merged.lastNs ? frame.receivedNs : merged.lastNs;
+            if (frame.rssi > merged.bestRssi)
+            {
+                merged.bestRssi = frame.rssi;
+                merged.bestGateway = frame.gateway;
+            }
+            merged.bestSnrQuarterDb = frame.snrQuarterDb > merged.bestSnrQuarterDb ? frame.snrQuarterDb : merged.bestSnrQuarterDb;
+        }
+
+        const uint64_t windowNs;
+        std::vector<Shard> shards;
+    };
+} // namespace INGEST
+
+#endif // INGEST_UPLINK_DEDUPLICATOR_HPP
@@ -0,0 +1,411 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file ingest_daemon.cpp
+ * @brief Receives Semtech UDP PUSH_DATA from packet forwarders and decodes the KISS payloads natively.
+ *
+ * Datagrams are received in batches with recvmmsg() and acknowledged in batches with sendmmsg().
+ * The rxpk JSON is read in place, `data` is base64-decoded into a per-batch arena, and the
+ * FRMPayload goes through the C++ decoder of include/ instead of the JavaScript TTN decoder.
+ * Copies of an uplink heard by several gateways are decoded once; their link metadata is merged.
+ * Per-stage latency and per-type counts are exported for Prometheus, see ingest/Metrics.hpp.
+ * Linux only. Build and run from the repository root:
+ *   g++ -std=c++17 -O2 -Iinclude ingest/ingest_daemon.cpp -o ingest_daemon -pthread
+ *   ./ingest_daemon --port 1700 --print
+ * Feed it with ingest/replay_client.cpp, or point a packet forwarder at it.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Base64.hpp"
+#include "DecodeArena.hpp"
+#include "LoRaWanFrame.hpp"
+#include "Metrics.hpp"
+#include "MetricsEndpoint.hpp"
+#include "SemtechUdp.hpp"
+#include "UplinkDecoder.hpp"
+#include "UplinkDeduplicator.hpp"
+
+using namespace INGEST;
+
+namespace
+{
+    const size_t DATAGRAM_SIZE = 65536;
+
+    struct Options
+    {
+        uint16_t port = 1700;
+        unsigned batch = 64;
+        uint64_t count = 0;     ///< Stop after this many rxpk, 0 to run until SIGINT.
+        uint64_t dedupMs = 250; ///< Deduplication window, 0 to decode every copy.
+        std::string metricsFile;        ///< Prometheus text file rewritten every second, if set.
+        uint16_t metricsPort = 0;       ///< Localhost port serving the metrics, 0 for none.
+        bool print = false;
+    };
+
+    struct Counters
+    {
+        uint64_t datagrams = 0;
+        uint64_t badDatagrams = 0;      ///< Not a PUSH_DATA, or malformed JSON.
+        uint64_t rxpk = 0;
+        uint64_t rejectedRxpk = 0;      ///< tmst, size, rssi or lsnr out of range.
+        uint64_t unknownGateways = 0;   ///< Datagrams of gateways beyond the first 256, not decoded.
+        uint64_t badBase64 = 0;
+        uint64_t badFrames = 0;         ///< Not a data uplink.
+        uint64_t undecoded = 0;         ///< Other FPort, or malformed CayenneLPP.
+        uint64_t duplicates = 0;        ///< Copies dropped before decoding.
+        uint64_t merged = 0;            ///< Uplinks whose copies were merged and retired.
+        uint64_t evicted = 0;           ///< Of those, retired early for lack of room.
+        uint64_t frames = 0;
+        uint64_t fields = 0;
+        uint64_t bytes = 0;             ///< Received datagram bytes.
+    };
+
+    // Room for 64k uplinks per second at the default window.
+    using Deduplicator = UplinkDeduplicator<16, 1024>;
+
+    volatile std::sig_atomic_t stopRequested = 0;
+
+    void requestStop(int)
+    {
+        stopRequested = 1;
+    }
+
+    void printFrame(const PushDataHeader &header, const Rxpk &rxpk, const DataUplink &uplink, const DecodedField *fields, const size_t count)
+    {
+        std::printf("%016llx %08lx fcnt %5u fport %u sf %2u rssi %6.1f snr %5.2f:", static_cast<unsigned long long>(header.gatewayEui),
+                    static_cast<unsigned long>(uplink.devAddr), uplink.fCnt, uplink.fPort, rxpk.spreadingFactor, rxpk.rssi, rxpk.lsnr);
+        for (size_t i = 0; i < count; i++)
+        {
+            std::printf(" %u/%u=", fields[i].channel, static_cast<unsigned>(fields[i].type));
+            for (uint8_t v = 0; v < fields[i].valueCount; v++)
+            {
+                std::printf(v ? ",%g" : "%g", fields[i].values[v]);
+            }
+        }
+        std::printf("\n");
+    }
+
+    uint64_t nowNs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Gateways get a small index in order of appearance, for the merged metadata. Returns false
+    // once all 256 indices are taken by other gateways, rather than sharing one.
+    bool getGatewayIndex(std::vector<uint64_t> &gateways, const uint64_t eui, uint8_t &index)
+    {
+        for (size_t i = 0; i < gateways.size(); i++)
+        {
+            if (gateways[i] == eui)
+            {
+                index = static_cast<uint8_t>(i);
+                return true;
+            }
+        }
+        if (gateways.size() > UINT8_MAX)
+        {
+            return false;
+        }
+        index = static_cast<uint8_t>(gateways.size());
+        gateways.push_back(eui);
+        return true;
+    }
+
+    void printMerged(const std::vector<uint64_t> &gateways, const MergedUplink &merged)
+    {
+        std::printf("merged %08lx fcnt %5u: %u copies, best %016llx rssi %d snr %5.2f%s\n", static_cast<unsigned long>(merged.devAddr),
+                    merged.fCnt, merged.copies, static_cast<unsigned long long>(gateways[merged.bestGateway]), merged.bestRssi,
+                    merged.bestSnrQuarterDb / 4.0, merged.evicted ? " (evicted)" : "");
+    }
+
+    void printCounters(const Counters &counters, const double seconds)
+    {
+        std::fprintf(stderr, "%llu datagrams (%llu bad), %llu rxpk: %llu frames decoded, %llu fields; %llu bad base64, %llu not data uplinks, %llu undecoded",
+                     static_cast<unsigned long long>(counters.datagrams), static_cast<unsigned long long>(counters.badDatagrams),
+                     static_cast<unsigned long long>(counters.rxpk), static_cast<unsigned long long>(counters.frames),
+                     static_cast<unsigned long long>(counters.fields), static_cast<unsigned long long>(counters.badBase64),
+                     static_cast<unsigned long long>(counters.badFrames), static_cast<unsigned long long>(counters.undecoded));
+        std::fprintf(stderr, "; %llu duplicates, %llu uplinks merged (%llu evicted)", static_cast<unsigned long long>(counters.duplicates),
+                     static_cast<unsigned long long>(counters.merged), static_cast<unsigned long long>(counters.evicted));
+        std::fprintf(stderr, "; %llu rxpk out of range, %llu datagrams of unknown gateways", static_cast<unsigned long long>(counters.rejectedRxpk),
+                     static_cast<unsigned long long>(counters.unknownGateways));
+        if (seconds > 0.0)
+        {
+            std::fprintf(stderr, "; %.0f rxpk/s, %.1f MB/s", counters.rxpk / seconds, counters.bytes / seconds / 1e6);
+        }
+        std::fprintf(stderr, "\n");
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--port") && hasValue)
+            options.port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--batch") && hasValue)
+            options.batch = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--count") && hasValue)
+            options.count = std::strtoull(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--dedup-ms") && hasValue)
+            options.dedupMs = std::strtoull(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--metrics-file") && hasValue)
+            options.metricsFile = argv[++i];
+        else if (!std::strcmp(argv[i], "--metrics-port") && hasValue)
+            options.metricsPort = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--print"))
+            options.print = true;
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--port N] [--batch N] [--count RXPK] [--dedup-ms MS]\n"
+                                 "          [--metrics-file PATH] [--metrics-port N] [--print]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (options.batch == 0 || options.batch > 1024)
+    {
+        std::fprintf(stderr, "--batch must be 1 to 1024\n");
+        return 1;
+    }
+
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const int receiveBuffer = 8 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    // Wake up now and then to notice a stop request while no traffic comes in.
+    const timeval timeout = {0, 200000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (fd < 0 || bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0)
+    {
+        std::perror("bind");
+        return 1;
+    }
+    MetricsEndpoint endpoint;
+    if (options.metricsPort && !endpoint.start(options.metricsPort))
+    {
+        std::fprintf(stderr, "cannot serve metrics on port %u\n", options.metricsPort);
+        return 1;
+    }
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    // One buffer, header and sender address per datagram of a batch.
+    const unsigned batch = options.batch;
+    std::vector<uint8_t> buffers(static_cast<size_t>(batch) * DATAGRAM_SIZE);
+    std::vector<iovec> vectors(batch);
+    std::vector<sockaddr_in> senders(batch);
+    std::vector<mmsghdr> messages(batch);
+    std::vector<uint8_t> acks(static_cast<size_t>(batch) * PUSH_ACK_SIZE);
+    std::vector<iovec> ackVectors(batch);
+    std::vector<mmsghdr> ackMessages(batch);
+    for (unsigned i = 0; i < batch; i++)
+    {
+        vectors[i] = {&buffers[static_cast<size_t>(i) * DATAGRAM_SIZE], DATAGRAM_SIZE};
+    }
+
+    // A datagram holds at most DATAGRAM_SIZE bytes of base64, so the batch always fits.
+    DecodeArena arena(static_cast<size_t>(batch) * getBase64DecodedSize(DATAGRAM_SIZE));
+    UplinkDecoder decoder;
+    DecodedField fields[UplinkDecoder::MAX_FIELDS];
+    Counters counters;
+    Deduplicator deduplicator(options.dedupMs * 1000000);
+    std::vector<uint64_t> gateways;
+    auto retire = [&](const MergedUplink &merged) {
+        counters.merged++;
+        counters.evicted += merged.evicted;
+        if (options.print)
+        {
+            printMerged(gateways, merged);
+        }
+    };
+    bool started = false;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point lastReport = std::chrono::steady_clock::now();
+
+    while (!stopRequested && (options.count == 0 || counters.rxpk < options.count))
+    {
+        for (unsigned i = 0; i < batch; i++)
+        {
+            messages[i].msg_hdr = {};
+            messages[i].msg_hdr.msg_name = &senders[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        const int received = recvmmsg(fd, messages.data(), batch, MSG_WAITFORONE, nullptr);
+        if (received <= 0)
+        {
+            continue;
+        }
+        if (!started)
+        {
+            start = std::chrono::steady_clock::now();
+            started = true;
+        }
+
+        unsigned ackCount = 0;
+        arena.reset();
+        const uint64_t receivedNs = nowNs();
+        for (int m = 0; m < received; m++)
+        {
+            const uint8_t *datagram = static_cast<const uint8_t *>(vectors[m].iov_base);
+            const size_t size = messages[m].msg_len;
+            counters.datagrams++;
+            counters.bytes += size;
+
+            PushDataHeader header;
+            if (!parsePushData(datagram, size, header))
+            {
+                counters.badDatagrams++;
+                continue;
+            }
+            uint8_t *ack = &acks[static_cast<size_t>(ackCount) * PUSH_ACK_SIZE];
+            ackVectors[ackCount] = {ack, writePushAck(header, ack)};
+            ackMessages[ackCount].msg_hdr = {};
+            ackMessages[ackCount].msg_hdr.msg_name = &senders[m];
+            ackMessages[ackCount].msg_hdr.msg_namelen = messages[m].msg_hdr.msg_namelen;
+            ackMessages[ackCount].msg_hdr.msg_iov = &ackVectors[ackCount];
+            ackMessages[ackCount].msg_hdr.msg_iovlen = 1;
+            ackCount++;
+
+            uint8_t gateway;
+            if (!getGatewayIndex(gateways, header.gatewayEui, gateway))
+            {
+                counters.unknownGateways++;
+                continue;
+            }
+            RxpkReader reader(header.json, header.jsonLength);
+            Rxpk rxpk;
+            while (true)
+            {
+                METRICS_BEGIN();
+                if (!reader.next(rxpk))
+                {
+                    break;
+                }
+                METRICS_STAGE(RXPK);
+                counters.rxpk++;
+                const size_t reserved = getBase64DecodedSize(rxpk.dataLength);
+                uint8_t *phy = rxpk.data ? arena.allocate(reserved) : nullptr;
+                const size_t phySize = phy ? decodeBase64(rxpk.data, rxpk.dataLength, phy) : 0;
+                if (phySize == 0)
+                {
+                    counters.badBase64++;
+                    METRICS_OUTCOME(BAD_BASE64);
+                    continue;
+                }
+                arena.shrink(phy, reserved, phySize);
+                METRICS_STAGE(BASE64);
+
+                DataUplink uplink;
+                if (!parseDataUplink(phy, phySize, uplink))
+                {
+                    counters.badFrames++;
+                    METRICS_OUTCOME(NOT_DATA_UPLINK);
+                    continue;
+                }
+                METRICS_STAGE(FRAME);
+                if (options.dedupMs && uplink.hasPort)
+                {
+                    FrameDescriptor copy = {};
+                    copy.payload = uplink.payload;
+                    copy.receivedNs = receivedNs;
+                    copy.devAddr = uplink.devAddr;
+                    copy.size = static_cast<uint16_t>(uplink.size);
+                    copy.fCnt = uplink.fCnt;
+                    copy.rssi = static_cast<int16_t>(std::lround(rxpk.rssi));
+                    copy.snrQuarterDb = static_cast<int8_t>(std::lround(rxpk.lsnr * 4.0f));
+                    copy.fPort = uplink.fPort;
+                    copy.gateway = gateway;
+                    const bool first = deduplicator.observe(copy, retire);
+                    METRICS_STAGE(DEDUP);
+                    if (!first)
+                    {
+                        counters.duplicates++;
+                        METRICS_OUTCOME(DUPLICATE);
+                        continue;
+                    }
+                }
+                const size_t count = uplink.hasPort ? decoder.decode(uplink.fPort, uplink.payload, uplink.size, fields) : 0;
+                METRICS_STAGE(DECODE);
+                if (count == 0)
+                {
+                    counters.undecoded++;
+                    METRICS_OUTCOME(UNDECODED);
+                    continue;
+                }
+                counters.frames++;
+                counters.fields += count;
+                METRICS_OUTCOME(DECODED);
+                for (size_t i = 0; i < count; i++)
+                {
+                    METRICS_FIELD(fields[i].type);
+                }
+                if (options.print)
+                {
+                    printFrame(header, rxpk, uplink, fields, count);
+                }
+            }
+            counters.rejectedRxpk += reader.getRejectedCount();
+            if (reader.failed())
+            {
+                counters.badDatagrams++;
+            }
+        }
+        if (ackCount)
+        {
+            sendmmsg(fd, ackMessages.data(), ackCount, 0);
+        }
+        if (options.dedupMs)
+        {
+            deduplicator.expire(nowNs(), retire);
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastReport > std::chrono::seconds(1))
+        {
+            if (!options.print)
+            {
+                printCounters(counters, std::chrono::duration<double>(now - start).count());
+            }
+            METRICS_PUBLISH();
+            if (!options.metricsFile.empty())
+            {
+                MetricsRegistry::get().writePrometheusFile(options.metricsFile);
+            }
+            lastReport = now;
+        }
+    }
+    close(fd);
+    deduplicator.expire(UINT64_MAX, retire);
+    METRICS_PUBLISH();
+    if (!options.metricsFile.empty() && !MetricsRegistry::get().writePrometheusFile(options.metricsFile))
+    {
+        std::perror(options.metricsFile.c_str());
+    }
+    std::fflush(stdout);
+    printCounters(counters, started ? std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() : 0.0);
+    return 0;
+}
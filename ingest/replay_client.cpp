@@ -0,0 +1,278 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file replay_client.cpp
+ * @brief Plays fleet traffic to the ingest daemon as packet forwarders would.
+ *
+ * Frames come from a corpus written by tools/fleet_gen.cpp or from the fleet generator in
+ * process. Each frame becomes an rxpk with a LoRaWAN data uplink in `data`; the rxpk of one
+ * gateway are collected into PUSH_DATA datagrams, which are sent with sendmmsg(), optionally
+ * paced to a frame rate. PUSH_ACKs are counted, so lost datagrams show. Build and run from the
+ * repository root:
+ *   g++ -std=c++17 -O2 -Iinclude ingest/replay_client.cpp -o replay_client
+ *   ./replay_client --corpus fleet.bin --rate 50000
+ *   ./replay_client --nodes 100000 --frames 1000000
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "LoRaWanFrame.hpp"
+#include "SemtechUdp.hpp"
+#include "../tools/FleetGenerator.hpp"
+
+using namespace INGEST;
+
+namespace
+{
+    const size_t SEND_BATCH = 64;
+    const uint64_t GATEWAY_EUI_BASE = 0xAA555A0000000000ULL;
+
+    struct Options
+    {
+        const char *corpusPath = nullptr;
+        FLEET::FleetConfig fleet;
+        uint64_t frames = 1000000;
+        double rate = 0.0;              ///< Frames per second, 0 for as fast as possible.
+        unsigned perDatagram = 4;       ///< rxpk per PUSH_DATA.
+        uint16_t port = 1700;
+    };
+
+    /**
+     * @brief Source of frames: a corpus file or the generator.
+     */
+    class FrameSource
+    {
+    public:
+        FrameSource(const Options &options) : generator(nullptr), offset(0)
+        {
+            if (options.corpusPath)
+            {
+                FILE *file = std::fopen(options.corpusPath, "rb");
+                if (!file)
+                {
+                    std::perror(options.corpusPath);
+                    std::exit(1);
+                }
+                uint8_t chunk[65536];
+                size_t read;
+                while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+                {
+                    corpus.insert(corpus.end(), chunk, chunk + read);
+                }
+                std::fclose(file);
+            }
+            else
+            {
+                generator = new FLEET::FleetGenerator(options.fleet);
+            }
+        }
+
+        ~FrameSource()
+        {
+            delete generator;
+        }
+
+        bool next(FLEET::FleetFrame &frame)
+        {
+            if (generator)
+            {
+                return generator->next(frame);
+            }
+            const size_t size = FLEET::readFleetRecord(corpus.data() + offset, corpus.size() - offset, frame);
+            offset += size;
+            return size > 0;
+        }
+
+    private:
+        FLEET::FleetGenerator *generator;
+        std::vector<uint8_t> corpus;
+        size_t offset;
+    };
+
+    /**
+     * @brief A PUSH_DATA datagram being filled with rxpk.
+     */
+    struct PendingDatagram
+    {
+        std::vector<uint8_t> bytes;
+        unsigned rxpkCount = 0;
+    };
+
+    void appendRxpk(PendingDatagram &datagram, const FLEET::FleetFrame &frame)
+    {
+        uint8_t phy[FLEET::MAX_PAYLOAD + 13];
+        const size_t phySize = writeDataUplink(frame.devAddr, frame.fCnt, frame.fPort, frame.payload, frame.size, phy);
+        char json[512];
+        json[0] = datagram.rxpkCount ? ',' : '[';
+        const size_t length = writeRxpk(static_cast<uint32_t>(frame.timeUs), frame.spreadingFactor, frame.snrQuarterDb / 4.0f,
+                                        frame.rssi, phy, phySize, json + 1, sizeof(json) - 1);
+        if (!datagram.rxpkCount)
+        {
+            const char *open = "{\"rxpk\":";
+            datagram.bytes.insert(datagram.bytes.end(), open, open + std::strlen(open));
+        }
+        datagram.bytes.insert(datagram.bytes.end(), json, json + 1 + length);
+        datagram.rxpkCount++;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    options.fleet.nodes = 100000;
+    for (int i = 1; i < argc; i++)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--corpus") && hasValue)
+            options.corpusPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--nodes") && hasValue)
+            options.fleet.nodes = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--seed") && hasValue)
+            options.fleet.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--frames") && hasValue)
+            options.frames = std::strtoull(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--rate") && hasValue)
+            options.rate = std::strtod(argv[++i], nullptr);
+        else if (!std::strcmp(argv[i], "--per-datagram") && hasValue)
+            options.perDatagram = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--port") && hasValue)
+            options.port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--corpus FILE | --nodes N --seed N] [--frames N] [--rate FPS] [--per-datagram N] [--port N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (options.perDatagram == 0 || options.perDatagram > 64 || options.fleet.nodes == 0)
+    {
+        std::fprintf(stderr, "--per-datagram must be 1 to 64, --nodes at least 1\n");
+        return 1;
+    }
+
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    // Acknowledgements are only read between send batches.
+    const int receiveBuffer = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0)
+    {
+        std::perror("connect");
+        return 1;
+    }
+
+    FrameSource source(options);
+    std::vector<PendingDatagram> pending(256);
+    std::vector<std::vector<uint8_t>> ready;
+    uint64_t frames = 0;
+    uint64_t datagrams = 0;
+    uint64_t acks = 0;
+    uint16_t token = 0;
+
+    auto receiveAcks = [&](const int flags) {
+        uint8_t ack[16];
+        ssize_t size;
+        while ((size = recv(fd, ack, sizeof(ack), flags)) > 0)
+        {
+            acks += size == PUSH_ACK_SIZE && ack[3] == static_cast<uint8_t>(SEMTECH_IDENTIFIER::PUSH_ACK);
+        }
+    };
+    auto sendReady = [&]() {
+        std::vector<iovec> vectors(ready.size());
+        std::vector<mmsghdr> messages(ready.size());
+        for (size_t i = 0; i < ready.size(); i++)
+        {
+            vectors[i] = {ready[i].data(), ready[i].size()};
+            messages[i].msg_hdr = {};
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        for (size_t sent = 0; sent < ready.size();)
+        {
+            const int count = sendmmsg(fd, messages.data() + sent, static_cast<unsigned>(ready.size() - sent), 0);
+            if (count <= 0)
+            {
+                std::perror("sendmmsg");
+                std::exit(1);
+            }
+            sent += static_cast<size_t>(count);
+        }
+        datagrams += ready.size();
+        ready.clear();
+        receiveAcks(MSG_DONTWAIT);
+    };
+    auto closeDatagram = [&](PendingDatagram &datagram, const uint8_t gateway) {
+        std::vector<uint8_t> bytes(PUSH_DATA_HEADER_SIZE);
+        writePushDataHeader(token++, GATEWAY_EUI_BASE | gateway, bytes.data());
+        bytes.insert(bytes.end(), datagram.bytes.begin(), datagram.bytes.end());
+        bytes.push_back(']');
+        bytes.push_back('}');
+        ready.push_back(std::move(bytes));
+        datagram.bytes.clear();
+        datagram.rxpkCount = 0;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    FLEET::FleetFrame frame;
+    while (frames < options.frames && source.next(frame))
+    {
+        PendingDatagram &datagram = pending[frame.gateway];
+        appendRxpk(datagram, frame);
+        frames++;
+        if (datagram.rxpkCount == options.perDatagram)
+        {
+            closeDatagram(datagram, frame.gateway);
+        }
+        if (ready.size() == SEND_BATCH)
+        {
+            sendReady();
+            if (options.rate > 0.0)
+            {
+                std::this_thread::sleep_until(start + std::chrono::microseconds(static_cast<uint64_t>(frames * 1e6 / options.rate)));
+            }
+        }
+    }
+    for (size_t gateway = 0; gateway < pending.size(); gateway++)
+    {
+        if (pending[gateway].rxpkCount)
+        {
+            closeDatagram(pending[gateway], static_cast<uint8_t>(gateway));
+        }
+    }
+    sendReady();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Give the daemon time to acknowledge the tail.
+    const timeval timeout = {0, 500000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    while (acks < datagrams)
+    {
+        const uint64_t before = acks;
+        receiveAcks(0);
+        if (acks == before)
+        {
+            break;
+        }
+    }
+    close(fd);
+    std::fprintf(stderr, "%llu frames in %llu datagrams, %.2f s, %.0f frames/s; %llu acknowledged\n",
+                 static_cast<unsigned long long>(frames), static_cast<unsigned long long>(datagrams), seconds,
+                 seconds > 0.0 ? frames / seconds : 0.0, static_cast<unsigned long long>(acks));
+    return 0;
+}
@@ -0,0 +1,264 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file stress_queues.cpp
+ * @brief Stress test of the ring queues and the arena pool, meant to run under ThreadSanitizer.
+ *
+ * Producers and consumers hammer small queues with random batch sizes, so the full and empty
+ * paths and the position wrap are taken constantly. Every item is checked for loss, duplication
+ * and per-producer order, and every payload for corruption before its arena is recycled.
+ * Build and run from the repository root:
+ *   g++ -std=c++17 -O1 -g -fsanitize=thread -Iinclude ingest/stress_queues.cpp -o stress_queues -pthread
+ *   ./stress_queues [items per producer]
+ * Exits with 1 on the first failed check; ThreadSanitizer reports races on its own.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include "FrameDescriptor.hpp"
+#include "RingQueue.hpp"
+
+using namespace INGEST;
+
+namespace
+{
+    std::atomic<bool> failed(false);
+
+    void check(const bool condition, const char *what)
+    {
+        if (!condition && !failed.exchange(true))
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what);
+        }
+    }
+
+    struct Item
+    {
+        uint32_t producer;
+        uint32_t sequence;
+    };
+
+    bool stressSpsc(const uint32_t items)
+    {
+        SpscQueue<Item, 64> queue;
+        std::thread producer([&] {
+            std::mt19937 random(1);
+            Item batch[24];
+            uint32_t next = 0;
+            while (next < items)
+            {
+                const size_t count = 1 + random() % 24;
+                size_t filled = 0;
+                for (; filled < count && next + filled < items; filled++)
+                {
+                    batch[filled] = {0, static_cast<uint32_t>(next + filled)};
+                }
+                next += static_cast<uint32_t>(queue.pushBatch(batch, filled));
+            }
+        });
+        std::mt19937 random(2);
+        Item batch[24];
+        uint32_t expected = 0;
+        while (expected < items && !failed)
+        {
+            const size_t popped = queue.popBatch(batch, 1 + random() % 24);
+            for (size_t i = 0; i < popped; i++)
+            {
+                check(batch[i].sequence == expected++, "SPSC order");
+            }
+        }
+        producer.join();
+        check(queue.getSize() == 0, "SPSC empty at the end");
+        return !failed;
+    }
+
+    bool stressMpmc(const uint32_t items, const unsigned producers, const unsigned consumers)
+    {
+        MpmcQueue<Item, 64> queue;
+        std::vector<std::atomic<uint8_t>> seen(static_cast<size_t>(items) * producers);
+        std::atomic<uint64_t> consumed(0);
+        std::vector<std::thread> threads;
+        for (unsigned p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&, p] {
+                std::mt19937 random(10 + p);
+                Item batch[16];
+                uint32_t next = 0;
+                while (next < items)
+                {
+                    const size_t count = 1 + random() % 16;
+                    size_t filled = 0;
+                    for (; filled < count && next + filled < items; filled++)
+                    {
+                        batch[filled] = {p, static_cast<uint32_t>(next + filled)};
+                    }
+                    const size_t pushed = queue.pushBatch(batch, filled);
+                    next += static_cast<uint32_t>(pushed);
+                    if (pushed == 0)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (unsigned c = 0; c < consumers; c++)
+        {
+            threads.emplace_back([&, c] {
+                std::mt19937 random(20 + c);
+                std::vector<int64_t> last(producers, -1);
+                Item batch[16];
+                while (consumed.load() < static_cast<uint64_t>(items) * producers && !failed)
+                {
+                    const size_t popped = queue.popBatch(batch, 1 + random() % 16);
+                    for (size_t i = 0; i < popped; i++)
+                    {
+                        const Item &item = batch[i];
+                        check(item.producer < producers && item.sequence < items, "MPMC item in range");
+                        if (failed)
+                        {
+                            return;
+                        }
+                        // A consumer claims positions in order, so it sees each producer in order.
+                        check(static_cast<int64_t>(item.sequence) > last[item.producer], "MPMC per-producer order");
+                        last[item.producer] = item.sequence;
+                        check(seen[static_cast<size_t>(item.producer) * items + item.sequence].fetch_add(1) == 0, "MPMC duplicate");
+                    }
+                    consumed += popped;
+                    if (popped == 0)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        check(consumed.load() == static_cast<uint64_t>(items) * producers, "MPMC count");
+        return !failed;
+    }
+
+    // Producers fill arenas with payloads carrying their own checksum; consumers verify them and release.
+    bool stressArenas(const uint32_t frames, const unsigned producers, const unsigned consumers)
+    {
+        ArenaPool<8> pool(512);
+        MpmcQueue<FrameDescriptor, 32> queue;
+        std::atomic<uint64_t> consumed(0);
+        std::vector<std::thread> threads;
+        for (unsigned p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&, p] {
+                std::mt19937 random(30 + p);
+                uint32_t produced = 0;
+                while (produced < frames && !failed)
+                {
+                    SharedArena *arena = pool.acquire();
+                    if (!arena)
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    FrameDescriptor batch[8];
+                    size_t count = 0;
+                    while (count < 8 && produced + count < frames)
+                    {
+                        const uint16_t size = static_cast<uint16_t>(2 + random() % 60);
+                        uint8_t *payload = arena->allocate(size);
+                        if (!payload)
+                        {
+                            break;
+                        }
+                        uint8_t sum = 0;
+                        for (uint16_t i = 1; i < size; i++)
+                        {
+                            payload[i] = static_cast<uint8_t>(random());
+                            sum = static_cast<uint8_t>(sum + payload[i]);
+                        }
+                        payload[0] = sum;
+                        FrameDescriptor &descriptor = batch[count++];
+                        descriptor = FrameDescriptor();
+                        descriptor.arena = arena;
+                        descriptor.payload = payload;
+                        descriptor.size = size;
+                        descriptor.devAddr = p;
+                    }
+                    arena->retain(static_cast<uint32_t>(count));
+                    for (size_t sent = 0; sent < count && !failed;)
+                    {
+                        const size_t pushed = queue.pushBatch(batch + sent, count - sent);
+                        sent += pushed;
+                        if (pushed == 0)
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                    produced += static_cast<uint32_t>(count);
+                    pool.release(arena);
+                }
+            });
+        }
+        for (unsigned c = 0; c < consumers; c++)
+        {
+            threads.emplace_back([&] {
+                FrameDescriptor batch[8];
+                while (consumed.load() < static_cast<uint64_t>(frames) * producers && !failed)
+                {
+                    const size_t popped = queue.popBatch(batch, 8);
+                    for (size_t i = 0; i < popped; i++)
+                    {
+                        uint8_t sum = 0;
+                        for (uint16_t b = 1; b < batch[i].size; b++)
+                        {
+                            sum = static_cast<uint8_t>(sum + batch[i].payload[b]);
+                        }
+                        check(sum == batch[i].payload[0], "arena payload intact");
+                        pool.release(batch[i].arena);
+                    }
+                    consumed += popped;
+                    if (popped == 0)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        check(pool.getFreeCount() == 8, "all arenas recycled");
+        return !failed;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const uint32_t items = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 200000;
+    struct
+    {
+        const char *name;
+        bool passed;
+    } results[] = {
+        {"SPSC 1:1", stressSpsc(items)},
+        {"MPMC 1:3", stressMpmc(items, 1, 3)},
+        {"MPMC 3:1", stressMpmc(items, 3, 1)},
+        {"MPMC 4:4", stressMpmc(items, 4, 4)},
+        {"arena pool 2:3", stressArenas(items / 4, 2, 3)},
+    };
+    for (const auto &result : results)
+    {
+        std::printf("%-16s %s\n", result.name, result.passed ? "PASS" : "FAIL");
+    }
+    return failed ? 1 : 0;
+}
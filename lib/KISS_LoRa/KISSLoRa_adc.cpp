@@ -0,0 +1,69 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#include "KISSLoRa_adc.h"
+
+//ATmega32U4 datasheet, 24.7: ADC Noise Canceler
+//ATmega32U4 datasheet, 24.9.2: ADC Multiplexer Selection Register
+
+#include <avr/power.h>
+#include <avr/sleep.h>
+#include <avr/interrupt.h>
+#include <Arduino.h>
+
+static volatile uint8_t conversionDone = 0;  // ADC vector flag
+
+// adc conversion complete service routine
+ISR(ADC_vect) {
+ conversionDone = 1;
+}
+
+//! \brief returns the MUX5:0 value of an analog input, numbered like analogRead() does
+uint8_t KISSLoRa_adc_pin_channel(uint8_t pin){
+  if (pin >= 18) {
+    pin -= 18; // allow for channel or pin numbers
+  }
+  const uint8_t adc = analogPinToChannel(pin);
+  return adc < 8 ? adc : 0x20 | (adc - 8); // ADC8-13 have MUX5 set
+}
+
+//! \brief selects the input of the following conversions, with AVcc as reference;
+//! waits for the bandgap to settle and discards the first conversion after the switch
+void KISSLoRa_adc_select(uint8_t channel){
+  power_adc_enable();
+  ADCSRA |= (1<<ADEN);
+  ADCSRB = (ADCSRB & ~(1<<MUX5)) | (((channel >> 5) & 0x01) << MUX5);
+  ADMUX = (1<<REFS0) | (channel & 0x1F);
+  if (channel == KISSLORA_ADC_BANDGAP) {
+    delayMicroseconds(1000);
+  }
+  KISSLoRa_adc_read();
+}
+
+//! \brief one 10 bit conversion of the selected input in ADC Noise Reduction sleep mode:
+//! the CPU and the IO clock stop while it runs, so digital switching noise stays off the ADC.
+//! timer0 stops too; millis() falls behind by one conversion time per call.
+uint16_t KISSLoRa_adc_read(void){
+  conversionDone = 0;
+  ADCSRA |= (1<<ADIE);
+  set_sleep_mode(SLEEP_MODE_ADC);
+  sleep_enable();
+  while (!conversionDone) {
+    // entering the mode starts the conversion; another interrupt may wake the CPU first, the conversion goes on
+    cli();
+    if (!conversionDone) {
+      sei();
+      sleep_cpu();
+    }
+    sei();
+  }
+  sleep_disable();
+  ADCSRA &= ~(1<<ADIE);
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  return ADC;
+}
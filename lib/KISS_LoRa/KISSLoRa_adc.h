@@ -0,0 +1,24 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+// ADC conversions in ADC Noise Reduction sleep mode for KISSLoRa
+
+#ifndef KISSLoRa_adc_h
+#define KISSLoRa_adc_h 1
+
+#include <stdint.h>
+
+#define KISSLORA_ADC_BANDGAP 0x1E // MUX5:0 of the internal 1.1V bandgap
+
+uint8_t KISSLoRa_adc_pin_channel(uint8_t pin);
+
+void KISSLoRa_adc_select(uint8_t channel);
+
+uint16_t KISSLoRa_adc_read(void);
+
+#endif
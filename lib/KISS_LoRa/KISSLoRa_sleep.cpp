@@ -79,6 +79,38 @@ static long timeSleep = 0;  // total time due to sleep
 static float calibv = 0.93; // ratio of real clock with WDT clock
 static volatile uint8_t isrcalled = 0;  // WDT vector flag
 
+static uint8_t wakePinCount = 0;                         // pins registered with KISSLoRa_sleep_wake_on_pin()
+static uint8_t wakePins[KISSLORA_WAKE_PINS];             // active low
+static uint8_t wakePinSources[KISSLORA_WAKE_PINS];       // source mask of each pin
+static volatile uint8_t wakeSources = 0;                 // sources of the pins that went low, until taken
+
+// Internal function: latch the sources of every wake pin that is low.
+// External interrupts are level triggered, the only trigger that wakes INT0-3 from power down,
+// so they are detached until the pin is released again.
+static void wakePinISR(void)
+{
+ for (uint8_t i = 0; i < wakePinCount; i++) {
+   if (digitalRead(wakePins[i]) == LOW) {
+     wakeSources |= wakePinSources[i];
+     if (digitalPinToInterrupt(wakePins[i]) != NOT_AN_INTERRUPT) {
+       detachInterrupt(digitalPinToInterrupt(wakePins[i]));
+     }
+   }
+ }
+}
+
+// Internal function: attach the external interrupt of every released wake pin.
+// Pin change interrupts stay enabled, they fire on both edges.
+static void armWakePins(void)
+{
+ for (uint8_t i = 0; i < wakePinCount; i++) {
+   const uint8_t interrupt = digitalPinToInterrupt(wakePins[i]);
+   if (interrupt != NOT_AN_INTERRUPT && digitalRead(wakePins[i]) == HIGH) {
+     attachInterrupt(interrupt, wakePinISR, LOW);
+   }
+ }
+}
+
 // Internal function: Start watchdog timer
 // byte psVal - Prescale mask
 static void WDT_On (uint8_t psVal)
@@ -110,13 +142,13 @@ static void WDT_Off() {
  sei();
 }
 
-// internal function.  
+// internal function.  Returns early, with the time not slept, when a wake pin fired
 static int doSleep(long timeRem) {
  uint8_t WDTps = 9;  // WDT Prescaler value, 9 = 8192ms
 
  isrcalled = 0;
  sleep_enable();
- while(timeRem > 0) {
+ while(timeRem > 0 && !wakeSources) {
    //work out next prescale unit to use
    while ((0x10<<WDTps) > timeRem && WDTps > 0) {
      WDTps--;
@@ -124,11 +156,21 @@ static int doSleep(long timeRem) {
    // send prescaler mask to WDT_On
    WDT_On((WDTps & 0x08 ? (1<<WDP3) : 0x00) | (WDTps & 0x07));
    isrcalled=0;
-   while (isrcalled==0) {
+   while (isrcalled==0 && !wakeSources) {
      // turn bod off
       // MCUCR |= (1<<BODS) | (1<<BODSE);
      //MCUCR &= ~(1<<BODSE);  // must be done right before sleep
-     sleep_cpu();  // sleep here
+     cli();
+     if (isrcalled==0 && !wakeSources) {
+       sei();        // takes effect after the next instruction, so an interrupt pending now still wakes the CPU
+       sleep_cpu();  // sleep here
+     }
+     sei();
+   }
+   if (isrcalled==0) {
+     // woken by a wake pin: the part of this prescale unit that passed is not counted
+     WDT_Off();
+     break;
    }
    // calculate remaining time
    timeRem -= (0x10<<WDTps);
@@ -175,9 +217,10 @@ ISR(WDT_vect) {
  isrcalled=1;
 }
 
-//ISR(PCINT0_vect){
-//  LORA_LED_PORT ^= LORA_LED_BIT;  
-//}
+// pin change int service routine, shared by all wake pins on port B
+ISR(PCINT0_vect) {
+ wakePinISR();
+}
 
 
 /*
@@ -265,7 +308,9 @@ void KISSLoRa_sleep_init(void){
 }
 
 //! \brief powers down peripherals and puts microcontroller in power down sleep mode, wakes up on watchdog timer
+//! or, before delay_ms passed, on a wake pin. millis() does not advance while powered down.
 void KISSLoRa_sleep_delay_ms(long delay_ms){
+  armWakePins();
   power_usb_disable();  
   power_timer0_disable();
   power_timer1_disable();
@@ -293,3 +338,54 @@ void KISSLoRa_sleep_delay_ms(long delay_ms){
   power_twi_enable();
 }
 
+//! \brief puts microcontroller in idle sleep until delay_ms passed or a wake pin fired;
+//! timer0, USB and the UARTs keep running, so millis() and the debug port keep working
+void KISSLoRa_sleep_idle_ms(long delay_ms){
+  armWakePins();
+  const unsigned long start = millis();
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_enable();
+  while ((long)(millis() - start) < delay_ms) {
+    cli();
+    if (wakeSources) {
+      sei();
+      break;
+    }
+    sei();
+    sleep_cpu();  // the timer0 overflow wakes the CPU at least every few ms
+  }
+  sleep_disable();
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+}
+
+//! \brief wakes the microcontroller from KISSLoRa_sleep_delay_ms() and KISSLoRa_sleep_idle_ms() when pin goes low
+//! \param pin arduino pin with an external (INT) or pin change (PCINT) interrupt
+//! \param sources mask returned by KISSLoRa_sleep_take_wake_sources() when the pin went low
+//! \return false if the pin has no interrupt or KISSLORA_WAKE_PINS pins are registered already
+bool KISSLoRa_sleep_wake_on_pin(uint8_t pin, uint8_t sources){
+  const bool external = digitalPinToInterrupt(pin) != NOT_AN_INTERRUPT;
+  if (wakePinCount >= KISSLORA_WAKE_PINS || (!external && digitalPinToPCICR(pin) == 0)) {
+    return false;
+  }
+  cli();
+  wakePins[wakePinCount] = pin;
+  wakePinSources[wakePinCount] = sources;
+  wakePinCount++;
+  if (!external) {
+    *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+    *digitalPinToPCICR(pin) |= _BV(digitalPinToPCICRbit(pin));
+  }
+  sei();
+  armWakePins();
+  return true;
+}
+
+//! \brief returns the sources of the wake pins that went low since the last call, and clears them
+uint8_t KISSLoRa_sleep_take_wake_sources(void){
+  const uint8_t oldSREG = SREG;
+  cli();
+  const uint8_t sources = wakeSources;
+  wakeSources = 0;
+  SREG = oldSREG;
+  return sources;
+}
@@ -9,10 +9,20 @@ Purpose  : sleep functions for KISSLoRa
 #ifndef KISSLoRa_sleep_h
 #define KISSLoRa_sleep_h 1
 
+#include <stdint.h>
+
+#define KISSLORA_WAKE_PINS 4 // pins that can be registered with KISSLoRa_sleep_wake_on_pin()
+
 //void sleep_test(void);
 
 void KISSLoRa_sleep_init(void);
 
 void KISSLoRa_sleep_delay_ms(long delay_ms);
 
+void KISSLoRa_sleep_idle_ms(long delay_ms);
+
+bool KISSLoRa_sleep_wake_on_pin(uint8_t pin, uint8_t sources);
+
+uint8_t KISSLoRa_sleep_take_wake_sources(void);
+
 #endif
@@ -0,0 +1,153 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file Arduino.h
+ * @brief Host replacement of the Arduino core used by src/main.cpp, running on the virtual clock.
+ */
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "Simulator.hpp"
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define F(string) (string)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+/**
+ * @brief Serial port. The debug port models a 64-byte transmit buffer draining at 9600 baud and
+ * captures its output; the LoRa modem port is a sink, TheThingsNetwork is mocked above it.
+ */
+class HardwareSerial
+{
+public:
+    explicit HardwareSerial(const bool debugPort) : debugPort(debugPort) {}
+
+    void begin(unsigned long) {}
+    explicit operator bool() const { return true; }
+    int available() { return 0; }
+    int read() { return -1; }
+
+    int availableForWrite()
+    {
+        return debugPort ? static_cast<int>(SIM::Simulator::DEBUG_TX_BUFFER - SIM::simulator().debugQueued()) : 64;
+    }
+
+    size_t write(const uint8_t value)
+    {
+        if (debugPort)
+        {
+            SIM::simulator().debugWrite(value);
+        }
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, const size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            write(buffer[i]);
+        }
+        return size;
+    }
+
+    size_t print(const char *text) { return write(reinterpret_cast<const uint8_t *>(text), strlen(text)); }
+    size_t print(const long value) { return printFormatted("%ld", value); }
+    size_t print(const unsigned long value) { return printFormatted("%lu", value); }
+    size_t print(const int value) { return print(static_cast<long>(value)); }
+    size_t print(const unsigned int value) { return print(static_cast<unsigned long>(value)); }
+    size_t print(const double value) { return printFormatted("%.2f", value); }
+    template <typename T>
+    size_t println(const T value) { return print(value) + println(); }
+    size_t println() { return print("\r\n"); }
+
+private:
+    bool debugPort;
+
+    template <typename T>
+    size_t printFormatted(const char *format, const T value)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), format, value);
+        return print(text);
+    }
+};
+
+typedef HardwareSerial Stream;
+
+inline HardwareSerial Serial(true);     ///< USB serial, the debug port of the KISS node.
+inline HardwareSerial Serial1(false);   ///< UART to the RN2483.
+
+inline unsigned long micros()
+{
+    return static_cast<unsigned long>(SIM::simulator().nowUs);
+}
+
+inline unsigned long millis()
+{
+    return static_cast<unsigned long>(SIM::simulator().nowUs / 1000);
+}
+
+inline void delay(const unsigned long ms)
+{
+    SIM::simulator().advance(SIM::Activity::ACT_IDLE, static_cast<uint64_t>(ms) * 1000);
+}
+
+inline void delayMicroseconds(const unsigned int us)
+{
+    SIM::simulator().advance(SIM::Activity::ACT_IDLE, us);
+}
+
+/**
+ * @brief INPUT_PULLUP pulls an input high until something drives it low.
+ */
+inline void pinMode(const uint8_t pin, const uint8_t mode)
+{
+    if (mode == INPUT_PULLUP && pin < SIM::Simulator::PIN_COUNT)
+    {
+        SIM::simulator().pinLevel[pin] = HIGH;
+    }
+}
+
+inline void digitalWrite(const uint8_t pin, const uint8_t level)
+{
+    if (pin < SIM::Simulator::PIN_COUNT)
+    {
+        SIM::simulator().pinLevel[pin] = level ? HIGH : LOW;
+    }
+}
+
+inline int digitalRead(const uint8_t pin)
+{
+    return pin < SIM::Simulator::PIN_COUNT ? SIM::simulator().pinLevel[pin] : LOW;
+}
+
+/**
+ * @brief Every analog pin reads the light sensor: 13 ADC clocks at 125 kHz, with the noise of a
+ * running CPU.
+ */
+inline int analogRead(uint8_t)
+{
+    SIM::Simulator &simulator = SIM::simulator();
+    simulator.advance(SIM::Activity::ACT_ADC, 104);
+    return simulator.convert(simulator.environment.lightAdc, simulator.environment.adcNoiseLsb);
+}
+
+#endif // SIM_ARDUINO_H
@@ -0,0 +1,61 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file KISSLoRa_adc.h
+ * @brief Host replacement of lib/KISS_LoRa/KISSLoRa_adc: conversions with the lower noise of
+ * ADC Noise Reduction sleep.
+ *
+ * The bandgap channel reads the bandgap against the RN2483 supply, any other channel the light
+ * sensor, like analogRead().
+ */
+
+#ifndef KISSLoRa_adc_h
+#define KISSLoRa_adc_h 1
+
+#include <stdint.h>
+#include "Simulator.hpp"
+
+#define KISSLORA_ADC_BANDGAP 0x1E
+
+namespace SIM
+{
+    inline uint8_t &selectedAdcChannel()
+    {
+        static uint8_t channel = 0;
+        return channel;
+    }
+} // namespace SIM
+
+inline uint8_t KISSLoRa_adc_pin_channel(const uint8_t pin)
+{
+    return pin;
+}
+
+inline uint16_t KISSLoRa_adc_read(void)
+{
+    SIM::Simulator &simulator = SIM::simulator();
+    simulator.advance(SIM::Activity::ACT_ADC, 104);
+    const SIM::Environment &environment = simulator.environment;
+    const float level = SIM::selectedAdcChannel() == KISSLORA_ADC_BANDGAP
+                            ? 1023.0f * environment.bandgapMv / environment.vddMv
+                            : environment.lightAdc;
+    return simulator.convert(level, environment.adcQuietNoiseLsb);
+}
+
+inline void KISSLoRa_adc_select(const uint8_t channel)
+{
+    SIM::selectedAdcChannel() = channel;
+    if (channel == KISSLORA_ADC_BANDGAP)
+    {
+        SIM::simulator().advance(SIM::Activity::ACT_ADC, 1000);
+    }
+    KISSLoRa_adc_read();
+}
+
+#endif // KISSLoRa_adc_h
@@ -0,0 +1,70 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file KISSLoRa_sleep.h
+ * @brief Host replacement of lib/KISS_LoRa/KISSLoRa_sleep, sleeping on the virtual clock.
+ *
+ * Sleeping lets virtual time pass until the deadline or until a stimulus pulls an armed wake
+ * pin low. Wake pins are armed when a sleep starts and the pin is high, and disarmed when they
+ * fire, like the level interrupts of the library. The virtual clock keeps millis() running in
+ * both sleep modes.
+ */
+
+#ifndef KISSLoRa_sleep_h
+#define KISSLoRa_sleep_h 1
+
+#include <stdint.h>
+#include "Simulator.hpp"
+
+#define KISSLORA_WAKE_PINS 4
+
+inline void KISSLoRa_sleep_init(void) {}
+
+/**
+ * @brief Sleeps until delay_ms passed or a wake pin fired.
+ */
+inline void KISSLoRa_sleep_idle_ms(const long delay_ms)
+{
+    SIM::Simulator &simulator = SIM::simulator();
+    for (SIM::WakePin &wakePin : simulator.wakePins)
+    {
+        wakePin.armed = wakePin.armed || simulator.pinLevel[wakePin.pin];
+    }
+    const uint64_t deadlineUs = simulator.nowUs + static_cast<uint64_t>(delay_ms > 0 ? delay_ms : 0) * 1000;
+    while (!simulator.wakeSources && simulator.nowUs < deadlineUs)
+    {
+        const uint64_t nextUs = simulator.nextStimulusUs();
+        simulator.advance(SIM::Activity::ACT_SLEEP, (nextUs < deadlineUs ? nextUs : deadlineUs) - simulator.nowUs);
+    }
+}
+
+inline void KISSLoRa_sleep_delay_ms(const long delay_ms)
+{
+    KISSLoRa_sleep_idle_ms(delay_ms);
+}
+
+inline bool KISSLoRa_sleep_wake_on_pin(const uint8_t pin, const uint8_t sources)
+{
+    SIM::Simulator &simulator = SIM::simulator();
+    if (simulator.wakePins.size() >= KISSLORA_WAKE_PINS || pin >= SIM::Simulator::PIN_COUNT)
+    {
+        return false;
+    }
+    simulator.wakePins.push_back(SIM::WakePin{pin, sources, simulator.pinLevel[pin] != 0});
+    return true;
+}
+
+inline uint8_t KISSLoRa_sleep_take_wake_sources(void)
+{
+    const uint8_t sources = SIM::simulator().wakeSources;
+    SIM::simulator().wakeSources = 0;
+    return sources;
+}
+
+#endif // KISSLoRa_sleep_h
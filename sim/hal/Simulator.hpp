@@ -0,0 +1,332 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file Simulator.hpp
+ * @brief State of the simulated KISS node: virtual clock, environment, captured traffic.
+ *
+ * The mocked Arduino, Wire, TheThingsNetwork and Weather headers in this folder read their
+ * inputs from here and charge the time every call would take on the node to the virtual clock,
+ * booked per activity, so a loop() iteration can be broken down afterwards.
+ */
+
+#ifndef SIM_SIMULATOR_HPP
+#define SIM_SIMULATOR_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace SIM
+{
+    /**
+     * @brief What the node spends virtual time on.
+     */
+    enum class Activity : uint8_t
+    {
+        ACT_SI7021      = 0,    /* Temperature/humidity conversions, including the library's fixed wait. */
+        ACT_I2C         = 1,    /* Wire transfers at 100 kHz. */
+        ACT_ADC         = 2,    /* analogRead conversions. */
+        ACT_RADIO       = 3,    /* RN2483 UART commands, time on air and receive windows. */
+        ACT_DEBUG       = 4,    /* Waiting for room in the debug serial transmit buffer. */
+        ACT_IDLE        = 5,    /* delay(). */
+        ACT_SLEEP       = 6,    /* KISSLoRa_sleep_*(), until the deadline or a wake pin. */
+        ACT_COUNT       = 7
+    };
+
+    const static char *const ACTIVITY_NAMES[] = {"si7021", "i2c", "adc", "radio", "debug", "idle", "sleep"};
+
+    /**
+     * @brief Sensor readings the mocked hardware reports.
+     */
+    struct Environment
+    {
+        float temperature = 21.0f;              ///< Degrees Celsius.
+        float humidity = 45.0f;                 ///< %RH.
+        float lightAdc = 200.0f;                ///< Light sensor voltage in 10-bit ADC steps, before noise.
+        float adcNoiseLsb = 2.0f;               ///< RMS noise of a conversion with the CPU running.
+        float adcQuietNoiseLsb = 0.6f;          ///< RMS noise of a conversion in ADC Noise Reduction sleep.
+        uint16_t bandgapMv = 1100;              ///< Internal bandgap of the MCU.
+        uint8_t rotary = 0;                     ///< Rotary switch position, 0 - 9.
+        int16_t acceleration[3] = {0, 0, 1024}; ///< Resting 12-bit accelerometer counts per axis.
+        int16_t vibration = 0;                  ///< Amplitude in counts of a 10 Hz vibration on every axis.
+        uint16_t vddMv = 3300;                  ///< RN2483 supply.
+    };
+
+    /**
+     * @brief One uplink captured from TheThingsNetwork::sendBytes().
+     */
+    struct Uplink
+    {
+        uint64_t timeUs;                ///< Virtual time the command was issued.
+        uint8_t port;                   ///< FPort.
+        uint8_t spreadingFactor;        ///< SF requested, 0 for the modem default.
+        uint32_t timeOnAirUs;           ///< Time on air of the frame.
+        std::vector<uint8_t> payload;   ///< Application payload.
+    };
+
+    /**
+     * @brief A downlink delivered in the receive window of a future uplink.
+     */
+    struct Downlink
+    {
+        size_t afterUplink;             ///< Delivered after this many uplinks were captured.
+        uint8_t port;                   ///< FPort.
+        std::vector<uint8_t> payload;   ///< Application payload.
+    };
+
+    /**
+     * @brief Something that happens to the node at a virtual time, e.g. a button press.
+     */
+    struct Stimulus
+    {
+        uint64_t timeUs;
+        std::function<void()> apply;
+    };
+
+    /**
+     * @brief A pin registered with KISSLoRa_sleep_wake_on_pin().
+     */
+    struct WakePin
+    {
+        uint8_t pin;
+        uint8_t sources;                ///< Latched when the pin is low while armed.
+        bool armed;                     ///< Cleared when it fires, like the detached level interrupt.
+    };
+
+    /**
+     * @brief Register-level model of an I2C device.
+     */
+    class I2cDevice
+    {
+    public:
+        virtual ~I2cDevice() = default;
+        virtual uint8_t readRegister(uint8_t reg) = 0;
+        virtual void writeRegister(uint8_t reg, uint8_t value) = 0;
+    };
+
+    /**
+     * @brief The whole simulated node.
+     */
+    struct Simulator
+    {
+        static const uint8_t PIN_COUNT = 32;
+        static const uint16_t DEBUG_TX_BUFFER = 64;     ///< Bytes the debug serial port buffers.
+        static const uint32_t DEBUG_BAUD = 9600;
+
+        uint64_t nowUs = 0;
+        uint64_t spentUs[static_cast<size_t>(Activity::ACT_COUNT)] = {};
+        Environment environment;
+        uint8_t pinLevel[PIN_COUNT] = {};
+        std::vector<Uplink> uplinks;
+        std::deque<Downlink> downlinks;
+        std::vector<uint8_t> debugOutput;       ///< Everything written to the debug serial port.
+        uint64_t debugTxEmptyUs = 0;            ///< Virtual time the debug transmit buffer runs empty.
+        I2cDevice *i2cDevices[128] = {};
+        std::deque<Stimulus> stimuli;           ///< Pending, in time order.
+        std::vector<WakePin> wakePins;
+        uint8_t wakeSources = 0;                ///< Sources latched by wake pins, until taken.
+        std::mt19937 adcRandom{1};              ///< Noise of the ADC, seeded so runs repeat.
+
+        /**
+         * @brief One 10-bit conversion of a level in ADC steps with gaussian noise.
+         */
+        uint16_t convert(const float level, const float noiseLsb)
+        {
+            std::normal_distribution<float> noise(0.0f, noiseLsb);
+            const long code = std::lround(level + noise(adcRandom));
+            return static_cast<uint16_t>(code < 0 ? 0 : (code > 1023 ? 1023 : code));
+        }
+
+        /**
+         * @brief Lets virtual time pass, booked on an activity. Stimuli due meanwhile are applied
+         * at their time, and wake pins they pull low are latched, as their interrupt would.
+         */
+        void advance(const Activity activity, const uint64_t us)
+        {
+            const uint64_t endUs = nowUs + us;
+            while (!stimuli.empty() && stimuli.front().timeUs <= endUs)
+            {
+                const Stimulus stimulus = stimuli.front();
+                stimuli.pop_front();
+                book(activity, stimulus.timeUs > nowUs ? stimulus.timeUs - nowUs : 0);
+                stimulus.apply();
+                latchWakePins();
+            }
+            book(activity, endUs - nowUs);
+        }
+
+        /**
+         * @brief Schedules a stimulus; stimuli at the same time apply in scheduling order.
+         */
+        void schedule(const uint64_t timeUs, std::function<void()> apply)
+        {
+            auto position = stimuli.end();
+            while (position != stimuli.begin() && (position - 1)->timeUs > timeUs)
+            {
+                --position;
+            }
+            stimuli.insert(position, Stimulus{timeUs, std::move(apply)});
+        }
+
+        /**
+         * @brief Virtual time of the next stimulus, UINT64_MAX if none is scheduled.
+         */
+        uint64_t nextStimulusUs() const
+        {
+            return stimuli.empty() ? UINT64_MAX : stimuli.front().timeUs;
+        }
+
+        /**
+         * @brief Latches the sources of armed wake pins that are low, and disarms them.
+         */
+        void latchWakePins()
+        {
+            for (WakePin &wakePin : wakePins)
+            {
+                if (wakePin.armed && !pinLevel[wakePin.pin])
+                {
+                    wakeSources |= wakePin.sources;
+                    wakePin.armed = false;
+                }
+            }
+        }
+
+        /**
+         * @brief Bytes still waiting in the debug transmit buffer.
+         */
+        uint32_t debugQueued() const
+        {
+            if (debugTxEmptyUs <= nowUs)
+            {
+                return 0;
+            }
+            const uint64_t byteUs = 10000000ULL / DEBUG_BAUD;
+            return static_cast<uint32_t>((debugTxEmptyUs - nowUs + byteUs - 1) / byteUs);
+        }
+
+        /**
+         * @brief Queues one byte on the debug serial port, waiting for room if the buffer is full.
+         */
+        void debugWrite(const uint8_t byte)
+        {
+            const uint64_t byteUs = 10000000ULL / DEBUG_BAUD;
+            if (debugQueued() >= DEBUG_TX_BUFFER)
+            {
+                advance(Activity::ACT_DEBUG, debugTxEmptyUs - (DEBUG_TX_BUFFER - 1) * byteUs - nowUs);
+            }
+            debugTxEmptyUs = (debugTxEmptyUs > nowUs ? debugTxEmptyUs : nowUs) + byteUs;
+            debugOutput.push_back(byte);
+        }
+
+    private:
+        void book(const Activity activity, const uint64_t us)
+        {
+            nowUs += us;
+            spentUs[static_cast<size_t>(activity)] += us;
+        }
+    };
+
+    /**
+     * @brief The simulator instance shared by all mocked peripherals.
+     */
+    inline Simulator &simulator()
+    {
+        static Simulator instance;
+        return instance;
+    }
+
+    /**
+     * @brief FXLS8471Q accelerometer: who-am-i, control registers, 12-bit output registers and the
+     * transient (high-pass filtered motion) interrupt on INT1, active low.
+     */
+    class Fxls8471q : public I2cDevice
+    {
+    public:
+        explicit Fxls8471q(const uint8_t interruptPin) : interruptPin(interruptPin)
+        {
+            simulator().pinLevel[interruptPin] = 1;
+        }
+
+        uint8_t readRegister(const uint8_t reg) override
+        {
+            if (reg == 0x0D)
+            {
+                return 0x6A;
+            }
+            if (reg == 0x1E)
+            {
+                // Reading TRANSIENT_SRC clears the event and releases INT1.
+                const uint8_t source = registers[reg];
+                registers[0x1E] = 0;
+                registers[0x0C] &= static_cast<uint8_t>(~0x20);
+                simulator().pinLevel[interruptPin] = 1;
+                return source;
+            }
+            if (reg >= 0x01 && reg <= 0x06)
+            {
+                const int16_t counts = sample((reg - 1) / 2);
+                const uint16_t left = static_cast<uint16_t>(counts) << 4;
+                return reg % 2 ? static_cast<uint8_t>(left >> 8) : static_cast<uint8_t>(left);
+            }
+            return registers[reg];
+        }
+
+        void writeRegister(const uint8_t reg, const uint8_t value) override
+        {
+            registers[reg] = value;
+        }
+
+        /**
+         * @brief A shake with the given peak acceleration on every axis. If transient detection is
+         * set up (TRANSIENT_CFG, CTRL_REG4, CTRL_REG5 routing it to INT1) and the peak exceeds the
+         * TRANSIENT_THS threshold, the event is latched and INT1 is pulled low until TRANSIENT_SRC is read.
+         */
+        void shake(const uint16_t peakMg)
+        {
+            const uint8_t config = registers[0x1D];
+            if (!(registers[0x2A] & 0x01) || !(config & 0x0E) || peakMg <= (registers[0x1F] & 0x7F) * 63U)
+            {
+                return;
+            }
+            registers[0x1E] = static_cast<uint8_t>(0x40 | (config & 0x08 ? 0x20 : 0) | (config & 0x04 ? 0x08 : 0) | (config & 0x02 ? 0x02 : 0));
+            if (registers[0x2D] & 0x20)
+            {
+                registers[0x0C] |= 0x20;
+                if (registers[0x2E] & 0x20)
+                {
+                    simulator().pinLevel[interruptPin] = 0;
+                }
+            }
+        }
+
+    private:
+        uint8_t registers[256] = {};
+        uint8_t interruptPin;
+
+        // Resting value plus a 10 Hz vibration, clamped to 12 bit; 0 while in standby.
+        int16_t sample(const int axis) const
+        {
+            if (!(registers[0x2A] & 0x01))
+            {
+                return 0;
+            }
+            const Environment &environment = simulator().environment;
+            const double phase = 2.0 * 3.14159265358979 * 10.0 * static_cast<double>(simulator().nowUs) / 1e6 + axis;
+            long counts = environment.acceleration[axis] + std::lround(environment.vibration * std::sin(phase));
+            counts = counts > 2047 ? 2047 : (counts < -2048 ? -2048 : counts);
+            return static_cast<int16_t>(counts);
+        }
+    };
+} // namespace SIM
+
+#endif // SIM_SIMULATOR_HPP
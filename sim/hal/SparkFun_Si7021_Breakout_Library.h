@@ -0,0 +1,96 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file SparkFun_Si7021_Breakout_Library.h
+ * @brief Host replacement of the Si7021 Weather class in lib/SparkFun_Si7021.
+ *
+ * Readings come from SIM::Environment, quantised to the 16-bit codes of the sensor. Each
+ * measurement costs what the real library spends: a command and 3-byte read over I2C plus its
+ * fixed 100 ms wait for the conversion.
+ */
+
+#ifndef SIM_SPARKFUN_SI7021_BREAKOUT_LIBRARY_H
+#define SIM_SPARKFUN_SI7021_BREAKOUT_LIBRARY_H
+
+#include "Arduino.h"
+
+class Weather
+{
+public:
+    static const uint32_t CONVERSION_WAIT_US = 100000;
+
+    bool begin()
+    {
+        transfer();
+        return true;
+    }
+
+    float getRH()
+    {
+        measure();
+        const float humidity = SIM::simulator().environment.humidity;
+        const uint16_t code = toCode((humidity + 6.0f) * 65536.0f / 125.0f);
+        return (125.0f * code / 65536) - 6;
+    }
+
+    float readTemp()
+    {
+        transfer();
+        return quantisedTemperature();
+    }
+
+    float getTemp()
+    {
+        measure();
+        return quantisedTemperature();
+    }
+
+    float readTempF()
+    {
+        return readTemp() * 1.8f + 32.0f;
+    }
+
+    float getTempF()
+    {
+        return getTemp() * 1.8f + 32.0f;
+    }
+
+    void heaterOn() { transfer(); }
+    void heaterOff() { transfer(); }
+    void changeResolution(uint8_t) { transfer(); }
+    void reset() { transfer(); }
+    uint8_t checkID() { transfer(); return 0x15; }
+
+private:
+    // Command byte out, three bytes back, with address bytes: 7 bytes at 100 kHz.
+    static void transfer()
+    {
+        SIM::simulator().advance(SIM::Activity::ACT_SI7021, 7 * 90);
+    }
+
+    static void measure()
+    {
+        transfer();
+        SIM::simulator().advance(SIM::Activity::ACT_SI7021, CONVERSION_WAIT_US);
+    }
+
+    static uint16_t toCode(const float code)
+    {
+        return static_cast<uint16_t>(code < 0.0f ? 0.0f : (code > 65535.0f ? 65535.0f : code));
+    }
+
+    static float quantisedTemperature()
+    {
+        const float temperature = SIM::simulator().environment.temperature;
+        const uint16_t code = toCode((temperature + 46.85f) * 65536.0f / 175.25f);
+        return (175.25f * code / 65536) - 46.85f;
+    }
+};
+
+#endif // SIM_SPARKFUN_SI7021_BREAKOUT_LIBRARY_H
@@ -0,0 +1,155 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file TheThingsNetwork.h
+ * @brief Host replacement of the TheThingsNetwork library: captures uplinks, delivers scheduled
+ * downlinks, and charges the RN2483 UART, time on air and receive windows to the virtual clock.
+ */
+
+#ifndef SIM_THE_THINGS_NETWORK_H
+#define SIM_THE_THINGS_NETWORK_H
+
+#include "Arduino.h"
+#include "../../include/LoRaAirtime.hpp"
+
+typedef uint8_t port_t;
+
+enum ttn_fp_t
+{
+    TTN_FP_EU868,
+    TTN_FP_US915,
+    TTN_FP_AU915,
+    TTN_FP_AS920_923,
+    TTN_FP_AS923_925,
+    TTN_FP_KR920_923,
+    TTN_FP_IN865_867
+};
+
+enum ttn_response_t
+{
+    TTN_ERROR_SEND_COMMAND_FAILED = (-1),
+    TTN_ERROR_UNEXPECTED_RESPONSE = (-10),
+    TTN_SUCCESSFUL_TRANSMISSION = 1,
+    TTN_SUCCESSFUL_RECEIVE = 2,
+    TTN_UNSUCESSFUL_RECEIVE = 3
+};
+
+class TheThingsNetwork
+{
+public:
+    static const uint32_t UART_BYTE_US = 174;       ///< 10 bits at 57600 baud.
+    static const uint32_t RECEIVE_DELAY1_US = 1000000;
+    static const uint32_t RECEIVE_DELAY2_US = 2000000;
+    static const uint32_t RX2_TIMEOUT_US = 200000;  ///< Preamble search at SF12 before the modem gives up.
+    static const uint32_t JOIN_US = 6000000;        ///< Join request plus the 5 s join accept delay.
+
+    TheThingsNetwork(Stream &, Stream &, ttn_fp_t, uint8_t = 7, uint8_t = 2) {}
+
+    void onMessage(void (*callback)(const uint8_t *payload, size_t size, port_t port))
+    {
+        messageCallback = callback;
+    }
+
+    bool reset(bool = true)
+    {
+        command(12, 8);
+        return true;
+    }
+
+    void showStatus()
+    {
+        command(60, 60);
+        Serial.println("EUI: 0004A30B001A2B3C");
+        Serial.println("Battery: 3300");
+    }
+
+    bool join(const char *, const char *, int8_t = -1, uint32_t = 10000)
+    {
+        command(60, 10);
+        SIM::simulator().advance(SIM::Activity::ACT_RADIO, JOIN_US);
+        return true;
+    }
+
+    bool personalize(const char *, const char *, const char *)
+    {
+        command(120, 10);
+        return true;
+    }
+
+    uint16_t getVDD()
+    {
+        command(13, 6);
+        return SIM::simulator().environment.vddMv;
+    }
+
+    /**
+     * @brief Sends an unconfirmed uplink: "mac tx" with the payload in hex, the frame on air,
+     * then RX1 and RX2. A scheduled downlink arrives in RX1 and is passed to the callback.
+     */
+    ttn_response_t sendBytes(const uint8_t *payload, const size_t length, const port_t port = 1,
+                             const bool = false, const uint8_t sf = 0)
+    {
+        SIM::Simulator &simulator = SIM::simulator();
+        const uint8_t airSf = sf ? sf : 7;
+        SIM::Uplink uplink;
+        uplink.timeUs = simulator.nowUs;
+        uplink.port = port;
+        uplink.spreadingFactor = sf;
+        uplink.timeOnAirUs = PAYLOAD_ENCODER::getUplinkTimeOnAirUs(static_cast<uint8_t>(length), airSf);
+        uplink.payload.assign(payload, payload + length);
+        simulator.uplinks.push_back(uplink);
+
+        command(static_cast<uint32_t>(sf ? 18 : 0) + 18 + 2 * static_cast<uint32_t>(length), 4);
+        simulator.advance(SIM::Activity::ACT_RADIO, uplink.timeOnAirUs);
+
+        if (!simulator.downlinks.empty() && simulator.downlinks.front().afterUplink <= simulator.uplinks.size())
+        {
+            const SIM::Downlink downlink = simulator.downlinks.front();
+            simulator.downlinks.pop_front();
+            simulator.advance(SIM::Activity::ACT_RADIO, RECEIVE_DELAY1_US +
+                              PAYLOAD_ENCODER::getUplinkTimeOnAirUs(static_cast<uint8_t>(downlink.payload.size()), airSf));
+            command(0, 18 + 2 * static_cast<uint32_t>(downlink.payload.size()));
+            if (messageCallback)
+            {
+                messageCallback(downlink.payload.data(), downlink.payload.size(), downlink.port);
+            }
+            return TTN_SUCCESSFUL_RECEIVE;
+        }
+        simulator.advance(SIM::Activity::ACT_RADIO, RECEIVE_DELAY2_US + RX2_TIMEOUT_US);
+        command(0, 12);
+        return TTN_SUCCESSFUL_TRANSMISSION;
+    }
+
+    ttn_response_t poll(port_t port = 1, bool confirm = false)
+    {
+        const uint8_t empty = 0;
+        return sendBytes(&empty, 1, port, confirm);
+    }
+
+    void sleep(uint32_t)
+    {
+        command(18, 0);
+    }
+
+    void wake()
+    {
+        command(1, 0);
+    }
+
+private:
+    void (*messageCallback)(const uint8_t *, size_t, port_t) = nullptr;
+
+    // A modem command and its answer over the UART.
+    static void command(const uint32_t sentBytes, const uint32_t answerBytes)
+    {
+        SIM::simulator().advance(SIM::Activity::ACT_RADIO, (sentBytes + answerBytes) * UART_BYTE_US);
+    }
+};
+
+#endif // SIM_THE_THINGS_NETWORK_H
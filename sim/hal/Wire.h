@@ -0,0 +1,102 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file Wire.h
+ * @brief Host replacement of the Arduino Wire library, routing transfers to SIM::I2cDevice models.
+ *
+ * The first byte written after beginTransmission() sets the register pointer, following bytes
+ * write registers, requestFrom() reads from the pointer on; the pointer auto-increments. Every
+ * byte, address bytes included, costs 9 bit times at 100 kHz.
+ */
+
+#ifndef SIM_WIRE_H
+#define SIM_WIRE_H
+
+#include "Arduino.h"
+
+class TwoWire
+{
+public:
+    static const uint32_t BYTE_US = 90;
+
+    void begin() {}
+
+    void beginTransmission(const uint8_t address)
+    {
+        transmitAddress = address & 0x7F;
+        transmitCount = 0;
+        charge(1);
+    }
+
+    size_t write(const uint8_t value)
+    {
+        SIM::I2cDevice *device = SIM::simulator().i2cDevices[transmitAddress];
+        if (transmitCount == 0)
+        {
+            pointer = value;
+        }
+        else if (device)
+        {
+            device->writeRegister(pointer++, value);
+        }
+        transmitCount++;
+        charge(1);
+        return 1;
+    }
+
+    uint8_t endTransmission(bool = true)
+    {
+        return SIM::simulator().i2cDevices[transmitAddress] ? 0 : 2; // 2: address not acknowledged
+    }
+
+    uint8_t requestFrom(const int address, const int quantity)
+    {
+        SIM::I2cDevice *device = SIM::simulator().i2cDevices[address & 0x7F];
+        receiveCount = 0;
+        receiveIndex = 0;
+        charge(1);
+        if (!device)
+        {
+            return 0;
+        }
+        for (int i = 0; i < quantity && receiveCount < sizeof(receiveBuffer); i++)
+        {
+            receiveBuffer[receiveCount++] = device->readRegister(pointer++);
+        }
+        charge(receiveCount);
+        return receiveCount;
+    }
+
+    int available()
+    {
+        return receiveCount - receiveIndex;
+    }
+
+    int read()
+    {
+        return receiveIndex < receiveCount ? receiveBuffer[receiveIndex++] : -1;
+    }
+
+private:
+    uint8_t transmitAddress = 0;
+    uint8_t transmitCount = 0;
+    uint8_t pointer = 0;
+    uint8_t receiveBuffer[32] = {};
+    uint8_t receiveCount = 0;
+    uint8_t receiveIndex = 0;
+
+    static void charge(const uint32_t bytes)
+    {
+        SIM::simulator().advance(SIM::Activity::ACT_I2C, bytes * BYTE_US);
+    }
+};
+
+inline TwoWire Wire;
+
+#endif // SIM_WIRE_H
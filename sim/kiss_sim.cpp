@@ -0,0 +1,342 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file kiss_sim.cpp
+ * @brief Runs the unmodified KISS node firmware of src/main.cpp on the host.
+ *
+ * The headers in sim/hal replace the Arduino core, Wire, TheThingsNetwork and the Si7021
+ * library; time is virtual, so a 50 s measurement cycle simulates in microseconds. Between
+ * loop() iterations the sensor inputs take a seeded random walk. Every uplink is captured
+ * with its virtual timestamp, and every iteration is broken down by where its virtual time went.
+ * The energy account of the firmware (include/EnergyModel.hpp) turns the phases it tagged into
+ * charge per iteration and per uplink, and a projected battery life.
+ * Button presses and shakes can be scheduled at virtual times after setup; each is reported
+ * with the delay until the next uplink. Motion wake is on here, whatever the board default,
+ * since the accelerometer model raises INT1 on ACC_INT_PIN.
+ * Build and run from the repository root:
+ *   g++ -std=c++17 -O2 -Isim/hal -Iinclude -Isrc sim/kiss_sim.cpp -o kiss_sim
+ *   ./kiss_sim --cycles 20 --downlink 3:10:05 --serial trace.bin
+ *   ./kiss_sim --cycles 4 --button 12.5 --shake 80:600
+ * Decode the captured debug port with tools/trace_print.cpp.
+ */
+
+#define MOTION_WAKE 1
+#include "../src/main.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace SIM
+{
+    /**
+     * @brief Where the virtual time of one loop() iteration went.
+     */
+    struct Iteration
+    {
+        uint64_t startUs;
+        uint64_t durationUs;
+        uint64_t spentUs[static_cast<size_t>(Activity::ACT_COUNT)];
+        uint64_t hostNs;            ///< Host time of the loop() call, simulator included.
+        float chargeMah;            ///< Charge drawn in this iteration, 0 without ENERGY.
+        size_t uplinks;             ///< Uplinks sent in this iteration.
+    };
+
+    /**
+     * @brief A button press or shake scheduled from the command line.
+     */
+    struct Event
+    {
+        double timeS;               ///< Virtual seconds after setup.
+        uint16_t shakeMg;           ///< Peak acceleration of a shake, 0 for a button press.
+    };
+
+    struct Options
+    {
+        std::vector<Event> events;
+        unsigned cycles = 20;
+        unsigned seed = 1;
+        const char *serialPath = nullptr;
+        float batteryMah = 2400.0f;
+    };
+
+    bool parseDownlink(const char *text, Downlink &downlink)
+    {
+        unsigned afterUplink = 0;
+        unsigned port = 0;
+        int consumed = 0;
+        if (std::sscanf(text, "%u:%u:%n", &afterUplink, &port, &consumed) != 2 || port > 255)
+        {
+            return false;
+        }
+        const std::string hex = text + consumed;
+        if (hex.size() % 2)
+        {
+            return false;
+        }
+        downlink.afterUplink = afterUplink;
+        downlink.port = static_cast<uint8_t>(port);
+        downlink.payload.clear();
+        for (size_t i = 0; i < hex.size(); i += 2)
+        {
+            downlink.payload.push_back(static_cast<uint8_t>(std::strtoul(hex.substr(i, 2).c_str(), nullptr, 16)));
+        }
+        return true;
+    }
+
+    // Schedule the events: the button is held for 200 ms, a shake vibrates for a second.
+    void scheduleEvents(const std::vector<Event> &events, Fxls8471q &accelerometer)
+    {
+        Simulator &sim = simulator();
+        for (const Event &event : events)
+        {
+            const uint64_t timeUs = sim.nowUs + static_cast<uint64_t>(event.timeS * 1e6);
+            if (!event.shakeMg)
+            {
+                sim.schedule(timeUs, [&sim] { sim.pinLevel[BUTTON_PIN] = LOW; });
+                sim.schedule(timeUs + 200000, [&sim] { sim.pinLevel[BUTTON_PIN] = HIGH; });
+                continue;
+            }
+            const uint16_t peakMg = event.shakeMg;
+            sim.schedule(timeUs, [&sim, &accelerometer, peakMg] {
+                sim.environment.vibration = static_cast<int16_t>(peakMg * 1024 / 1000);
+                accelerometer.shake(peakMg);
+            });
+            sim.schedule(timeUs + 1000000, [&sim] { sim.environment.vibration = 0; });
+        }
+    }
+
+    void printEvents(const std::vector<Event> &events, const uint64_t startUs, const std::vector<Uplink> &uplinks)
+    {
+        if (events.empty())
+        {
+            return;
+        }
+        std::printf("\n%-6s %10s %8s %14s\n", "event", "time_s", "shake_mg", "next_uplink_s");
+        for (const Event &event : events)
+        {
+            const uint64_t timeUs = startUs + static_cast<uint64_t>(event.timeS * 1e6);
+            std::printf("%-6s %10.3f %8u ", event.shakeMg ? "shake" : "button", timeUs / 1e6, event.shakeMg);
+            size_t next = 0;
+            while (next < uplinks.size() && uplinks[next].timeUs < timeUs)
+            {
+                next++;
+            }
+            if (next < uplinks.size())
+            {
+                std::printf("%14.3f\n", (uplinks[next].timeUs - timeUs) / 1e6);
+            }
+            else
+            {
+                std::printf("%14s\n", "-");
+            }
+        }
+    }
+
+    // Let the inputs drift: temperature and humidity walk, light flickers, the switch turns
+    // now and then, and the vibration level changes.
+    void stepEnvironment(std::mt19937 &random, Environment &environment)
+    {
+        std::normal_distribution<float> step(0.0f, 1.0f);
+        std::uniform_int_distribution<int> percent(0, 99);
+        environment.temperature += 0.2f * step(random);
+        environment.humidity += 0.8f * step(random);
+        environment.humidity = environment.humidity < 0.0f ? 0.0f : (environment.humidity > 100.0f ? 100.0f : environment.humidity);
+        const float light = environment.lightAdc + 30.0f * step(random);
+        environment.lightAdc = light < 0.0f ? 0.0f : (light > 1023.0f ? 1023.0f : light);
+        if (percent(random) < 10)
+        {
+            environment.rotary = static_cast<uint8_t>(percent(random) % 10);
+        }
+        environment.vibration = static_cast<int16_t>(percent(random) < 20 ? 200 + percent(random) * 4 : 0);
+        environment.vddMv = static_cast<uint16_t>(environment.vddMv - (percent(random) < 5 ? 1 : 0));
+    }
+
+    // The rotary switch drives four GPIO inputs.
+    void applyInputs(const Environment &environment)
+    {
+        const uint8_t pins[4] = {ROTARY_PIN_0, ROTARY_PIN_1, ROTARY_PIN_2, ROTARY_PIN_3};
+        for (uint8_t bit = 0; bit < 4; bit++)
+        {
+            simulator().pinLevel[pins[bit]] = (environment.rotary >> bit) & 1;
+        }
+    }
+
+    void printIterations(const std::vector<Iteration> &iterations)
+    {
+        std::printf("%-9s %10s %10s", "iteration", "start_s", "total_ms");
+        for (const char *name : ACTIVITY_NAMES)
+        {
+            std::printf(" %9s", name);
+        }
+        std::printf(" %9s %10s %7s\n", "host_us", "charge_uAh", "uplinks");
+        for (size_t i = 0; i < iterations.size(); i++)
+        {
+            const Iteration &iteration = iterations[i];
+            std::printf("%-9zu %10.3f %10.1f", i, iteration.startUs / 1e6, iteration.durationUs / 1e3);
+            for (const uint64_t spent : iteration.spentUs)
+            {
+                std::printf(" %9.1f", spent / 1e3);
+            }
+            std::printf(" %9.1f %10.2f %7zu\n", iteration.hostNs / 1e3, iteration.chargeMah * 1e3, iteration.uplinks);
+        }
+    }
+
+    void printUplinks(const std::vector<Uplink> &uplinks)
+    {
+        std::printf("\n%-6s %10s %5s %3s %8s %5s  %s\n", "uplink", "time_s", "fport", "sf", "toa_ms", "size", "payload");
+        for (size_t i = 0; i < uplinks.size(); i++)
+        {
+            const Uplink &uplink = uplinks[i];
+            std::printf("%-6zu %10.3f %5u %3u %8.1f %5zu  ", i, uplink.timeUs / 1e6, uplink.port,
+                        uplink.spreadingFactor, uplink.timeOnAirUs / 1e3, uplink.payload.size());
+            for (const uint8_t byte : uplink.payload)
+            {
+                std::printf("%02X", byte);
+            }
+            std::printf("\n");
+        }
+    }
+
+#if ENERGY
+    const static char *const PHASE_NAMES[] = {"active", "sensor read", "encode", "tx", "rx window", "idle sleep"};
+
+    void printEnergy(const PAYLOAD_ENCODER::EnergyAccount &account, const float batteryMah)
+    {
+        std::printf("\n%-12s %12s %12s\n", "phase", "time_s", "charge_mAh");
+        for (size_t i = 0; i < PAYLOAD_ENCODER::ENERGY_PHASE_COUNT; i++)
+        {
+            const PAYLOAD_ENCODER::ENERGY_PHASE phase = static_cast<PAYLOAD_ENCODER::ENERGY_PHASE>(i);
+            std::printf("%-12s %12.3f %12.5f\n", PHASE_NAMES[i], account.getTimeUs(phase) / 1e6, account.getChargeMah(phase));
+        }
+        std::printf("%-12s %12.3f %12.5f\n", "total", account.getTotalTimeUs() / 1e6, account.getTotalChargeMah());
+        std::printf("\nuplinks %lu, %.5f mAh per uplink, average %.3f mA, %.1f days on %.0f mAh\n",
+                    static_cast<unsigned long>(account.getUplinkCount()), account.getChargePerUplinkMah(),
+                    account.getAverageCurrentMa(), account.getBatteryLifeDays(batteryMah), batteryMah);
+    }
+#endif
+} // namespace SIM
+
+int main(int argc, char **argv)
+{
+    SIM::Options options;
+    SIM::Simulator &simulator = SIM::simulator();
+    for (int i = 1; i < argc; i++)
+    {
+        SIM::Downlink downlink;
+        if (!std::strcmp(argv[i], "--cycles") && i + 1 < argc)
+        {
+            options.cycles = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            options.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!std::strcmp(argv[i], "--battery") && i + 1 < argc)
+        {
+            options.batteryMah = std::strtof(argv[++i], nullptr);
+        }
+        else if (!std::strcmp(argv[i], "--serial") && i + 1 < argc)
+        {
+            options.serialPath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--downlink") && i + 1 < argc && SIM::parseDownlink(argv[++i], downlink))
+        {
+            simulator.downlinks.push_back(downlink);
+        }
+        else if (!std::strcmp(argv[i], "--button") && i + 1 < argc)
+        {
+            options.events.push_back({std::strtod(argv[++i], nullptr), 0});
+        }
+        else if (!std::strcmp(argv[i], "--shake") && i + 1 < argc)
+        {
+            char *end = nullptr;
+            const double timeS = std::strtod(argv[++i], &end);
+            const unsigned long peakMg = *end == ':' ? std::strtoul(end + 1, nullptr, 10) : 1000;
+            options.events.push_back({timeS, static_cast<uint16_t>(peakMg ? (peakMg > 8000 ? 8000 : peakMg) : 1)});
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--cycles N] [--seed N] [--battery MAH] [--serial FILE] [--downlink UPLINK:FPORT:HEX]... "
+                                 "[--button SECONDS]... [--shake SECONDS[:MG]]...\n", argv[0]);
+            return 1;
+        }
+    }
+
+    SIM::Fxls8471q accelerometer(ACC_INT_PIN);
+    simulator.i2cDevices[0x1D] = &accelerometer;
+    std::mt19937 random(options.seed);
+
+    SIM::applyInputs(simulator.environment);
+    setup();
+    std::printf("setup: %.3f s virtual\n\n", simulator.nowUs / 1e6);
+    const uint64_t cyclesStartUs = simulator.nowUs;
+    SIM::scheduleEvents(options.events, accelerometer);
+#if ENERGY
+    // Account for the measurement cycles only, not for joining.
+    energy.reset(micros());
+#endif
+
+    std::vector<SIM::Iteration> iterations;
+    for (unsigned cycle = 0; cycle < options.cycles; cycle++)
+    {
+        SIM::stepEnvironment(random, simulator.environment);
+        SIM::applyInputs(simulator.environment);
+
+        SIM::Iteration iteration = {};
+        iteration.startUs = simulator.nowUs;
+        const size_t uplinksBefore = simulator.uplinks.size();
+        uint64_t spentBefore[static_cast<size_t>(SIM::Activity::ACT_COUNT)];
+        std::memcpy(spentBefore, simulator.spentUs, sizeof(spentBefore));
+#if ENERGY
+        const float chargeBefore = energy.getTotalChargeMah();
+#endif
+
+        const auto hostStart = std::chrono::steady_clock::now();
+        loop();
+        const auto hostEnd = std::chrono::steady_clock::now();
+#if ENERGY
+        energy.update(micros());
+        iteration.chargeMah = energy.getTotalChargeMah() - chargeBefore;
+#endif
+
+        iteration.durationUs = simulator.nowUs - iteration.startUs;
+        for (size_t activity = 0; activity < static_cast<size_t>(SIM::Activity::ACT_COUNT); activity++)
+        {
+            iteration.spentUs[activity] = simulator.spentUs[activity] - spentBefore[activity];
+        }
+        iteration.hostNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(hostEnd - hostStart).count());
+        iteration.uplinks = simulator.uplinks.size() - uplinksBefore;
+        iterations.push_back(iteration);
+    }
+
+    SIM::printIterations(iterations);
+    SIM::printUplinks(simulator.uplinks);
+    SIM::printEvents(options.events, cyclesStartUs, simulator.uplinks);
+#if ENERGY
+    SIM::printEnergy(energy, options.batteryMah);
+#endif
+
+    if (options.serialPath)
+    {
+        FILE *file = std::fopen(options.serialPath, "wb");
+        if (!file)
+        {
+            std::perror(options.serialPath);
+            return 1;
+        }
+        std::fwrite(simulator.debugOutput.data(), 1, simulator.debugOutput.size(), file);
+        std::fclose(file);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+#ifndef TRACE_EVENTS_HPP
+#define TRACE_EVENTS_HPP
+
+#include <stdint.h>
+
+/**
+ * @brief Trace event IDs of the KISS node firmware, shared with tools/trace_print.cpp.
+ *
+ * The comment of each event gives the meaning and scale of its value. Values of float
+ * measurements are logged in thousandths so no formatting happens on the node.
+ */
+enum class TraceEvent : uint8_t {
+  TRACE_LOST                = 0,    ///< Records overwritten before a flush (PAYLOAD_ENCODER::TRACE_EVENT_LOST)
+  TRACE_STATUS              = 1,    ///< Radio status printed by the TTN library follows; value unused
+  TRACE_JOIN                = 2,    ///< Join or personalisation started; value unused
+  TRACE_LOOP                = 3,    ///< Measurement cycle started; value is the cycle number
+  TRACE_HUMIDITY            = 4,    ///< Relative humidity in 0.001 %RH
+  TRACE_TEMPERATURE         = 5,    ///< Temperature in 0.001 degrees Celsius
+  TRACE_LUMINOSITY          = 6,    ///< Ambient light in 0.001 lux
+  TRACE_ROTARY              = 7,    ///< Rotary switch position
+  TRACE_ACC_X               = 8,    ///< Acceleration x axis in 0.001 g
+  TRACE_ACC_Y               = 9,    ///< Acceleration y axis in 0.001 g
+  TRACE_ACC_Z               = 10,   ///< Acceleration z axis in 0.001 g
+  TRACE_VDD                 = 11,   ///< RN2483 supply in mV
+  TRACE_FIELDS_DROPPED      = 12,   ///< Fields dropped by the payload budget
+  TRACE_UPLINK_SENT         = 13,   ///< Uplink sent; value is size | SF << 8 | FPort << 16
+  TRACE_UPLINK_UNCHANGED    = 14,   ///< Nothing changed, uplink skipped; value unused
+  TRACE_UPLINK_DUTY_CYCLE   = 15,   ///< Duty cycle exhausted, uplink skipped; value is the wait in ms
+  TRACE_DOWNLINK_IGNORED    = 16,   ///< Downlink on another port ignored; value is the FPort
+  TRACE_DOWNLINK_REJECTED   = 17,   ///< Downlink rejected; value is the offset of the bad command
+  TRACE_DOWNLINK_APPLIED    = 18,   ///< Downlink applied; value is the number of commands
+  TRACE_ACC_NOT_INITIALIZED = 19,   ///< Accelerometer did not answer who-am-i; value is the answer
+  TRACE_CHARGE              = 20,   ///< Uplink sent; value is the charge since the previous uplink in 0.001 mAh
+  TRACE_WAKE                = 21,   ///< Wake pins fired; value is the PAYLOAD_ENCODER::WAKE_SOURCE mask
+};
+
+#endif // TRACE_EVENTS_HPP
@@ -20,6 +20,16 @@
 
 #include <Arduino.h>
 #include <main.hpp>
+#include <LoRaAirtime.hpp>
+#include <DownlinkCommands.hpp>
+
+PAYLOAD_ENCODER::DutyCycleLimiter dutyCycle; ///< Airtime credit per EU868 sub-band
+
+/// Run-time configuration, changed by downlink commands on APPLICATION_FPORT_COMMAND; deadbands in NodeSensors order
+PAYLOAD_ENCODER::DeviceConfig<KISS::REPORT_CHANNELS> config = {
+  UPLINK_INTERVAL_MS, ACC_SAMPLE_PERIOD_MS, PAYLOAD_ENCODER::getDataRateEU868(SF), false,
+  {KISS::DEADBAND_TEMPERATURE, KISS::DEADBAND_HUMIDITY, KISS::DEADBAND_LUMINOSITY, KISS::DEADBAND_ROTARYSWITCH,
+   KISS::DEADBAND_ACCELEROMETER, KISS::DEADBAND_BOARDVCCVOLTAGE, KISS::DEADBAND_PRESENCE, KISS::DEADBAND_ACC_SUMMARY}};
 
 #ifdef CAYENNELPP_CLASSIC 
   #include <CayenneLPP.h> // Library
@@ -27,7 +37,13 @@
 #endif
 #ifdef CAYENNELPP_NEW
   #include <CayenneLPP.hpp> // Refactored Library
-  PAYLOAD_ENCODER::CayenneLPP<52> lpp(51); ///< Cayenne object for composing sensor message
+  #include <CayenneBudgetFrame.hpp>
+  #include <ReportOnChange.hpp>
+  #include <StreamingAggregator.hpp>
+  #include <CompactFrame.hpp>
+  PAYLOAD_ENCODER::CayenneBudgetFrame<64> lppFrame; ///< Builder fitting the sensor message into the data rate budget; at most 64 bytes, also at DR3-5, to spare RAM
+  PAYLOAD_ENCODER::ReportOnChange<KISS::REPORT_CHANNELS> reportFilter; ///< Deadband per channel, only changed fields are sent
+  PAYLOAD_ENCODER::StreamingAggregator accelerationWindow[3]; ///< x, y and z statistics sampled between uplinks
 #endif
 
 
@@ -35,99 +51,375 @@ void setup() {
   pinMode(2, OUTPUT);
   digitalWrite(2, HIGH); 
   initialize();
+#ifdef CAYENNELPP_NEW
+  configureReportOnChange();
+#endif
 }
 
 void loop() {
-    DEBUG_MSG_LN("-- LOOP");
+#if DEBUG
+    static uint32_t cycle = 0;
+    TRACE_EVENT(TraceEvent::TRACE_LOOP, cycle++);
+#endif
+    // A REQUEST_UPLINK downlink stays set until the requested uplink is sent
+    const bool requested = config.uplinkRequested;
+    ENERGY_PHASE(SENSOR_READ);
 
     // Measure Relative Humidity from the Si7021
+    PROFILE_BEGIN(SI7021);
     const float humidity = sensor.getRH();
-    DEBUG_MSG("Humidity: ");
-    DEBUG_MSG(humidity);
-    DEBUG_MSG_LN(" %RH.");
 
     // Measure Temperature from the Si7021
     const float temperature = sensor.getTemp();
-    DEBUG_MSG("Temperature: ");
-    DEBUG_MSG(temperature);
-    DEBUG_MSG_LN(" Degrees.");
+    PROFILE_END();
+    TRACE_MILLI(TraceEvent::TRACE_HUMIDITY, humidity);
+    TRACE_MILLI(TraceEvent::TRACE_TEMPERATURE, temperature);
 
     // Measure luminosity
     const float luminosity = get_lux_value();
-    DEBUG_MSG("Ambient light: ");
-    DEBUG_MSG(luminosity);
-    DEBUG_MSG_LN(" lux");
+    TRACE_MILLI(TraceEvent::TRACE_LUMINOSITY, luminosity);
 
     // get rotary encode position
     const uint8_t rotaryPosition = static_cast<uint8_t>(getRotaryPosition());
-    DEBUG_MSG("Rotary encoder position: ");
-    DEBUG_MSG_LN(rotaryPosition);
+    TRACE_EVENT(TraceEvent::TRACE_ROTARY, rotaryPosition);
 
     /// get accelerometer
     float x, y, z;
+    PROFILE_BEGIN(ACCELERATION);
     getAcceleration(&x, &y, &z);
-    DEBUG_MSG("Acceleration:\tx=");
-    DEBUG_MSG(x);
-    DEBUG_MSG("g\n\t\ty=");
-    DEBUG_MSG(y);
-    DEBUG_MSG("g\n\t\tz=");
-    DEBUG_MSG(z);
-    DEBUG_MSG_LN("g");
-    DEBUG_MSG_LN("---");
-
-    const float vdd = (static_cast<float>(ttn.getVDD()) / 1000);
-    DEBUG_MSG("RN2483 voltage: ");
-    DEBUG_MSG(vdd);
-    DEBUG_MSG_LN(" Volt");
+    PROFILE_END();
+    TRACE_MILLI(TraceEvent::TRACE_ACC_X, x);
+    TRACE_MILLI(TraceEvent::TRACE_ACC_Y, y);
+    TRACE_MILLI(TraceEvent::TRACE_ACC_Z, z);
+
+    PROFILE_BEGIN(VDD);
+#if VDD_FROM_ADC
+    const uint16_t vddMv = getSupplyMv();
+#else
+    const uint16_t vddMv = ttn.getVDD();
+#endif
+    PROFILE_END();
+    const float vdd = (static_cast<float>(vddMv) / 1000);
+    TRACE_EVENT(TraceEvent::TRACE_VDD, vddMv);
+    ENERGY_PHASE(ENCODE);
+    PROFILE_BEGIN(ENCODE);
 
 #ifdef CAYENNELPP_CLASSIC
     lpp.reset();    // reset cayenne object
-    lpp.addTemperature(static_cast<uint8_t>(NodeSensors::LPP_CH_TEMPERATURE), temperature);
-    lpp.addRelativeHumidity(static_cast<uint8_t>(NodeSensors::LPP_CH_HUMIDITY), humidity);
-    lpp.addLuminosity(static_cast<uint8_t>(NodeSensors::LPP_CH_LUMINOSITY), luminosity);
-    lpp.addDigitalInput(static_cast<uint8_t>(NodeSensors::LPP_CH_ROTARYSWITCH), rotaryPosition);
-    lpp.addAccelerometer(static_cast<uint8_t>(NodeSensors::LPP_CH_ACCELEROMETER), x, y, z);
-    lpp.addAnalogInput(static_cast<uint8_t>(NodeSensors::LPP_CH_BOARDVCCVOLTAGE), vdd);
+    PROFILE_ADD(lpp.addTemperature(static_cast<uint8_t>(NodeSensors::LPP_CH_TEMPERATURE), temperature));
+    PROFILE_ADD(lpp.addRelativeHumidity(static_cast<uint8_t>(NodeSensors::LPP_CH_HUMIDITY), humidity));
+    PROFILE_ADD(lpp.addLuminosity(static_cast<uint8_t>(NodeSensors::LPP_CH_LUMINOSITY), luminosity));
+    PROFILE_ADD(lpp.addDigitalInput(static_cast<uint8_t>(NodeSensors::LPP_CH_ROTARYSWITCH), rotaryPosition));
+    PROFILE_ADD(lpp.addAccelerometer(static_cast<uint8_t>(NodeSensors::LPP_CH_ACCELEROMETER), x, y, z));
+    PROFILE_ADD(lpp.addAnalogInput(static_cast<uint8_t>(NodeSensors::LPP_CH_BOARDVCCVOLTAGE), vdd));
 #endif
 
 #ifdef CAYENNELPP_NEW
-    lpp.reset();    // reset cayenne object
-    lpp.addDigitalInput(static_cast<uint8_t>(NodeSensors::LPP_CH_ROTARYSWITCH), rotaryPosition);
-    lpp.addTemperature(static_cast<uint8_t>(NodeSensors::LPP_CH_TEMPERATURE), temperature);
-    lpp.addHumidity(static_cast<uint8_t>(NodeSensors::LPP_CH_HUMIDITY), humidity);
-    lpp.addIllumination(static_cast<uint8_t>(NodeSensors::LPP_CH_LUMINOSITY), luminosity);
-    lpp.addAccelerometer(static_cast<uint8_t>(NodeSensors::LPP_CH_ACCELEROMETER), x, y, z);
-    lpp.addAnalogInput(static_cast<uint8_t>(NodeSensors::LPP_CH_BOARDVCCVOLTAGE), vdd);
+    // Only fields that changed beyond their deadband, or were silent too long, are staged.
+    // Fields that do not fit the payload budget of the data rate are dropped lowest priority first.
+    // A requested uplink reports every field, changed or not.
+    const uint32_t now = millis();
+    if (requested)
+      reportFilter.expire();
+    if (reportFilter.update(static_cast<uint8_t>(NodeSensors::LPP_CH_ROTARYSWITCH), rotaryPosition, now))
+      PROFILE_ADD(lppFrame.stage(static_cast<uint8_t>(FieldPriority::PRIO_INPUT)).addDigitalInput(static_cast<uint8_t>(NodeSensors::LPP_CH_ROTARYSWITCH), rotaryPosition));
+    if (reportFilter.update(static_cast<uint8_t>(NodeSensors::LPP_CH_TEMPERATURE), temperature, now))
+      PROFILE_ADD(lppFrame.stage(static_cast<uint8_t>(FieldPriority::PRIO_ENVIRONMENT)).addTemperature(static_cast<uint8_t>(NodeSensors::LPP_CH_TEMPERATURE), temperature));
+    if (reportFilter.update(static_cast<uint8_t>(NodeSensors::LPP_CH_HUMIDITY), humidity, now))
+      PROFILE_ADD(lppFrame.stage(static_cast<uint8_t>(FieldPriority::PRIO_ENVIRONMENT)).addHumidity(static_cast<uint8_t>(NodeSensors::LPP_CH_HUMIDITY), humidity));
+    if (reportFilter.update(static_cast<uint8_t>(NodeSensors::LPP_CH_LUMINOSITY), luminosity, now))
+      PROFILE_ADD(lppFrame.stage(static_cast<uint8_t>(FieldPriority::PRIO_ENVIRONMENT)).addIllumination(static_cast<uint8_t>(NodeSensors::LPP_CH_LUMINOSITY), luminosity));
+    if (reportFilter.update(static_cast<uint8_t>(NodeSensors::LPP_CH_ACCELEROMETER), x, y, z, now))
+      PROFILE_ADD(lppFrame.stage(static_cast<uint8_t>(FieldPriority::PRIO_MOTION)).addAccelerometer(static_cast<uint8_t>(NodeSensors::LPP_CH_ACCELEROMETER), x, y, z));
+    if (reportFilter.update(static_cast<uint8_t>(NodeSensors::LPP_CH_BOARDVCCVOLTAGE), vdd, now))
+      PROFILE_ADD(lppFrame.stage(static_cast<uint8_t>(FieldPriority::PRIO_DIAGNOSTICS)).addAnalogInput(static_cast<uint8_t>(NodeSensors::LPP_CH_BOARDVCCVOLTAGE), vdd));
+    // The window summary is filtered on the peak-to-peak swing of each axis and keeps collecting
+    // until it is sent; a full window no longer takes samples, so it is sent regardless.
+    const float accelerationScale = static_cast<float>(ACC_RANGE) / (1 << 11);
+    float swing[3];
+    for (uint8_t axis = 0; axis < 3; axis++)
+      swing[axis] = (accelerationWindow[axis].getMax() - accelerationWindow[axis].getMin()) * accelerationScale;
+    if (accelerationWindow[0].getCount() == PAYLOAD_ENCODER::StreamingAggregator::MAX_SAMPLES)
+      reportFilter.expire(static_cast<uint8_t>(NodeSensors::LPP_CH_ACC_MIN));
+    if (accelerationWindow[0].getCount() > 0 &&
+        reportFilter.update(static_cast<uint8_t>(NodeSensors::LPP_CH_ACC_MIN), swing[0], swing[1], swing[2], now))
+      PROFILE_ADD(PAYLOAD_ENCODER::addAccelerometerSummary(lppFrame.stage(static_cast<uint8_t>(FieldPriority::PRIO_MOTION)),
+        static_cast<uint8_t>(NodeSensors::LPP_CH_ACC_MIN), accelerationWindow, accelerationScale));
+    const PAYLOAD_ENCODER::CayenneLPP<64>& lpp = lppFrame.build(config.dataRate);
+    TRACE_EVENT(TraceEvent::TRACE_FIELDS_DROPPED, lppFrame.getDroppedCount());
+#if PROFILER
+    profiler.countDropped(lppFrame.getDroppedCount()); // Groups the payload budget left out are overflows too
+#endif
+#endif
+
+    const uint8_t *payload = lpp.getBuffer();
+    uint8_t payloadSize = lpp.getSize();
+    port_t fport = APPLICATION_FPORT_CAYENNE;
+#if defined(CAYENNELPP_NEW) && COMPACT_FRAMES
+    // Drop the per-field headers when every field is in the profile; otherwise send CayenneLPP.
+    uint8_t compact[64];
+    const size_t compactSize = payloadSize ? PAYLOAD_ENCODER::compactFrame(KISS::KISS_PROFILE, payload, payloadSize, compact, sizeof(compact)) : 0;
+    if (compactSize)
+    {
+      payload = compact;
+      payloadSize = static_cast<uint8_t>(compactSize);
+      fport = APPLICATION_FPORT_COMPACT;
+    }
 #endif
+    PROFILE_END();
+
+    ENERGY_PHASE(ACTIVE);
 
-    digitalWrite(LED_LORA, LOW); // switch LED_LORA LED on
-    ttn.sendBytes(lpp.getBuffer(), lpp.getSize(), APPLICATION_FPORT_CAYENNE, false, SF);
-    digitalWrite(LED_LORA, HIGH); // switch LED_LORA LED off
-    delay(50000);
+    // Send with the most robust SF the duty cycle credit allows; skip this uplink when none does.
+    uint32_t waitMs = config.uplinkPeriodMs;
+    dutyCycle.update(millis());
+    const uint8_t sf = payloadSize ? dutyCycle.selectSpreadingFactor(DUTY_CYCLE_SUB_BAND, payloadSize, SF_MIN,
+                                                                     PAYLOAD_ENCODER::getSpreadingFactorEU868(config.dataRate)) : 0;
+    if (sf)
+    {
+      const uint32_t timeOnAirUs = PAYLOAD_ENCODER::getUplinkTimeOnAirUs(payloadSize, sf);
+      digitalWrite(LED_LORA, LOW); // switch LED_LORA LED on
+      ENERGY_PHASE(TX);
+      PROFILE_BEGIN(SEND);
+      if (requested)
+        config.uplinkRequested = false; // Before sending: a request in its receive windows is for the next uplink
+      ttn.sendBytes(payload, payloadSize, fport, false, sf);
+      PROFILE_END();
+#if ENERGY
+      energy.endUplink(micros(), timeOnAirUs);
+      static float chargeAtUplinkMah = 0.0f;
+      TRACE_MILLI(TraceEvent::TRACE_CHARGE, energy.getTotalChargeMah() - chargeAtUplinkMah);
+      chargeAtUplinkMah = energy.getTotalChargeMah();
+#endif
+      digitalWrite(LED_LORA, HIGH); // switch LED_LORA LED off
+      dutyCycle.consume(DUTY_CYCLE_SUB_BAND, timeOnAirUs);
+      TRACE_EVENT(TraceEvent::TRACE_UPLINK_SENT, payloadSize | static_cast<uint32_t>(sf) << 8 | static_cast<uint32_t>(fport) << 16);
+#ifdef CAYENNELPP_NEW
+      // Only fields that made it into the frame were reported; changes dropped for the budget
+      // stay unreported and are staged again next cycle.
+      for (uint8_t channel = 0; channel < KISS::REPORT_CHANNELS; channel++)
+        if (lppFrame.contains(channel))
+          reportFilter.commit(channel, millis());
+      reportFilter.discard();
+      if (lppFrame.contains(static_cast<uint8_t>(NodeSensors::LPP_CH_ACC_MIN)))
+        for (uint8_t axis = 0; axis < 3; axis++)
+          accelerationWindow[axis].reset();
+#endif
+#if PROFILER
+      // A report the duty cycle held back is retried after the next uplink
+      static uint8_t uplinksSinceDiagnostics = 0;
+      if (uplinksSinceDiagnostics < DIAGNOSTICS_EVERY_UPLINKS)
+        uplinksSinceDiagnostics++;
+      if (uplinksSinceDiagnostics >= DIAGNOSTICS_EVERY_UPLINKS && sendDiagnostics())
+        uplinksSinceDiagnostics = 0;
+#endif
+    }
+    else if (payloadSize == 0)
+    {
+      TRACE_EVENT(TraceEvent::TRACE_UPLINK_UNCHANGED, 0);
+    }
+    else
+    {
+      const uint32_t creditMs = dutyCycle.getWaitTimeMs(DUTY_CYCLE_SUB_BAND, PAYLOAD_ENCODER::getUplinkTimeOnAirUs(payloadSize, SF_MIN));
+      TRACE_EVENT(TraceEvent::TRACE_UPLINK_DUTY_CYCLE, creditMs);
+#ifdef CAYENNELPP_NEW
+      reportFilter.discard();
+#endif
+      // A requested uplink the duty cycle held back is retried once there is credit for it
+      if (requested && creditMs < waitMs)
+        waitMs = creditMs;
+    }
+    TRACE_FLUSH();
+    // A request that came with a downlink starts the next cycle at once, unless it is the one
+    // just held back by the duty cycle
+    const bool stopOnRequest = !requested || sf;
+#ifdef CAYENNELPP_NEW
+    sampleAcceleration(waitMs, stopOnRequest);
+#else
+    if (!(stopOnRequest && config.uplinkRequested))
+      delay(waitMs); // Class A: downlinks only arrive in the receive windows, never during the wait
+#endif
 }
 
-void message(const uint8_t *payload, size_t size, port_t port)
+#if DEBUG
+// Write trace frames to the debug serial port as long as it accepts them without blocking
+static void flushTrace(void)
 {
-  DEBUG_MSG_LN("-- MESSAGE");
-  DEBUG_MSG("Received " + String(size) + " bytes on port " + String(port) + ":");
+  uint8_t frame[PAYLOAD_ENCODER::TRACE_FRAME_SIZE];
+  while (trace.getCount() + trace.getLostCount() > 0 && debugSerial.availableForWrite() >= static_cast<int>(sizeof(frame)))
+  {
+    const size_t size = trace.drain(frame, sizeof(frame));
+    debugSerial.write(frame, size);
+  }
+}
+#endif
 
-  for (uint32_t i = 0; i < size; i++)
+// Send an uplink outside the measurement cycle with the most robust SF the duty cycle credit allows;
+// returns false, without sending, when none does
+bool sendUplink(const uint8_t *payload, const uint8_t size, const port_t port)
+{
+  dutyCycle.update(millis());
+  const uint8_t sf = size ? dutyCycle.selectSpreadingFactor(DUTY_CYCLE_SUB_BAND, size, SF_MIN,
+                                                            PAYLOAD_ENCODER::getSpreadingFactorEU868(config.dataRate)) : 0;
+  if (!sf)
   {
-    DEBUG_MSG(" " + String(payload[i]));
+    TRACE_EVENT(TraceEvent::TRACE_UPLINK_DUTY_CYCLE, dutyCycle.getWaitTimeMs(DUTY_CYCLE_SUB_BAND, PAYLOAD_ENCODER::getUplinkTimeOnAirUs(size, SF_MIN)));
+    return false;
   }
+  const uint32_t timeOnAirUs = PAYLOAD_ENCODER::getUplinkTimeOnAirUs(size, sf);
+  ENERGY_PHASE(TX);
+  ttn.sendBytes(payload, size, port, false, sf);
+#if ENERGY
+  energy.endUplink(micros(), timeOnAirUs);
+#endif
+  dutyCycle.consume(DUTY_CYCLE_SUB_BAND, timeOnAirUs);
+  TRACE_EVENT(TraceEvent::TRACE_UPLINK_SENT, size | static_cast<uint32_t>(sf) << 8 | static_cast<uint32_t>(port) << 16);
+  return true;
+}
 
-  DEBUG_MSG_LN();
+#if PROFILER
+// Send the phase profile since the last report on its own FPort, if the duty cycle allows it now;
+// otherwise the profile keeps accumulating until the next attempt. Returns whether it was sent
+static bool sendDiagnostics(void)
+{
+  PAYLOAD_ENCODER::CayenneLPP<64> diagnostics(PAYLOAD_ENCODER::getMaxPayloadSizeEU868(config.dataRate));
+  if (!sendUplink(diagnostics.getBuffer(), profiler.report(diagnostics), APPLICATION_FPORT_DIAGNOSTICS))
+    return false;
+  profiler.reset();
+  return true;
+}
+#endif
+
+#ifdef CAYENNELPP_NEW
+// Configure the deadband of every sensor channel from the run-time configuration, and the maximum silence
+static void configureReportOnChange(void)
+{
+  for (uint8_t channel = 0; channel < KISS::REPORT_CHANNELS; channel++)
+    reportFilter.configure(channel, config.deadband[channel], KISS::REPORT_MAX_SILENCE_MS);
+}
+
+// Sample the accelerometer every config.samplePeriodMs into the statistics window until durationMs
+// passed, or, with stopOnRequest, until a downlink requested an uplink
+static void sampleAcceleration(const uint32_t durationMs, const bool stopOnRequest)
+{
+  const uint32_t start = millis();
+  while (millis() - start < durationMs && !(stopOnRequest && config.uplinkRequested))
+  {
+    int16_t raw[3];
+    ENERGY_PHASE(SENSOR_READ);
+    getAccelerationRaw(&raw[0], &raw[1], &raw[2]);
+    ENERGY_PHASE(ACTIVE);
+    for (uint8_t axis = 0; axis < 3; axis++)
+      accelerationWindow[axis].add(raw[axis]);
+#if WAKE_EVENTS
+    handleWakeEvents();
+    TRACE_FLUSH();
+    ENERGY_PHASE(IDLE_SLEEP);
+    KISSLoRa_sleep_idle_ms(config.samplePeriodMs); // Ends early on a button press or motion
+    ENERGY_PHASE(ACTIVE);
+#else
+    TRACE_FLUSH();
+    delay(config.samplePeriodMs);
+#endif
+  }
+}
+
+#if WAKE_EVENTS
+// Latch the wake pins that fired and, unless the hold-off since the last event uplink still runs,
+// send the events right away: the source mask on the presence channel, with the rotary position
+// and the acceleration, compacted when COMPACT_FRAMES is set. Events the duty cycle does not allow
+// now are sent after the next hold-off.
+static void handleWakeEvents(void)
+{
+  const uint8_t fired = KISSLoRa_sleep_take_wake_sources();
+  if (fired)
+  {
+    TRACE_EVENT(TraceEvent::TRACE_WAKE, fired);
+    wakeEvents.latch(fired);
+  }
+  if (fired & PAYLOAD_ENCODER::getWakeMask(PAYLOAD_ENCODER::WAKE_SOURCE::MOTION))
+    readAccelerometer(0x1E); // TRANSIENT_SRC: clears the event and releases INT1
+  if (!wakeEvents.isDue(millis()))
+    return;
+
+  float x, y, z;
+  ENERGY_PHASE(SENSOR_READ);
+  getAcceleration(&x, &y, &z);
+  const uint8_t rotaryPosition = static_cast<uint8_t>(getRotaryPosition());
+  ENERGY_PHASE(ENCODE);
+  const uint8_t sources = wakeEvents.take(millis());
+  PAYLOAD_ENCODER::CayenneLPP<64> event(PAYLOAD_ENCODER::getMaxPayloadSizeEU868(config.dataRate));
+  event.addPresence(static_cast<uint8_t>(NodeSensors::LPP_CH_PRESENCE), sources);
+  event.addDigitalInput(static_cast<uint8_t>(NodeSensors::LPP_CH_ROTARYSWITCH), rotaryPosition);
+  event.addAccelerometer(static_cast<uint8_t>(NodeSensors::LPP_CH_ACCELEROMETER), x, y, z);
+  const uint8_t *payload = event.getBuffer();
+  uint8_t payloadSize = event.getSize();
+  port_t fport = APPLICATION_FPORT_CAYENNE;
+#if COMPACT_FRAMES
+  uint8_t compact[64];
+  const size_t compactSize = PAYLOAD_ENCODER::compactFrame(KISS::KISS_PROFILE, payload, payloadSize, compact, sizeof(compact));
+  if (compactSize)
+  {
+    payload = compact;
+    payloadSize = static_cast<uint8_t>(compactSize);
+    fport = APPLICATION_FPORT_COMPACT;
+  }
+#endif
+  ENERGY_PHASE(ACTIVE);
+  if (!sendUplink(payload, payloadSize, fport))
+    wakeEvents.requeue(sources);
+}
+#endif
+#endif
+
+void message(const uint8_t *payload, size_t size, port_t port)
+{
+  if (port != APPLICATION_FPORT_COMMAND)
+  {
+    TRACE_EVENT(TraceEvent::TRACE_DOWNLINK_IGNORED, port);
+    return;
+  }
+
+  // All commands of the downlink are applied, or none of them.
+  const PAYLOAD_ENCODER::ValidationResult result = PAYLOAD_ENCODER::applyDownlink(payload, size, config);
+  if (result.error != PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OK)
+  {
+    TRACE_EVENT(TraceEvent::TRACE_DOWNLINK_REJECTED, result.offset);
+    return;
+  }
+  TRACE_EVENT(TraceEvent::TRACE_DOWNLINK_APPLIED, result.fieldCount);
+#ifdef CAYENNELPP_NEW
+  configureReportOnChange();
+#endif
 
   // Toggle red LED when a message is received
   pinMode(RGBLED_RED, OUTPUT);
   digitalWrite(RGBLED_RED, !digitalRead(RGBLED_RED));
 }
 
+// Read an ADC channel 4^ADC_OVERSAMPLING_BITS times in ADC Noise Reduction sleep and decimate the
+// conversions into one reading of 10 + ADC_OVERSAMPLING_BITS bits
+static uint16_t readOversampled(const uint8_t channel)
+{
+  PAYLOAD_ENCODER::Decimator decimator(ADC_OVERSAMPLING_BITS);
+  KISSLoRa_adc_select(channel);
+  while (!decimator.add(KISSLoRa_adc_read()));
+  return decimator.getResult();
+}
+
+#if VDD_FROM_ADC
+// Measure the supply by reading the MCU bandgap against it
+static uint16_t getSupplyMv(void)
+{
+  return PAYLOAD_ENCODER::getSupplyMv(readOversampled(KISSLORA_ADC_BANDGAP), ADC_OVERSAMPLING_BITS, BANDGAP_MV);
+}
+#endif
+
 // Get the lux value from the APDS-9007 Ambient Light Photo Sensor
 const float get_lux_value()
 {
-  int digital_value = analogRead(LIGHT_SENSOR_PIN);
-  double vlux = digital_value * (2.56 / 1023.0); // lux value in volts
+  const uint16_t digital_value = readOversampled(KISSLoRa_adc_pin_channel(LIGHT_SENSOR_PIN));
+  double vlux = digital_value * (2.56 / PAYLOAD_ENCODER::getOversampledFullScale(ADC_OVERSAMPLING_BITS)); // lux value in volts
   double ilux = (vlux / 56) * 1000;              // lux value in micro amperes
   double lux = pow(10, (ilux / 10));             // Convert ilux to Lux value
   return (float)lux;                             // Return Lux value as value without decimal
@@ -187,8 +479,20 @@ const uint8_t readAccelerometer(const uint8_t REG_ADDRESS)
 static void initAccelerometer(void)
 {
   // Check if the chip responds to the who-am-i command, should return 0x6A (106)
-  if (readAccelerometer(0x0D) == 106)
+  const uint8_t whoAmI = readAccelerometer(0x0D);
+  if (whoAmI == 106)
   {
+#if WAKE_EVENTS && MOTION_WAKE && defined(CAYENNELPP_NEW)
+    // Transient detection on INT1, set up in standby: high-pass filtered acceleration above
+    // MOTION_THRESHOLD_MG on any axis for MOTION_DEBOUNCE_SAMPLES samples latches an event,
+    // holding INT1 low until TRANSIENT_SRC (0x1E) is read. The filter removes gravity, so the
+    // orientation of the node does not matter.
+    writeAccelerometer(0x1D, 0x1E);                         // TRANSIENT_CFG: ELE latch, ZTEFE, YTEFE, XTEFE
+    writeAccelerometer(0x1F, MOTION_THRESHOLD_MG / 63);     // TRANSIENT_THS, 63 mg steps
+    writeAccelerometer(0x20, MOTION_DEBOUNCE_SAMPLES);      // TRANSIENT_COUNT
+    writeAccelerometer(0x2D, 0x20);                         // CTRL_REG4: INT_EN_TRANS
+    writeAccelerometer(0x2E, 0x20);                         // CTRL_REG5: INT_CFG_TRANS, transient interrupt on INT1
+#endif
     // Configure FXLS8471Q CTRL_REG1 register
     // Set f_read bit to activate fast read mode
     // Set active bit to put accelerometer in active mode
@@ -196,7 +500,7 @@ static void initAccelerometer(void)
   }
   else
   {
-    DEBUG_MSG_LN(F("--- I2C Accelerometer not initialized"));
+    TRACE_EVENT(TraceEvent::TRACE_ACC_NOT_INITIALIZED, whoAmI);
   }
 }
 
@@ -222,8 +526,8 @@ static void setAccelerometerRange(uint8_t range_g)
   writeAccelerometer(0x0E, range_b);
 }
 
-// Read the acceleration from the accelerometer
-void getAcceleration(float *x, float *y, float *z)
+// Read the raw 12 bit acceleration counts from the accelerometer
+void getAccelerationRaw(int16_t *x, int16_t *y, int16_t *z)
 {
   // Resource: https://github.com/sparkfun/MMA8452_Accelerometer/blob/master/Libraries/Arduino/src/SparkFun_MMA8452Q.cpp
   // Read the acceleration from registers 1 through 6 of the MMA8452 accelerometer.
@@ -232,11 +536,18 @@ void getAcceleration(float *x, float *y, float *z)
   *x = ((short)(readAccelerometer(1) << 8 | readAccelerometer(2))) >> 4;
   *y = ((short)(readAccelerometer(3) << 8 | readAccelerometer(4))) >> 4;
   *z = ((short)(readAccelerometer(5) << 8 | readAccelerometer(6))) >> 4;
+}
+
+// Read the acceleration from the accelerometer
+void getAcceleration(float *x, float *y, float *z)
+{
+  int16_t rawX, rawY, rawZ;
+  getAccelerationRaw(&rawX, &rawY, &rawZ);
 
   // Scale 12 bit signed values to units of g. The default measurement range is ±2g.
   // That is 11 bits for positive values and 11 bits for negative values.
   // value = (value / (2^11)) * 2
-  *x = (float)*x / (float)(1 << 11) * (float)(ACC_RANGE);
-  *y = (float)*y / (float)(1 << 11) * (float)(ACC_RANGE);
-  *z = (float)*z / (float)(1 << 11) * (float)(ACC_RANGE);
+  *x = (float)rawX / (float)(1 << 11) * (float)(ACC_RANGE);
+  *y = (float)rawY / (float)(1 << 11) * (float)(ACC_RANGE);
+  *z = (float)rawZ / (float)(1 << 11) * (float)(ACC_RANGE);
 }
\ No newline at end of file
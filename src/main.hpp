@@ -16,6 +16,16 @@
 
 #include <main.hpp>
 #include <SparkFun_Si7021_Breakout_Library.h>
+#include <TraceBuffer.hpp>
+#include <FixedPointConversion.hpp>
+#include <EnergyModel.hpp>
+#include <PhaseProfiler.hpp>
+#include <WakeEvents.hpp>
+#include <KISSLoRa_sleep.h>
+#include <Oversampling.hpp>
+#include <KISSLoRa_adc.h>
+#include <KissNode.hpp>
+#include "TraceEvents.hpp"
 
 /* DEVICE CONFIGURATION */
 #define loraSerial      Serial1
@@ -24,26 +34,69 @@
 #define freqPlan        TTN_FP_EU868 // The KISS device should only be used in Europe
 #define OTAA                         // ABP
 
-#define SF 9                        // Spreading Factor. 
+#define SF 9                        // Spreading Factor. Most robust SF used; the duty cycle planner may go faster.
+#define SF_MIN 7                    // Fastest Spreading Factor the duty cycle planner may fall back to.
+#define DUTY_CYCLE_SUB_BAND PAYLOAD_ENCODER::EU868_SUB_BAND::BAND_868_0_868_6 // TTN default channels, 1 % duty cycle.
 
 /* END OF DEVICE CONFIGURATION */
 #define LORA_BAUD_RATE 57600
 /* DEBUG CONFIG */
 #define DEBUG_BAUD_RATE 9600
 #define DEBUG 1
+#define TRACE_CAPACITY 24           // Trace records buffered between flushes, 9 bytes of RAM each
 
+// Trace events are binary records in a RAM ring buffer, written to debugSerial by TRACE_FLUSH()
+// when it has room; decode them with tools/trace_print.cpp.
 #if DEBUG
 #define DEBUG_SERIAL_BEGIN() debugSerial.begin(DEBUG_BAUD_RATE)
-#define DEBUG_MSG(x) debugSerial.print(x)
-
-#define DEBUG_MSG_LN(x) debugSerial.println(x)
+#define TRACE_EVENT(event, value) trace.log(static_cast<uint8_t>(event), millis(), static_cast<int32_t>(value))
+#define TRACE_MILLI(event, value) TRACE_EVENT(event, PAYLOAD_ENCODER::roundHalfAwayFromZero((value) * 1000.0f))
+#define TRACE_FLUSH() flushTrace()
 #else
 #define DEBUG_SERIAL_BEGIN()
-#define DEBUG_MSG(x)
-#define DEBUG_MSG_LN(x)
+#define TRACE_EVENT(event, value)
+#define TRACE_MILLI(event, value)
+#define TRACE_FLUSH()
 #endif
 
 /* END OF DEBUG CONFIG */
+/* ENERGY CONFIG */
+#define ENERGY 1                    // Book the time of every phase on its supply current, see include/EnergyModel.hpp
+
+#if ENERGY
+#define ENERGY_PHASE(phase) energy.begin(PAYLOAD_ENCODER::ENERGY_PHASE::phase, micros())
+#else
+#define ENERGY_PHASE(phase)
+#endif
+/* END OF ENERGY CONFIG */
+/* PROFILER CONFIG */
+#define PROFILER 1                  // Time the loop() phases and count full-payload add* calls and budget drops, see include/PhaseProfiler.hpp
+#define DIAGNOSTICS_EVERY_UPLINKS 72 // Send the profile on APPLICATION_FPORT_DIAGNOSTICS after this many sensor uplinks; with report-on-change an hour when every cycle sends, at most 72 hours
+
+#if PROFILER
+#define PROFILE_BEGIN(phase) profiler.begin(PAYLOAD_ENCODER::PROFILE_PHASE::phase, micros())
+#define PROFILE_END() profiler.end(micros())
+#define PROFILE_ADD(call) profiler.countAdd(call)
+#else
+#define PROFILE_BEGIN(phase)
+#define PROFILE_END()
+#define PROFILE_ADD(call) (call)
+#endif
+/* END OF PROFILER CONFIG */
+/* WAKE CONFIG */
+#define WAKE_EVENTS 1               // Idle between accelerometer samples; a button press (or a shake, with MOTION_WAKE) wakes the node for an event uplink, see include/WakeEvents.hpp
+#ifndef MOTION_WAKE
+#define MOTION_WAKE 0               // 1: FXLS8471Q INT1 wakes the node too; off until ACC_INT_PIN is confirmed on the board schematic. sim/kiss_sim.cpp defines it as 1
+#endif
+#define EVENT_HOLDOFF_MS 30000UL    // Shortest time between two event uplinks; events in between are sent together afterwards
+#define MOTION_THRESHOLD_MG 252     // High-pass filtered acceleration that counts as motion, steps of 63 mg
+#define MOTION_DEBOUNCE_SAMPLES 4   // Samples above the threshold before motion is reported, 800 Hz data rate
+/* END OF WAKE CONFIG */
+/* ADC CONFIG */
+#define ADC_OVERSAMPLING_BITS 3     // Bits gained by oversampling: 4^3 = 64 conversions in ADC Noise Reduction sleep per 13-bit reading, see include/Oversampling.hpp
+#define VDD_FROM_ADC 0              // 1: measure the supply against the MCU bandgap instead of asking the RN2483; saves a UART round trip, but only 10 % accurate uncalibrated
+#define BANDGAP_MV 1100             // Bandgap voltage; measure it once per board for VDD_FROM_ADC
+/* END OF ADC CONFIG */
 /* PIN DEFINES */
 
 // defines for LEDs
@@ -60,11 +113,23 @@
 
 #define LIGHT_SENSOR_PIN 10     // Define for Analog inpu pin
 #define BUTTON_PIN 7            // defines for pushbutton 
+#define ACC_INT_PIN 16          // FXLS8471Q INT1, UNCONFIRMED: 16 is MOSI (PB2), an assumed PCINT routing, not a schematic net; only used with MOTION_WAKE
 #define ACC_RANGE 2             // Set up to read the accelerometer values in range -2g to +2g - valid ranges: ±2G,±4G or ±8G
 
 /* END OF PIN DEFINES */
 
-#define APPLICATION_FPORT_CAYENNE 1 ///< LoRaWAN port to which CayenneLPP packets shall be sent
+// FPorts, channels and the compact frame profile are in include/KissNode.hpp, shared with the decoders.
+#define APPLICATION_FPORT_CAYENNE KISS::FPORT_CAYENNE ///< LoRaWAN port to which CayenneLPP packets shall be sent
+#define APPLICATION_FPORT_COMPACT KISS::FPORT_COMPACT ///< LoRaWAN port to which compact frames (profile ID + channel bitmap) shall be sent
+#define COMPACT_FRAMES 1            ///< 1: send compact frames when every field is in the profile, 0: always send CayenneLPP
+#define APPLICATION_FPORT_DIAGNOSTICS KISS::FPORT_DIAGNOSTICS ///< LoRaWAN port to which the phase profile (CayenneLPP, see PhaseProfiler::report) shall be sent
+#define APPLICATION_FPORT_COMMAND KISS::FPORT_COMMAND ///< LoRaWAN port on which binary downlink commands are accepted
+#define UPLINK_INTERVAL_MS 50000    ///< Time between two measurement cycles
+#define ACC_SAMPLE_PERIOD_MS 50     ///< Accelerometer sampling period between uplinks (20 Hz) for the vibration statistics
+
+/* REPORT-ON-CHANGE CONFIG */
+// Deadbands, maximum silence and field priorities are in include/KissNode.hpp, shared with tools/fleet_gen.
+/* END OF REPORT-ON-CHANGE CONFIG */
 
 #if defined(OTAA)
 // HAN KISS-xx: devEui is device specific
@@ -80,26 +145,52 @@ const char *appSKey = "00000000000000000000000000000000";
 
 /* GLOBAL VARIABLES: */
 Weather sensor; // temperature and humidity sensor
+#if DEBUG
+PAYLOAD_ENCODER::TraceBuffer<TRACE_CAPACITY> trace; // binary trace records waiting for the serial port
+#endif
+#if ENERGY
+PAYLOAD_ENCODER::EnergyAccount energy; // time and charge per phase, KISS node currents
+#endif
+#if PROFILER
+PAYLOAD_ENCODER::PhaseProfiler profiler; // duration per loop() phase and add* overflows since the last diagnostics uplink
+#endif
+#if WAKE_EVENTS && defined(CAYENNELPP_NEW)
+PAYLOAD_ENCODER::WakeEvents wakeEvents(EVENT_HOLDOFF_MS); // button and motion events waiting for an event uplink
+#endif
 
 /* FUNCTION PROTOTYPES */
 static inline void initialize();
 static void initAccelerometer(void);
 static void setAccelerometerRange(uint8_t range_g);
 const float get_lux_value();
+static uint16_t readOversampled(const uint8_t channel);
+#if VDD_FROM_ADC
+static uint16_t getSupplyMv(void);
+#endif
 const int8_t getRotaryPosition();
+void writeAccelerometer(const uint8_t REG_ADDRESS, const uint8_t DATA);
+const uint8_t readAccelerometer(const uint8_t REG_ADDRESS);
+void getAccelerationRaw(int16_t *x, int16_t *y, int16_t *z);
 void getAcceleration(float *x, float *y, float *z);
 void message(const uint8_t *payload, size_t size, port_t port);
+bool sendUplink(const uint8_t *payload, const uint8_t size, const port_t port);
+#if DEBUG
+static void flushTrace(void);
+#endif
+#if PROFILER
+static bool sendDiagnostics(void);
+#endif
+#ifdef CAYENNELPP_NEW
+static void configureReportOnChange(void);
+static void sampleAcceleration(const uint32_t durationMs, const bool stopOnRequest);
+#if WAKE_EVENTS
+static void handleWakeEvents(void);
+#endif
+#endif
 TheThingsNetwork ttn(loraSerial, debugSerial, freqPlan); // TTN object for LoRaWAN radio
 
-enum class NodeSensors : uint8_t {
-  LPP_CH_TEMPERATURE        = 0,    ///< CayenneLPP CHannel for Temperature
-  LPP_CH_HUMIDITY           = 1,    ///< CayenneLPP CHannel for Humidity sensor
-  LPP_CH_LUMINOSITY         = 2,    ///< CayenneLPP CHannel for Luminosity sensor
-  LPP_CH_ROTARYSWITCH       = 3,    ///< CayenneLPP CHannel for Rotary switch
-  LPP_CH_ACCELEROMETER      = 4,    ///< CayenneLPP CHannel for Accelerometer
-  LPP_CH_BOARDVCCVOLTAGE    = 5,    ///< CayenneLPP CHannel for Processor voltage
-  LPP_CH_PRESENCE           = 6,    ///< CayenneLPP CHannel for Alarm
-};
+using KISS::NodeSensors;
+using KISS::FieldPriority;
 
 static inline void initialize() {
   loraSerial.begin(LORA_BAUD_RATE);
@@ -137,13 +228,29 @@ static inline void initialize() {
   initAccelerometer();
   setAccelerometerRange(ACC_RANGE);
 
+#if WAKE_EVENTS && defined(CAYENNELPP_NEW)
+  // Both inputs are active low: the button closes to ground, INT1 is push-pull, active low.
+  pinMode(BUTTON_PIN, INPUT_PULLUP);
+  KISSLoRa_sleep_init();
+  KISSLoRa_sleep_wake_on_pin(BUTTON_PIN, PAYLOAD_ENCODER::getWakeMask(PAYLOAD_ENCODER::WAKE_SOURCE::BUTTON));
+#if MOTION_WAKE
+  pinMode(ACC_INT_PIN, INPUT);
+  KISSLoRa_sleep_wake_on_pin(ACC_INT_PIN, PAYLOAD_ENCODER::getWakeMask(PAYLOAD_ENCODER::WAKE_SOURCE::MOTION));
+  // The transient interrupt was armed by initAccelerometer(); an event latched before the pin
+  // was registered would hold INT1 low and never wake the node, so release it.
+  readAccelerometer(0x1E); // TRANSIENT_SRC
+#endif
+#endif
+
   // Initialize LoRaWAN radio
   ttn.onMessage(message); // Set callback for incoming messages
   ttn.reset(true);        // Reset LoRaWAN mac and enable ADR
 
-  DEBUG_MSG_LN("-- STATUS");
+  TRACE_EVENT(TraceEvent::TRACE_STATUS, 0);
+  TRACE_FLUSH();
   ttn.showStatus();
-  DEBUG_MSG_LN("-- JOIN");
+  TRACE_EVENT(TraceEvent::TRACE_JOIN, 0);
+  TRACE_FLUSH();
 
 #if defined(OTAA)
   ttn.join(appEui, appKey);
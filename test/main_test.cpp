@@ -8,7 +8,24 @@
 
 #include <unity.h>
 #include "../include/CayenneLPP.hpp"
+#include "../include/CayenneDecoder.hpp"
+#include "../include/CayenneValidator.hpp"
+#include "../include/LoRaWANParameters.hpp"
+#include "../include/CayenneBudgetFrame.hpp"
+#include "../include/LoRaAirtime.hpp"
+#include "../include/ReportOnChange.hpp"
+#include "../include/StreamingAggregator.hpp"
+#include "../include/CompactFrame.hpp"
+#include "../include/DownlinkCommands.hpp"
+#include "../include/TraceBuffer.hpp"
+#include "../include/EnergyModel.hpp"
+#include "../include/PhaseProfiler.hpp"
+#include "../include/WakeEvents.hpp"
+#include "../include/Oversampling.hpp"
+#include <cmath>
 #include <cstring>
+#include <type_traits>
+#include <utility>
 
 #define BUF_DEFAULT 64
 
@@ -308,6 +325,1193 @@ void test_CopyToNullBuffer(void) {
     TEST_ASSERT_EQUAL_UINT8(0, copiedBytes);
 }
 
+// Builds the six-field frame sent by the KISS node in loop().
+static void buildKissFrame(PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT>& lpp, float temperature) {
+    lpp.reset();
+    lpp.addDigitalInput(3, 4);
+    lpp.addTemperature(0, temperature);
+    lpp.addHumidity(1, 45.5f);
+    lpp.addIllumination(2, 320);
+    lpp.addAccelerometer(4, 0.012f, -0.98f, 0.051f);
+    lpp.addAnalogInput(5, 3.31f);
+}
+
+void test_Decoder_RoundTrip(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    buildKissFrame(lpp, 21.4f);
+    PAYLOAD_ENCODER::CayenneDecoder<8> decoder;
+    PAYLOAD_ENCODER::DecodedField fields[8];
+
+    size_t count = decoder.decode(lpp.getBuffer(), lpp.getSize(), fields);
+
+    TEST_ASSERT_EQUAL_size_t(6, count);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::DIG_IN), static_cast<uint8_t>(fields[0].type));
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, fields[0].values[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, fields[1].channel);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 21.4f, fields[1].values[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 45.5f, fields[2].values[0]);
+    TEST_ASSERT_EQUAL_FLOAT(320.0f, fields[3].values[0]);
+    TEST_ASSERT_EQUAL_UINT8(3, fields[4].valueCount);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, -0.98f, fields[4].values[1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 3.31f, fields[5].values[0]);
+}
+
+void test_Decoder_LayoutCacheHit(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    PAYLOAD_ENCODER::CayenneDecoder<8> decoder;
+    PAYLOAD_ENCODER::DecodedField cached[8];
+    PAYLOAD_ENCODER::DecodedField walked[8];
+
+    buildKissFrame(lpp, 20.0f);
+    decoder.decode(lpp.getBuffer(), lpp.getSize(), cached);
+    buildKissFrame(lpp, -7.3f);
+    size_t count = decoder.decode(lpp.getBuffer(), lpp.getSize(), cached);
+    size_t expected = PAYLOAD_ENCODER::CayenneDecoder<8>::decodeUncached(lpp.getBuffer(), lpp.getSize(), walked);
+
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.getCacheMisses());
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.getCacheHits());
+    TEST_ASSERT_EQUAL_size_t(expected, count);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_UINT8(walked[i].channel, cached[i].channel);
+        TEST_ASSERT_EQUAL_FLOAT(walked[i].values[0], cached[i].values[0]);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, -7.3f, cached[1].values[0]);
+}
+
+void test_Decoder_LayoutChangeMisses(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    PAYLOAD_ENCODER::CayenneDecoder<8> decoder;
+    PAYLOAD_ENCODER::DecodedField fields[8];
+
+    lpp.addTemperature(1, 20.0f);
+    lpp.addHumidity(2, 50.0f);
+    decoder.decode(lpp.getBuffer(), lpp.getSize(), fields);
+    // Same size and first header, different channel on the second field.
+    lpp.reset();
+    lpp.addTemperature(1, 20.0f);
+    lpp.addHumidity(3, 50.0f);
+    size_t count = decoder.decode(lpp.getBuffer(), lpp.getSize(), fields);
+
+    TEST_ASSERT_EQUAL_size_t(2, count);
+    TEST_ASSERT_EQUAL_UINT8(3, fields[1].channel);
+    TEST_ASSERT_EQUAL_UINT32(0, decoder.getCacheHits());
+    TEST_ASSERT_EQUAL_UINT32(2, decoder.getCacheMisses());
+}
+
+void test_Decoder_MalformedPayload(void) {
+    PAYLOAD_ENCODER::CayenneDecoder<8> decoder;
+    PAYLOAD_ENCODER::DecodedField fields[8];
+    const uint8_t unknownType[] = {0x55, 0x01, 0x00};
+    const uint8_t truncated[] = {103, 0x01, 0xFF};
+
+    TEST_ASSERT_EQUAL_size_t(0, decoder.decode(unknownType, sizeof(unknownType), fields));
+    TEST_ASSERT_EQUAL_size_t(0, decoder.decode(truncated, sizeof(truncated), fields));
+    TEST_ASSERT_EQUAL_size_t(0, decoder.decode(nullptr, 4, fields));
+}
+
+void test_Validator_ValidFrame(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    buildKissFrame(lpp, 21.4f);
+
+    PAYLOAD_ENCODER::ValidationResult result = PAYLOAD_ENCODER::validatePayload(lpp.getBuffer(), lpp.getSize());
+
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OK), static_cast<uint8_t>(result.error));
+    TEST_ASSERT_EQUAL_size_t(lpp.getSize(), result.offset);
+    TEST_ASSERT_EQUAL_size_t(6, result.fieldCount);
+}
+
+void test_Validator_UnknownType(void) {
+    const uint8_t payload[] = {103, 0x01, 0xFF, 0x00, 0x55, 0x02, 0x00};
+
+    PAYLOAD_ENCODER::ValidationResult result = PAYLOAD_ENCODER::validatePayload(payload, sizeof(payload));
+
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_UNKOWN_TYPE), static_cast<uint8_t>(result.error));
+    TEST_ASSERT_EQUAL_size_t(4, result.offset);
+    TEST_ASSERT_EQUAL_size_t(1, result.fieldCount);
+}
+
+void test_Validator_Truncated(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    lpp.addTemperature(1, 20.0f);
+    lpp.addAccelerometer(2, 0.1f, 0.2f, 0.3f);
+    const uint8_t header[] = {103};
+
+    PAYLOAD_ENCODER::ValidationResult result = PAYLOAD_ENCODER::validatePayload(lpp.getBuffer(), lpp.getSize() - 1);
+    PAYLOAD_ENCODER::ValidationResult headerOnly = PAYLOAD_ENCODER::validatePayload(header, sizeof(header));
+
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_TRUNCATED), static_cast<uint8_t>(result.error));
+    TEST_ASSERT_EQUAL_size_t(4, result.offset);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_TRUNCATED), static_cast<uint8_t>(headerOnly.error));
+    TEST_ASSERT_EQUAL_size_t(0, headerOnly.offset);
+}
+
+void test_Validator_OutOfRange(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> humidity(BUF_DEFAULT);
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> gps(BUF_DEFAULT);
+    humidity.addTemperature(1, 20.0f);
+    humidity.addHumidity(2, 120.0f);
+    gps.addGPSLocation(3, 51.98f, 190.0f, 10.0f);
+
+    PAYLOAD_ENCODER::ValidationResult humResult = PAYLOAD_ENCODER::validatePayload(humidity.getBuffer(), humidity.getSize());
+    PAYLOAD_ENCODER::ValidationResult gpsResult = PAYLOAD_ENCODER::validatePayload(gps.getBuffer(), gps.getSize());
+
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OUT_OF_RANGE), static_cast<uint8_t>(humResult.error));
+    TEST_ASSERT_EQUAL_size_t(6, humResult.offset);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OUT_OF_RANGE), static_cast<uint8_t>(gpsResult.error));
+    TEST_ASSERT_EQUAL_size_t(6, gpsResult.offset); // Longitude follows the 4-byte latitude.
+}
+
+void test_Validator_Overflow(void) {
+    uint8_t payload[64] = {0};
+
+    PAYLOAD_ENCODER::ValidationResult result = PAYLOAD_ENCODER::validatePayload(payload, sizeof(payload), 51);
+
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OVERFLOW), static_cast<uint8_t>(result.error));
+    TEST_ASSERT_EQUAL_size_t(51, result.offset);
+}
+
+void test_Validator_CountsBeyond255Fields(void) {
+    static uint8_t payload[300 * 3] = {0};                              // 300 digital inputs on channel 0
+
+    PAYLOAD_ENCODER::ValidationResult result = PAYLOAD_ENCODER::validatePayload(payload, sizeof(payload), sizeof(payload));
+
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OK), static_cast<uint8_t>(result.error));
+    TEST_ASSERT_EQUAL_size_t(300, result.fieldCount);
+}
+
+void test_Validator_StandardUnknownType(void) {
+    // [channel][type]: the offset points at the type byte, behind the channel.
+    const uint8_t payload[] = {0x01, 103, 0x00, 0xFF, 0x02, 0x55, 0x00};
+
+    PAYLOAD_ENCODER::ValidationResult result = PAYLOAD_ENCODER::validatePayload(payload, sizeof(payload), 255, PAYLOAD_ENCODER::PAYLOAD_ENCODING::STANDARD);
+
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_UNKOWN_TYPE), static_cast<uint8_t>(result.error));
+    TEST_ASSERT_EQUAL_size_t(5, result.offset);
+    TEST_ASSERT_EQUAL_size_t(1, result.fieldCount);
+}
+
+void test_CayenneLPP_CopyAssignmentKeepsOperationalSize(void) {
+    PAYLOAD_ENCODER::CayenneLPP<64> source(64);
+    PAYLOAD_ENCODER::CayenneLPP<64> target(4);
+    source.addTemperature(1, 20.0f);
+
+    target = source;
+    uint8_t result = target.addHumidity(2, 50.0f); // Would not fit in the old operational size of 4.
+
+    TEST_ASSERT_EQUAL_UINT8(8, result);
+    TEST_ASSERT_EQUAL_size_t(8, target.getSize());
+}
+
+void test_CayenneLPP_MoveConstruction(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> source(BUF_DEFAULT);
+    buildKissFrame(source, 19.9f);
+    uint8_t expected[BUF_DEFAULT];
+    const uint8_t expectedSize = source.copy(expected);
+
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> moved(std::move(source));
+
+    TEST_ASSERT_EQUAL_size_t(expectedSize, moved.getSize());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, moved.getBuffer(), expectedSize);
+}
+
+void test_CayenneLPP_TriviallyCopyable(void) {
+    TEST_ASSERT_TRUE(std::is_trivially_copyable<PAYLOAD_ENCODER::CayenneLPP<52>>::value);
+    TEST_ASSERT_TRUE(std::is_trivially_move_constructible<PAYLOAD_ENCODER::CayenneLPP<52>>::value);
+    TEST_ASSERT_TRUE(std::is_trivially_destructible<PAYLOAD_ENCODER::CayenneLPP<52>>::value);
+}
+
+void test_Append_AllFragmentsFit(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> uplink(51);
+    PAYLOAD_ENCODER::CayenneLPP<8> sensors(8);
+    PAYLOAD_ENCODER::CayenneLPP<16> diagnostics(16);
+    sensors.addTemperature(0, 21.0f);
+    sensors.addHumidity(1, 40.0f);
+    diagnostics.addAnalogInput(5, 3.3f);
+    diagnostics.addDigitalInput(7, 1);
+
+    size_t takenSensors = uplink.append(sensors);
+    size_t takenDiagnostics = uplink.append(diagnostics);
+
+    TEST_ASSERT_EQUAL_size_t(sensors.getSize(), takenSensors);
+    TEST_ASSERT_EQUAL_size_t(diagnostics.getSize(), takenDiagnostics);
+    TEST_ASSERT_EQUAL_size_t(15, uplink.getSize());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(sensors.getBuffer(), uplink.getBuffer(), sensors.getSize());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(diagnostics.getBuffer(), uplink.getBuffer() + sensors.getSize(), diagnostics.getSize());
+}
+
+void test_Append_CarryOverRemainder(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> uplink(12);
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> fragment(BUF_DEFAULT);
+    uplink.addTemperature(0, 21.0f);
+    fragment.addHumidity(1, 40.0f);
+    fragment.addAccelerometer(4, 0.0f, 0.0f, 1.0f);
+    fragment.addDigitalInput(3, 2);
+
+    size_t taken = uplink.append(fragment);
+    size_t remaining = fragment.discardFront(taken);
+
+    // Only the humidity field fits next to the temperature; the rest is carried over whole.
+    TEST_ASSERT_EQUAL_size_t(4, taken);
+    TEST_ASSERT_EQUAL_size_t(8, uplink.getSize());
+    TEST_ASSERT_EQUAL_size_t(11, remaining);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS), fragment.getBuffer()[0]);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::DIG_IN), fragment.getBuffer()[8]);
+}
+
+void test_SetOperationalSize_FromSpreadingFactor(void) {
+    PAYLOAD_ENCODER::CayenneLPP<222> lpp(51);
+
+    size_t sf9 = lpp.setOperationalSize(PAYLOAD_ENCODER::getMaxPayloadSizeEU868(PAYLOAD_ENCODER::getDataRateEU868(9)));
+    size_t sf7 = lpp.setOperationalSize(PAYLOAD_ENCODER::getMaxPayloadSizeEU868(PAYLOAD_ENCODER::getDataRateEU868(7)));
+    size_t sf12 = lpp.setOperationalSize(PAYLOAD_ENCODER::getMaxPayloadSizeEU868(PAYLOAD_ENCODER::getDataRateEU868(12)));
+
+    TEST_ASSERT_EQUAL_size_t(115, sf9);
+    TEST_ASSERT_EQUAL_size_t(222, sf7);
+    TEST_ASSERT_EQUAL_size_t(51, sf12);
+    TEST_ASSERT_EQUAL_size_t(51, lpp.getOperationalSize());
+}
+
+void test_BudgetFrame_AllFieldsFit(void) {
+    PAYLOAD_ENCODER::CayenneBudgetFrame<BUF_DEFAULT> budgetFrame;
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> expected(BUF_DEFAULT);
+    expected.addTemperature(0, 21.0f);
+    expected.addAnalogInput(5, 3.3f);
+
+    budgetFrame.stage(1).addTemperature(0, 21.0f);
+    budgetFrame.stage(9).addAnalogInput(5, 3.3f);
+    const PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT>& frame = budgetFrame.build(0);
+
+    // Staging order is kept, whatever the priorities.
+    TEST_ASSERT_EQUAL_size_t(expected.getSize(), frame.getSize());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.getBuffer(), frame.getBuffer(), expected.getSize());
+    TEST_ASSERT_EQUAL_UINT8(0, budgetFrame.getDroppedCount());
+}
+
+void test_BudgetFrame_DropsLowPriority(void) {
+    PAYLOAD_ENCODER::CayenneBudgetFrame<BUF_DEFAULT> budgetFrame;
+
+    budgetFrame.stage(5).addTemperature(0, 21.0f);                     // 4 bytes
+    budgetFrame.stage(3).addAccelerometer(4, 0.0f, 0.0f, 1.0f);        // 8 bytes, does not fit
+    budgetFrame.stage(1).addDigitalInput(3, 7);                        // 3 bytes, still fits
+    budgetFrame.stage(0).addHumidity(1, 50.0f);                        // 4 bytes, does not fit
+    const PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT>& frame = budgetFrame.buildWithBudget(10);
+
+    TEST_ASSERT_EQUAL_size_t(7, frame.getSize());
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::TEMP_SENS), frame.getBuffer()[0]);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::DIG_IN), frame.getBuffer()[4]);
+    TEST_ASSERT_EQUAL_UINT8(2, budgetFrame.getDroppedCount());
+    TEST_ASSERT_EQUAL_UINT8(0, budgetFrame.getDeferredCount());
+}
+
+void test_BudgetFrame_DefersToNextBuild(void) {
+    PAYLOAD_ENCODER::CayenneBudgetFrame<BUF_DEFAULT> budgetFrame;
+
+    budgetFrame.stage(5).addTemperature(0, 21.0f);
+    budgetFrame.stage(1, PAYLOAD_ENCODER::OVERFLOW_POLICY::DEFER).addAnalogInput(5, 3.3f);
+    size_t first = budgetFrame.buildWithBudget(4).getSize();
+    uint8_t deferred = budgetFrame.getDeferredCount();
+    budgetFrame.stage(5).addTemperature(0, 22.0f);
+    const PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT>& second = budgetFrame.buildWithBudget(51);
+
+    TEST_ASSERT_EQUAL_size_t(4, first);
+    TEST_ASSERT_EQUAL_UINT8(1, deferred);
+    TEST_ASSERT_EQUAL_size_t(8, second.getSize());
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::ANL_IN), second.getBuffer()[0]);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::TEMP_SENS), second.getBuffer()[4]);
+    TEST_ASSERT_EQUAL_UINT8(0, budgetFrame.getDeferredCount());
+}
+
+void test_BudgetFrame_DropsUnfittableDeferredGroup(void) {
+    // A deferred group beyond the DR5 payload would never be selected and hold its staging bytes forever.
+    PAYLOAD_ENCODER::CayenneBudgetFrame<255> budgetFrame;
+
+    PAYLOAD_ENCODER::CayenneLPP<255> &staging = budgetFrame.stage(1, PAYLOAD_ENCODER::OVERFLOW_POLICY::DEFER);
+    for (uint8_t channel = 0; channel < 28; channel++)
+        staging.addAccelerometer(channel, 0.0f, 0.0f, 1.0f);                // 224 bytes
+    budgetFrame.stage(5).addTemperature(0, 21.0f);
+    const size_t first = budgetFrame.build(5).getSize();
+    const uint8_t dropped = budgetFrame.getDroppedCount();
+    budgetFrame.stage(5).addTemperature(0, 22.0f);
+    const PAYLOAD_ENCODER::CayenneLPP<255>& second = budgetFrame.build(5);
+
+    TEST_ASSERT_EQUAL_size_t(222, PAYLOAD_ENCODER::CayenneBudgetFrame<255>::getLargestBudget());
+    TEST_ASSERT_EQUAL_size_t(64, PAYLOAD_ENCODER::CayenneBudgetFrame<BUF_DEFAULT>::getLargestBudget());
+    TEST_ASSERT_EQUAL_size_t(4, first);
+    TEST_ASSERT_EQUAL_UINT8(1, dropped);
+    TEST_ASSERT_EQUAL_UINT8(0, budgetFrame.getDeferredCount());
+    TEST_ASSERT_EQUAL_size_t(4, second.getSize());
+}
+
+void test_BudgetFrame_StandardEncoding(void) {
+    // Channel-first headers: contains() must read the channel from the first header byte.
+    PAYLOAD_ENCODER::CayenneBudgetFrame<BUF_DEFAULT, 16, PAYLOAD_ENCODER::PAYLOAD_ENCODING::STANDARD> budgetFrame;
+
+    budgetFrame.stage(5).addTemperature(3, 21.0f);                     // 4 bytes
+    budgetFrame.stage(1).addHumidity(1, 50.0f);                        // 3 bytes, does not fit
+    const PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT, PAYLOAD_ENCODER::PAYLOAD_ENCODING::STANDARD>& frame = budgetFrame.buildWithBudget(5);
+
+    TEST_ASSERT_EQUAL_size_t(4, frame.getSize());
+    TEST_ASSERT_EQUAL_UINT8(3, frame.getBuffer()[0]);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::TEMP_SENS), frame.getBuffer()[1]);
+    TEST_ASSERT_TRUE(budgetFrame.contains(3));
+    TEST_ASSERT_FALSE(budgetFrame.contains(1));
+    TEST_ASSERT_FALSE(budgetFrame.contains(static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::TEMP_SENS)));
+    TEST_ASSERT_EQUAL_UINT8(1, budgetFrame.getDroppedCount());
+}
+
+void test_Airtime_PublishedValues(void) {
+    // Reference values of the Semtech LoRa calculator / TTN airtime calculator (125 kHz, CR 4/5, 8 preamble symbols).
+    TEST_ASSERT_EQUAL_UINT32(46336, PAYLOAD_ENCODER::getUplinkTimeOnAirUs(0, 7));
+    TEST_ASSERT_EQUAL_UINT32(1155072, PAYLOAD_ENCODER::getUplinkTimeOnAirUs(0, 12));
+    TEST_ASSERT_EQUAL_UINT32(2793472, PAYLOAD_ENCODER::getUplinkTimeOnAirUs(51, 12));
+    TEST_ASSERT_EQUAL_UINT32(267264, PAYLOAD_ENCODER::getUplinkTimeOnAirUs(26, 9));
+    TEST_ASSERT_EQUAL_UINT32(30848, PAYLOAD_ENCODER::getTimeOnAirUs(7, 250, PAYLOAD_ENCODER::LORA_CODING_RATE::CR_4_5, 23));
+    TEST_ASSERT_EQUAL_UINT32(0, PAYLOAD_ENCODER::getTimeOnAirUs(6, 125, PAYLOAD_ENCODER::LORA_CODING_RATE::CR_4_5, 23));
+}
+
+void test_DutyCycle_BlocksWhenCreditSpent(void) {
+    PAYLOAD_ENCODER::DutyCycleLimiter limiter(0);
+    const PAYLOAD_ENCODER::EU868_SUB_BAND band = PAYLOAD_ENCODER::EU868_SUB_BAND::BAND_868_0_868_6;
+    const uint32_t toa = PAYLOAD_ENCODER::getUplinkTimeOnAirUs(51, 12); // 2.79 s, 1 % allows 36 s per hour.
+    uint8_t sent = 0;
+
+    while (limiter.consume(band, toa)) {
+        sent++;
+    }
+    uint32_t wait = limiter.getWaitTimeMs(band, toa);
+    limiter.update(wait);
+
+    TEST_ASSERT_EQUAL_UINT8(12, sent);
+    TEST_ASSERT_GREATER_THAN(0, wait);
+    TEST_ASSERT_LESS_OR_EQUAL(toa / 10, wait); // toa * 100 us of waiting, in ms.
+    TEST_ASSERT_TRUE(limiter.canTransmit(band, toa));
+    TEST_ASSERT_FALSE(limiter.canTransmit(PAYLOAD_ENCODER::EU868_SUB_BAND::BAND_863_865, 40000000UL));
+}
+
+void test_DutyCycle_SelectsSpreadingFactor(void) {
+    PAYLOAD_ENCODER::DutyCycleLimiter limiter(0);
+    const PAYLOAD_ENCODER::EU868_SUB_BAND band = PAYLOAD_ENCODER::EU868_SUB_BAND::BAND_868_0_868_6;
+
+    uint8_t robust = limiter.selectSpreadingFactor(band, 26, 7, 12);
+    uint8_t large = limiter.selectSpreadingFactor(band, 100, 7, 12); // Does not fit SF10-12 (51 bytes).
+    while (limiter.consume(band, PAYLOAD_ENCODER::getUplinkTimeOnAirUs(26, 12))) {}
+    uint8_t throttled = limiter.selectSpreadingFactor(band, 26, 7, 12);
+
+    TEST_ASSERT_EQUAL_UINT8(12, robust);
+    TEST_ASSERT_EQUAL_UINT8(9, large);
+    TEST_ASSERT_LESS_THAN(12, throttled);
+}
+
+void test_ReportOnChange_Deadband(void) {
+    PAYLOAD_ENCODER::ReportOnChange<8> filter;
+    filter.configure(0, 0.5f, 0);
+
+    bool first = filter.update(0, 20.0f, 0);
+    filter.commit(0);
+    bool small = filter.update(0, 20.4f, 1000);
+    bool large = filter.update(0, 20.6f, 2000);
+    filter.commit(2000);
+    bool againSmall = filter.update(0, 20.9f, 3000); // Compared with 20.6, the last transmitted value.
+
+    TEST_ASSERT_TRUE(first);
+    TEST_ASSERT_FALSE(small);
+    TEST_ASSERT_TRUE(large);
+    TEST_ASSERT_FALSE(againSmall);
+}
+
+void test_ReportOnChange_MaxSilence(void) {
+    PAYLOAD_ENCODER::ReportOnChange<8> filter;
+    filter.configure(1, 1.0f, 60000);
+
+    filter.update(1, 50.0f, 0);
+    filter.commit(0);
+    bool beforeTimeout = filter.update(1, 50.0f, 59999);
+    bool atTimeout = filter.update(1, 50.0f, 60000);
+
+    TEST_ASSERT_FALSE(beforeTimeout);
+    TEST_ASSERT_TRUE(atTimeout);
+}
+
+void test_ReportOnChange_DiscardKeepsReference(void) {
+    PAYLOAD_ENCODER::ReportOnChange<8> filter;
+    filter.configure(4, 0.05f, 0);
+
+    filter.update(4, 0.0f, 0.0f, 1.0f, 0);
+    filter.commit(0);
+    bool moved = filter.update(4, 0.0f, 0.1f, 1.0f, 1000);
+    filter.discard(); // Uplink was not sent.
+    bool stillMoved = filter.update(4, 0.0f, 0.1f, 1.0f, 2000);
+    bool untracked = filter.update(9, 1.0f, 2000);
+
+    TEST_ASSERT_TRUE(moved);
+    TEST_ASSERT_TRUE(stillMoved);
+    TEST_ASSERT_TRUE(untracked);
+}
+
+void test_ReportOnChange_CommitsSentChannelsOnly(void) {
+    // A change dropped for the payload budget must stay unreported, not wait for the maximum silence.
+    PAYLOAD_ENCODER::ReportOnChange<8> filter;
+    PAYLOAD_ENCODER::CayenneBudgetFrame<BUF_DEFAULT> budgetFrame;
+    filter.configure(0, 0.2f, 3600000UL);
+    filter.configure(5, 0.05f, 3600000UL);
+
+    if (filter.update(0, 21.0f, 0))
+        budgetFrame.stage(3).addTemperature(0, 21.0f);                // 4 bytes
+    if (filter.update(5, 3.3f, 0))
+        budgetFrame.stage(0).addAnalogInput(5, 3.3f);                 // 4 bytes, does not fit
+    budgetFrame.buildWithBudget(6);
+    bool temperatureSent = budgetFrame.contains(0);
+    bool vddSent = budgetFrame.contains(5);
+    for (uint8_t channel = 0; channel < 8; channel++)
+        if (budgetFrame.contains(channel))
+            filter.commit(channel, 0);
+    filter.discard();
+    bool temperatureAgain = filter.update(0, 21.0f, 1000);
+    bool vddAgain = filter.update(5, 3.3f, 1000);
+
+    TEST_ASSERT_TRUE(temperatureSent);
+    TEST_ASSERT_FALSE(vddSent);
+    TEST_ASSERT_FALSE(temperatureAgain);
+    TEST_ASSERT_TRUE(vddAgain);
+}
+
+void test_ReportOnChange_Expire(void) {
+    PAYLOAD_ENCODER::ReportOnChange<8> filter;
+    filter.configure(7, 0.05f, 3600000UL);
+
+    filter.update(7, 0.01f, 0.01f, 0.02f, 0);
+    filter.commit(0);
+    bool unchanged = filter.update(7, 0.01f, 0.01f, 0.02f, 1000);
+    filter.expire(7);
+    bool expired = filter.update(7, 0.01f, 0.01f, 0.02f, 2000);
+    filter.discard(); // Uplink was not sent, the channel stays expired.
+    bool stillExpired = filter.update(7, 0.01f, 0.01f, 0.02f, 3000);
+    filter.commit(3000);
+    bool afterCommit = filter.update(7, 0.01f, 0.01f, 0.02f, 4000);
+
+    TEST_ASSERT_FALSE(unchanged);
+    TEST_ASSERT_TRUE(expired);
+    TEST_ASSERT_TRUE(stillExpired);
+    TEST_ASSERT_FALSE(afterCommit);
+}
+
+// Test StreamingAggregator against statistics computed in double precision
+void test_StreamingAggregator_MatchesReference(void) {
+    PAYLOAD_ENCODER::StreamingAggregator aggregator;
+    uint32_t seed = 12345;
+    int16_t minimum = 32767, maximum = -32768;
+    double sum = 0, sumSquares = 0;
+    const int samples = 5000;
+    for (int i = 0; i < samples; i++) {
+        seed = seed * 1103515245UL + 12345UL;
+        const int16_t sample = static_cast<int16_t>(static_cast<int32_t>((seed >> 16) & 0x0FFF) - 2048); // 12-bit accelerometer counts
+        aggregator.add(sample);
+        minimum = sample < minimum ? sample : minimum;
+        maximum = sample > maximum ? sample : maximum;
+        sum += sample;
+        sumSquares += static_cast<double>(sample) * sample;
+    }
+
+    TEST_ASSERT_EQUAL_UINT16(samples, aggregator.getCount());
+    TEST_ASSERT_EQUAL_INT16(minimum, aggregator.getMin());
+    TEST_ASSERT_EQUAL_INT16(maximum, aggregator.getMax());
+    TEST_ASSERT_INT_WITHIN(1, static_cast<int>(std::lround(sum / samples)), aggregator.getMean());
+    TEST_ASSERT_INT_WITHIN(1, static_cast<int>(std::lround(std::sqrt(sumSquares / samples))), aggregator.getRms());
+}
+
+// Test StreamingAggregator on a full window of the most negative sample, and reset
+void test_StreamingAggregator_FullScaleWindow(void) {
+    PAYLOAD_ENCODER::StreamingAggregator aggregator;
+    for (uint32_t i = 0; i < PAYLOAD_ENCODER::StreamingAggregator::MAX_SAMPLES; i++) {
+        aggregator.add(-32768);
+    }
+    bool accepted = aggregator.add(100);
+
+    TEST_ASSERT_FALSE(accepted);
+    TEST_ASSERT_EQUAL_INT16(-32768, aggregator.getMean());
+    TEST_ASSERT_EQUAL_UINT16(32768, aggregator.getRms());
+    TEST_ASSERT_EQUAL_INT16(-32768, aggregator.getMax());
+
+    aggregator.reset();
+    TEST_ASSERT_EQUAL_UINT16(0, aggregator.getCount());
+    TEST_ASSERT_EQUAL_INT16(0, aggregator.getMean());
+    TEST_ASSERT_EQUAL_UINT16(0, aggregator.getRms());
+}
+
+// Test addAccelerometerSummary writes min, max, mean and RMS on consecutive channels
+void test_StreamingAggregator_AccelerometerSummary(void) {
+    PAYLOAD_ENCODER::StreamingAggregator axes[3];
+    const int16_t samples[] = {-1024, 0, 1024, 2047};
+    for (size_t i = 0; i < 4; i++) {
+        axes[0].add(samples[i]);
+        axes[1].add(static_cast<int16_t>(-samples[i]));
+        axes[2].add(1024);
+    }
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    const float scale = 2.0f / 2048; // +-2g range, 12-bit counts
+
+    uint8_t size = PAYLOAD_ENCODER::addAccelerometerSummary(lpp, 7, axes, scale);
+
+    PAYLOAD_ENCODER::DecodedField fields[4];
+    size_t count = PAYLOAD_ENCODER::CayenneDecoder<4>::decodeUncached(lpp.getBuffer(), lpp.getSize(), fields);
+    TEST_ASSERT_EQUAL_UINT8(32, size);
+    TEST_ASSERT_EQUAL_size_t(4, count);
+    TEST_ASSERT_EQUAL_UINT8(7, fields[0].channel);
+    TEST_ASSERT_EQUAL_UINT8(10, fields[3].channel);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, -1.0f, fields[0].values[0]);   // min x
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, -1.999f, fields[0].values[1]); // min y
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.999f, fields[1].values[0]);  // max x
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.5f, fields[2].values[0]);    // mean x: 2047 / 4 = 511.75 -> 512
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.0f, fields[3].values[2]);    // rms z
+
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> small(30);
+    TEST_ASSERT_EQUAL_UINT8(0, PAYLOAD_ENCODER::addAccelerometerSummary(small, 7, axes, scale));
+    TEST_ASSERT_EQUAL_size_t(0, small.getSize());
+}
+
+// Profile with the KISS frame fields in buildKissFrame order, plus the accelerometer statistics
+static const PAYLOAD_ENCODER::ProfileSlot kissSlots[] = {
+    {3, PAYLOAD_ENCODER::DATA_TYPES::DIG_IN},
+    {0, PAYLOAD_ENCODER::DATA_TYPES::TEMP_SENS},
+    {1, PAYLOAD_ENCODER::DATA_TYPES::HUM_SENS},
+    {2, PAYLOAD_ENCODER::DATA_TYPES::ILLUM_SENS},
+    {4, PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS},
+    {5, PAYLOAD_ENCODER::DATA_TYPES::ANL_IN},
+    {7, PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS},
+    {8, PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS},
+    {9, PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS},
+    {10, PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS},
+};
+static const PAYLOAD_ENCODER::CompactProfile kissProfiles[] = {{1, 10, kissSlots}};
+
+// Test a compact frame drops the headers and expands to the original payload
+void test_CompactFrame_RoundTrip(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    buildKissFrame(lpp, 21.4f);
+    uint8_t compact[BUF_DEFAULT];
+    uint8_t expanded[BUF_DEFAULT];
+
+    size_t compactSize = PAYLOAD_ENCODER::compactFrame(kissProfiles[0], lpp.getBuffer(), lpp.getSize(), compact, sizeof(compact));
+    size_t expandedSize = PAYLOAD_ENCODER::expandCompactFrame(kissProfiles, 1, compact, compactSize, expanded, sizeof(expanded));
+
+    TEST_ASSERT_EQUAL_size_t(lpp.getSize() - 2 * 6 + 3, compactSize); // Profile ID and two bitmap bytes.
+    TEST_ASSERT_EQUAL_UINT8(1, compact[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x3F, compact[1]);
+    TEST_ASSERT_EQUAL_UINT8(0x00, compact[2]);
+    TEST_ASSERT_EQUAL_size_t(lpp.getSize(), expandedSize);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(lpp.getBuffer(), expanded, expandedSize);
+}
+
+// Test a sparse frame is written in slot order and decodes through the profile
+void test_CompactFrame_SparseDecode(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    lpp.addAnalogInput(5, 3.31f);
+    lpp.addTemperature(0, -4.5f);
+    uint8_t compact[BUF_DEFAULT];
+    PAYLOAD_ENCODER::DecodedField fields[10];
+
+    size_t compactSize = PAYLOAD_ENCODER::compactFrame(kissProfiles[0], lpp.getBuffer(), lpp.getSize(), compact, sizeof(compact));
+    size_t count = PAYLOAD_ENCODER::decodeCompactFrame<10>(kissProfiles, 1, compact, compactSize, fields);
+
+    TEST_ASSERT_EQUAL_size_t(3 + 2 + 2, compactSize);
+    TEST_ASSERT_EQUAL_UINT8(0x22, compact[1]); // Slots 1 and 5.
+    TEST_ASSERT_EQUAL_size_t(2, count);
+    TEST_ASSERT_EQUAL_UINT8(0, fields[0].channel);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, -4.5f, fields[0].values[0]);
+    TEST_ASSERT_EQUAL_UINT8(5, fields[1].channel);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 3.31f, fields[1].values[0]);
+}
+
+// Test fields outside the profile and malformed compact frames are rejected
+void test_CompactFrame_Rejects(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    lpp.addTemperature(6, 20.0f); // Channel 6 carries no temperature in the profile.
+    uint8_t compact[BUF_DEFAULT];
+    uint8_t expanded[BUF_DEFAULT];
+    TEST_ASSERT_EQUAL_size_t(0, PAYLOAD_ENCODER::compactFrame(kissProfiles[0], lpp.getBuffer(), lpp.getSize(), compact, sizeof(compact)));
+
+    const uint8_t unknownProfile[] = {2, 0x01, 0x00, 4};
+    const uint8_t truncated[] = {1, 0x02, 0x00, 0xD6};
+    const uint8_t trailing[] = {1, 0x01, 0x00, 4, 0xFF};
+    const uint8_t slotBeyondProfile[] = {1, 0x00, 0x04, 4};
+    TEST_ASSERT_EQUAL_size_t(0, PAYLOAD_ENCODER::expandCompactFrame(kissProfiles, 1, unknownProfile, sizeof(unknownProfile), expanded, sizeof(expanded)));
+    TEST_ASSERT_EQUAL_size_t(0, PAYLOAD_ENCODER::expandCompactFrame(kissProfiles, 1, truncated, sizeof(truncated), expanded, sizeof(expanded)));
+    TEST_ASSERT_EQUAL_size_t(0, PAYLOAD_ENCODER::expandCompactFrame(kissProfiles, 1, trailing, sizeof(trailing), expanded, sizeof(expanded)));
+    TEST_ASSERT_EQUAL_size_t(0, PAYLOAD_ENCODER::expandCompactFrame(kissProfiles, 1, slotBeyondProfile, sizeof(slotBeyondProfile), expanded, sizeof(expanded)));
+}
+
+// Reference byte vectors of the CayenneLPP specification, encoded in the STANDARD mode
+typedef PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT, PAYLOAD_ENCODER::PAYLOAD_ENCODING::STANDARD> StandardLPP;
+
+void test_StandardEncoding_ReferenceVectors(void) {
+    StandardLPP temperatures(BUF_DEFAULT);
+    temperatures.addTemperature(3, 27.2f);
+    temperatures.addTemperature(5, 25.5f);
+    const uint8_t temperaturesExpected[] = {0x03, 0x67, 0x01, 0x10, 0x05, 0x67, 0x00, 0xFF};
+
+    StandardLPP accelerometer(BUF_DEFAULT);
+    accelerometer.addAccelerometer(6, 1.234f, -1.234f, 0.0f);
+    const uint8_t accelerometerExpected[] = {0x06, 0x71, 0x04, 0xD2, 0xFB, 0x2E, 0x00, 0x00};
+
+    StandardLPP gps(BUF_DEFAULT);
+    gps.addGPSLocation(1, 42.3519f, -87.9094f, 10.0f);
+    const uint8_t gpsExpected[] = {0x01, 0x88, 0x06, 0x76, 0x5F, 0xF2, 0x96, 0x0A, 0x00, 0x03, 0xE8};
+
+    StandardLPP scalars(BUF_DEFAULT);
+    scalars.addDigitalInput(1, 100);
+    scalars.addAnalogInput(2, 3.3f);
+    scalars.addIllumination(3, 320);
+    scalars.addHumidity(4, 50.0f);
+    scalars.addBarometer(5, 1013.2f);
+    const uint8_t scalarsExpected[] = {0x01, 0x00, 0x64, 0x02, 0x02, 0x01, 0x4A, 0x03, 0x65, 0x01, 0x40,
+                                       0x04, 0x68, 0x64, 0x05, 0x73, 0x27, 0x94};
+
+    TEST_ASSERT_EQUAL_size_t(sizeof(temperaturesExpected), temperatures.getSize());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(temperaturesExpected, temperatures.getBuffer(), sizeof(temperaturesExpected));
+    TEST_ASSERT_EQUAL_size_t(sizeof(accelerometerExpected), accelerometer.getSize());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(accelerometerExpected, accelerometer.getBuffer(), sizeof(accelerometerExpected));
+    TEST_ASSERT_EQUAL_size_t(sizeof(gpsExpected), gps.getSize());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(gpsExpected, gps.getBuffer(), sizeof(gpsExpected));
+    TEST_ASSERT_EQUAL_size_t(sizeof(scalarsExpected), scalars.getSize());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(scalarsExpected, scalars.getBuffer(), sizeof(scalarsExpected));
+}
+
+// Test the packed int24 GPS store at the ends of its range
+void test_StandardEncoding_GPSInt24(void) {
+    StandardLPP gps(BUF_DEFAULT);
+    gps.addGPSLocation(0, -90.0f, 180.0f, 90000.0f); // Altitude beyond the int24 range saturates.
+    const uint8_t expected[] = {0x00, 0x88, 0xF2, 0x44, 0x60, 0x1B, 0x77, 0x40, 0x7F, 0xFF, 0xFF};
+
+    TEST_ASSERT_EQUAL_size_t(2 + 9, gps.getSize());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, gps.getBuffer(), sizeof(expected));
+}
+
+// Test the STANDARD decoder and validator read the reference vectors
+void test_StandardEncoding_DecodeAndValidate(void) {
+    const uint8_t frame[] = {0x01, 0x88, 0x06, 0x76, 0x5F, 0xF2, 0x96, 0x0A, 0x00, 0x03, 0xE8,
+                             0x06, 0x71, 0x04, 0xD2, 0xFB, 0x2E, 0x00, 0x00,
+                             0x04, 0x68, 0x64};
+    PAYLOAD_ENCODER::CayenneDecoder<4, 4, PAYLOAD_ENCODER::PAYLOAD_ENCODING::STANDARD> decoder;
+    PAYLOAD_ENCODER::DecodedField fields[4];
+
+    size_t count = decoder.decode(frame, sizeof(frame), fields);
+    PAYLOAD_ENCODER::ValidationResult standard = PAYLOAD_ENCODER::validatePayload(frame, sizeof(frame), 255, PAYLOAD_ENCODER::PAYLOAD_ENCODING::STANDARD);
+    PAYLOAD_ENCODER::ValidationResult native = PAYLOAD_ENCODER::validatePayload(frame, sizeof(frame));
+
+    TEST_ASSERT_EQUAL_size_t(3, count);
+    TEST_ASSERT_EQUAL_UINT8(1, fields[0].channel);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 42.3519f, fields[0].values[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, -87.9094f, fields[0].values[1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 10.0f, fields[0].values[2]);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, -1.234f, fields[1].values[1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 50.0f, fields[2].values[0]);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OK), static_cast<uint8_t>(standard.error));
+    TEST_ASSERT_EQUAL_size_t(3, standard.fieldCount);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_UNKOWN_TYPE), static_cast<uint8_t>(native.error));
+}
+
+// Reads the value bytes of the single field in a NATIVE payload
+static int32_t readNativeValue(const uint8_t *buffer, size_t offset, size_t size) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < size; i++) {
+        value |= static_cast<uint32_t>(buffer[offset + i]) << (8 * i);
+    }
+    return size == 2 ? static_cast<int16_t>(value) : static_cast<int32_t>(value);
+}
+
+// Test every signed 16-bit value of every signed scaled type converts exactly, without clipping
+void test_Conversion_ExhaustiveSigned16(void) {
+    const PAYLOAD_ENCODER::DATA_TYPES types[] = {PAYLOAD_ENCODER::DATA_TYPES::ANL_IN, PAYLOAD_ENCODER::DATA_TYPES::ANL_OUT,
+                                                 PAYLOAD_ENCODER::DATA_TYPES::TEMP_SENS, PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS,
+                                                 PAYLOAD_ENCODER::DATA_TYPES::GYRO_SENS};
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    size_t mismatches = 0;
+    for (const PAYLOAD_ENCODER::DATA_TYPES type : types) {
+        const float resolution = PAYLOAD_ENCODER::FLOATING_DATA_RESOLUTION(type);
+        for (int32_t i = -32768; i <= 32767; i++) {
+            const float value = i / resolution;
+            lpp.reset();
+            switch (type) {
+            case PAYLOAD_ENCODER::DATA_TYPES::ANL_IN: lpp.addAnalogInput(0, value); break;
+            case PAYLOAD_ENCODER::DATA_TYPES::ANL_OUT: lpp.addAnalogOutput(0, value); break;
+            case PAYLOAD_ENCODER::DATA_TYPES::TEMP_SENS: lpp.addTemperature(0, value); break;
+            case PAYLOAD_ENCODER::DATA_TYPES::ACCRM_SENS: lpp.addAccelerometer(0, value, -value, 0.0f); break;
+            default: lpp.addGyroscope(0, value, -value, 0.0f); break;
+            }
+            mismatches += readNativeValue(lpp.getBuffer(), 2, 2) != i;
+        }
+    }
+    TEST_ASSERT_EQUAL_size_t(0, mismatches);
+    TEST_ASSERT_EQUAL_UINT16(2, lpp.getClippedCount()); // Only -(-32768) on the second axis, once per three-axis type.
+}
+
+// Test every unsigned 16-bit value of humidity and barometer converts exactly, without clipping
+void test_Conversion_ExhaustiveUnsigned16(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> lpp(BUF_DEFAULT);
+    size_t mismatches = 0;
+    for (int32_t i = 0; i <= 0xFFFF; i++) {
+        lpp.reset();
+        lpp.addHumidity(0, i / 10.0f);
+        mismatches += static_cast<uint16_t>(readNativeValue(lpp.getBuffer(), 2, 2)) != i;
+        lpp.reset();
+        lpp.addBarometer(0, i / 10.0f);
+        mismatches += static_cast<uint16_t>(readNativeValue(lpp.getBuffer(), 2, 2)) != i;
+    }
+    TEST_ASSERT_EQUAL_size_t(0, mismatches);
+    TEST_ASSERT_EQUAL_UINT16(0, lpp.getClippedCount());
+}
+
+// Test the one-byte STANDARD humidity and the GPS ranges in both encodings
+void test_Conversion_ExhaustiveHumidityAndGPS(void) {
+    StandardLPP standard(BUF_DEFAULT);
+    size_t mismatches = 0;
+    for (int32_t i = 0; i <= 0xFF; i++) {
+        standard.reset();
+        standard.addHumidity(0, i / 2.0f);
+        mismatches += standard.getBuffer()[2] != i;
+    }
+
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> native(BUF_DEFAULT);
+    for (int32_t i = -900000; i <= 900000; i += 7) {
+        const int32_t lon = i * 2;
+        const int32_t alt = i;      // +-9 km at 0.01 m, within float precision.
+        native.reset();
+        native.addGPSLocation(0, i / 10000.0f, lon / 10000.0f, alt / 100.0f);
+        mismatches += readNativeValue(native.getBuffer(), 2, 4) != i;
+        mismatches += readNativeValue(native.getBuffer(), 6, 4) != lon;
+        mismatches += readNativeValue(native.getBuffer(), 10, 4) != alt;
+        standard.reset();
+        standard.addGPSLocation(0, i / 10000.0f, lon / 10000.0f, alt / 100.0f);
+        const uint8_t *data = standard.getBuffer() + 2;
+        mismatches += ((static_cast<int32_t>(static_cast<int8_t>(data[0])) << 16) | (data[1] << 8) | data[2]) != i;
+        mismatches += ((static_cast<int32_t>(static_cast<int8_t>(data[6])) << 16) | (data[7] << 8) | data[8]) != alt;
+    }
+    TEST_ASSERT_EQUAL_size_t(0, mismatches);
+    TEST_ASSERT_EQUAL_UINT16(0, standard.getClippedCount());
+    TEST_ASSERT_EQUAL_UINT16(0, native.getClippedCount());
+}
+
+// Test the saturate, wrap and report policies on out-of-range values
+void test_Conversion_Policies(void) {
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT> saturate(BUF_DEFAULT);
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT, PAYLOAD_ENCODER::PAYLOAD_ENCODING::NATIVE, PAYLOAD_ENCODER::CONVERSION_POLICY::WRAP> wrap(BUF_DEFAULT);
+    PAYLOAD_ENCODER::CayenneLPP<BUF_DEFAULT, PAYLOAD_ENCODER::PAYLOAD_ENCODING::NATIVE, PAYLOAD_ENCODER::CONVERSION_POLICY::REPORT> report(BUF_DEFAULT);
+
+    saturate.addBarometer(0, 7000.0f);      // 70000 > 65535
+    saturate.addHumidity(1, -5.0f);         // Unsigned.
+    saturate.addTemperature(2, 4000.0f);    // 40000 > 32767
+    wrap.addBarometer(0, 7000.0f);
+    uint8_t reported = report.addBarometer(0, 7000.0f);
+    uint8_t reportedAxes = report.addAccelerometer(1, 40.0f, 0.0f, -40.0f);
+    uint8_t accepted = report.addBarometer(0, 3300.0f);
+
+    TEST_ASSERT_EQUAL_UINT16(0xFFFF, static_cast<uint16_t>(readNativeValue(saturate.getBuffer(), 2, 2)));
+    TEST_ASSERT_EQUAL_INT32(0, readNativeValue(saturate.getBuffer(), 6, 2));
+    TEST_ASSERT_EQUAL_INT32(32767, readNativeValue(saturate.getBuffer(), 10, 2));
+    TEST_ASSERT_EQUAL_UINT16(3, saturate.getClippedCount());
+    TEST_ASSERT_EQUAL_UINT16(70000 & 0xFFFF, static_cast<uint16_t>(readNativeValue(wrap.getBuffer(), 2, 2)));
+    TEST_ASSERT_EQUAL_UINT16(1, wrap.getClippedCount());
+    TEST_ASSERT_EQUAL_UINT8(0, reported);
+    TEST_ASSERT_EQUAL_UINT8(0, reportedAxes);
+    TEST_ASSERT_EQUAL_UINT8(4, accepted);   // 3300 hPa fits the unsigned range.
+    TEST_ASSERT_EQUAL_UINT16(3, report.getClippedCount());
+    report.resetClippedCount();
+    TEST_ASSERT_EQUAL_UINT16(0, report.getClippedCount());
+}
+
+// Test branch-free rounding half away from zero
+void test_Conversion_RoundHalfAwayFromZero(void) {
+    TEST_ASSERT_EQUAL_INT32(3, PAYLOAD_ENCODER::roundHalfAwayFromZero(2.5f));
+    TEST_ASSERT_EQUAL_INT32(-3, PAYLOAD_ENCODER::roundHalfAwayFromZero(-2.5f));
+    TEST_ASSERT_EQUAL_INT32(0, PAYLOAD_ENCODER::roundHalfAwayFromZero(0.49f));
+    TEST_ASSERT_EQUAL_INT32(-1, PAYLOAD_ENCODER::roundHalfAwayFromZero(-0.5f));
+    TEST_ASSERT_EQUAL_INT32(0, PAYLOAD_ENCODER::roundHalfAwayFromZero(-0.0f));
+    TEST_ASSERT_EQUAL_INT32(2147483520L, PAYLOAD_ENCODER::roundHalfAwayFromZero(1e10f));
+    TEST_ASSERT_EQUAL_INT32(-2147483520L, PAYLOAD_ENCODER::roundHalfAwayFromZero(-1e10f));
+}
+
+// Default configuration for the downlink tests
+static PAYLOAD_ENCODER::DeviceConfig<3> makeDeviceConfig(void) {
+    PAYLOAD_ENCODER::DeviceConfig<3> config = {50000, 50, 3, false, {0.2f, 1.0f, 10.0f}};
+    return config;
+}
+
+// Test a downlink with every command
+void test_Downlink_AppliesAllCommands(void) {
+    PAYLOAD_ENCODER::DeviceConfig<3> config = makeDeviceConfig();
+    const uint8_t downlink[] = {0x01, 0x01, 0x2C,        // Uplink every 300 s
+                                0x02, 0x00, 0x64,        // Sample every 100 ms
+                                0x03, 0x02, 0x01, 0xF4,  // Channel 2 deadband 5.00
+                                0x04, 0x05,              // DR5
+                                0x05};                   // Uplink now
+
+    PAYLOAD_ENCODER::ValidationResult result = PAYLOAD_ENCODER::applyDownlink(downlink, sizeof(downlink), config);
+
+    TEST_ASSERT_EQUAL(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OK, result.error);
+    TEST_ASSERT_EQUAL_size_t(5, result.fieldCount);
+    TEST_ASSERT_EQUAL_UINT32(300000, config.uplinkPeriodMs);
+    TEST_ASSERT_EQUAL_UINT16(100, config.samplePeriodMs);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 5.0f, config.deadband[2]);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.2f, config.deadband[0]);
+    TEST_ASSERT_EQUAL_UINT8(5, config.dataRate);
+    TEST_ASSERT_TRUE(config.uplinkRequested);
+    TEST_ASSERT_EQUAL_UINT8(7, PAYLOAD_ENCODER::getSpreadingFactorEU868(config.dataRate));
+}
+
+// Test that a downlink with one bad command changes nothing
+void test_Downlink_RejectsAtomically(void) {
+    const uint8_t outOfRange[] = {0x01, 0x01, 0x2C, 0x04, 0x06};
+    const uint8_t unknown[] = {0x05, 0x7F};
+    const uint8_t truncated[] = {0x02, 0x00, 0x64, 0x03, 0x01, 0x00};
+    const uint8_t badChannel[] = {0x03, 0x03, 0x00, 0x01};
+    const uint8_t tooFast[] = {0x01, 0x00, 0x09};
+
+    PAYLOAD_ENCODER::DeviceConfig<3> config = makeDeviceConfig();
+    PAYLOAD_ENCODER::ValidationResult result = PAYLOAD_ENCODER::applyDownlink(outOfRange, sizeof(outOfRange), config);
+    TEST_ASSERT_EQUAL(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OUT_OF_RANGE, result.error);
+    TEST_ASSERT_EQUAL_size_t(3, result.offset);
+    result = PAYLOAD_ENCODER::applyDownlink(unknown, sizeof(unknown), config);
+    TEST_ASSERT_EQUAL(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_UNKOWN_TYPE, result.error);
+    TEST_ASSERT_EQUAL_size_t(1, result.offset);
+    result = PAYLOAD_ENCODER::applyDownlink(truncated, sizeof(truncated), config);
+    TEST_ASSERT_EQUAL(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_TRUNCATED, result.error);
+    TEST_ASSERT_EQUAL_size_t(3, result.offset);
+    result = PAYLOAD_ENCODER::applyDownlink(badChannel, sizeof(badChannel), config);
+    TEST_ASSERT_EQUAL(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OUT_OF_RANGE, result.error);
+    result = PAYLOAD_ENCODER::applyDownlink(tooFast, sizeof(tooFast), config);
+    TEST_ASSERT_EQUAL(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OUT_OF_RANGE, result.error);
+
+    const PAYLOAD_ENCODER::DeviceConfig<3> expected = makeDeviceConfig();
+    TEST_ASSERT_EQUAL_UINT32(expected.uplinkPeriodMs, config.uplinkPeriodMs);
+    TEST_ASSERT_EQUAL_UINT16(expected.samplePeriodMs, config.samplePeriodMs);
+    TEST_ASSERT_EQUAL_UINT8(expected.dataRate, config.dataRate);
+    TEST_ASSERT_FALSE(config.uplinkRequested);
+    TEST_ASSERT_EQUAL_MEMORY(expected.deadband, config.deadband, sizeof(config.deadband));
+}
+
+// Test the empty downlink and the spreading factor of every data rate
+void test_Downlink_EmptyAndDataRates(void) {
+    PAYLOAD_ENCODER::DeviceConfig<3> config = makeDeviceConfig();
+    PAYLOAD_ENCODER::ValidationResult result = PAYLOAD_ENCODER::applyDownlink(nullptr, 0, config);
+    TEST_ASSERT_EQUAL(PAYLOAD_ENCODER::ERROR_TYPES::LPP_ERROR_OK, result.error);
+    TEST_ASSERT_EQUAL_size_t(0, result.fieldCount);
+    for (uint8_t sf = 7; sf <= 12; sf++) {
+        TEST_ASSERT_EQUAL_UINT8(sf, PAYLOAD_ENCODER::getSpreadingFactorEU868(PAYLOAD_ENCODER::getDataRateEU868(sf)));
+    }
+}
+
+// Test that a requested uplink reports every field of a node whose inputs did not change
+void test_Downlink_RequestedUplinkReportsAll(void) {
+    PAYLOAD_ENCODER::DeviceConfig<3> config = makeDeviceConfig();
+    PAYLOAD_ENCODER::ReportOnChange<3> filter;
+    PAYLOAD_ENCODER::CayenneBudgetFrame<BUF_DEFAULT> budgetFrame;
+    for (uint8_t channel = 0; channel < 3; channel++)
+        filter.configure(channel, config.deadband[channel], 3600000UL);
+    const float values[3] = {21.0f, 50.0f, 400.0f};
+    const uint8_t request[] = {0x05};
+    size_t sizes[3];
+
+    for (uint8_t cycle = 0; cycle < 3; cycle++) {
+        if (cycle == 2)
+            PAYLOAD_ENCODER::applyDownlink(request, sizeof(request), config);
+        if (config.uplinkRequested)
+            filter.expire();
+        for (uint8_t channel = 0; channel < 3; channel++)
+            if (filter.update(channel, values[channel], cycle * 50000UL))
+                budgetFrame.stage(3).addAnalogInput(channel, values[channel] / 100.0f);
+        sizes[cycle] = budgetFrame.build(config.dataRate).getSize();
+        for (uint8_t channel = 0; channel < 3; channel++)
+            if (budgetFrame.contains(channel))
+                filter.commit(channel, cycle * 50000UL);
+        filter.discard();
+        if (sizes[cycle])
+            config.uplinkRequested = false;
+    }
+
+    TEST_ASSERT_EQUAL_size_t(12, sizes[0]);
+    TEST_ASSERT_EQUAL_size_t(0, sizes[1]);
+    TEST_ASSERT_EQUAL_size_t(12, sizes[2]);
+    TEST_ASSERT_FALSE(config.uplinkRequested);
+}
+
+// Test that trace records drain in order as frames that read back
+void test_Trace_DrainRoundTrip(void) {
+    PAYLOAD_ENCODER::TraceBuffer<4> trace;
+    trace.log(3, 1000, 7);
+    trace.log(5, 1001, -21500);
+    trace.log(11, 0xFFFFFFFFUL, 3300);
+
+    uint8_t frames[2 * PAYLOAD_ENCODER::TRACE_FRAME_SIZE + 5];
+    size_t size = trace.drain(frames, sizeof(frames));    // Room for two frames only.
+    TEST_ASSERT_EQUAL_size_t(2 * PAYLOAD_ENCODER::TRACE_FRAME_SIZE, size);
+    TEST_ASSERT_EQUAL_size_t(1, trace.getCount());
+
+    const uint8_t expected[] = {0xA5, 0x03, 0xE8, 0x03, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x03 ^ 0xE8 ^ 0x03 ^ 0x07};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, frames, sizeof(expected));
+    PAYLOAD_ENCODER::TraceRecord record;
+    TEST_ASSERT_TRUE(PAYLOAD_ENCODER::readTraceFrame(&frames[PAYLOAD_ENCODER::TRACE_FRAME_SIZE], PAYLOAD_ENCODER::TRACE_FRAME_SIZE, record));
+    TEST_ASSERT_EQUAL_UINT8(5, record.event);
+    TEST_ASSERT_EQUAL_UINT32(1001, record.timeMs);
+    TEST_ASSERT_EQUAL_INT32(-21500, record.value);
+
+    size = trace.drain(frames, sizeof(frames));
+    TEST_ASSERT_EQUAL_size_t(PAYLOAD_ENCODER::TRACE_FRAME_SIZE, size);
+    TEST_ASSERT_TRUE(PAYLOAD_ENCODER::readTraceFrame(frames, size, record));
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFUL, record.timeMs);
+    TEST_ASSERT_EQUAL_size_t(0, trace.drain(frames, sizeof(frames)));
+
+    frames[6] ^= 0x01;  // Corrupt the value.
+    TEST_ASSERT_FALSE(PAYLOAD_ENCODER::readTraceFrame(frames, size, record));
+    TEST_ASSERT_FALSE(PAYLOAD_ENCODER::readTraceFrame(frames, size - 1, record));
+}
+
+// Test that a full trace overwrites the oldest records and reports them lost
+void test_Trace_OverwriteReportsLost(void) {
+    PAYLOAD_ENCODER::TraceBuffer<3> trace;
+    for (int32_t i = 0; i < 8; i++) {
+        trace.log(3, 100 + i, i);
+    }
+    TEST_ASSERT_EQUAL_size_t(3, trace.getCount());
+    TEST_ASSERT_EQUAL_UINT16(5, trace.getLostCount());
+
+    uint8_t frames[8 * PAYLOAD_ENCODER::TRACE_FRAME_SIZE];
+    const size_t size = trace.drain(frames, sizeof(frames));
+    TEST_ASSERT_EQUAL_size_t(4 * PAYLOAD_ENCODER::TRACE_FRAME_SIZE, size);
+    PAYLOAD_ENCODER::TraceRecord record;
+    TEST_ASSERT_TRUE(PAYLOAD_ENCODER::readTraceFrame(frames, size, record));
+    TEST_ASSERT_EQUAL_UINT8(PAYLOAD_ENCODER::TRACE_EVENT_LOST, record.event);
+    TEST_ASSERT_EQUAL_INT32(5, record.value);
+    TEST_ASSERT_EQUAL_UINT32(107, record.timeMs);
+    for (int32_t i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(PAYLOAD_ENCODER::readTraceFrame(&frames[(1 + i) * PAYLOAD_ENCODER::TRACE_FRAME_SIZE], PAYLOAD_ENCODER::TRACE_FRAME_SIZE, record));
+        TEST_ASSERT_EQUAL_INT32(5 + i, record.value);
+    }
+    TEST_ASSERT_EQUAL_UINT16(0, trace.getLostCount());
+    TEST_ASSERT_EQUAL_size_t(0, trace.getCount());
+}
+
+// Test that phases book their time and an uplink splits into TX and RX windows
+void test_Energy_PhaseBooking(void) {
+    PAYLOAD_ENCODER::EnergyAccount account;
+    account.begin(PAYLOAD_ENCODER::ENERGY_PHASE::SENSOR_READ, 1000);    // 1 ms ACTIVE before.
+    account.begin(PAYLOAD_ENCODER::ENERGY_PHASE::ENCODE, 201000);
+    account.begin(PAYLOAD_ENCODER::ENERGY_PHASE::TX, 202000);
+    account.endUplink(202000 + 2500000, 300000);                        // 300 ms on air, 2.2 s receiving.
+    account.begin(PAYLOAD_ENCODER::ENERGY_PHASE::IDLE_SLEEP, 2712000);
+    account.update(0xFFFFFFFFUL);                                        // Wrap of micros() is harmless.
+    account.update(2000);
+
+    TEST_ASSERT_EQUAL_UINT64(1000 + 10000, account.getTimeUs(PAYLOAD_ENCODER::ENERGY_PHASE::ACTIVE));
+    TEST_ASSERT_EQUAL_UINT64(200000, account.getTimeUs(PAYLOAD_ENCODER::ENERGY_PHASE::SENSOR_READ));
+    TEST_ASSERT_EQUAL_UINT64(1000, account.getTimeUs(PAYLOAD_ENCODER::ENERGY_PHASE::ENCODE));
+    TEST_ASSERT_EQUAL_UINT64(300000, account.getTimeUs(PAYLOAD_ENCODER::ENERGY_PHASE::TX));
+    TEST_ASSERT_EQUAL_UINT64(2200000, account.getTimeUs(PAYLOAD_ENCODER::ENERGY_PHASE::RX_WINDOW));
+    TEST_ASSERT_EQUAL_UINT64(0x100000000ULL + 2000 - 2712000, account.getTimeUs(PAYLOAD_ENCODER::ENERGY_PHASE::IDLE_SLEEP));
+    TEST_ASSERT_EQUAL_UINT64(0x100000000ULL + 2000, account.getTotalTimeUs());
+    TEST_ASSERT_EQUAL_UINT32(1, account.getUplinkCount());
+}
+
+// Test charge, charge per uplink and battery life against the KISS currents
+void test_Energy_ChargeAndBatteryLife(void) {
+    PAYLOAD_ENCODER::EnergyAccount account;
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, account.getBatteryLifeDays(2400.0f));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, account.getChargePerUplinkMah());
+
+    // One hour: 36 s on air, 3564 s in idle sleep, two uplinks.
+    account.begin(PAYLOAD_ENCODER::ENERGY_PHASE::TX, 0);
+    account.endUplink(18000000, 18000000);
+    account.begin(PAYLOAD_ENCODER::ENERGY_PHASE::TX, 18000000);
+    account.endUplink(36000000, 18000000);
+    account.begin(PAYLOAD_ENCODER::ENERGY_PHASE::IDLE_SLEEP, 36000000);
+    account.update(3600000000UL);
+
+    const float txMah = 52.70f * 0.01f;
+    const float sleepMah = 10.65f * 0.99f;
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, txMah, account.getChargeMah(PAYLOAD_ENCODER::ENERGY_PHASE::TX));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, sleepMah, account.getChargeMah(PAYLOAD_ENCODER::ENERGY_PHASE::IDLE_SLEEP));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, txMah + sleepMah, account.getTotalChargeMah());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, (txMah + sleepMah) / 2, account.getChargePerUplinkMah());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, txMah + sleepMah, account.getAverageCurrentMa());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 2400.0f / (txMah + sleepMah) / 24.0f, account.getBatteryLifeDays(2400.0f));
+}
+
+// Test phase timing: mean and maximum per phase, micros() wrap, end() without begin()
+void test_Profiler_PhaseTiming(void) {
+    PAYLOAD_ENCODER::PhaseProfiler profiler;
+    profiler.begin(PAYLOAD_ENCODER::PROFILE_PHASE::SI7021, 1000);
+    profiler.end(21000);
+    profiler.begin(PAYLOAD_ENCODER::PROFILE_PHASE::SI7021, 0xFFFFF000UL);
+    profiler.end(26000 - 0x1000);                                       // 26 ms across the wrap of micros().
+    profiler.end(90000);                                                // No phase running: ignored.
+    profiler.begin(PAYLOAD_ENCODER::PROFILE_PHASE::SEND, 0);
+    profiler.end(2500000);
+
+    TEST_ASSERT_EQUAL_UINT16(2, profiler.getCount(PAYLOAD_ENCODER::PROFILE_PHASE::SI7021));
+    TEST_ASSERT_EQUAL_UINT32(23000, profiler.getMeanUs(PAYLOAD_ENCODER::PROFILE_PHASE::SI7021));
+    TEST_ASSERT_EQUAL_UINT32(26000, profiler.getMaxUs(PAYLOAD_ENCODER::PROFILE_PHASE::SI7021));
+    TEST_ASSERT_EQUAL_UINT32(2500000, profiler.getMeanUs(PAYLOAD_ENCODER::PROFILE_PHASE::SEND));
+    TEST_ASSERT_EQUAL_UINT32(0, profiler.getMeanUs(PAYLOAD_ENCODER::PROFILE_PHASE::VDD));
+
+    // Totals saturate instead of wrapping.
+    profiler.record(PAYLOAD_ENCODER::PROFILE_PHASE::ENCODE, 0xF0000000UL);
+    profiler.record(PAYLOAD_ENCODER::PROFILE_PHASE::ENCODE, 0xF0000000UL);
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFUL / 2, profiler.getMeanUs(PAYLOAD_ENCODER::PROFILE_PHASE::ENCODE));
+
+    profiler.reset();
+    TEST_ASSERT_EQUAL_UINT16(0, profiler.getCount(PAYLOAD_ENCODER::PROFILE_PHASE::SI7021));
+}
+
+// Test the diagnostics frame: it decodes to the phase durations and the add overflow count
+void test_Profiler_ReportFrame(void) {
+    PAYLOAD_ENCODER::PhaseProfiler profiler;
+    profiler.record(PAYLOAD_ENCODER::PROFILE_PHASE::SI7021, 20000);
+    profiler.record(PAYLOAD_ENCODER::PROFILE_PHASE::SI7021, 30000);
+    profiler.record(PAYLOAD_ENCODER::PROFILE_PHASE::ACCELERATION, 2160);
+    profiler.record(PAYLOAD_ENCODER::PROFILE_PHASE::SEND, 2510000);
+
+    PAYLOAD_ENCODER::CayenneLPP<8> full(8);
+    full.addTemperature(0, 20.0f);
+    TEST_ASSERT_EQUAL_UINT8(8, profiler.countAdd(full.addTemperature(1, 20.0f)));
+    TEST_ASSERT_EQUAL_UINT8(0, profiler.countAdd(full.addTemperature(2, 20.0f)));
+    TEST_ASSERT_EQUAL_UINT16(1, profiler.getAddOverflowCount());
+
+    // Too small for the report: nothing is added.
+    PAYLOAD_ENCODER::CayenneLPP<64> small(42);
+    TEST_ASSERT_EQUAL_UINT8(0, profiler.report(small));
+    TEST_ASSERT_EQUAL_size_t(0, small.getSize());
+
+    PAYLOAD_ENCODER::CayenneLPP<64> lpp(51);
+    TEST_ASSERT_EQUAL_UINT8(PAYLOAD_ENCODER::PhaseProfiler::getReportSize(), profiler.report(lpp));
+    TEST_ASSERT_EQUAL_size_t(43, lpp.getSize());
+
+    PAYLOAD_ENCODER::DecodedField fields[12];
+    TEST_ASSERT_EQUAL_size_t(11, PAYLOAD_ENCODER::CayenneDecoder<12>::decodeUncached(lpp.getBuffer(), lpp.getSize(), fields));
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 25.0f, fields[0].values[0]);      // SI7021 mean, ms.
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 30.0f, fields[1].values[0]);      // SI7021 maximum, ms.
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 2.16f, fields[2].values[0]);      // ACCELERATION mean, ms.
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.0f, fields[4].values[0]);       // VDD did not run.
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 2.51f, fields[8].values[0]);      // SEND mean, s.
+    TEST_ASSERT_EQUAL_UINT8(PAYLOAD_ENCODER::PhaseProfiler::REPORT_OVERFLOW_CHANNEL, fields[10].channel);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(PAYLOAD_ENCODER::DATA_TYPES::DIG_IN), static_cast<uint8_t>(fields[10].type));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, fields[10].values[0]);
+}
+
+// Test that groups dropped for the payload budget add to the overflow count, which saturates
+void test_Profiler_CountsDroppedGroups(void) {
+    PAYLOAD_ENCODER::PhaseProfiler profiler;
+    PAYLOAD_ENCODER::CayenneBudgetFrame<64> frame;
+    frame.stage(0).addTemperature(0, 20.0f);
+    frame.stage(1).addGPSLocation(1, 51.5f, 4.5f, 10.0f);
+    frame.stage(2).addGPSLocation(2, 51.5f, 4.5f, 10.0f);
+    frame.buildWithBudget(20);                                          // Room for the temperature and one GPS group.
+    TEST_ASSERT_EQUAL_UINT8(1, frame.getDroppedCount());
+    profiler.countDropped(frame.getDroppedCount());
+    profiler.countAdd(0);
+    TEST_ASSERT_EQUAL_UINT16(2, profiler.getAddOverflowCount());
+
+    for (uint16_t i = 0; i < 300; i++)
+    {
+        profiler.countDropped(UINT8_MAX);
+    }
+    TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, profiler.getAddOverflowCount());
+    profiler.reset();
+    TEST_ASSERT_EQUAL_UINT16(0, profiler.getAddOverflowCount());
+}
+
+// Test that the first event is due at once and later events wait for the hold-off, then go together
+void test_WakeEvents_HoldOff(void) {
+    const uint8_t button = PAYLOAD_ENCODER::getWakeMask(PAYLOAD_ENCODER::WAKE_SOURCE::BUTTON);
+    const uint8_t motion = PAYLOAD_ENCODER::getWakeMask(PAYLOAD_ENCODER::WAKE_SOURCE::MOTION);
+    PAYLOAD_ENCODER::WakeEvents events(30000);
+    TEST_ASSERT_FALSE(events.isDue(0));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, events.getWaitMs(0));
+
+    events.latch(button);
+    TEST_ASSERT_TRUE(events.isDue(1000));
+    TEST_ASSERT_EQUAL_UINT8(button, events.take(1000));
+    TEST_ASSERT_EQUAL_UINT8(0, events.take(1000));                    // Nothing pending any more.
+
+    events.latch(motion);
+    events.latch(motion | button | 0x80);                              // Unknown bits are ignored.
+    TEST_ASSERT_FALSE(events.isDue(5000));
+    TEST_ASSERT_EQUAL_UINT32(26000, events.getWaitMs(5000));
+    TEST_ASSERT_TRUE(events.isDue(31000));
+    TEST_ASSERT_EQUAL_UINT8(button | motion, events.take(31000));
+
+    // Counts per source include events sent together.
+    TEST_ASSERT_EQUAL_UINT16(2, events.getCount(PAYLOAD_ENCODER::WAKE_SOURCE::BUTTON));
+    TEST_ASSERT_EQUAL_UINT16(2, events.getCount(PAYLOAD_ENCODER::WAKE_SOURCE::MOTION));
+}
+
+// Test events an uplink could not send: they wait for the hold-off again, and millis() wraps
+void test_WakeEvents_RequeueAndWrap(void) {
+    const uint8_t motion = PAYLOAD_ENCODER::getWakeMask(PAYLOAD_ENCODER::WAKE_SOURCE::MOTION);
+    PAYLOAD_ENCODER::WakeEvents events(30000);
+    events.latch(motion);
+    const uint8_t sources = events.take(0xFFFFF000UL);
+    events.requeue(sources);
+    TEST_ASSERT_EQUAL_UINT8(motion, events.getPending());
+    TEST_ASSERT_EQUAL_UINT16(1, events.getCount(PAYLOAD_ENCODER::WAKE_SOURCE::MOTION));
+    TEST_ASSERT_FALSE(events.isDue(1000));                             // 5096 ms after the take, across the wrap.
+    TEST_ASSERT_EQUAL_UINT32(24904, events.getWaitMs(1000));
+    TEST_ASSERT_TRUE(events.isDue(25904));
+
+    events.reset();
+    TEST_ASSERT_EQUAL_UINT8(0, events.getPending());
+    TEST_ASSERT_EQUAL_UINT16(0, events.getCount(PAYLOAD_ENCODER::WAKE_SOURCE::MOTION));
+}
+
+// Test the decimation: 4^n conversions, sum shifted right by n with rounding, clamping and limits
+void test_Oversampling_Decimation(void) {
+    TEST_ASSERT_EQUAL_UINT16(1, PAYLOAD_ENCODER::getOversampleCount(0));
+    TEST_ASSERT_EQUAL_UINT16(64, PAYLOAD_ENCODER::getOversampleCount(3));
+    TEST_ASSERT_EQUAL_UINT16(4096, PAYLOAD_ENCODER::getOversampleCount(9));      // Limited to 6 extra bits.
+    TEST_ASSERT_EQUAL_UINT16(8184, PAYLOAD_ENCODER::getOversampledFullScale(3));
+
+    // Half the conversions one code higher: half an LSB, three bits below the 10-bit code.
+    PAYLOAD_ENCODER::Decimator decimator(3);
+    for (uint16_t i = 0; i < 63; i++)
+    {
+        TEST_ASSERT_FALSE(decimator.add(i % 2 ? 201 : 200));
+    }
+    TEST_ASSERT_EQUAL_UINT16(0, decimator.getResult());                          // Not complete yet.
+    TEST_ASSERT_TRUE(decimator.add(201));
+    TEST_ASSERT_TRUE(decimator.add(1023));                                       // Ignored once complete.
+    TEST_ASSERT_EQUAL_UINT16(1604, decimator.getResult());                       // 200.5 * 8.
+
+    // Full scale, with out-of-range conversions clamped, is the largest 16-bit reading.
+    PAYLOAD_ENCODER::Decimator full(6);
+    while (!full.add(0xFFFF));
+    TEST_ASSERT_EQUAL_UINT16(PAYLOAD_ENCODER::getOversampledFullScale(6), full.getResult());
+
+    // Without extra bits one conversion is the reading.
+    PAYLOAD_ENCODER::Decimator single(0);
+    TEST_ASSERT_TRUE(single.add(517));
+    TEST_ASSERT_EQUAL_UINT16(517, single.getResult());
+    single.reset();
+    TEST_ASSERT_FALSE(single.isComplete());
+}
+
+// Test that dithered conversions resolve a level between two codes, and the supply from the bandgap
+void test_Oversampling_ResolutionAndSupply(void) {
+    // A level of 300.3 codes with +-1 LSB of triangular dither, as a noisy ADC would convert it.
+    const float level = 300.3f;
+    PAYLOAD_ENCODER::Decimator decimator(4);
+    for (uint16_t i = 0; !decimator.isComplete(); i++)
+    {
+        const float dither = (static_cast<float>(i * 37 % 256) + static_cast<float>(i * 101 % 256)) / 256.0f - 1.0f;
+        decimator.add(static_cast<uint16_t>(level + dither + 0.5f));
+    }
+    const float oversampled = static_cast<float>(decimator.getResult()) / 16.0f;
+    TEST_ASSERT_FLOAT_WITHIN(1.0f / 16.0f, level, oversampled);                  // A single conversion reads 300.
+
+    // 3300 mV supply: the 1100 mV bandgap reads a third of full scale.
+    TEST_ASSERT_EQUAL_UINT16(3300, PAYLOAD_ENCODER::getSupplyMv(341, 0, 1100));
+    TEST_ASSERT_EQUAL_UINT16(3300, PAYLOAD_ENCODER::getSupplyMv(2728, 3, 1100));
+    TEST_ASSERT_EQUAL_UINT16(3289, PAYLOAD_ENCODER::getSupplyMv(2737, 3, 1100)); // Nine 13-bit steps of about 1.2 mV.
+    TEST_ASSERT_EQUAL_UINT16(0, PAYLOAD_ENCODER::getSupplyMv(0, 3, 1100));
+}
+
 // Main function
 int main(void) {
     UNITY_BEGIN();
@@ -327,5 +1531,64 @@ int main(void) {
     RUN_TEST(test_CayenneLPP_CopyAssignment);
     RUN_TEST(test_CopyToValidBuffer);
     RUN_TEST(test_CopyToNullBuffer);
+    RUN_TEST(test_CayenneLPP_CopyAssignmentKeepsOperationalSize);
+    RUN_TEST(test_CayenneLPP_MoveConstruction);
+    RUN_TEST(test_CayenneLPP_TriviallyCopyable);
+    RUN_TEST(test_Append_AllFragmentsFit);
+    RUN_TEST(test_Append_CarryOverRemainder);
+    RUN_TEST(test_SetOperationalSize_FromSpreadingFactor);
+    RUN_TEST(test_BudgetFrame_AllFieldsFit);
+    RUN_TEST(test_BudgetFrame_DropsLowPriority);
+    RUN_TEST(test_BudgetFrame_DefersToNextBuild);
+    RUN_TEST(test_BudgetFrame_DropsUnfittableDeferredGroup);
+    RUN_TEST(test_BudgetFrame_StandardEncoding);
+    RUN_TEST(test_Airtime_PublishedValues);
+    RUN_TEST(test_DutyCycle_BlocksWhenCreditSpent);
+    RUN_TEST(test_DutyCycle_SelectsSpreadingFactor);
+    RUN_TEST(test_ReportOnChange_Deadband);
+    RUN_TEST(test_ReportOnChange_MaxSilence);
+    RUN_TEST(test_ReportOnChange_DiscardKeepsReference);
+    RUN_TEST(test_ReportOnChange_CommitsSentChannelsOnly);
+    RUN_TEST(test_ReportOnChange_Expire);
+    RUN_TEST(test_StreamingAggregator_MatchesReference);
+    RUN_TEST(test_StreamingAggregator_FullScaleWindow);
+    RUN_TEST(test_StreamingAggregator_AccelerometerSummary);
+    RUN_TEST(test_CompactFrame_RoundTrip);
+    RUN_TEST(test_CompactFrame_SparseDecode);
+    RUN_TEST(test_CompactFrame_Rejects);
+    RUN_TEST(test_StandardEncoding_ReferenceVectors);
+    RUN_TEST(test_StandardEncoding_GPSInt24);
+    RUN_TEST(test_StandardEncoding_DecodeAndValidate);
+    RUN_TEST(test_Conversion_ExhaustiveSigned16);
+    RUN_TEST(test_Conversion_ExhaustiveUnsigned16);
+    RUN_TEST(test_Conversion_ExhaustiveHumidityAndGPS);
+    RUN_TEST(test_Conversion_Policies);
+    RUN_TEST(test_Conversion_RoundHalfAwayFromZero);
+    RUN_TEST(test_Downlink_AppliesAllCommands);
+    RUN_TEST(test_Downlink_RejectsAtomically);
+    RUN_TEST(test_Downlink_EmptyAndDataRates);
+    RUN_TEST(test_Downlink_RequestedUplinkReportsAll);
+    RUN_TEST(test_Trace_DrainRoundTrip);
+    RUN_TEST(test_Trace_OverwriteReportsLost);
+    RUN_TEST(test_Energy_PhaseBooking);
+    RUN_TEST(test_Energy_ChargeAndBatteryLife);
+    RUN_TEST(test_Profiler_PhaseTiming);
+    RUN_TEST(test_Profiler_ReportFrame);
+    RUN_TEST(test_Profiler_CountsDroppedGroups);
+    RUN_TEST(test_WakeEvents_HoldOff);
+    RUN_TEST(test_WakeEvents_RequeueAndWrap);
+    RUN_TEST(test_Oversampling_Decimation);
+    RUN_TEST(test_Oversampling_ResolutionAndSupply);
+    RUN_TEST(test_Decoder_RoundTrip);
+    RUN_TEST(test_Decoder_LayoutCacheHit);
+    RUN_TEST(test_Decoder_LayoutChangeMisses);
+    RUN_TEST(test_Decoder_MalformedPayload);
+    RUN_TEST(test_Validator_ValidFrame);
+    RUN_TEST(test_Validator_UnknownType);
+    RUN_TEST(test_Validator_Truncated);
+    RUN_TEST(test_Validator_OutOfRange);
+    RUN_TEST(test_Validator_Overflow);
+    RUN_TEST(test_Validator_CountsBeyond255Fields);
+    RUN_TEST(test_Validator_StandardUnknownType);
     UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,437 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file FleetGenerator.hpp
+ * @brief Synthetic uplink traffic of a fleet of KISS nodes, as a reproducible workload.
+ *
+ * Every virtual node runs the frame building of loop() in src/main.cpp: report-on-change with
+ * the deadbands and priorities of include/KissNode.hpp, the accelerometer window summary, the
+ * payload budget of its data rate and, by default, the compact frame on FPort 2. Sensor values take per-node random walks,
+ * uplink periods jitter, and a share of uplinks is heard by several gateways, so the stream
+ * carries duplicates as a network server receives them. Output is ordered by arrival time and
+ * depends only on the configuration and seed.
+ */
+
+#ifndef FLEET_GENERATOR_HPP
+#define FLEET_GENERATOR_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <vector>
+#include "../include/CayenneLPP.hpp"
+#include "../include/CayenneBudgetFrame.hpp"
+#include "../include/CompactFrame.hpp"
+#include "../include/ReportOnChange.hpp"
+#include "../include/StreamingAggregator.hpp"
+#include "../include/KissNode.hpp"
+
+namespace FLEET
+{
+    using namespace PAYLOAD_ENCODER;
+    using namespace KISS;
+
+    const static size_t MAX_PAYLOAD = 64;
+
+    /**
+     * @brief Shape of the fleet and its traffic.
+     */
+    struct FleetConfig
+    {
+        uint32_t nodes = 100000;
+        uint32_t uplinkIntervalMs = 50000;  ///< UPLINK_INTERVAL_MS of the firmware.
+        uint32_t jitterMs = 5000;           ///< Uplink period varies by up to this much either way.
+        float duplicateRatio = 0.3f;        ///< Share of uplinks heard by more than one gateway.
+        uint8_t gateways = 4;               ///< Gateways in range of the fleet, at most 255.
+        bool compact = true;                ///< Send compact frames on FPort 2 when the profile fits.
+        uint64_t seed = 1;
+    };
+
+    /**
+     * @brief One uplink as delivered by one gateway.
+     */
+    struct FleetFrame
+    {
+        uint64_t timeUs;            ///< Arrival time at the network server.
+        uint32_t devAddr;
+        uint16_t fCnt;
+        uint8_t fPort;
+        uint8_t gateway;
+        int16_t rssi;               ///< dBm.
+        int8_t snrQuarterDb;        ///< SNR in 0.25 dB.
+        uint8_t spreadingFactor;
+        uint8_t size;
+        uint8_t payload[MAX_PAYLOAD];
+    };
+
+    /**
+     * @brief Size of the header of a corpus record:
+     * [time u64][devAddr u32][fCnt u16][fPort u8][gateway u8][rssi i16][snr i8][sf u8][size u8],
+     * little-endian, followed by size payload bytes.
+     */
+    const static size_t FLEET_RECORD_HEADER = 21;
+
+    /**
+     * @brief Writes a frame as a corpus record.
+     * @return Size of the record.
+     */
+    inline size_t writeFleetRecord(const FleetFrame &frame, uint8_t *destination)
+    {
+        size_t index = 0;
+        auto put = [&](const uint64_t value, const size_t bytes) {
+            for (size_t i = 0; i < bytes; i++)
+            {
+                destination[index++] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        };
+        put(frame.timeUs, 8);
+        put(frame.devAddr, 4);
+        put(frame.fCnt, 2);
+        put(frame.fPort, 1);
+        put(frame.gateway, 1);
+        put(static_cast<uint16_t>(frame.rssi), 2);
+        put(static_cast<uint8_t>(frame.snrQuarterDb), 1);
+        put(frame.spreadingFactor, 1);
+        put(frame.size, 1);
+        std::memcpy(&destination[index], frame.payload, frame.size);
+        return index + frame.size;
+    }
+
+    /**
+     * @brief Reads a corpus record.
+     * @return Size of the record, 0 if the data is truncated or the payload too large.
+     */
+    inline size_t readFleetRecord(const uint8_t *data, const size_t size, FleetFrame &frame)
+    {
+        if (size < FLEET_RECORD_HEADER || data[20] > MAX_PAYLOAD || size < FLEET_RECORD_HEADER + data[20])
+        {
+            return 0;
+        }
+        auto get = [&](const size_t offset, const size_t bytes) {
+            uint64_t value = 0;
+            for (size_t i = 0; i < bytes; i++)
+            {
+                value |= static_cast<uint64_t>(data[offset + i]) << (8 * i);
+            }
+            return value;
+        };
+        frame.timeUs = get(0, 8);
+        frame.devAddr = static_cast<uint32_t>(get(8, 4));
+        frame.fCnt = static_cast<uint16_t>(get(12, 2));
+        frame.fPort = data[14];
+        frame.gateway = data[15];
+        frame.rssi = static_cast<int16_t>(get(16, 2));
+        frame.snrQuarterDb = static_cast<int8_t>(data[18]);
+        frame.spreadingFactor = data[19];
+        frame.size = data[20];
+        std::memcpy(frame.payload, &data[FLEET_RECORD_HEADER], frame.size);
+        return FLEET_RECORD_HEADER + frame.size;
+    }
+
+    /**
+     * @brief splitmix64: 8 bytes of state per node, so 100k nodes stay cheap.
+     */
+    struct Random
+    {
+        uint64_t state;
+
+        uint64_t next()
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+
+        /// Uniform in [0, 1).
+        float uniform()
+        {
+            return static_cast<float>(next() >> 40) / static_cast<float>(1ULL << 24);
+        }
+
+        /// Standard normal, Box-Muller.
+        float normal()
+        {
+            const float u = uniform() + 1.0f / (1 << 25);
+            return std::sqrt(-2.0f * std::log(u)) * std::cos(6.2831853f * uniform());
+        }
+    };
+
+    /**
+     * @brief Generates the traffic of a fleet in arrival order.
+     */
+    class FleetGenerator
+    {
+    public:
+        explicit FleetGenerator(const FleetConfig &config) : config(config), nodes(config.nodes)
+        {
+            Random seeder = {config.seed};
+            for (uint32_t i = 0; i < config.nodes; i++)
+            {
+                Node &node = nodes[i];
+                node.random.state = seeder.next();
+                node.devAddr = 0x26000000UL | (i & 0x01FFFFFFUL);
+                node.fCnt = 0;
+                node.spreadingFactor = pickSpreadingFactor(node.random.uniform());
+                node.temperatureBase = 15.0f + 10.0f * node.random.uniform();
+                node.temperature = node.temperatureBase;
+                node.humidity = 35.0f + 30.0f * node.random.uniform();
+                node.daylight = 200.0f + 800.0f * node.random.uniform();
+                node.rotary = static_cast<uint8_t>(node.random.next() % 10);
+                node.vdd = 3.2f + 0.15f * node.random.uniform();
+                node.motion = 0.0f;
+                node.firstUplink = true;
+                node.rssiBase = static_cast<int16_t>(-125 + static_cast<int>(55.0f * node.random.uniform()));
+                for (uint8_t channel = 0; channel < REPORT_CHANNELS; channel++)
+                {
+                    node.filter.configure(channel, REPORT_DEADBANDS[channel], REPORT_MAX_SILENCE_MS);
+                }
+                const uint64_t first = static_cast<uint64_t>(node.random.uniform() * config.uplinkIntervalMs * 1000.0f);
+                uplinks.push({first, i});
+            }
+        }
+
+        /**
+         * @brief Produces the next delivery in arrival order.
+         *
+         * @param frame The frame.
+         * @return bool False if the fleet is empty.
+         */
+        bool next(FleetFrame &frame)
+        {
+            // Deliveries may only leave once no uplink that is still to be generated can arrive earlier.
+            while (!uplinks.empty() && (deliveries.empty() || uplinks.top().timeUs <= deliveries.top().timeUs))
+            {
+                const Scheduled scheduled = uplinks.top();
+                uplinks.pop();
+                transmit(scheduled.timeUs, nodes[scheduled.node]);
+                Node &node = nodes[scheduled.node];
+                const int64_t jitterUs = static_cast<int64_t>((2.0f * node.random.uniform() - 1.0f) * config.jitterMs * 1000.0f);
+                uplinks.push({scheduled.timeUs + static_cast<uint64_t>(static_cast<int64_t>(config.uplinkIntervalMs) * 1000 + jitterUs), scheduled.node});
+            }
+            if (deliveries.empty())
+            {
+                return false;
+            }
+            frame = deliveries.top().frame;
+            deliveries.pop();
+            return true;
+        }
+
+        uint64_t getUplinkCount(void) const { return uplinkCount; }
+        uint64_t getDuplicateCount(void) const { return duplicateCount; }
+
+    private:
+        struct Node
+        {
+            Random random;
+            ReportOnChange<REPORT_CHANNELS> filter;
+            StreamingAggregator window[3];  ///< Accelerometer samples since the last summary.
+            uint32_t devAddr;
+            uint16_t fCnt;
+            uint8_t spreadingFactor;
+            uint8_t rotary;
+            float temperatureBase;
+            float temperature;
+            float humidity;
+            float daylight;
+            float vdd;
+            float motion;
+            int16_t rssiBase;
+            bool firstUplink;
+        };
+
+        struct Scheduled
+        {
+            uint64_t timeUs;
+            uint32_t node;
+            bool operator>(const Scheduled &other) const { return timeUs > other.timeUs; }
+        };
+
+        struct Delivery
+        {
+            uint64_t timeUs;
+            FleetFrame frame;
+            bool operator>(const Delivery &other) const { return timeUs > other.timeUs; }
+        };
+
+        FleetConfig config;
+        std::vector<Node> nodes;
+        std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<Scheduled>> uplinks;
+        std::priority_queue<Delivery, std::vector<Delivery>, std::greater<Delivery>> deliveries;
+        CayenneBudgetFrame<MAX_PAYLOAD> builder;
+        uint64_t uplinkCount = 0;
+        uint64_t duplicateCount = 0;
+
+        static uint8_t channel(const NodeSensors sensor)
+        {
+            return static_cast<uint8_t>(sensor);
+        }
+
+        static uint8_t priority(const FieldPriority fieldPriority)
+        {
+            return static_cast<uint8_t>(fieldPriority);
+        }
+
+        // ADR spread of a typical deployment: most nodes close enough for SF7.
+        static uint8_t pickSpreadingFactor(const float u)
+        {
+            const float cumulative[] = {0.40f, 0.60f, 0.75f, 0.85f, 0.93f};
+            uint8_t sf = 7;
+            while (sf < 12 && u >= cumulative[sf - 7])
+            {
+                sf++;
+            }
+            return sf;
+        }
+
+        // One step of every random walk over an uplink period.
+        static void walk(Node &node)
+        {
+            Random &random = node.random;
+            node.temperature += 0.1f * random.normal() + 0.05f * (node.temperatureBase - node.temperature);
+            node.humidity += 0.6f * random.normal();
+            node.humidity = node.humidity < 5.0f ? 5.0f : (node.humidity > 99.0f ? 99.0f : node.humidity);
+            if (random.uniform() < 0.01f)
+            {
+                node.rotary = static_cast<uint8_t>(random.next() % 10);
+            }
+            if (node.motion > 0.0f ? random.uniform() < 0.3f : random.uniform() < 0.05f)
+            {
+                node.motion = node.motion > 0.0f ? 0.0f : 0.2f + 0.6f * random.uniform();
+            }
+            node.vdd -= random.uniform() < 0.01f ? 0.001f : 0.0f;
+        }
+
+        float luminosity(Node &node, const uint64_t timeUs)
+        {
+            const double day = std::sin(6.283185307 * static_cast<double>(timeUs % 86400000000ULL) / 86400e6);
+            const float light = static_cast<float>(day > 0.0 ? day : 0.0) * node.daylight + 2.0f + 5.0f * node.random.uniform();
+            return light;
+        }
+
+        // Build the payload as loop() does, then deliver it through one or more gateways.
+        void transmit(const uint64_t timeUs, Node &node)
+        {
+            walk(node);
+            const uint32_t nowMs = static_cast<uint32_t>(timeUs / 1000);
+            const float lux = luminosity(node, timeUs);
+
+            // A few synthetic accelerometer samples per axis for the period. They are the reading of
+            // this uplink and, except before the first uplink, go into the window of the summary.
+            StreamingAggregator period[3];
+            for (int sample = 0; sample < 16; sample++)
+            {
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    const float rest = axis == 2 ? 1024.0f : 0.0f;
+                    const float counts = rest + node.motion * 1024.0f * std::sin(0.7f * sample + axis) + 4.0f * node.random.normal();
+                    period[axis].add(static_cast<int16_t>(counts));
+                    if (!node.firstUplink)
+                    {
+                        node.window[axis].add(static_cast<int16_t>(counts));
+                    }
+                }
+            }
+            node.firstUplink = false;
+            const float scale = 2.0f / (1 << 11);
+            const float x = period[0].getMean() * scale;
+            const float y = period[1].getMean() * scale;
+            const float z = period[2].getMean() * scale;
+            float swing[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                swing[axis] = (node.window[axis].getMax() - node.window[axis].getMin()) * scale;
+            }
+
+            if (node.filter.update(channel(NodeSensors::LPP_CH_ROTARYSWITCH), node.rotary, nowMs))
+                builder.stage(priority(FieldPriority::PRIO_INPUT)).addDigitalInput(channel(NodeSensors::LPP_CH_ROTARYSWITCH), node.rotary);
+            if (node.filter.update(channel(NodeSensors::LPP_CH_TEMPERATURE), node.temperature, nowMs))
+                builder.stage(priority(FieldPriority::PRIO_ENVIRONMENT)).addTemperature(channel(NodeSensors::LPP_CH_TEMPERATURE), node.temperature);
+            if (node.filter.update(channel(NodeSensors::LPP_CH_HUMIDITY), node.humidity, nowMs))
+                builder.stage(priority(FieldPriority::PRIO_ENVIRONMENT)).addHumidity(channel(NodeSensors::LPP_CH_HUMIDITY), node.humidity);
+            if (node.filter.update(channel(NodeSensors::LPP_CH_LUMINOSITY), lux, nowMs))
+                builder.stage(priority(FieldPriority::PRIO_ENVIRONMENT)).addIllumination(channel(NodeSensors::LPP_CH_LUMINOSITY), lux);
+            if (node.filter.update(channel(NodeSensors::LPP_CH_ACCELEROMETER), x, y, z, nowMs))
+                builder.stage(priority(FieldPriority::PRIO_MOTION)).addAccelerometer(channel(NodeSensors::LPP_CH_ACCELEROMETER), x, y, z);
+            if (node.filter.update(channel(NodeSensors::LPP_CH_BOARDVCCVOLTAGE), node.vdd, nowMs))
+                builder.stage(priority(FieldPriority::PRIO_DIAGNOSTICS)).addAnalogInput(channel(NodeSensors::LPP_CH_BOARDVCCVOLTAGE), node.vdd);
+            if (node.window[0].getCount() > 0 && node.filter.update(channel(NodeSensors::LPP_CH_ACC_MIN), swing[0], swing[1], swing[2], nowMs))
+                addAccelerometerSummary(builder.stage(priority(FieldPriority::PRIO_MOTION)), channel(NodeSensors::LPP_CH_ACC_MIN), node.window, scale);
+            const CayenneLPP<MAX_PAYLOAD> &lpp = builder.build(static_cast<uint8_t>(12 - node.spreadingFactor));
+
+            // As after an uplink of the firmware: only channels in the frame count as reported.
+            for (uint8_t channel = 0; channel < REPORT_CHANNELS; channel++)
+            {
+                if (builder.contains(channel))
+                {
+                    node.filter.commit(channel, nowMs);
+                }
+            }
+            node.filter.discard();
+            if (builder.contains(channel(NodeSensors::LPP_CH_ACC_MIN)))
+            {
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    node.window[axis].reset();
+                }
+            }
+            if (lpp.getSize() == 0)
+            {
+                return;
+            }
+
+            FleetFrame frame;
+            frame.devAddr = node.devAddr;
+            frame.fCnt = node.fCnt++;
+            frame.spreadingFactor = node.spreadingFactor;
+            frame.fPort = FPORT_CAYENNE;
+            frame.size = static_cast<uint8_t>(lpp.getSize());
+            lpp.copy(frame.payload);
+            if (config.compact)
+            {
+                uint8_t compact[MAX_PAYLOAD];
+                const size_t compactSize = compactFrame(KISS_PROFILE, frame.payload, frame.size, compact, sizeof(compact));
+                if (compactSize)
+                {
+                    std::memcpy(frame.payload, compact, compactSize);
+                    frame.size = static_cast<uint8_t>(compactSize);
+                    frame.fPort = FPORT_COMPACT;
+                }
+            }
+            uplinkCount++;
+
+            // The first gateway always hears it; more gateways hear a share of uplinks.
+            const uint8_t gatewayCount = config.gateways ? config.gateways : 1;
+            uint8_t copies = 1;
+            if (gatewayCount > 1 && node.random.uniform() < config.duplicateRatio)
+            {
+                copies = static_cast<uint8_t>(2 + node.random.next() % (gatewayCount - 1));
+            }
+            const uint8_t firstGateway = static_cast<uint8_t>(node.devAddr % gatewayCount);
+            for (uint8_t copy = 0; copy < copies; copy++)
+            {
+                Delivery delivery;
+                delivery.frame = frame;
+                delivery.frame.gateway = static_cast<uint8_t>((firstGateway + copy) % gatewayCount);
+                delivery.frame.rssi = static_cast<int16_t>(node.rssiBase - 6 * copy + static_cast<int>(3.0f * node.random.normal()));
+                const float snr = (delivery.frame.rssi + 120) / 2.0f + 1.5f * node.random.normal();
+                delivery.frame.snrQuarterDb = static_cast<int8_t>(std::lround((snr < -20.0f ? -20.0f : (snr > 15.0f ? 15.0f : snr)) * 4));
+                // Backhaul latency per gateway.
+                delivery.timeUs = timeUs + 20000 + static_cast<uint64_t>(node.random.uniform() * (copy ? 200000.0f : 30000.0f));
+                delivery.frame.timeUs = delivery.timeUs;
+                deliveries.push(delivery);
+            }
+            duplicateCount += copies - 1;
+        }
+    };
+} // namespace FLEET
+
+#endif // FLEET_GENERATOR_HPP
@@ -0,0 +1,158 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file fleet_gen.cpp
+ * @brief Generates the uplink traffic of a fleet of virtual KISS nodes (tools/FleetGenerator.hpp).
+ *
+ * Writes a corpus of records in arrival order, either as fast as possible or paced to a target
+ * rate in frames per second, so a server can be fed a steady stream through a pipe or FIFO.
+ * Build and run from the repository root:
+ *   g++ -std=c++17 -O2 -Iinclude tools/fleet_gen.cpp -o fleet_gen
+ *   ./fleet_gen --nodes 100000 --duration 600 --out fleet.bin
+ *   ./fleet_gen --frames 1000000 --rate 20000 --out - | consumer
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "FleetGenerator.hpp"
+
+namespace
+{
+    struct Options
+    {
+        FLEET::FleetConfig fleet;
+        uint64_t frames = 0;            ///< Stop after this many frames, 0 for no limit.
+        double durationS = 0.0;         ///< Stop after this much fleet time, 0 for no limit.
+        double rate = 0.0;              ///< Frames per second of wall time, 0 for as fast as possible.
+        const char *outPath = nullptr;
+    };
+
+    void usage(const char *program)
+    {
+        std::fprintf(stderr,
+                     "usage: %s [--nodes N] [--interval-ms MS] [--jitter-ms MS] [--duplicates RATIO] [--gateways N]\n"
+                     "          [--classic] [--seed N] [--frames N] [--duration S] [--rate FPS] --out FILE|-\n",
+                     program);
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--nodes") && hasValue)
+            options.fleet.nodes = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--interval-ms") && hasValue)
+            options.fleet.uplinkIntervalMs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--jitter-ms") && hasValue)
+            options.fleet.jitterMs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--duplicates") && hasValue)
+            options.fleet.duplicateRatio = std::strtof(argv[++i], nullptr);
+        else if (!std::strcmp(argv[i], "--gateways") && hasValue)
+            options.fleet.gateways = static_cast<uint8_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--classic"))
+            options.fleet.compact = false;
+        else if (!std::strcmp(argv[i], "--seed") && hasValue)
+            options.fleet.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--frames") && hasValue)
+            options.frames = std::strtoull(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--duration") && hasValue)
+            options.durationS = std::strtod(argv[++i], nullptr);
+        else if (!std::strcmp(argv[i], "--rate") && hasValue)
+            options.rate = std::strtod(argv[++i], nullptr);
+        else if (!std::strcmp(argv[i], "--out") && hasValue)
+            options.outPath = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!options.outPath || options.fleet.nodes == 0 || options.fleet.jitterMs >= options.fleet.uplinkIntervalMs ||
+        (options.frames == 0 && options.durationS <= 0.0 && options.rate <= 0.0))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *out = std::strcmp(options.outPath, "-") ? std::fopen(options.outPath, "wb") : stdout;
+    if (!out)
+    {
+        std::perror(options.outPath);
+        return 1;
+    }
+
+    const auto setupStart = std::chrono::steady_clock::now();
+    FLEET::FleetGenerator generator(options.fleet);
+    const auto start = std::chrono::steady_clock::now();
+
+    // Paced output goes out in batches of about a millisecond, so the sleeps stay coarse.
+    const uint64_t batch = options.rate > 0.0 ? static_cast<uint64_t>(options.rate / 1000.0) + 1 : 1024;
+    const uint64_t endUs = static_cast<uint64_t>(options.durationS * 1e6);
+    std::vector<uint8_t> buffer;
+    buffer.reserve(batch * (FLEET::FLEET_RECORD_HEADER + FLEET::MAX_PAYLOAD));
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t lastUs = 0;
+    FLEET::FleetFrame frame;
+    bool running = true;
+    while (running)
+    {
+        buffer.clear();
+        for (uint64_t i = 0; i < batch; i++)
+        {
+            if ((options.frames && frames == options.frames) || !generator.next(frame) || (endUs && frame.timeUs >= endUs))
+            {
+                running = false;
+                break;
+            }
+            const size_t offset = buffer.size();
+            buffer.resize(offset + FLEET::FLEET_RECORD_HEADER + frame.size);
+            FLEET::writeFleetRecord(frame, &buffer[offset]);
+            lastUs = frame.timeUs;
+            frames++;
+        }
+        if (std::fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size())
+        {
+            std::perror(options.outPath);
+            return 1;
+        }
+        bytes += buffer.size();
+        if (options.rate > 0.0)
+        {
+            std::fflush(out);
+            std::this_thread::sleep_until(start + std::chrono::microseconds(static_cast<uint64_t>(frames * 1e6 / options.rate)));
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+    else
+    {
+        std::fflush(out);
+    }
+
+    const double setupS = std::chrono::duration<double>(start - setupStart).count();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::fprintf(stderr, "%u nodes set up in %.2f s\n", options.fleet.nodes, setupS);
+    std::fprintf(stderr, "%llu frames (%llu uplinks, %llu duplicates), %llu bytes, %.3f s of fleet time\n",
+                 static_cast<unsigned long long>(frames), static_cast<unsigned long long>(generator.getUplinkCount()),
+                 static_cast<unsigned long long>(generator.getDuplicateCount()), static_cast<unsigned long long>(bytes),
+                 lastUs / 1e6);
+    std::fprintf(stderr, "%.2f s wall time, %.0f frames/s\n", seconds, seconds > 0.0 ? frames / seconds : 0.0);
+    return 0;
+}
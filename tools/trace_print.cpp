@@ -0,0 +1,164 @@
+/* This code is free software:
+ * you can redistribute it and/or modify it under the terms of a Creative
+ * Commons Attribution-NonCommercial 4.0 International License
+ * (http://creativecommons.org/licenses/by-nc/4.0/)
+ *
+ * Copyright (c) 2024 March by Klaasjan Wagenaar, Tristan Bosveld and Richard Kroesen
+ */
+
+/**
+ * @file trace_print.cpp
+ * @brief Pretty-prints the binary trace of the KISS node firmware.
+ *
+ * Reads a capture of the debug serial port from a file or stdin. Trace frames are decoded
+ * with the event table of src/TraceEvents.hpp; any other bytes, e.g. the text the TTN library
+ * prints, are passed through. Build and run from the repository root:
+ *   g++ -std=c++17 -Iinclude -Isrc tools/trace_print.cpp -o trace_print
+ *   ./trace_print capture.bin        (or: cat /dev/ttyACM0 | ./trace_print)
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "../include/TraceBuffer.hpp"
+#include "../src/TraceEvents.hpp"
+
+using namespace PAYLOAD_ENCODER;
+
+namespace
+{
+    enum class Format
+    {
+        NONE,       // No value.
+        INTEGER,    // Value as is.
+        MILLI,      // Value in thousandths.
+        UPLINK      // size | SF << 8 | FPort << 16.
+    };
+
+    struct EventInfo
+    {
+        const char *name;
+        const char *unit;
+        Format format;
+    };
+
+    EventInfo describe(const uint8_t event)
+    {
+        switch (static_cast<TraceEvent>(event))
+        {
+        case TraceEvent::TRACE_LOST:                return {"records lost", "", Format::INTEGER};
+        case TraceEvent::TRACE_STATUS:              return {"-- STATUS", "", Format::NONE};
+        case TraceEvent::TRACE_JOIN:                return {"-- JOIN", "", Format::NONE};
+        case TraceEvent::TRACE_LOOP:                return {"-- LOOP", "", Format::INTEGER};
+        case TraceEvent::TRACE_HUMIDITY:            return {"humidity", "%RH", Format::MILLI};
+        case TraceEvent::TRACE_TEMPERATURE:         return {"temperature", "C", Format::MILLI};
+        case TraceEvent::TRACE_LUMINOSITY:          return {"ambient light", "lux", Format::MILLI};
+        case TraceEvent::TRACE_ROTARY:              return {"rotary position", "", Format::INTEGER};
+        case TraceEvent::TRACE_ACC_X:               return {"acceleration x", "g", Format::MILLI};
+        case TraceEvent::TRACE_ACC_Y:               return {"acceleration y", "g", Format::MILLI};
+        case TraceEvent::TRACE_ACC_Z:               return {"acceleration z", "g", Format::MILLI};
+        case TraceEvent::TRACE_VDD:                 return {"RN2483 voltage", "mV", Format::INTEGER};
+        case TraceEvent::TRACE_FIELDS_DROPPED:      return {"fields dropped", "", Format::INTEGER};
+        case TraceEvent::TRACE_UPLINK_SENT:         return {"uplink sent", "", Format::UPLINK};
+        case TraceEvent::TRACE_UPLINK_UNCHANGED:    return {"nothing changed: uplink skipped", "", Format::NONE};
+        case TraceEvent::TRACE_UPLINK_DUTY_CYCLE:   return {"duty cycle: uplink skipped, wait", "ms", Format::INTEGER};
+        case TraceEvent::TRACE_DOWNLINK_IGNORED:    return {"downlink ignored, port", "", Format::INTEGER};
+        case TraceEvent::TRACE_DOWNLINK_REJECTED:   return {"downlink rejected at byte", "", Format::INTEGER};
+        case TraceEvent::TRACE_DOWNLINK_APPLIED:    return {"downlink commands applied", "", Format::INTEGER};
+        case TraceEvent::TRACE_ACC_NOT_INITIALIZED: return {"accelerometer not initialized, who-am-i", "", Format::INTEGER};
+        case TraceEvent::TRACE_CHARGE:              return {"charge since previous uplink", "mAh", Format::MILLI};
+        case TraceEvent::TRACE_WAKE:                return {"wake sources (1 button, 2 motion)", "", Format::INTEGER};
+        }
+        return {nullptr, "", Format::INTEGER};
+    }
+
+    void printRecord(const TraceRecord &record)
+    {
+        const EventInfo info = describe(record.event);
+        std::printf("[%7lu.%03lu] ", static_cast<unsigned long>(record.timeMs / 1000),
+                    static_cast<unsigned long>(record.timeMs % 1000));
+        if (info.name)
+        {
+            std::printf("%s", info.name);
+        }
+        else
+        {
+            std::printf("event %u", record.event);
+        }
+
+        switch (info.format)
+        {
+        case Format::NONE:
+            break;
+        case Format::INTEGER:
+            std::printf(": %ld %s", static_cast<long>(record.value), info.unit);
+            break;
+        case Format::MILLI:
+        {
+            const long magnitude = record.value < 0 ? -static_cast<long>(record.value) : static_cast<long>(record.value);
+            std::printf(": %s%ld.%03ld %s", record.value < 0 ? "-" : "", magnitude / 1000, magnitude % 1000, info.unit);
+            break;
+        }
+        case Format::UPLINK:
+        {
+            const uint32_t value = static_cast<uint32_t>(record.value);
+            std::printf(": %lu bytes, SF%lu, FPort %lu", static_cast<unsigned long>(value & 0xFF),
+                        static_cast<unsigned long>((value >> 8) & 0xFF), static_cast<unsigned long>((value >> 16) & 0xFF));
+            break;
+        }
+        }
+        std::printf("\n");
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    FILE *input = argc > 1 ? std::fopen(argv[1], "rb") : stdin;
+    if (!input)
+    {
+        std::perror(argv[1]);
+        return 1;
+    }
+
+    // Bytes that did not form a frame yet; text is printed as soon as it cannot start one.
+    std::vector<uint8_t> pending;
+    size_t frames = 0;
+    size_t invalid = 0;
+    int c;
+    while ((c = std::fgetc(input)) != EOF)
+    {
+        pending.push_back(static_cast<uint8_t>(c));
+        while (!pending.empty())
+        {
+            if (pending[0] != TRACE_SYNC)
+            {
+                std::putchar(pending[0]);
+                pending.erase(pending.begin());
+                continue;
+            }
+            if (pending.size() < TRACE_FRAME_SIZE)
+            {
+                break;
+            }
+            TraceRecord record;
+            if (readTraceFrame(pending.data(), pending.size(), record))
+            {
+                printRecord(record);
+                pending.erase(pending.begin(), pending.begin() + TRACE_FRAME_SIZE);
+                frames++;
+            }
+            else
+            {
+                // Not a frame after all: skip the sync byte and resynchronise.
+                pending.erase(pending.begin());
+                invalid++;
+            }
+        }
+    }
+    if (input != stdin)
+    {
+        std::fclose(input);
+    }
+    std::fprintf(stderr, "%zu frames, %zu bytes skipped, %zu bytes incomplete\n", frames, invalid, pending.size());
+    return 0;
+}